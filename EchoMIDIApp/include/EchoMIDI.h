@@ -14,9 +14,12 @@
 #include <iostream>
 #include <type_traits>
 #include <fstream>
+#include <chrono>
 
 #include "Echoer.h"
 #include "FocusHook.h"
+#include "DeviceWatcher.h"
+#include "FileWatcher.h"
 
 
 #include "EchoManager.h"
@@ -309,8 +312,8 @@ public:
 		m_midi_output_frame = new wxStaticBoxSizer(wxVERTICAL, this, "MIDI Outputs [NONE]");
 		m_midi_outputs = new MidiOutputsTable(m_midi_output_frame->GetStaticBox(), m_manager);
 
-		if(std::filesystem::exists("EchoMidiDevProps.json"))
-			m_manager.loadFromFile("EchoMidiDevProps.json");
+		if(std::filesystem::exists(PRESET_FILE))
+			m_manager.loadFromFile(PRESET_FILE);
 
 		m_manager.syncMidiDevices();
 
@@ -331,6 +334,51 @@ public:
 		m_midi_inputs->getList()->Bind(wxEVT_DATAVIEW_ITEM_ACTIVATED, &EchoMidiWindow::onInputSelect, this);
 
 		SetSizerAndFit(m_sizer);
+
+		// plugged in or removed devices are handled as soon as the os reports them, only the changed devices are touched.
+		// the watcher calls back from its own thread, so the devices are rescanned and the echoers remapped together on the ui thread.
+		m_device_watcher = std::make_unique<EchoMIDI::DeviceWatcher>([this]()
+			{
+				CallAfter([this]()
+					{
+						if (!m_manager.rescanDevices())
+							return;
+
+						m_midi_inputs->updateTable();
+						m_midi_outputs->updateTable();
+					});
+			});
+
+		// edits to the preset on disk are applied whilst running, e.g. when switching setups between songs.
+		// the watcher calls back from its own thread, so the preset is reloaded on the ui thread.
+		m_preset_watcher = std::make_unique<EchoMIDI::FileWatcher>(PRESET_FILE, [this]()
+			{
+				CallAfter([this]() { reloadPreset(); });
+			});
+	}
+
+	// only the routes that changed are touched, if the preset cannot be applied, the previous setup keeps running.
+	void reloadPreset()
+	{
+		auto reload_start = std::chrono::steady_clock::now();
+
+		try
+		{
+			EchoManager::PresetChanges changes = m_manager.loadFromFile(PRESET_FILE, false);
+
+			int64_t reload_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - reload_start).count();
+
+			ECHOMIDI_LOG(LogLevel::INFO, "preset reloaded in us, with added, changed and removed routes", PRESET_FILE,
+				{ reload_us, (int64_t)changes.added_routes, (int64_t)changes.changed_routes, (int64_t)changes.removed_routes });
+		}
+		catch (std::exception& e)
+		{
+			ECHOMIDI_LOG(LogLevel::WARN, "could not reload the preset", e.what());
+			printExcept(e);
+		}
+
+		m_midi_inputs->updateTable();
+		m_midi_outputs->updateTable();
 	}
 
 	void onInputSelect(wxDataViewEvent& e)
@@ -346,15 +394,23 @@ public:
 
 	~EchoMidiWindow()
 	{
-		m_manager.saveToFile("EchoMidiDevProps.json");
+		// no changes may be reported whilst the manager is being saved, and saving must not trigger a reload.
+		m_device_watcher.reset();
+		m_preset_watcher.reset();
+
+		m_manager.saveToFile(PRESET_FILE);
 	}
 
 private:
 
 	constexpr static const char* NAME_FORMAT_STRING = "MIDI Outputs [{}]";
+	constexpr static const char* PRESET_FILE = "EchoMidiDevProps.json";
 
 	EchoManager m_manager;
 
+	std::unique_ptr<EchoMIDI::DeviceWatcher> m_device_watcher;
+	std::unique_ptr<EchoMIDI::FileWatcher> m_preset_watcher;
+
 	// wxWidgets
 	wxBoxSizer* m_sizer;
 
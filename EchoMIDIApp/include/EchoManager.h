@@ -1,6 +1,8 @@
 #pragma once
 
 #include <Echoer.h>
+#include <DeviceRegistry.h>
+#include <MetricsExporter.h>
 
 /// @brief class reseponsible for handling a system of midi input devices and their corresponding target output devices.
 /// stores properties for midi devices that are currently being used / has been used, unless forgetMidi(In/Out)Device() is excplicitly called.
@@ -13,6 +15,18 @@ public:
 		bool avaliable;
 		std::map<std::string, bool> mute;
 		std::map<std::string, std::string> focus_send;
+		std::map<std::string, EchoMIDI::TransformRules> transform;
+		std::map<std::string, bool> coalesce;
+	};
+
+	/// @brief number of routes and inputs a preset changed, see loadFromFile().
+	struct PresetChanges
+	{
+		size_t added_routes = 0;
+		size_t changed_routes = 0;
+		size_t removed_routes = 0;
+		size_t opened_inputs = 0;
+		size_t closed_inputs = 0;
 	};
 
 	struct MidiInProps
@@ -28,6 +42,18 @@ public:
 	/// @brief updates the avaliability of all the currently stored midi devices, and adds any new midi devices connected to the computer.
 	void syncMidiDevices();
 
+	/// @brief updates only the devices that appeared or vanished, as reported by DeviceRegistry::rescan().
+	/// 
+	/// echoers of vanished inputs are closed, and vanished outputs are removed as targets, every other device keeps running untouched.
+	/// appeared devices are reopened and retargeted with their stored properties, just like syncMidiDevices() does.
+	/// changes must be applied in the order they were reported, as every set of ids is relative to the previous scan.
+	void applyDeviceChanges(const EchoMIDI::DeviceChanges& changes);
+
+	/// @brief rescans the DeviceRegistry, and applies the changes, see applyDeviceChanges(), called once a DeviceWatcher reports a change.
+	/// the rescan renumbers the shared output ports right away, so the echoers are remapped by the same call, on the thread owning them.
+	/// @return wether any device appeared, vanished or got a different id.
+	bool rescanDevices();
+
 	/// @brief set the send state for a input device
 	/// 
 	/// if the send state is true, the input device will be opened and start echoing to its output targets.
@@ -42,6 +68,12 @@ public:
 
 	void setTargetFocusSend(const std::string& target, const std::string& source, const std::string& val);
 
+	/// @brief set the rules used for transforming the messages the source sends to the target, e.g. keyboard splits or channel remapping.
+	void setTargetTransform(const std::string& target, const std::string& source, const EchoMIDI::TransformRules& rules);
+
+	/// @brief set wether controller floods the source sends to the target are coalesced, once the target falls behind.
+	void setTargetCoalescing(const std::string& target, const std::string& source, bool val);
+
 	bool inIsAvaliable(const std::string& name)
 	{
 		return m_midi_inputs[name].avaliable;
@@ -60,14 +92,36 @@ public:
 
 	/// @brief saves all the currently stored midi devices' properties into a JSON format that can later be loaded using the loadFromFile() function.
 	void saveToFile(std::filesystem::path file);
-	void loadFromFile(std::filesystem::path file, bool keep_unsaved = true);
+	/// @brief applies the properties saved by saveToFile().
+	///
+	/// the preset is diffed against the current routes, and only the routes that differ are touched, every other device keeps running untouched.
+	/// every needed device is opened in parallel, and the routes are only committed once all of them opened, otherwise nothing changes.
+	/// 
+	/// @param keep_unsaved if false, routes missing from the file are removed, and inputs missing from the file stop echoing,
+	/// e.g. when a preset that was edited on disk is reloaded.
+	/// @return the routes and inputs the preset changed.
+	PresetChanges loadFromFile(std::filesystem::path file, bool keep_unsaved = true);
+
+	/// @brief saves the latency percentiles of every open input device and its targets into a JSON file.
+	void saveLatencyReport(std::filesystem::path file);
+	/// @brief clears the latency histograms of every input device and its targets.
+	void resetLatency();
+
+	/// @brief starts exporting the metrics of every input device and its targets, or stops it if the config exports nothing.
+	/// replaces any exporter started before.
+	void setMetricsConfig(const EchoMIDI::MetricsConfig& config);
 
 private:
 
+	// closes vanished inputs, marks vanished outputs as unavaliable, and moves every echoer to the new device ids.
+	void remapDevices(const EchoMIDI::DeviceChanges& changes);
+
 	// initializes the source Echoer with the target outptus devices properties, if the target is not muted for the source.
 	void tryAddTarget(const std::string& target, const std::string& source);
 
 	std::map<std::string, MidiInProps> m_midi_inputs;
 	std::map<std::string, MidiOutProps> m_midi_outputs;
+
+	std::unique_ptr<EchoMIDI::MetricsExporter> m_metrics_exporter;
 };
 
@@ -1,18 +1,126 @@
 #include "EchoManager.h"
 
+#include <Realtime.h>
+#include <DeviceRegistry.h>
+#include <FocusHook.h>
+#include <WorkerPool.h>
+
 #include <fstream>
+#include <functional>
+#include <optional>
 
 #include <nlohmann/json.hpp>
 
 using json = nlohmann::json;
 using ordered_json = nlohmann::ordered_json;
 
+// ============ JSON conversions ============
+
+namespace EchoMIDI
+{
+	// only the rules are stored, the tables are compiled again when loaded.
+	void to_json(ordered_json& j, const TransformRules& rules)
+	{
+		j["Channel map"] = rules.channel_map;
+		j["Channel mask"] = rules.channel_mask;
+		j["Type mask"] = rules.type_mask;
+		j["Note low"] = rules.note_low;
+		j["Note high"] = rules.note_high;
+		j["Transpose"] = rules.transpose;
+		j["Velocity curve"] = rules.velocity_curve;
+		j["Velocity min"] = rules.velocity_min;
+		j["Velocity max"] = rules.velocity_max;
+	}
+
+	// any missing properties are left at their default values, so older and hand written files still load.
+	void from_json(const json& j, TransformRules& rules)
+	{
+		TransformRules defaults;
+
+		rules.channel_map = j.value("Channel map", defaults.channel_map);
+		rules.channel_mask = j.value("Channel mask", defaults.channel_mask);
+		rules.type_mask = j.value("Type mask", defaults.type_mask);
+		rules.note_low = j.value("Note low", defaults.note_low);
+		rules.note_high = j.value("Note high", defaults.note_high);
+		rules.transpose = j.value("Transpose", defaults.transpose);
+		rules.velocity_curve = j.value("Velocity curve", defaults.velocity_curve);
+		rules.velocity_min = j.value("Velocity min", defaults.velocity_min);
+		rules.velocity_max = j.value("Velocity max", defaults.velocity_max);
+	}
+
+	// cpus are stored as a list of cpu indexes, instead of a bit mask.
+	void to_json(ordered_json& j, const RealtimeConfig& config)
+	{
+		j["Enabled"] = config.enabled;
+		j["Priority"] = config.priority;
+		j["CPUs"] = ordered_json::array_t();
+
+		for (int cpu = 0; cpu < 64; cpu++)
+		{
+			if (config.cpu_mask >> cpu & 1)
+				j["CPUs"].push_back(cpu);
+		}
+
+		j["Lock memory"] = config.lock_memory;
+		j["Prefault"] = config.prefault;
+	}
+
+	void from_json(const json& j, RealtimeConfig& config)
+	{
+		RealtimeConfig defaults;
+
+		config.enabled = j.value("Enabled", defaults.enabled);
+		config.priority = j.value("Priority", defaults.priority);
+		config.cpu_mask = 0;
+
+		for (int cpu : j.value("CPUs", std::vector<int>()))
+		{
+			if (cpu >= 0 && cpu < 64)
+				config.cpu_mask |= 1ull << cpu;
+		}
+
+		config.lock_memory = j.value("Lock memory", defaults.lock_memory);
+		config.prefault = j.value("Prefault", defaults.prefault);
+	}
+
+	void to_json(ordered_json& j, const MetricsConfig& config)
+	{
+		j["File"] = config.file.string();
+		j["Port"] = config.port;
+		j["Interval ms"] = config.interval.count();
+	}
+
+	void from_json(const json& j, MetricsConfig& config)
+	{
+		MetricsConfig defaults;
+
+		config.file = j.value("File", defaults.file.string());
+		config.port = j.value("Port", defaults.port);
+		config.interval = std::chrono::milliseconds(j.value("Interval ms", defaults.interval.count()));
+	}
+
+	// latencies are written in microseconds, which is far easier to read than nanoseconds.
+	void to_json(ordered_json& j, const LatencySummary& summary)
+	{
+		j["Count"] = summary.count;
+		j["p50 us"] = summary.p50 / 1000.0;
+		j["p99 us"] = summary.p99 / 1000.0;
+		j["p99.9 us"] = summary.p999 / 1000.0;
+		j["Max us"] = summary.max / 1000.0;
+	}
+}
+
 // ============ Public ============
 
 // TODO: check for optimizations / potential code cleanups.
 void EchoManager::syncMidiDevices()
 {
 	// loop over all the connected midi inputs and remove / add any missing midi devices.
+	// the devices are enumerated once here, every name and id lookup below is answered by the registry.
+	EchoMIDI::DeviceRegistry& registry = EchoMIDI::getDeviceRegistry();
+
+	// devices that vanished since the last scan shift the ids of every device after them, so the echoers are updated before any lookup.
+	remapDevices(registry.rescan());
 
 	std::map<std::string, bool> avaliable_devices;
 	std::vector<std::string> new_devices;
@@ -20,7 +128,7 @@ void EchoManager::syncMidiDevices()
 	for (auto& [name, _] : m_midi_inputs)
 		avaliable_devices[name] = false;
 
-	for (UINT id = 0; id < midiInGetNumDevs(); id++)
+	for (UINT id = 0; id < registry.getInputCount(); id++)
 	{
 		std::string input_name = EchoMIDI::getMidiInputName(id);
 
@@ -42,7 +150,10 @@ void EchoManager::syncMidiDevices()
 		else
 		{
 			// a new device was discovered.
-			m_midi_inputs[input_name] = MidiInProps{ true, false };
+			// Echoer instances cannot be copied, so the properties are set in place.
+			MidiInProps& midi_input = m_midi_inputs[input_name];
+			midi_input.avaliable = true;
+			midi_input.echo = false;
 			new_devices.push_back(input_name);
 		}
 	}
@@ -75,7 +186,7 @@ void EchoManager::syncMidiDevices()
 	for (auto& [name, _] : m_midi_outputs)
 		avaliable_devices[name] = false;
 
-	for (UINT id = 0; id < midiOutGetNumDevs(); id++)
+	for (UINT id = 0; id < registry.getOutputCount(); id++)
 	{
 		std::string output_name = EchoMIDI::getMidiOutputName(id);
 
@@ -113,15 +224,7 @@ void EchoManager::syncMidiDevices()
 		{
 			props.avaliable = avaliable_devices[name];
 
-			// device is no longer avaliable, remove it as a target from all the active echoers.
-
-			if (!props.avaliable)
-			{
-				UINT device_id = EchoMIDI::getMidiOutIDByName(name);
-				for (auto& [input_name, input_prop] : m_midi_inputs)
-					if (input_prop.avaliable && input_prop.echoer.getTargets().contains(device_id))
-						input_prop.echoer.remove(device_id);
-			}
+			// devices that are no longer avaliable have already been removed as targets by remapDevices().
 		}
 	}
 
@@ -131,6 +234,59 @@ void EchoManager::syncMidiDevices()
 			tryAddTarget(out_name, new_input);
 }
 
+bool EchoManager::rescanDevices()
+{
+	EchoMIDI::DeviceChanges changes = EchoMIDI::getDeviceRegistry().rescan();
+
+	if (changes.empty())
+		return false;
+
+	applyDeviceChanges(changes);
+
+	return true;
+}
+
+void EchoManager::applyDeviceChanges(const EchoMIDI::DeviceChanges& changes)
+{
+	remapDevices(changes);
+
+	for (const std::string& name : changes.added_inputs)
+	{
+		bool known = m_midi_inputs.contains(name);
+		MidiInProps& midi_input = m_midi_inputs[name];
+
+		// Echoer instances cannot be copied, so the properties are set in place.
+		if (!known)
+			midi_input.echo = false;
+
+		midi_input.avaliable = true;
+
+		if (midi_input.echo && !midi_input.echoer.isOpen())
+		{
+			midi_input.echoer.open(EchoMIDI::getMidiInIDByName(name));
+			midi_input.echoer.start();
+		}
+
+		for (auto& [out_name, out_props] : m_midi_outputs)
+			if (out_props.avaliable)
+				tryAddTarget(out_name, name);
+	}
+
+	for (const std::string& name : changes.added_outputs)
+	{
+		if (!m_midi_outputs.contains(name))
+		{
+			m_midi_outputs[name] = MidiOutProps{ true };
+			continue;
+		}
+
+		m_midi_outputs[name].avaliable = true;
+
+		for (auto& [in_name, _] : m_midi_inputs)
+			tryAddTarget(name, in_name);
+	}
+}
+
 void EchoManager::setInEcho(const std::string& name, bool val)
 {
 	if (m_midi_inputs[name].echo != val && m_midi_inputs[name].avaliable)
@@ -173,6 +329,30 @@ void EchoManager::setTargetFocusSend(const std::string& target, const std::strin
 
 }
 
+void EchoManager::setTargetTransform(const std::string& target, const std::string& source, const EchoMIDI::TransformRules& rules)
+{
+	m_midi_outputs[target].transform[source] = rules;
+
+	tryAddTarget(target, source);
+
+	UINT out_id = EchoMIDI::getMidiOutIDByName(target);
+
+	if (m_midi_inputs[source].avaliable && m_midi_inputs[source].echo && m_midi_inputs[source].echoer.getTargets().contains(out_id))
+		m_midi_inputs[source].echoer.setTransform(out_id, rules);
+}
+
+void EchoManager::setTargetCoalescing(const std::string& target, const std::string& source, bool val)
+{
+	m_midi_outputs[target].coalesce[source] = val;
+
+	tryAddTarget(target, source);
+
+	UINT out_id = EchoMIDI::getMidiOutIDByName(target);
+
+	if (m_midi_inputs[source].avaliable && m_midi_inputs[source].echo && m_midi_inputs[source].echoer.getTargets().contains(out_id))
+		m_midi_inputs[source].echoer.setCoalescing(out_id, val);
+}
+
 
 void EchoManager::saveToFile(std::filesystem::path file)
 {
@@ -202,6 +382,12 @@ void EchoManager::saveToFile(std::filesystem::path file)
 				midi_output_obj["Mute"] = out_props.mute[in_name];
 				midi_output_obj["Focus send"] = out_props.focus_send[in_name];
 
+				if (!out_props.transform[in_name].isIdentity())
+					midi_output_obj["Transform"] = out_props.transform[in_name];
+
+				if (out_props.coalesce[in_name])
+					midi_output_obj["Coalesce"] = true;
+
 				midi_input_obj["Midi Outputs"].push_back(midi_output_obj);
 			}
 		}
@@ -210,6 +396,14 @@ void EchoManager::saveToFile(std::filesystem::path file)
 	}
 
 	ordered_json j_out = ordered_json({ {"Midi Inputs", midi_inputs} });
+
+	EchoMIDI::RealtimeConfig realtime_config = EchoMIDI::getRealtimeConfig();
+
+	if (realtime_config != EchoMIDI::RealtimeConfig())
+		j_out["Realtime"] = realtime_config;
+
+	if (m_metrics_exporter)
+		j_out["Metrics"] = m_metrics_exporter->getConfig();
 	
 	std::ofstream file_out(file);
 
@@ -218,28 +412,372 @@ void EchoManager::saveToFile(std::filesystem::path file)
 	file_out.close();
 }
 
-void EchoManager::loadFromFile(std::filesystem::path file, bool keep_unsaved)
+void EchoManager::saveLatencyReport(std::filesystem::path file)
+{
+	ordered_json midi_inputs = ordered_json::array_t();
+
+	for (auto& [in_name, in_props] : m_midi_inputs)
+	{
+		// only open inputs have ever recorded anything.
+		if (!in_props.echoer.isOpen())
+			continue;
+
+		EchoMIDI::Echoer& echoer = in_props.echoer;
+		ordered_json midi_input_obj = ordered_json::object();
+
+		midi_input_obj["Name"] = in_name;
+		midi_input_obj["Input latency"] = echoer.getInputLatency();
+		midi_input_obj["Midi Outputs"] = ordered_json::array_t();
+
+		for (auto& [out_id, _] : echoer.getTargets())
+		{
+			ordered_json midi_output_obj;
+
+			midi_output_obj["Name"] = EchoMIDI::getMidiOutputName(out_id);
+			midi_output_obj["Dispatch latency"] = echoer.getDispatchLatency(out_id);
+			midi_output_obj["Total latency"] = echoer.getTotalLatency(out_id);
+
+			midi_input_obj["Midi Outputs"].push_back(midi_output_obj);
+		}
+
+		midi_inputs.push_back(midi_input_obj);
+	}
+
+	ordered_json j_out = ordered_json({ {"Midi Inputs", midi_inputs} });
+
+	// the os may refuse realtime scheduling, which shows up as higher latencies, so the reason is kept alongside them.
+	if (EchoMIDI::getRealtimeConfig().enabled)
+		j_out["Realtime status"] = EchoMIDI::getRealtimeStatus().describe();
+
+	// time from switching windows, until the focus send targets were muted or unmuted.
+	EchoMIDI::FocusStats focus_stats = EchoMIDI::getFocusStats();
+
+	if (focus_stats.switch_count > 0)
+		j_out["Focus switch latency"] = focus_stats.switch_latency;
+
+	std::ofstream file_out(file);
+
+	file_out << j_out.dump(4);
+
+	file_out.close();
+}
+
+void EchoManager::resetLatency()
+{
+	for (auto& [_, in_props] : m_midi_inputs)
+		in_props.echoer.resetLatency();
+}
+
+void EchoManager::setMetricsConfig(const EchoMIDI::MetricsConfig& config)
+{
+	// an unchanged config keeps the running exporter, e.g. when a preset is reloaded.
+	if (m_metrics_exporter ? m_metrics_exporter->getConfig() == config : !config.enabled())
+		return;
+
+	// the previous exporter must release its port, before a new one can bind it.
+	m_metrics_exporter.reset();
+
+	if (config.enabled())
+		m_metrics_exporter = std::make_unique<EchoMIDI::MetricsExporter>(config);
+}
+
+EchoManager::PresetChanges EchoManager::loadFromFile(std::filesystem::path file, bool keep_unsaved)
 {
+	PresetChanges changes;
+
 	json j_in;
 
 	std::ifstream file_in(file);
 
 	file_in >> j_in;
 
+	// the entire preset is parsed into copies of the properties first, so a malformed file changes nothing.
+	// both configs are only saved if they differ from their defaults, so a missing object means the default, unless unsaved properties are kept.
+	std::optional<EchoMIDI::RealtimeConfig> realtime_config;
+	std::optional<EchoMIDI::MetricsConfig> metrics_config;
+
+	if (j_in.contains("Realtime") || !keep_unsaved)
+		realtime_config = j_in.contains("Realtime") ? j_in["Realtime"].get<EchoMIDI::RealtimeConfig>() : EchoMIDI::RealtimeConfig();
+
+	if (j_in.contains("Metrics") || !keep_unsaved)
+		metrics_config = j_in.contains("Metrics") ? j_in["Metrics"].get<EchoMIDI::MetricsConfig>() : EchoMIDI::MetricsConfig();
+
+	std::map<std::string, bool> echo_states;
+	std::map<std::string, MidiOutProps> midi_outputs = m_midi_outputs;
+
+	// routes missing from the file are removed, only the avaliability of every output is kept.
+	if (!keep_unsaved)
+	{
+		for (auto& [out_name, out_props] : midi_outputs)
+			out_props = MidiOutProps{ out_props.avaliable };
+	}
+
 	for (json& midi_input : j_in["Midi Inputs"])
 	{
-		setInEcho(midi_input["Name"], midi_input["Echo"]);
+		const std::string in_name = midi_input["Name"].get<std::string>();
+
+		echo_states[in_name] = midi_input["Echo"].get<bool>();
 
 		for (json& midi_output : midi_input["Midi Outputs"])
 		{
-			setTargetMute(midi_output["Name"], midi_input["Name"], midi_output["Mute"]);
-			setTargetFocusSend(midi_output["Name"], midi_input["Name"], midi_output["Focus send"]);
+			MidiOutProps& out_props = midi_outputs[midi_output["Name"].get<std::string>()];
+
+			out_props.mute[in_name] = midi_output["Mute"].get<bool>();
+			out_props.focus_send[in_name] = midi_output["Focus send"].get<std::string>();
+
+			if (midi_output.contains("Transform"))
+				out_props.transform[in_name] = midi_output["Transform"].get<EchoMIDI::TransformRules>();
+
+			if (midi_output.contains("Coalesce"))
+				out_props.coalesce[in_name] = midi_output["Coalesce"].get<bool>();
+		}
+	}
+
+	// every output id is resolved once, instead of once per route.
+	std::map<std::string, UINT> output_ids;
+
+	for (auto& [out_name, out_props] : midi_outputs)
+	{
+		UINT out_id = EchoMIDI::getMidiOutIDByName(out_name);
+
+		if (out_props.avaliable && out_id != EchoMIDI::INVALID_MIDI_ID)
+			output_ids[out_name] = out_id;
+	}
+
+	// diff the new properties against the targets every echoer has right now, only routes that change end up in a batch.
+	struct InputPlan
+	{
+		MidiInProps* props = nullptr;
+		UINT id = EchoMIDI::INVALID_MIDI_ID;
+		bool open = false;
+		bool close = false;
+		bool echo = false;
+		EchoMIDI::Echoer::TargetBatch batch;
+	};
+
+	std::vector<InputPlan> plans;
+
+	for (auto& [in_name, in_props] : m_midi_inputs)
+	{
+		if (!in_props.avaliable)
+			continue;
+
+		EchoMIDI::Echoer& echoer = in_props.echoer;
+		bool echo = echo_states.contains(in_name) ? echo_states[in_name] : keep_unsaved && in_props.echo;
+
+		std::vector<EchoMIDI::Echoer::TargetConfig> configs;
+		std::vector<UINT> removed_ids;
+
+		for (auto& [out_name, out_id] : output_ids)
+		{
+			MidiOutProps& out_props = midi_outputs[out_name];
+
+			if (!out_props.mute.contains(in_name))
+			{
+				if (echoer.getTargets().contains(out_id))
+					removed_ids.push_back(out_id);
+
+				continue;
+			}
+
+			EchoMIDI::Echoer::TargetConfig config = { out_id, out_props.mute[in_name], out_props.focus_send[in_name], out_props.transform[in_name], out_props.coalesce[in_name] };
+
+			if (echoer.getTargets().contains(out_id))
+			{
+				if (config.mute == echoer.isMuted(out_id) && config.focus_send_path == echoer.getFocusSendExec(out_id)
+					&& config.transform_rules == echoer.getTransform(out_id) && config.coalesce == echoer.isCoalescing(out_id))
+					continue;
+
+				changes.changed_routes++;
+			}
+			// muted routes are only opened once they are unmuted, see tryAddTarget().
+			else if (config.mute)
+			{
+				continue;
+			}
+			else
+			{
+				changes.added_routes++;
+			}
+
+			configs.push_back(std::move(config));
+		}
+
+		changes.removed_routes += removed_ids.size();
+
+		plans.push_back({ &in_props, EchoMIDI::getMidiInIDByName(in_name), echo && !echoer.isOpen(), !echo && echoer.isOpen(), echo,
+			echoer.prepareTargets(std::move(configs), std::move(removed_ids)) });
+	}
+
+	// the configs in effect before the preset, restored by a rollback.
+	EchoMIDI::RealtimeConfig prev_realtime_config = EchoMIDI::getRealtimeConfig();
+	EchoMIDI::MetricsConfig prev_metrics_config = m_metrics_exporter ? m_metrics_exporter->getConfig() : EchoMIDI::MetricsConfig();
+
+	// undoes every input opened below, and the configs, the batches close their own targets once they are destroyed.
+	// the error that caused the rollback is the one reported, so any error whilst closing, or restoring the exporter, is ignored.
+	auto rollback = [&]()
+	{
+		if (EchoMIDI::getRealtimeConfig() != prev_realtime_config)
+			EchoMIDI::setRealtimeConfig(prev_realtime_config);
+
+		try
+		{
+			setMetricsConfig(prev_metrics_config);
+		}
+		catch (const EchoMIDI::MIDIEchoExcept&)
+		{
 		}
+
+		for (InputPlan& plan : plans)
+		{
+			if (!plan.open)
+				continue;
+
+			try
+			{
+				if (plan.props->echoer.isEchoing())
+					plan.props->echoer.stop();
+
+				if (plan.props->echoer.isOpen())
+					plan.props->echoer.close();
+			}
+			catch (const EchoMIDI::MIDIEchoExcept&)
+			{
+			}
+		}
+	};
+
+	// every device is opened on a small worker pool, as an open mostly waits on the driver, and each one only touches its own echoer or target.
+	std::vector<std::function<void()>> opens;
+
+	for (InputPlan& plan : plans)
+	{
+		if (plan.open)
+			opens.push_back([&plan]() { plan.props->echoer.open(plan.id); });
+
+		for (size_t i = 0; i < plan.batch.getOpenCount(); i++)
+			opens.push_back([&plan, i]() { plan.batch.open(i); });
 	}
+
+	try
+	{
+		// applied before any device is opened, so sender threads started by the batches already run with it.
+		if (realtime_config && *realtime_config != prev_realtime_config)
+			EchoMIDI::setRealtimeConfig(*realtime_config);
+
+		// the exporter may fail to bind its port, which rolls back the preset like any device that fails to open.
+		if (metrics_config)
+			setMetricsConfig(*metrics_config);
+
+		EchoMIDI::runParallel(opens.size(), [&](size_t index) { opens[index](); });
+
+		// started before anything is committed, so a failing start can still be undone.
+		for (InputPlan& plan : plans)
+			if (plan.open)
+				plan.props->echoer.start();
+	}
+	catch (...)
+	{
+		rollback();
+		throw;
+	}
+
+	// every target has been opened, so only closing a removed target can fail from here on, which does not stop the remaining echoers from committing.
+	std::exception_ptr err;
+
+	for (InputPlan& plan : plans)
+	{
+		try
+		{
+			plan.props->echoer.commitTargets(plan.batch);
+		}
+		catch (...)
+		{
+			if (!err)
+				err = std::current_exception();
+		}
+	}
+
+	m_midi_outputs = std::move(midi_outputs);
+
+	for (InputPlan& plan : plans)
+		plan.props->echo = plan.echo;
+
+	// unavaliable inputs are opened by syncMidiDevices() or applyDeviceChanges() once they are plugged in, based on their echo state.
+	for (auto& [in_name, in_props] : m_midi_inputs)
+		if (!in_props.avaliable && !echo_states.contains(in_name) && !keep_unsaved)
+			in_props.echo = false;
+
+	for (auto& [in_name, echo] : echo_states)
+		if (!m_midi_inputs.contains(in_name) || !m_midi_inputs[in_name].avaliable)
+			m_midi_inputs[in_name].echo = echo;
+
+	// closing an input cannot be undone by reopening it, so inputs are only closed once the preset has been applied.
+	for (InputPlan& plan : plans)
+	{
+		if (plan.open)
+			changes.opened_inputs++;
+
+		if (!plan.close)
+			continue;
+
+		changes.closed_inputs++;
+
+		if (plan.props->echoer.isEchoing())
+			plan.props->echoer.stop();
+
+		plan.props->echoer.close();
+	}
+
+	if (err)
+		std::rethrow_exception(err);
+
+	return changes;
 }
 
 // ============ Private ============
 
+void EchoManager::remapDevices(const EchoMIDI::DeviceChanges& changes)
+{
+	for (const std::string& name : changes.removed_inputs)
+	{
+		if (!m_midi_inputs.contains(name))
+			continue;
+
+		MidiInProps& midi_input = m_midi_inputs[name];
+		midi_input.avaliable = false;
+
+		if (midi_input.echoer.isEchoing())
+			midi_input.echoer.stop();
+
+		if (midi_input.echoer.isOpen())
+			midi_input.echoer.close();
+	}
+
+	for (const std::string& name : changes.removed_outputs)
+		if (m_midi_outputs.contains(name))
+			m_midi_outputs[name].avaliable = false;
+
+	// every echoer is remapped, even if one of them fails to close a vanished target, the first error is rethrown afterwards.
+	std::exception_ptr err;
+
+	for (auto& [name, midi_input] : m_midi_inputs)
+	{
+		try
+		{
+			midi_input.echoer.remapIDs(changes.input_ids, changes.output_ids);
+		}
+		catch (...)
+		{
+			if (!err)
+				err = std::current_exception();
+		}
+	}
+
+	if (err)
+		std::rethrow_exception(err);
+}
+
 void EchoManager::tryAddTarget(const std::string& target, const std::string& source)
 {
 	MidiInProps& in_props = m_midi_inputs[source];
@@ -251,6 +789,8 @@ void EchoManager::tryAddTarget(const std::string& target, const std::string& sou
 	{
 		m_midi_inputs[source].echoer.add(target_id);
 		m_midi_inputs[source].echoer.focusSend(target_id, m_midi_outputs[target].focus_send[source]);
+		m_midi_inputs[source].echoer.setTransform(target_id, m_midi_outputs[target].transform[source]);
+		m_midi_inputs[source].echoer.setCoalescing(target_id, m_midi_outputs[target].coalesce[source]);
 		m_midi_inputs[source].echoer.setMute(target_id, false);
 	}
 }
@@ -0,0 +1,392 @@
+// drives the fan-out core of the midi callback with synthetic traffic, against in-memory fake outputs.
+// the exact same code path as the midi callback is timed: reading the route snapshot, loading the mute state, and fanning out.
+//
+// loopback builds also drive a real Echoer through the loopback ports, so the raw numbers can be compared against
+// the full midi callback, including the driver calls, latency tracking, note tracking and, in async mode, the sender queues.
+//
+// usage: EchoMIDIBench [fan-outs per run]
+
+#include "FanOut.h"
+#include "Snapshot.h"
+
+#ifdef ECHOMIDI_BACKEND_LOOPBACK
+#include "Echoer.h"
+#include "FocusHook.h"
+
+#include <thread>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <new>
+
+using namespace EchoMIDI;
+
+// ============ Allocation counting ============
+
+static std::atomic<size_t> g_alloc_count = 0;
+
+void* operator new(size_t size)
+{
+	g_alloc_count.fetch_add(1, std::memory_order_relaxed);
+
+	if (void* ptr = std::malloc(size ? size : 1))
+		return ptr;
+
+	throw std::bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void* ptr) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept
+{
+	std::free(ptr);
+}
+
+// ============ Fake outputs ============
+
+// stands in for an output device, short messages are written to a ring, SysEx blocks are only referenced, like the SysExPool does.
+struct FakeOutput
+{
+	static constexpr size_t RING_SIZE = 1024;
+
+	std::array<uint32_t, RING_SIZE> messages = {};
+	size_t written = 0;
+
+	size_t sysex_refs = 0;
+	size_t sysex_bytes = 0;
+};
+
+struct FakeSink
+{
+	size_t sysex_length;
+	size_t sent = 0;
+
+	void sendShort(const Route<FakeOutput*>& route, uint32_t msg)
+	{
+		FakeOutput& output = *route.handle;
+
+		output.messages[output.written++ % FakeOutput::RING_SIZE] = msg;
+		sent++;
+	}
+
+	void sendLong(const Route<FakeOutput*>& route)
+	{
+		FakeOutput& output = *route.handle;
+
+		output.sysex_refs++;
+		output.sysex_bytes += sysex_length;
+		sent++;
+	}
+};
+
+// ============ Benchmark ============
+
+enum class MessageKind
+{
+	SHORT,
+	LONG
+};
+
+struct BenchResult
+{
+	double msgs_per_sec;
+	double ns_per_fan_out;
+	double allocs_per_msg;
+	double sends_per_msg;
+	// the fraction of the targets actually muted, which the requested percentage only approximates for a few targets.
+	double muted_fraction;
+};
+
+static constexpr size_t SYSEX_LENGTH = 256;
+
+// muted targets are spread evenly over the slots, a slot is muted whenever the rounded running muted count increases,
+// so round(target_count * muted_percent / 100) of the targets are muted in total.
+static bool isMutedSlot(size_t slot, size_t muted_percent)
+{
+	auto muted_before = [&](size_t count) { return (count * muted_percent + 50) / 100; };
+
+	return muted_before(slot + 1) != muted_before(slot);
+}
+
+static double mutedFraction(size_t target_count, size_t muted_percent)
+{
+	return (double)((target_count * muted_percent + 50) / 100) / target_count;
+}
+
+// a mix of notes and the controller floods seen during live playing.
+static std::array<uint32_t, 256> makeTraffic()
+{
+	std::array<uint32_t, 256> traffic;
+
+	for (uint32_t i = 0; i < traffic.size(); i++)
+	{
+		uint32_t channel = i % 16;
+
+		switch (i % 4)
+		{
+		case 0:
+			traffic[i] = 0x90 | channel | (36 + i % 48) << 8 | (1 + i % 127) << 16;
+			break;
+		case 1:
+			traffic[i] = 0xB0 | channel | 1 << 8 | (i % 128) << 16;
+			break;
+		case 2:
+			traffic[i] = 0xE0 | channel | (i % 128) << 8 | 64 << 16;
+			break;
+		default:
+			traffic[i] = 0x80 | channel | (36 + i % 48) << 8;
+			break;
+		}
+	}
+
+	return traffic;
+}
+
+static BenchResult runBench(size_t target_count, MessageKind kind, size_t muted_percent, size_t fan_outs)
+{
+	static const std::array<uint32_t, 256> traffic = makeTraffic();
+
+	// every output and its stats are allocated up front, just like the targets of an Echoer.
+	std::unique_ptr<FakeOutput[]> outputs = std::make_unique<FakeOutput[]>(target_count);
+	std::unique_ptr<TargetStats[]> stats = std::make_unique<TargetStats[]>(target_count);
+
+	Snapshot<RouteTable<FakeOutput*>> routes;
+	MuteMask mute_mask;
+
+	std::unique_ptr<RouteTable<FakeOutput*>> table = std::make_unique<RouteTable<FakeOutput*>>();
+
+	for (uint32_t slot = 0; slot < target_count; slot++)
+		table->routes.push_back({ &outputs[slot], slot, slot, nullptr, &stats[slot], nullptr });
+
+	table->word_count = (target_count + MuteMask::TARGETS_PER_WORD - 1) / MuteMask::TARGETS_PER_WORD;
+
+	routes.publish(std::move(table));
+
+	for (size_t slot = 0; slot < target_count; slot++)
+		mute_mask.setUserMuted(slot, isMutedSlot(slot, muted_percent));
+
+	size_t message_count = std::max<size_t>(fan_outs / target_count, 10000);
+
+	FakeSink sink = { SYSEX_LENGTH };
+
+	size_t alloc_count = g_alloc_count.load(std::memory_order_relaxed);
+	auto start = std::chrono::steady_clock::now();
+
+	for (size_t i = 0; i < message_count; i++)
+	{
+		auto guard = routes.read();
+
+		SendBits send_bits;
+		send_bits.load(mute_mask, guard->word_count);
+
+		if (kind == MessageKind::SHORT)
+			fanOutShort(*guard, send_bits, traffic[i % traffic.size()], sink);
+		else
+			fanOutLong(*guard, send_bits, sink);
+	}
+
+	auto end = std::chrono::steady_clock::now();
+	alloc_count = g_alloc_count.load(std::memory_order_relaxed) - alloc_count;
+
+	double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+
+	return {
+		message_count / (ns / 1e9),
+		ns / ((double)message_count * target_count),
+		(double)alloc_count / message_count,
+		(double)sink.sent / message_count,
+		mutedFraction(target_count, muted_percent)
+	};
+}
+
+// ============ Echoer benchmark ============
+
+#ifdef ECHOMIDI_BACKEND_LOOPBACK
+// the loopback port the Echoer listens on, every other port is a target.
+static constexpr UINT SOURCE_PORT = 0;
+
+// counts what arrives at a target port.
+struct LoopbackSink
+{
+	std::atomic<size_t> count = 0;
+	Backend::InputHandle handle = {};
+
+	InputCallbacks callbacks = { this,
+		[](void* user, uint32_t, DWORD) { ((LoopbackSink*)user)->count.fetch_add(1, std::memory_order_relaxed); },
+		[](void* user, const uint8_t*, size_t, DWORD) { ((LoopbackSink*)user)->count.fetch_add(1, std::memory_order_relaxed); } };
+};
+
+static BenchResult runEchoerBench(size_t target_count, MessageKind kind, size_t muted_percent, bool async, size_t fan_outs)
+{
+	static const std::array<uint32_t, 256> traffic = makeTraffic();
+	static const std::array<uint8_t, SYSEX_LENGTH> sysex = []()
+		{
+			std::array<uint8_t, SYSEX_LENGTH> data = {};
+			data.front() = 0xF0;
+			data.back() = 0xF7;
+			return data;
+		}();
+
+	std::array<LoopbackSink, LoopbackBackend::PORT_COUNT> sinks;
+
+	for (UINT id = 1; id <= target_count; id++)
+	{
+		Backend::openInput(sinks[id].handle, id, sinks[id].callbacks);
+		Backend::startInput(sinks[id].handle);
+	}
+
+	Backend::OutputHandle source;
+	Backend::openOutput(source, SOURCE_PORT);
+
+	// a real fan-out costs a driver call per target, so fewer messages are enough for stable timings.
+	size_t message_count = std::max<size_t>(fan_outs / target_count / 16, 10000);
+	size_t alloc_count;
+	size_t sent = 0;
+	std::chrono::steady_clock::time_point start;
+	std::chrono::steady_clock::time_point end;
+
+	{
+		Echoer echoer;
+		echoer.open(SOURCE_PORT);
+		echoer.setAsync(async);
+
+		for (UINT id = 1; id <= target_count; id++)
+		{
+			echoer.add(id);
+			echoer.setMute(id, isMutedSlot(id - 1, muted_percent));
+		}
+
+		echoer.start();
+
+		alloc_count = g_alloc_count.load(std::memory_order_relaxed);
+		start = std::chrono::steady_clock::now();
+
+		// every send runs the midi callback of the Echoer on this thread, just like a driver would.
+		for (size_t i = 0; i < message_count; i++)
+		{
+			if (kind == MessageKind::SHORT)
+				Backend::sendShort(source, traffic[i % traffic.size()]);
+			else
+				Backend::sendLong(source, sysex.data(), sysex.size());
+		}
+
+		end = std::chrono::steady_clock::now();
+		alloc_count = g_alloc_count.load(std::memory_order_relaxed) - alloc_count;
+
+		echoer.stop();
+
+		// in async mode, the sender threads may still be sending, only the time spent in the midi callback is measured.
+		auto drained = [&]()
+			{
+				EchoerMetrics metrics = echoer.getMetrics();
+
+				return std::ranges::all_of(metrics.targets, [](const TargetMetrics& target) { return target.queue_depth == 0; });
+			};
+
+		while (!drained())
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+		// counted before the Echoer is destroyed, the note offs it sends on the way out are not part of the run.
+		for (UINT id = 1; id <= target_count; id++)
+			sent += sinks[id].count.load(std::memory_order_relaxed);
+	}
+
+	for (UINT id = 1; id <= target_count; id++)
+		Backend::closeInput(sinks[id].handle);
+
+	Backend::closeOutput(source);
+
+	double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+
+	return {
+		message_count / (ns / 1e9),
+		ns / ((double)message_count * target_count),
+		(double)alloc_count / message_count,
+		(double)sent / message_count,
+		mutedFraction(target_count, muted_percent)
+	};
+}
+#endif
+
+int main(int argc, char** argv)
+{
+	size_t fan_outs = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 20'000'000;
+
+	const size_t target_counts[] = { 1, 2, 4, 8, 16, 32, 64, 128, 256 };
+	const size_t muted_percents[] = { 0, 50, 90 };
+
+	std::printf("fan-out core, fake outputs\n");
+	std::printf("%8s %6s %6s %7s %14s %12s %12s %10s\n", "targets", "kind", "muted", "actual", "msgs/s", "ns/fan-out", "allocs/msg", "sends/msg");
+
+	for (MessageKind kind : { MessageKind::SHORT, MessageKind::LONG })
+	{
+		for (size_t target_count : target_counts)
+		{
+			for (size_t muted_percent : muted_percents)
+			{
+				BenchResult result = runBench(target_count, kind, muted_percent, fan_outs);
+
+				std::printf("%8zu %6s %5zu%% %6.1f%% %14.0f %12.2f %12.4f %10.2f\n",
+					target_count, kind == MessageKind::SHORT ? "short" : "long", muted_percent, result.muted_fraction * 100,
+					result.msgs_per_sec, result.ns_per_fan_out, result.allocs_per_msg, result.sends_per_msg);
+			}
+		}
+	}
+
+#ifdef ECHOMIDI_BACKEND_LOOPBACK
+	EchoMIDIInit();
+
+	// every loopback port but the source is a target, so at most PORT_COUNT - 1 targets fit.
+	const size_t echoer_target_counts[] = { 1, 2, 4, 8, LoopbackBackend::PORT_COUNT - 1 };
+
+	// in async mode, ns/fan-out is the time spent in the midi callback only, and sends/msg drops below the unmuted fraction once the queues overflow.
+	std::printf("\nEchoer, loopback ports\n");
+	std::printf("%8s %6s %6s %6s %7s %14s %12s %12s %10s\n", "targets", "kind", "mode", "muted", "actual", "msgs/s", "ns/fan-out", "allocs/msg", "sends/msg");
+
+	for (MessageKind kind : { MessageKind::SHORT, MessageKind::LONG })
+	{
+		for (bool async : { false, true })
+		{
+			for (size_t target_count : echoer_target_counts)
+			{
+				for (size_t muted_percent : muted_percents)
+				{
+					BenchResult result = runEchoerBench(target_count, kind, muted_percent, async, fan_outs);
+
+					std::printf("%8zu %6s %6s %5zu%% %6.1f%% %14.0f %12.2f %12.4f %10.2f\n",
+						target_count, kind == MessageKind::SHORT ? "short" : "long", async ? "async" : "sync", muted_percent, result.muted_fraction * 100,
+						result.msgs_per_sec, result.ns_per_fan_out, result.allocs_per_msg, result.sends_per_msg);
+				}
+			}
+		}
+	}
+
+	EchoMIDICleanup();
+#endif
+
+	return 0;
+}
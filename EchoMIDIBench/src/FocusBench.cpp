@@ -0,0 +1,142 @@
+// drives the X11 focus provider with a scripted window switcher, and times every switch.
+// two windows are created, one owned by the benchmark itself and one by a child process, and _NET_ACTIVE_WINDOW is switched between them,
+// exactly like a window manager does. every switch is timed from setting the property, until getFocusedPath() reports the new executable.
+//
+// requires a display without a window manager, e.g. xvfb-run EchoMIDIFocusBench.
+// usage: EchoMIDIFocusBench [switches] [debounce ms]
+
+#include "FocusHook.h"
+#include "LatencyHistogram.h"
+
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <thread>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+// xlib defines macros like None, Bool and Status, so it is included after everything else.
+#include <X11/Xlib.h>
+#include <X11/Xatom.h>
+
+using namespace EchoMIDI;
+
+// ============ Scripted window switcher ============
+
+// an unmapped window, which claims to belong to the passed process.
+Window createWindow(Display* display, Atom wm_pid, pid_t pid)
+{
+	Window window = XCreateSimpleWindow(display, DefaultRootWindow(display), 0, 0, 1, 1, 0, 0, 0);
+	unsigned long pid_value = (unsigned long)pid;
+
+	XChangeProperty(display, window, wm_pid, XA_CARDINAL, 32, PropModeReplace, (unsigned char*)&pid_value, 1);
+
+	return window;
+}
+
+void activateWindow(Display* display, Atom active_window, Window window)
+{
+	unsigned long window_value = window;
+
+	XChangeProperty(display, DefaultRootWindow(display), active_window, XA_WINDOW, 32, PropModeReplace, (unsigned char*)&window_value, 1);
+	XFlush(display);
+}
+
+// spins until the focus provider reports the passed executable, returns false if it did not within a second.
+bool waitForFocus(const std::filesystem::path& path)
+{
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+
+	while (getFocusedPath() != path)
+	{
+		if (std::chrono::steady_clock::now() > deadline)
+			return false;
+
+		std::this_thread::yield();
+	}
+
+	return true;
+}
+
+void printSummary(const char* name, const LatencySummary& summary)
+{
+	std::printf("%-22s %8llu %10.1f %10.1f %10.1f %10.1f\n", name, (unsigned long long)summary.count,
+		summary.p50 / 1000.0, summary.p99 / 1000.0, summary.p999 / 1000.0, summary.max / 1000.0);
+}
+
+int main(int argc, char** argv)
+{
+	size_t switches = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000;
+	setFocusDebounce(std::chrono::milliseconds(argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 0));
+
+	Display* display = XOpenDisplay(nullptr);
+
+	if (display == nullptr)
+	{
+		std::fprintf(stderr, "cannot open a display, run the benchmark under Xvfb, e.g. xvfb-run %s\n", argv[0]);
+		return 1;
+	}
+
+	// a second executable to switch to, it only needs to stay alive until the benchmark is done.
+	pid_t child = fork();
+
+	if (child == 0)
+	{
+		execlp("sleep", "sleep", "3600", (char*)nullptr);
+		_exit(1);
+	}
+
+	// give the child the time to replace its image, before its executable path is read.
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+	const std::filesystem::path paths[2] = {
+		std::filesystem::read_symlink("/proc/self/exe"),
+		std::filesystem::read_symlink("/proc/" + std::to_string(child) + "/exe")
+	};
+
+	Atom active_window = XInternAtom(display, "_NET_ACTIVE_WINDOW", False);
+	Atom wm_pid = XInternAtom(display, "_NET_WM_PID", False);
+
+	const Window windows[2] = { createWindow(display, wm_pid, getpid()), createWindow(display, wm_pid, child) };
+
+	EchoMIDIInit();
+
+	LatencyHistogram switch_latency;
+	size_t missed = 0;
+
+	for (size_t i = 0; i <= switches; i++)
+	{
+		int64_t start = latencyNow();
+
+		activateWindow(display, active_window, windows[i % 2]);
+
+		if (!waitForFocus(paths[i % 2]))
+			missed++;
+		// the first switch only sets up the initial focus.
+		else if (i > 0)
+			switch_latency.record(latencyNow() - start);
+	}
+
+	FocusStats stats = getFocusStats();
+
+	EchoMIDICleanup();
+
+	kill(child, SIGTERM);
+	waitpid(child, nullptr, 0);
+
+	XDestroyWindow(display, windows[0]);
+	XDestroyWindow(display, windows[1]);
+	XCloseDisplay(display);
+
+	std::printf("%zu switches, %zu missed, debounce %lld ms\n", switches, missed, (long long)getFocusDebounce().count());
+	std::printf("%zu events, %zu switches applied, %zu path cache hits, %zu misses\n\n", stats.event_count, stats.switch_count, stats.cache_hit_count, stats.cache_miss_count);
+
+	std::printf("%-22s %8s %10s %10s %10s %10s\n", "latency", "count", "p50 us", "p99 us", "p99.9 us", "max us");
+	printSummary("provider", stats.switch_latency);
+	printSummary("end to end", switch_latency.getSummary());
+
+	return missed == 0 ? 0 : 1;
+}
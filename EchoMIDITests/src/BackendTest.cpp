@@ -0,0 +1,234 @@
+// the loopback backend, and Echoers echoing through its ports, in sync and async mode, muted, and sharing an output.
+
+#include "Check.h"
+#include "Backend.h"
+#include "Echoer.h"
+#include "FocusHook.h"
+
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace EchoMIDI;
+
+// ============ Local defines ============
+
+// records every message delivered to a loopback input.
+struct Sink
+{
+	std::mutex mutex;
+	std::vector<uint32_t> msgs;
+	std::vector<uint8_t> sysex;
+	Backend::InputHandle handle = {};
+
+	InputCallbacks callbacks = { this,
+		[](void* user, uint32_t msg, DWORD)
+		{
+			Sink& sink = *(Sink*)user;
+			std::lock_guard lock(sink.mutex);
+			sink.msgs.push_back(msg);
+		},
+		[](void* user, const uint8_t* data, size_t length, DWORD)
+		{
+			Sink& sink = *(Sink*)user;
+			std::lock_guard lock(sink.mutex);
+			sink.sysex.insert(sink.sysex.end(), data, data + length);
+		} };
+
+	MMRESULT open(UINT id)
+	{
+		MMRESULT res = Backend::openInput(handle, id, callbacks);
+
+		if (res == MMSYSERR_NOERROR)
+			res = Backend::startInput(handle);
+
+		return res;
+	}
+
+	~Sink()
+	{
+		if (handle)
+			Backend::closeInput(handle);
+	}
+
+	std::vector<uint32_t> get()
+	{
+		std::lock_guard lock(mutex);
+		return msgs;
+	}
+
+	// async senders and shared outputs deliver on their own threads, so the test waits for them, up to a few seconds.
+	std::vector<uint32_t> waitFor(size_t count)
+	{
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+
+		while (get().size() < count && std::chrono::steady_clock::now() < deadline)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+		return get();
+	}
+};
+
+// control changes on channel 0, so the Echoers have no notes to release once they are destroyed.
+std::vector<uint32_t> makeMessages(uint32_t channel, uint32_t count)
+{
+	std::vector<uint32_t> msgs;
+
+	for (uint32_t i = 0; i < count; i++)
+		msgs.push_back(0xB0 | channel | (i % 100) << 8 | (i % 128) << 16);
+
+	return msgs;
+}
+
+void sendAll(UINT id, const std::vector<uint32_t>& msgs)
+{
+	Backend::OutputHandle out;
+	CHECK_EQ(Backend::openOutput(out, id), MMSYSERR_NOERROR);
+
+	for (uint32_t msg : msgs)
+		Backend::sendShort(out, msg);
+
+	Backend::closeOutput(out);
+}
+
+// ============ Backend ============
+
+void testBackend()
+{
+	CHECK_EQ(Backend::getInputCount(), LoopbackBackend::PORT_COUNT);
+	CHECK_EQ(Backend::getOutputCount(), LoopbackBackend::PORT_COUNT);
+
+	std::string name;
+	CHECK_EQ(Backend::getInputName(3, name), MMSYSERR_NOERROR);
+	CHECK(name == "EchoMIDI Loopback 3");
+	CHECK_EQ(Backend::getOutputName(LoopbackBackend::PORT_COUNT, name), MMSYSERR_BADDEVICEID);
+	CHECK_EQ(getMidiInIDByName("EchoMIDI Loopback 3"), 3u);
+
+	Backend::OutputHandle out;
+	CHECK_EQ(Backend::openOutput(out, LoopbackBackend::PORT_COUNT), MMSYSERR_BADDEVICEID);
+	CHECK_EQ(Backend::openOutput(out, 1), MMSYSERR_NOERROR);
+
+	// nothing listens on the port yet, the message is dropped.
+	CHECK_EQ(Backend::sendShort(out, 0x7F3C90), MMSYSERR_NOERROR);
+
+	{
+		Sink sink;
+		CHECK_EQ(sink.open(1), MMSYSERR_NOERROR);
+
+		// an input can only be opened once.
+		Sink second;
+		CHECK_EQ(second.open(1), MMSYSERR_ALLOCATED);
+
+		const uint32_t batch[] = { 0x003C80, 0x0007B0, 0x0000F8 };
+		const uint8_t sysex[] = { 0xF0, 0x7E, 0x7F, 0x06, 0x01, 0xF7 };
+
+		CHECK_EQ(Backend::sendShort(out, 0x7F3C90), MMSYSERR_NOERROR);
+		CHECK_EQ(Backend::sendBatch(out, batch, 3), MMSYSERR_NOERROR);
+		CHECK_EQ(Backend::sendLong(out, sysex, sizeof(sysex)), MMSYSERR_NOERROR);
+
+		// delivery is synchronous, on the sending thread.
+		CHECK(sink.get() == std::vector<uint32_t>({ 0x7F3C90, 0x003C80, 0x0007B0, 0x0000F8 }));
+		CHECK(sink.sysex == std::vector<uint8_t>(sysex, sysex + sizeof(sysex)));
+
+		// a stopped input recieves nothing.
+		CHECK_EQ(Backend::stopInput(sink.handle), MMSYSERR_NOERROR);
+		CHECK_EQ(Backend::sendShort(out, 0x7F3C90), MMSYSERR_NOERROR);
+		CHECK_EQ(sink.get().size(), 4u);
+	}
+
+	Backend::closeOutput(out);
+}
+
+// ============ Echoer ============
+
+void testEchoer(bool async)
+{
+	Sink target;
+	Sink muted;
+	CHECK_EQ(target.open(2), MMSYSERR_NOERROR);
+	CHECK_EQ(muted.open(3), MMSYSERR_NOERROR);
+
+	std::vector<uint32_t> msgs = makeMessages(0, 1000);
+
+	{
+		Echoer echoer;
+		echoer.open(1);
+		echoer.setAsync(async);
+		echoer.add(2);
+		echoer.add(3);
+		echoer.setMute(3, true);
+		echoer.start();
+
+		CHECK(echoer.isEchoing());
+		CHECK(echoer.isMuted(3));
+
+		sendAll(1, msgs);
+
+		CHECK(target.waitFor(msgs.size()) == msgs);
+
+		echoer.stop();
+	}
+
+	CHECK(muted.get().empty());
+}
+
+// two Echoers sending to the same output, both streams arrive complete, and each in its own order.
+void testSharedOutput()
+{
+	Sink target;
+	CHECK_EQ(target.open(4), MMSYSERR_NOERROR);
+
+	std::vector<uint32_t> first = makeMessages(1, 500);
+	std::vector<uint32_t> second = makeMessages(2, 500);
+
+	{
+		Echoer first_echoer;
+		first_echoer.open(5);
+		first_echoer.add(4);
+		first_echoer.start();
+
+		Echoer second_echoer;
+		second_echoer.open(6);
+		second_echoer.add(4);
+		second_echoer.start();
+
+		std::thread sender([&]() { sendAll(6, second); });
+		sendAll(5, first);
+		sender.join();
+
+		std::vector<uint32_t> recieved = target.waitFor(first.size() + second.size());
+		CHECK_EQ(recieved.size(), first.size() + second.size());
+
+		std::vector<uint32_t> from_first;
+		std::vector<uint32_t> from_second;
+
+		for (uint32_t msg : recieved)
+			((msg & 0x0F) == 1 ? from_first : from_second).push_back(msg);
+
+		CHECK(from_first == first);
+		CHECK(from_second == second);
+	}
+}
+
+int main()
+{
+	EchoMIDIInit();
+
+	try
+	{
+		testBackend();
+		testEchoer(false);
+		testEchoer(true);
+		testSharedOutput();
+	}
+	catch (const MIDIEchoExcept& e)
+	{
+		std::fprintf(stderr, "%s\n", e.what());
+		check_failures++;
+	}
+
+	EchoMIDICleanup();
+
+	return checkResult();
+}
@@ -0,0 +1,274 @@
+// CaptureJournal: capturing through a loopback Echoer, reading the journal back, replaying it, also for a single input, and dropping events once it is full.
+
+#include "Check.h"
+#include "Backend.h"
+#include "CaptureJournal.h"
+#include "Echoer.h"
+#include "FocusHook.h"
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <vector>
+
+using namespace EchoMIDI;
+
+// ============ Local defines ============
+
+// records every message delivered to a loopback input.
+struct Sink
+{
+	std::mutex mutex;
+	std::vector<uint32_t> msgs;
+	std::vector<uint8_t> sysex;
+	Backend::InputHandle handle = {};
+
+	InputCallbacks callbacks = { this,
+		[](void* user, uint32_t msg, DWORD)
+		{
+			Sink& sink = *(Sink*)user;
+			std::lock_guard lock(sink.mutex);
+			sink.msgs.push_back(msg);
+		},
+		[](void* user, const uint8_t* data, size_t length, DWORD)
+		{
+			Sink& sink = *(Sink*)user;
+			std::lock_guard lock(sink.mutex);
+			sink.sysex.insert(sink.sysex.end(), data, data + length);
+		} };
+
+	Sink(UINT id)
+	{
+		Backend::openInput(handle, id, callbacks);
+		Backend::startInput(handle);
+	}
+
+	~Sink()
+	{
+		Backend::closeInput(handle);
+	}
+};
+
+std::vector<uint8_t> readBytes(const std::filesystem::path& file)
+{
+	std::ifstream stream(file, std::ios::binary);
+
+	return std::vector<uint8_t>(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+}
+
+void writeBytes(const std::filesystem::path& file, const std::vector<uint8_t>& bytes)
+{
+	std::ofstream(file, std::ios::binary | std::ios::trunc).write((const char*)bytes.data(), (std::streamsize)bytes.size());
+}
+
+static const std::vector<uint32_t> SHORT_MSGS = { 0x7F3C90, 0x1001B0, 0x2000E0, 0x003C80, 0x0000F8 };
+static const std::vector<uint8_t> SYSEX = { 0xF0, 0x7E, 0x7F, 0x06, 0x01, 0xF7 };
+
+// ============ Round trip ============
+
+void testRoundTrip(const std::filesystem::path& dir)
+{
+	std::filesystem::path file = dir / "capture.emj";
+
+	auto journal = std::make_shared<CaptureJournal>(file, 4096);
+
+	{
+		Sink target(2);
+
+		Echoer echoer;
+		echoer.open(1);
+		echoer.add(2);
+		echoer.setCapture(journal);
+		echoer.start();
+
+		Backend::OutputHandle out;
+		Backend::openOutput(out, 1);
+
+		for (uint32_t msg : SHORT_MSGS)
+			Backend::sendShort(out, msg);
+
+		Backend::sendLong(out, SYSEX.data(), SYSEX.size());
+		Backend::closeOutput(out);
+
+		echoer.stop();
+		echoer.setCapture(nullptr);
+
+		CHECK(target.msgs == SHORT_MSGS);
+	}
+
+	CHECK_EQ(journal->getEventCount(), SHORT_MSGS.size() + 1);
+	CHECK_EQ(journal->getDropCount(), 0u);
+
+	// the file is still preallocated, the reader stops at the first record that was never committed.
+	{
+		JournalReader reader(file);
+
+		CHECK_EQ(reader.getEvents().size(), SHORT_MSGS.size() + 1);
+		CHECK(reader.getSources() == std::vector<UINT>({ 1 }));
+	}
+
+	journal.reset();
+
+	JournalReader reader(file);
+	const std::vector<JournalEvent>& events = reader.getEvents();
+
+	CHECK_EQ(events.size(), SHORT_MSGS.size() + 1);
+
+	for (size_t i = 0; i < SHORT_MSGS.size() && i < events.size(); i++)
+	{
+		CHECK(!events[i].isLong());
+		CHECK_EQ(events[i].msg, SHORT_MSGS[i]);
+		CHECK_EQ(events[i].source, 1u);
+		CHECK(i == 0 || events[i].time >= events[i - 1].time);
+	}
+
+	if (events.size() == SHORT_MSGS.size() + 1)
+	{
+		const JournalEvent& sysex = events.back();
+
+		CHECK(sysex.isLong());
+		CHECK(std::vector<uint8_t>(sysex.data, sysex.data + sysex.length) == SYSEX);
+	}
+
+	// replaying into an Echoer that is not echoing sends the same messages to its targets.
+	{
+		Sink target(4);
+
+		Echoer echoer;
+		echoer.open(3);
+		echoer.add(4);
+
+		ReplayConfig config;
+		config.speed = 0;
+
+		JournalReplay replay(reader, echoer, config);
+		replay.wait();
+
+		CHECK(replay.isDone());
+		CHECK_EQ(replay.getReplayedCount(), events.size());
+		CHECK(target.msgs == SHORT_MSGS);
+		CHECK(target.sysex == SYSEX);
+	}
+
+	// a record whose size was never written ends the journal, even if records follow it.
+	std::vector<uint8_t> bytes = readBytes(file);
+	size_t second_record = sizeof(JournalHeader) + sizeof(JournalRecord);
+	std::memset(bytes.data() + second_record, 0, sizeof(uint32_t));
+
+	std::filesystem::path cut_file = dir / "cut.emj";
+	writeBytes(cut_file, bytes);
+
+	CHECK_EQ(JournalReader(cut_file).getEvents().size(), 1u);
+
+	// anything else is not a journal.
+	writeBytes(cut_file, { 'n', 'o', 't', ' ', 'a', ' ', 'j', 'o', 'u', 'r', 'n', 'a', 'l' });
+
+	bool threw = false;
+
+	try
+	{
+		JournalReader invalid(cut_file);
+	}
+	catch (const MIDIEchoExcept&)
+	{
+		threw = true;
+	}
+
+	CHECK(threw);
+}
+
+// ============ Filtered replay ============
+
+void testFilteredReplay(const std::filesystem::path& dir)
+{
+	std::filesystem::path file = dir / "sources.emj";
+
+	{
+		CaptureJournal journal(file, 4096);
+
+		int64_t now = latencyNow();
+
+		// the events of input 2 start two seconds after the event of input 1.
+		journal.appendShort(1, 0x7F3C90, 0, now);
+		journal.appendShort(2, 0x7F3E90, 2000, now + 2'000'000'000);
+		journal.appendShort(2, 0x003E80, 2050, now + 2'050'000'000);
+	}
+
+	JournalReader reader(file);
+	CHECK(reader.getSources() == std::vector<UINT>({ 1, 2 }));
+
+	Sink target(6);
+
+	Echoer echoer;
+	echoer.open(5);
+	echoer.add(6);
+
+	ReplayConfig config;
+	config.source = 2;
+
+	auto start = std::chrono::steady_clock::now();
+
+	JournalReplay replay(reader, echoer, config);
+	replay.wait();
+
+	// the pace starts at the first event of input 2, so only the 50 ms between its events are waited for.
+	CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(1));
+	CHECK_EQ(replay.getReplayedCount(), 2u);
+	CHECK(target.msgs == std::vector<uint32_t>({ 0x7F3E90, 0x003E80 }));
+}
+
+// ============ Full journal ============
+
+void testFull(const std::filesystem::path& dir)
+{
+	std::filesystem::path file = dir / "full.emj";
+
+	{
+		// room for exactly two short messages.
+		CaptureJournal journal(file, 2 * sizeof(JournalRecord));
+
+		int64_t now = latencyNow();
+
+		CHECK(journal.appendShort(1, 0x7F3C90, 0, now));
+		CHECK(journal.appendShort(1, 0x003C80, 1, now));
+		CHECK(!journal.appendShort(1, 0x7F3C90, 2, now));
+		CHECK(!journal.appendLong(1, SYSEX.data(), SYSEX.size(), 3, now));
+
+		CHECK_EQ(journal.getEventCount(), 2u);
+		CHECK_EQ(journal.getDropCount(), 2u);
+	}
+
+	// the file is truncated to the records written.
+	CHECK_EQ(std::filesystem::file_size(file), sizeof(JournalHeader) + 2 * sizeof(JournalRecord));
+	CHECK_EQ(JournalReader(file).getEvents().size(), 2u);
+}
+
+int main()
+{
+	EchoMIDIInit();
+
+	std::filesystem::path dir = std::filesystem::temp_directory_path() / "EchoMIDICaptureJournalTest";
+	std::filesystem::remove_all(dir);
+	std::filesystem::create_directories(dir);
+
+	try
+	{
+		testRoundTrip(dir);
+		testFilteredReplay(dir);
+		testFull(dir);
+	}
+	catch (const MIDIEchoExcept& e)
+	{
+		std::fprintf(stderr, "%s\n", e.what());
+		check_failures++;
+	}
+
+	std::filesystem::remove_all(dir);
+
+	EchoMIDICleanup();
+
+	return checkResult();
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+// minimal checks for the test executables, a failed check is reported, and the test goes on,
+// so a single run shows every failure, main() returns checkResult().
+
+#include <cstdio>
+
+inline int check_failures = 0;
+
+#define CHECK(condition) \
+	do \
+	{ \
+		if (!(condition)) \
+		{ \
+			std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+			check_failures++; \
+		} \
+	} while (false)
+
+#define CHECK_EQ(actual, expected) \
+	do \
+	{ \
+		auto check_actual = (actual); \
+		auto check_expected = (expected); \
+		if (!(check_actual == check_expected)) \
+		{ \
+			std::fprintf(stderr, "%s:%d: check failed: %s == %s, got %lld, expected %lld\n", __FILE__, __LINE__, #actual, #expected, \
+				(long long)check_actual, (long long)check_expected); \
+			check_failures++; \
+		} \
+	} while (false)
+
+inline int checkResult()
+{
+	if (check_failures > 0)
+		std::fprintf(stderr, "%d checks failed\n", check_failures);
+
+	return check_failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,68 @@
+// Coalescer: latest value wins per controller, at the position of its first arrival, and never across a barrier.
+
+#include "Check.h"
+#include "Coalescer.h"
+
+#include <vector>
+
+using namespace EchoMIDI;
+
+struct Message
+{
+	uint32_t msg;
+};
+
+// coalesces msgs, and returns the messages left.
+std::vector<uint32_t> coalesce(Coalescer& coalescer, std::vector<uint32_t> msgs)
+{
+	std::vector<Message> messages;
+
+	for (uint32_t msg : msgs)
+		messages.push_back({ msg });
+
+	size_t count = coalescer.coalesce(messages.data(), messages.size());
+
+	std::vector<uint32_t> out;
+
+	for (size_t i = 0; i < count; i++)
+		out.push_back(messages[i].msg);
+
+	return out;
+}
+
+int main()
+{
+	Coalescer coalescer;
+
+	CHECK(coalesce(coalescer, {}).empty());
+
+	// mod wheel, pitch bend and channel pressure keep their newest value, at the position of their first arrival.
+	CHECK(coalesce(coalescer, { 0x1001B0, 0x0000E0, 0x2001B0, 0x4000E0, 0x3001B0, 0x10D0, 0x20D0 })
+		== std::vector<uint32_t>({ 0x3001B0, 0x4000E0, 0x20D0 }));
+
+	// channels, controllers and poly aftertouch notes are coalesced independently.
+	CHECK(coalesce(coalescer, { 0x1001B0, 0x1001B1, 0x1002B0, 0x103CA0, 0x103DA0, 0x2001B0, 0x203CA0 })
+		== std::vector<uint32_t>({ 0x2001B0, 0x1001B1, 0x1002B0, 0x203CA0, 0x103DA0 }));
+
+	// a note is a barrier, controllers on either side of it are never merged.
+	CHECK(coalesce(coalescer, { 0x1001B0, 0x2001B0, 0x7F3C90, 0x3001B0, 0x4001B0 })
+		== std::vector<uint32_t>({ 0x2001B0, 0x7F3C90, 0x4001B0 }));
+
+	// controllers whose order matters are never coalesced, and act as barriers themselves.
+	CHECK(coalesce(coalescer, { 0x7F40B0, 0x0040B0, 0x7F40B0 }) == std::vector<uint32_t>({ 0x7F40B0, 0x0040B0, 0x7F40B0 }));
+	CHECK(coalesce(coalescer, { 0x0000B0, 0x0100B0, 0x0065B0, 0x0006B0, 0x0106B0 }).size() == 5);
+	CHECK(!Coalescer::isCoalescable(0x7F3C90));
+	CHECK(!Coalescer::isCoalescable(0x0007C0));
+	CHECK(!Coalescer::isCoalescable(0x0000F8));
+	CHECK(!Coalescer::isCoalescable(0x007BB0));
+	CHECK(Coalescer::isCoalescable(0x0007B0));
+
+	// batches are independent of each other, also once the generation wraps around.
+	for (size_t i = 0; i < 70'000; i++)
+		coalesce(coalescer, { 0x1001B0 });
+
+	CHECK(coalesce(coalescer, { 0x1001B0, 0x2001B0 }) == std::vector<uint32_t>({ 0x2001B0 }));
+	CHECK(coalesce(coalescer, { 0x3001B0 }) == std::vector<uint32_t>({ 0x3001B0 }));
+
+	return checkResult();
+}
@@ -0,0 +1,131 @@
+// DeviceRegistry: lookups against the loopback ports, and the diff between two enumerations.
+
+#include "Check.h"
+#include "DeviceRegistry.h"
+
+#include <climits>
+
+using namespace EchoMIDI;
+
+// ============ Lookups ============
+
+void testLookups()
+{
+	DeviceRegistry registry;
+
+	CHECK_EQ(registry.getGeneration(), 0u);
+	CHECK_EQ(registry.getInputCount(), LoopbackBackend::PORT_COUNT);
+	CHECK_EQ(registry.getOutputCount(), LoopbackBackend::PORT_COUNT);
+	CHECK_EQ(registry.getGeneration(), 1u);
+
+	std::string name;
+	CHECK_EQ(registry.getOutputName(7, name), MMSYSERR_NOERROR);
+	CHECK(name == "EchoMIDI Loopback 7");
+	CHECK_EQ(registry.getInputName(LoopbackBackend::PORT_COUNT, name), MMSYSERR_BADDEVICEID);
+
+	CHECK_EQ(registry.getInputID("EchoMIDI Loopback 5"), 5u);
+	CHECK_EQ(registry.getOutputID("EchoMIDI Loopback 15"), 15u);
+	CHECK_EQ(registry.getOutputID("EchoMIDI Loopback"), UINT_MAX);
+
+	// lookups never enumerate again.
+	CHECK_EQ(registry.getGeneration(), 1u);
+}
+
+void testRescan()
+{
+	DeviceRegistry registry;
+
+	// the first enumeration has nothing to compare against.
+	CHECK(registry.rescan().empty());
+
+	// the loopback ports never change.
+	DeviceChanges changes = registry.rescan();
+
+	CHECK(changes.empty());
+	CHECK_EQ(changes.input_ids.size(), (size_t)LoopbackBackend::PORT_COUNT);
+	CHECK_EQ(changes.output_ids[3], 3u);
+	CHECK_EQ(registry.getGeneration(), 2u);
+}
+
+// ============ Diff ============
+
+// a list of devices, an empty name is a device that failed to enumerate.
+DeviceRegistry::DeviceList makeList(std::vector<std::string> names)
+{
+	DeviceRegistry::DeviceList list;
+
+	for (std::string& name : names)
+		list.caps.push_back({ name, name.empty() ? MMSYSERR_NODRIVER : MMSYSERR_NOERROR });
+
+	return list;
+}
+
+struct Diff
+{
+	std::vector<std::string> added;
+	std::vector<std::string> removed;
+	std::vector<UINT> ids;
+	bool renumbered;
+};
+
+Diff diff(std::vector<std::string> old_names, std::vector<std::string> new_names)
+{
+	Diff result;
+	result.renumbered = DeviceRegistry::diff(makeList(old_names), makeList(new_names), result.added, result.removed, result.ids);
+
+	return result;
+}
+
+void testDiff()
+{
+	using Names = std::vector<std::string>;
+	using IDs = std::vector<UINT>;
+
+	Diff result = diff({ "A", "B" }, { "A", "B" });
+	CHECK(result.added.empty() && result.removed.empty() && !result.renumbered);
+	CHECK(result.ids == IDs({ 0, 1 }));
+
+	// removing a device shifts every device after it.
+	result = diff({ "A", "B", "C" }, { "A", "C" });
+	CHECK(result.removed == Names({ "B" }));
+	CHECK(result.ids == IDs({ 0, UINT_MAX, 1 }));
+	CHECK(result.renumbered);
+
+	// devices added at the end leave every id as it is.
+	result = diff({ "A" }, { "A", "B", "B" });
+	CHECK(result.added == Names({ "B", "B" }));
+	CHECK(result.ids == IDs({ 0 }));
+	CHECK(!result.renumbered);
+
+	// devices sharing a name are matched in id order.
+	result = diff({ "A", "B", "A" }, { "A", "A", "B" });
+	CHECK(result.added.empty() && result.removed.empty());
+	CHECK(result.ids == IDs({ 0, 2, 1 }));
+	CHECK(result.renumbered);
+
+	// of two devices sharing a name, the one with the higher id is the one removed.
+	result = diff({ "A", "A" }, { "A" });
+	CHECK(result.removed == Names({ "A" }));
+	CHECK(result.ids == IDs({ 0, UINT_MAX }));
+	CHECK(!result.renumbered);
+
+	result = diff({ "B", "A", "A" }, { "A", "A" });
+	CHECK(result.removed == Names({ "B" }));
+	CHECK(result.ids == IDs({ UINT_MAX, 0, 1 }));
+	CHECK(result.renumbered);
+
+	// devices that failed to enumerate are neither added nor removed.
+	result = diff({ "A", "" }, { "", "A" });
+	CHECK(result.added.empty() && result.removed.empty());
+	CHECK(result.ids == IDs({ 1, UINT_MAX }));
+	CHECK(result.renumbered);
+}
+
+int main()
+{
+	testLookups();
+	testRescan();
+	testDiff();
+
+	return checkResult();
+}
@@ -0,0 +1,102 @@
+// FileWatcher: a burst of writes is reported once, after it settled, and only changed contents are reported.
+
+#include "Check.h"
+#include "FileWatcher.h"
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+using namespace EchoMIDI;
+
+static constexpr std::chrono::milliseconds SETTLE_TIME = std::chrono::milliseconds(200);
+
+void writeFile(const std::filesystem::path& file, const char* contents)
+{
+	std::ofstream(file, std::ios::binary | std::ios::trunc) << contents;
+}
+
+// waits for up to a few seconds, until count reaches expected.
+bool waitFor(const std::atomic<int>& count, int expected)
+{
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+
+	while (count.load() < expected && std::chrono::steady_clock::now() < deadline)
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+	return count.load() >= expected;
+}
+
+int main()
+{
+	std::filesystem::path dir = std::filesystem::temp_directory_path() / "EchoMIDIFileWatcherTest";
+	std::filesystem::path file = dir / "preset.json";
+
+	std::filesystem::remove_all(dir);
+	std::filesystem::create_directories(dir);
+	writeFile(file, "initial");
+
+	std::atomic<int> count = 0;
+	std::atomic<int64_t> notified_at = 0;
+
+	auto now = []() { return std::chrono::steady_clock::now().time_since_epoch().count(); };
+
+	{
+		FileWatcher watcher(file, [&]()
+			{
+				notified_at = now();
+				count++;
+			}, SETTLE_TIME);
+
+		CHECK(watcher.isWatching());
+		CHECK(watcher.getFile() == std::filesystem::absolute(file));
+
+		// several writes in quick succession, like an editor saving in steps, are read once, once they settled.
+		writeFile(file, "");
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		writeFile(file, "first");
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		writeFile(file, "second");
+
+		int64_t written_at = now();
+
+		CHECK(waitFor(count, 1));
+		CHECK(notified_at - written_at >= std::chrono::duration_cast<std::chrono::steady_clock::duration>(SETTLE_TIME).count());
+
+		std::this_thread::sleep_for(SETTLE_TIME * 3);
+		CHECK_EQ(count.load(), 1);
+
+		// saving the same contents again, touching the file, or changing another file of the directory is not reported.
+		writeFile(file, "second");
+		std::filesystem::last_write_time(file, std::filesystem::file_time_type::clock::now());
+		writeFile(dir / "other.json", "other");
+
+		std::this_thread::sleep_for(SETTLE_TIME * 3);
+		CHECK_EQ(count.load(), 1);
+
+		// replacing the file by a rename is reported, like a write.
+		writeFile(dir / "preset.json.tmp", "third");
+		std::filesystem::rename(dir / "preset.json.tmp", file);
+
+		CHECK(waitFor(count, 2));
+
+		// a deleted file is only reported, once it is back with new contents.
+		std::filesystem::remove(file);
+		std::this_thread::sleep_for(SETTLE_TIME * 3);
+		CHECK_EQ(count.load(), 2);
+
+		writeFile(file, "fourth");
+		CHECK(waitFor(count, 3));
+	}
+
+	// once the watcher is destroyed, nothing is reported anymore.
+	writeFile(file, "fifth");
+	std::this_thread::sleep_for(SETTLE_TIME * 2);
+	CHECK_EQ(count.load(), 3);
+
+	std::filesystem::remove_all(dir);
+
+	return checkResult();
+}
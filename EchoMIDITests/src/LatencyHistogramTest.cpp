@@ -0,0 +1,85 @@
+// LatencyHistogram: percentiles stay within the relative error of a bucket, and never exceed the max.
+
+#include "Check.h"
+#include "LatencyHistogram.h"
+
+#include <thread>
+#include <vector>
+
+using namespace EchoMIDI;
+
+// wether value is at least expected, and above it by no more than the width of its bucket.
+bool isNear(uint64_t value, uint64_t expected)
+{
+	return value >= expected && value <= expected + expected / LatencyHistogram::SUB_BUCKET_COUNT + 1;
+}
+
+int main()
+{
+	LatencyHistogram histogram;
+
+	CHECK_EQ(histogram.getCount(), 0u);
+	CHECK_EQ(histogram.getPercentile(50), 0u);
+
+	// small values get a bucket each, and are exact.
+	for (int64_t ns = 1; ns <= 31; ns++)
+		histogram.record(ns);
+
+	CHECK_EQ(histogram.getPercentile(50), 16u);
+	CHECK_EQ(histogram.getPercentile(100), 31u);
+
+	// 1 - 100000 ns, every percentile lies within the bucket of its exact value.
+	histogram.reset();
+	CHECK_EQ(histogram.getCount(), 0u);
+	CHECK_EQ(histogram.getMax(), 0u);
+
+	for (int64_t ns = 1; ns <= 100'000; ns++)
+		histogram.record(ns);
+
+	LatencySummary summary = histogram.getSummary();
+
+	CHECK_EQ(summary.count, 100'000u);
+	CHECK(isNear(summary.p50, 50'000));
+	CHECK(isNear(summary.p99, 99'000));
+	CHECK(isNear(summary.p999, 99'900));
+	CHECK_EQ(summary.max, 100'000u);
+
+	// a single outlier is the max, and the percentiles are clamped to it.
+	histogram.reset();
+	histogram.record(1000);
+	histogram.record(1'000'000'007);
+
+	CHECK_EQ(histogram.getMax(), 1'000'000'007u);
+	CHECK(isNear(histogram.getPercentile(50), 1000));
+	CHECK_EQ(histogram.getPercentile(100), 1'000'000'007u);
+
+	// negative values count as 0, and huge values as MAX_VALUE.
+	histogram.reset();
+	histogram.record(-5);
+	histogram.record(INT64_MAX);
+
+	CHECK_EQ(histogram.getPercentile(50), 0u);
+	CHECK_EQ(histogram.getMax(), LatencyHistogram::MAX_VALUE);
+
+	// concurrent recorders never lose a value.
+	histogram.reset();
+
+	std::vector<std::thread> threads;
+
+	for (int t = 0; t < 4; t++)
+	{
+		threads.emplace_back([&]()
+			{
+				for (int64_t ns = 0; ns < 50'000; ns++)
+					histogram.record(ns);
+			});
+	}
+
+	for (std::thread& thread : threads)
+		thread.join();
+
+	CHECK_EQ(histogram.getCount(), 200'000u);
+	CHECK_EQ(histogram.getMax(), 49'999u);
+
+	return checkResult();
+}
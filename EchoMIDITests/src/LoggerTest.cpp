@@ -0,0 +1,74 @@
+// Logger: the runtime level filter, record formatting, and counting records dropped from a full ring.
+
+#include "Check.h"
+#include "Logger.h"
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+using namespace EchoMIDI;
+
+std::string readFile(const std::filesystem::path& file)
+{
+	std::ifstream stream(file);
+	std::stringstream contents;
+	contents << stream.rdbuf();
+
+	return contents.str();
+}
+
+size_t countLines(const std::string& text, const std::string& part)
+{
+	size_t count = 0;
+
+	for (size_t pos = text.find(part); pos != std::string::npos; pos = text.find(part, pos + 1))
+		count++;
+
+	return count;
+}
+
+int main()
+{
+	std::filesystem::path file = std::filesystem::temp_directory_path() / "EchoMIDILoggerTest.log";
+
+	// the logger thread is never started, so every record stays in the ring until it is flushed.
+	setLogConsole(false);
+	setLogFile(file, true);
+
+	// records below the runtime level are discarded, before they reach the ring.
+	setLogLevel(LogLevel::WARN);
+	CHECK(getLogLevel() == LogLevel::WARN);
+
+	ECHOMIDI_LOG(LogLevel::INFO, "filtered record");
+	ECHOMIDI_LOG(LogLevel::WARN, "kept record", "some text", { 1, -2 });
+	ECHOMIDI_LOG(LogLevel::ERR, "too many values", "", { 1, 2, 3, 4, 5 });
+	flushLog();
+
+	std::string log = readFile(file);
+
+	CHECK(log.find("filtered record") == std::string::npos);
+	CHECK(log.find("WARN  kept record: some text (1, -2): at ") != std::string::npos);
+	CHECK(log.find("ERROR too many values (1, 2, 3, 4): at ") != std::string::npos);
+
+	// a full ring drops every further record, and the drop is reported once with the next flush.
+	setLogLevel(LogLevel::TRACE);
+
+	for (size_t i = 0; i < LOG_RING_SIZE + 10; i++)
+		ECHOMIDI_LOG(LogLevel::TRACE, "flood record");
+
+	CHECK_EQ(getLogDropCount(), 10u);
+
+	flushLog();
+	closeLogFile();
+
+	log = readFile(file);
+
+	CHECK_EQ(countLines(log, "flood record"), LOG_RING_SIZE);
+	CHECK_EQ(countLines(log, "10 log records dropped"), 1u);
+
+	std::filesystem::remove(file);
+
+	return checkResult();
+}
@@ -0,0 +1,58 @@
+// formatPrometheus(): the text exposition format, label escaping, and one sample per Echoer and target.
+
+#include "Check.h"
+#include "Metrics.h"
+
+#include <string>
+
+using namespace EchoMIDI;
+
+bool contains(const std::string& text, const std::string& part)
+{
+	return text.find(part) != std::string::npos;
+}
+
+int main()
+{
+	// without any Echoer, only the headers are left.
+	std::string text = formatPrometheus({});
+
+	CHECK(contains(text, "# HELP echomidi_received_messages_total "));
+	CHECK(contains(text, "# TYPE echomidi_received_messages_total counter\n"));
+	CHECK(contains(text, "# TYPE echomidi_queue_depth gauge\n"));
+	CHECK(!contains(text, "{"));
+
+	EchoerMetrics echoer;
+	echoer.id = 2;
+	echoer.name = "Keys \"A\"\\B\nC";
+	echoer.received_count = 42;
+
+	TargetMetrics first;
+	first.id = 5;
+	first.name = "Synth";
+	first.sent_count = 40;
+	first.queue_depth = 3;
+
+	TargetMetrics second;
+	second.id = 6;
+	second.name = "Drums";
+	second.sent_count = 2;
+
+	echoer.targets = { first, second };
+
+	text = formatPrometheus({ echoer });
+
+	// backslashes, quotes and line feeds in device names are escaped.
+	const std::string input_labels = "input=\"Keys \\\"A\\\"\\\\B\\nC\",input_id=\"2\"";
+
+	CHECK(contains(text, "echomidi_received_messages_total{" + input_labels + "} 42\n"));
+	CHECK(contains(text, "echomidi_sent_messages_total{" + input_labels + ",output=\"Synth\",output_id=\"5\"} 40\n"));
+	CHECK(contains(text, "echomidi_sent_messages_total{" + input_labels + ",output=\"Drums\",output_id=\"6\"} 2\n"));
+	CHECK(contains(text, "echomidi_queue_depth{" + input_labels + ",output=\"Synth\",output_id=\"5\"} 3\n"));
+
+	// every sample line follows the header of its metric, and every line ends with a line feed.
+	CHECK(text.find("# TYPE echomidi_sent_messages_total") < text.find("echomidi_sent_messages_total{"));
+	CHECK(text.back() == '\n');
+
+	return checkResult();
+}
@@ -0,0 +1,108 @@
+// MuteMask: user mute, focus mute and disabled bits, and the send bits derived from them.
+
+#include "Check.h"
+#include "MuteMask.h"
+
+using namespace EchoMIDI;
+
+void testMute()
+{
+	MuteMask mask;
+
+	CHECK_EQ(mask.getSendBits(0), 0xFFFFFFFFu);
+	CHECK_EQ(mask.getGeneration(), 0u);
+
+	mask.setUserMuted(1, true);
+	mask.setFocusMuted(2, true);
+
+	CHECK(mask.isUserMuted(1) && !mask.isFocusMuted(1));
+	CHECK(mask.isFocusMuted(2) && !mask.isUserMuted(2));
+	CHECK_EQ(mask.getSendBits(0), ~0b110u);
+	CHECK_EQ(mask.getGeneration(), 2u);
+
+	// setting a bit to its current state is not a change.
+	mask.setUserMuted(1, true);
+	mask.setFocusMuted(3, false);
+	CHECK_EQ(mask.getGeneration(), 2u);
+
+	// slots of later words are independent of the first one.
+	size_t last_slot = MuteMask::MAX_TARGETS - 1;
+	mask.setUserMuted(last_slot, true);
+	CHECK_EQ(mask.getSendBits(MuteMask::WORD_COUNT - 1), 0x7FFFFFFFu);
+	CHECK_EQ(mask.getSendBits(0), ~0b110u);
+
+	mask.setFocusMuted(1, true);
+	mask.clear(1);
+	CHECK(!mask.isUserMuted(1) && !mask.isFocusMuted(1));
+	CHECK_EQ(mask.getSendBits(0), ~0b100u);
+}
+
+void testDisabled()
+{
+	MuteMask mask;
+
+	mask.setDisabled(3, true);
+	CHECK(mask.isDisabled(3) && !mask.isUserMuted(3) && !mask.isFocusMuted(3));
+	CHECK_EQ(mask.getSendBits(0), ~0b1000u);
+	CHECK_EQ(mask.getGeneration(), 1u);
+
+	mask.setDisabled(3, true);
+	CHECK_EQ(mask.getGeneration(), 1u);
+
+	// clearing a slot also enables it again.
+	mask.clear(3);
+	CHECK(!mask.isDisabled(3));
+	CHECK_EQ(mask.getSendBits(0), 0xFFFFFFFFu);
+}
+
+void testFocusWord()
+{
+	MuteMask mask;
+
+	mask.setUserMuted(1, true);
+	mask.setFocusMuted(1, true);
+	mask.setFocusMuted(5, true);
+
+	uint64_t generation = mask.getGeneration();
+
+	// the focus bits of a word are set at once, leaving the bits outside of slots and every user mute bit alone.
+	mask.setFocusMutedWord(0, 0b110000, 0b010000);
+	CHECK(mask.isFocusMuted(4) && !mask.isFocusMuted(5));
+	CHECK(mask.isFocusMuted(1) && mask.isUserMuted(1));
+	CHECK_EQ(mask.getGeneration(), generation + 1);
+
+	// a word that does not change is not counted.
+	mask.setFocusMutedWord(0, 0b110000, 0b010000);
+	CHECK_EQ(mask.getGeneration(), generation + 1);
+
+	mask.setFocusMutedWord(1, 0xFFFFFFFF, 0xFFFFFFFF);
+	CHECK_EQ(mask.getSendBits(1), 0u);
+	CHECK(mask.isFocusMuted(MuteMask::TARGETS_PER_WORD));
+}
+
+void testFocusSendBits()
+{
+	MuteMask mask;
+
+	mask.setUserMuted(1, true);
+	mask.setFocusMuted(1, true);
+	mask.setFocusMuted(2, true);
+	mask.setDisabled(3, true);
+	mask.setFocusMuted(3, true);
+
+	// only targets muted by focus alone are reported as focus muted.
+	uint32_t focus_muted;
+	CHECK_EQ(mask.getSendBits(0, focus_muted), ~0b1110u);
+	CHECK_EQ(focus_muted, 0b100u);
+	CHECK_EQ(mask.getSendBits(0), ~0b1110u);
+}
+
+int main()
+{
+	testMute();
+	testDisabled();
+	testFocusWord();
+	testFocusSendBits();
+
+	return checkResult();
+}
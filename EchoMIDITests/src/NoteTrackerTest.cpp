@@ -0,0 +1,80 @@
+// NoteTracker: note on / off, sustain and channel mode messages, and the messages release() sends.
+
+#include "Check.h"
+#include "NoteTracker.h"
+
+#include <vector>
+
+using namespace EchoMIDI;
+
+std::vector<uint32_t> release(NoteTracker& tracker)
+{
+	std::vector<uint32_t> sent;
+	size_t count = tracker.release([&](uint32_t msg) { sent.push_back(msg); });
+
+	CHECK_EQ(count, sent.size());
+
+	return sent;
+}
+
+int main()
+{
+	NoteTracker tracker;
+
+	CHECK(tracker.empty());
+	CHECK(release(tracker).empty());
+
+	// note 60 and 100 on channel 0, note 5 on channel 15.
+	tracker.track(0x7F3C90);
+	tracker.track(0x406490);
+	tracker.track(0x10059F);
+	CHECK_EQ(tracker.getNoteCount(), 3u);
+
+	// both a note off, and a note on with velocity 0 end a note.
+	tracker.track(0x003C80);
+	tracker.track(0x00059F);
+	CHECK_EQ(tracker.getNoteCount(), 1u);
+
+	// anything else leaves the set alone.
+	tracker.track(0x2000E0);
+	tracker.track(0x0007B0);
+	tracker.track(0x0000F8);
+	CHECK_EQ(tracker.getNoteCount(), 1u);
+
+	// the pedal is down from 64 up, and its release follows the note offs.
+	tracker.track(0x7F40B3);
+	tracker.track(0x7F40B4);
+	tracker.track(0x3F40B4);
+
+	std::vector<uint32_t> sent = release(tracker);
+	CHECK(sent == std::vector<uint32_t>({ 0x6480, 0x40B3 }));
+	CHECK(tracker.empty());
+	CHECK(release(tracker).empty());
+
+	// all sound off and all notes off end the notes of their channel only, the pedal stays down.
+	tracker.track(0x7F3C91);
+	tracker.track(0x7F3C92);
+	tracker.track(0x7F40B1);
+	tracker.track(0x0078B1);
+	CHECK_EQ(tracker.getNoteCount(), 1u);
+
+	tracker.track(0x007BB2);
+	CHECK_EQ(tracker.getNoteCount(), 0u);
+	CHECK(!tracker.empty());
+
+	sent = release(tracker);
+	CHECK(sent == std::vector<uint32_t>({ 0x40B1 }));
+
+	// every note of every channel fits.
+	for (uint32_t channel = 0; channel < 16; channel++)
+	{
+		for (uint32_t note = 0; note < 128; note++)
+			tracker.track(0x7F0090 | channel | note << 8);
+	}
+
+	CHECK_EQ(tracker.getNoteCount(), 16u * 128u);
+	CHECK_EQ(release(tracker).size(), 16u * 128u);
+	CHECK(tracker.empty());
+
+	return checkResult();
+}
@@ -0,0 +1,150 @@
+// SPSCQueue and MPSCQueue: ordering, capacity, wrap around and concurrent producers.
+
+#include "Check.h"
+#include "MPSCQueue.h"
+#include "SPSCQueue.h"
+
+#include <thread>
+#include <vector>
+
+using namespace EchoMIDI;
+
+// ============ SPSCQueue ============
+
+void testSPSC()
+{
+	SPSCQueue<uint32_t, 8> queue;
+	uint32_t elem = 0;
+
+	CHECK(queue.empty());
+	CHECK(!queue.pop(elem));
+
+	for (uint32_t i = 0; i < 8; i++)
+		CHECK(queue.push(i));
+
+	CHECK(!queue.push(8));
+	CHECK_EQ(queue.size(), 8u);
+
+	uint32_t batch[5];
+	CHECK_EQ(queue.popBatch(batch, 5), 5u);
+
+	for (uint32_t i = 0; i < 5; i++)
+		CHECK_EQ(batch[i], i);
+
+	// the next pushes wrap around the end of the buffer.
+	for (uint32_t i = 8; i < 13; i++)
+		CHECK(queue.push(i));
+
+	for (uint32_t i = 5; i < 13; i++)
+	{
+		CHECK(queue.pop(elem));
+		CHECK_EQ(elem, i);
+	}
+
+	CHECK(queue.empty());
+
+	// a consumer on another thread sees every element, in order.
+	constexpr uint32_t COUNT = 100'000;
+	SPSCQueue<uint32_t, 64> shared;
+
+	std::thread producer([&]()
+		{
+			for (uint32_t i = 0; i < COUNT; i++)
+			{
+				while (!shared.push(i))
+					std::this_thread::yield();
+			}
+		});
+
+	uint32_t expected = 0;
+	bool ordered = true;
+
+	while (expected < COUNT)
+	{
+		if (shared.pop(elem))
+			ordered &= elem == expected++;
+		else
+			std::this_thread::yield();
+	}
+
+	producer.join();
+
+	CHECK(ordered);
+}
+
+// ============ MPSCQueue ============
+
+void testMPSC()
+{
+	MPSCQueue<uint32_t, 4> queue;
+	uint32_t elem = 0;
+
+	CHECK(!queue.pop(elem));
+
+	for (uint32_t i = 0; i < 4; i++)
+		CHECK(queue.push(i));
+
+	CHECK(!queue.push(4));
+	CHECK(!queue.push(5));
+	CHECK_EQ(queue.getDropCount(), 2u);
+
+	for (uint32_t i = 0; i < 4; i++)
+	{
+		CHECK(queue.pop(elem));
+		CHECK_EQ(elem, i);
+	}
+
+	CHECK(!queue.pop(elem));
+
+	// every element of every producer arrives exactly once, and the elements of a single producer in order.
+	constexpr uint32_t PRODUCERS = 4;
+	constexpr uint32_t COUNT = 50'000;
+	MPSCQueue<uint32_t, 64> shared;
+
+	std::vector<std::thread> producers;
+
+	for (uint32_t p = 0; p < PRODUCERS; p++)
+	{
+		producers.emplace_back([&, p]()
+			{
+				for (uint32_t i = 0; i < COUNT; i++)
+				{
+					while (!shared.push(p << 24 | i))
+						std::this_thread::yield();
+				}
+			});
+	}
+
+	std::vector<uint32_t> next(PRODUCERS, 0);
+	uint32_t received = 0;
+	bool ordered = true;
+
+	while (received < PRODUCERS * COUNT)
+	{
+		if (shared.pop(elem))
+		{
+			ordered &= (elem & 0xFFFFFF) == next[elem >> 24]++;
+			received++;
+		}
+		else
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	for (std::thread& producer : producers)
+		producer.join();
+
+	CHECK(ordered);
+
+	for (uint32_t p = 0; p < PRODUCERS; p++)
+		CHECK_EQ(next[p], COUNT);
+}
+
+int main()
+{
+	testSPSC();
+	testMPSC();
+
+	return checkResult();
+}
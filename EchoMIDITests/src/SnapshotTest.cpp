@@ -0,0 +1,68 @@
+// Snapshot: readers see the published object, and publish() waits for readers of the previous one.
+
+#include "Check.h"
+#include "Snapshot.h"
+
+#include <chrono>
+#include <thread>
+
+using namespace EchoMIDI;
+
+// counts live instances, so the test can tell when the previous snapshot is deleted.
+struct Counted
+{
+	static inline std::atomic<int> alive = 0;
+
+	int value = 0;
+
+	Counted() { alive++; }
+	Counted(int value) : value(value) { alive++; }
+	~Counted() { alive--; }
+};
+
+int main()
+{
+	{
+		Snapshot<Counted> snapshot;
+
+		CHECK_EQ(snapshot.read()->value, 0);
+
+		snapshot.publish(std::make_unique<Counted>(1));
+
+		CHECK_EQ(snapshot.read()->value, 1);
+		CHECK_EQ(Counted::alive.load(), 1);
+
+		// a reader holding the old object keeps it alive, and blocks the writer until it is done.
+		std::atomic<bool> published = false;
+		std::thread writer;
+
+		{
+			auto guard = snapshot.read();
+
+			writer = std::thread([&]()
+				{
+					snapshot.publish(std::make_unique<Counted>(2));
+					published = true;
+				});
+
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+			CHECK(!published);
+			CHECK_EQ(guard->value, 1);
+			CHECK_EQ(Counted::alive.load(), 2);
+		}
+
+		writer.join();
+
+		CHECK(published);
+		CHECK_EQ(snapshot.read()->value, 2);
+		CHECK_EQ(Counted::alive.load(), 1);
+
+		// with no reader left, a grace period ends right away.
+		snapshot.synchronize();
+	}
+
+	CHECK_EQ(Counted::alive.load(), 0);
+
+	return checkResult();
+}
@@ -0,0 +1,89 @@
+// TransformRules / TransformTable: filters, channel map, splits, transpose and velocity curve.
+
+#include "Check.h"
+#include "Transform.h"
+
+using namespace EchoMIDI;
+
+// applies the rules to msg, 0 if the message is not sent.
+uint32_t apply(const TransformRules& rules, uint32_t msg)
+{
+	return rules.compile().apply(msg) ? msg : 0;
+}
+
+int main()
+{
+	TransformRules rules;
+
+	CHECK(rules.isIdentity());
+
+	// the identity leaves every message untouched.
+	for (uint32_t msg : { 0x7F3C90u, 0x003C80u, 0x2000E5u, 0x0007BFu, 0x0000F8u, 0x0000F0u })
+		CHECK_EQ(apply(rules, msg), msg);
+
+	// channel map, and channel filter.
+	rules.channel_map[0] = 9;
+	CHECK(!rules.isIdentity());
+	CHECK_EQ(apply(rules, 0x7F3C90), 0x7F3C99u);
+	CHECK_EQ(apply(rules, 0x7F3C91), 0x7F3C91u);
+
+	rules.channel_mask = 0xFFFE;
+	CHECK_EQ(apply(rules, 0x7F3C90), 0u);
+	CHECK_EQ(apply(rules, 0x7F3C91), 0x7F3C91u);
+
+	// type filter, system messages have no channel, and are only filtered by their type.
+	rules = {};
+	rules.type_mask = TransformRules::ALL_TYPES & ~(TransformRules::CONTROL_CHANGE | TransformRules::SYSTEM);
+	CHECK_EQ(apply(rules, 0x0007B0), 0u);
+	CHECK_EQ(apply(rules, 0x0000F8), 0u);
+	CHECK_EQ(apply(rules, 0x2000E0), 0x2000E0u);
+
+	// split and transpose apply to every message carrying a note, notes leaving 0 - 127 are dropped.
+	rules = {};
+	rules.note_low = 48;
+	rules.note_high = 72;
+	rules.transpose = 12;
+	CHECK_EQ(apply(rules, 0x7F3C90), 0x7F4890u);
+	CHECK_EQ(apply(rules, 0x003C80), 0x004880u);
+	CHECK_EQ(apply(rules, 0x103CA0), 0x1048A0u);
+	CHECK_EQ(apply(rules, 0x7F2F90), 0u);
+	CHECK_EQ(apply(rules, 0x7F4990), 0u);
+	CHECK_EQ(apply(rules, 0x0007B0), 0x0007B0u);
+
+	rules = {};
+	rules.transpose = -12;
+	CHECK_EQ(apply(rules, 0x7F0B90), 0u);
+	CHECK_EQ(apply(rules, 0x7F0C90), 0x7F0090u);
+
+	// the velocity range clamps note ons, a note on with velocity 0 stays a note off.
+	rules = {};
+	rules.velocity_min = 20;
+	rules.velocity_max = 100;
+
+	TransformTable table = rules.compile();
+
+	for (uint32_t velocity = 1; velocity < 128; velocity++)
+	{
+		uint32_t msg = 0x3C90 | velocity << 16;
+		CHECK(table.apply(msg));
+
+		uint32_t mapped = msg >> 16;
+		CHECK(mapped >= 20 && mapped <= 100);
+	}
+
+	CHECK_EQ(apply(rules, 0x003C90), 0x003C90u);
+	CHECK_EQ(apply(rules, 0x7F3C80), 0x7F3C80u);
+
+	// a curve below 1 makes soft playing louder, and keeps the velocities in order.
+	rules = {};
+	rules.velocity_curve = 0.5f;
+	table = rules.compile();
+
+	CHECK(table.velocity_map[32] > 32);
+	CHECK_EQ(table.velocity_map[127], 127u);
+
+	for (size_t velocity = 2; velocity < 128; velocity++)
+		CHECK(table.velocity_map[velocity] >= table.velocity_map[velocity - 1] && table.velocity_map[velocity] >= 1);
+
+	return checkResult();
+}
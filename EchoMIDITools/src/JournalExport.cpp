@@ -0,0 +1,229 @@
+// converts a capture journal, see CaptureJournal, into a type 1 standard midi file, with a track per input device.
+// the midi file runs at 120 bpm with 1000 ticks per quarter note, so every tick is 0.5 ms, finer than any driver timestamp.
+// system realtime messages have no representation in a midi file, and are skipped.
+//
+// usage: EchoMIDIJournalExport <journal> <midi file> [input id]
+
+#include "CaptureJournal.h"
+#include "Echoer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace EchoMIDI;
+
+// ============ Midi file ============
+
+static constexpr uint16_t TICKS_PER_QUARTER = 1000;
+static constexpr uint32_t MICROSECONDS_PER_QUARTER = 500'000;
+static constexpr int64_t NANOSECONDS_PER_TICK = (int64_t)MICROSECONDS_PER_QUARTER * 1000 / TICKS_PER_QUARTER;
+
+void writeBigEndian(std::vector<uint8_t>& out, uint32_t value, size_t bytes)
+{
+	for (size_t i = bytes; i > 0; i--)
+		out.push_back((uint8_t)(value >> (8 * (i - 1))));
+}
+
+void writeVarLen(std::vector<uint8_t>& out, uint32_t value)
+{
+	uint8_t bytes[5];
+	size_t count = 0;
+
+	do
+	{
+		bytes[count++] = value & 0x7F;
+		value >>= 7;
+	} while (value != 0);
+
+	// every byte but the last has its high bit set.
+	while (count > 1)
+		out.push_back(bytes[--count] | 0x80);
+
+	out.push_back(bytes[0]);
+}
+
+// collects the events of a single track, and converts their times into delta times.
+struct Track
+{
+	std::vector<uint8_t> data;
+	int64_t last_tick = 0;
+
+	void writeDelta(int64_t tick)
+	{
+		writeVarLen(data, (uint32_t)std::max<int64_t>(0, tick - last_tick));
+		last_tick = std::max(last_tick, tick);
+	}
+
+	void writeMeta(int64_t tick, uint8_t type, const std::vector<uint8_t>& bytes)
+	{
+		writeDelta(tick);
+		data.push_back(0xFF);
+		data.push_back(type);
+		writeVarLen(data, (uint32_t)bytes.size());
+		data.insert(data.end(), bytes.begin(), bytes.end());
+	}
+
+	// @return false if the event has no representation in a midi file.
+	bool writeEvent(int64_t tick, const JournalEvent& event)
+	{
+		if (event.isLong())
+		{
+			writeDelta(tick);
+
+			// a SysEx message split over several blocks continues with escaped packets.
+			if (event.data[0] == 0xF0)
+			{
+				data.push_back(0xF0);
+				writeVarLen(data, (uint32_t)event.length - 1);
+				data.insert(data.end(), event.data + 1, event.data + event.length);
+			}
+			else
+			{
+				data.push_back(0xF7);
+				writeVarLen(data, (uint32_t)event.length);
+				data.insert(data.end(), event.data, event.data + event.length);
+			}
+
+			return true;
+		}
+
+		uint8_t status = event.msg & 0xFF;
+		size_t length = getShortMessageLength(status);
+
+		// running status never reaches the midi callback, and realtime messages would be read as meta events.
+		if (status < 0x80 || status >= 0xF8)
+			return false;
+
+		writeDelta(tick);
+
+		// system common messages are only allowed as escaped packets.
+		if (status >= 0xF0)
+		{
+			data.push_back(0xF7);
+			writeVarLen(data, (uint32_t)length);
+		}
+
+		for (size_t i = 0; i < length; i++)
+			data.push_back((uint8_t)(event.msg >> (8 * i)));
+
+		return true;
+	}
+
+	void end()
+	{
+		writeMeta(last_tick, 0x2F, {});
+	}
+};
+
+void writeChunk(std::vector<uint8_t>& out, const char* type, const std::vector<uint8_t>& data)
+{
+	out.insert(out.end(), type, type + 4);
+	writeBigEndian(out, (uint32_t)data.size(), 4);
+	out.insert(out.end(), data.begin(), data.end());
+}
+
+// ============ Main ============
+
+int main(int argc, char** argv)
+{
+	if (argc < 3)
+	{
+		std::fprintf(stderr, "usage: %s <journal> <midi file> [input id]\n", argv[0]);
+		return 1;
+	}
+
+	try
+	{
+		JournalReader reader(argv[1]);
+
+		const std::vector<JournalEvent>& events = reader.getEvents();
+		std::vector<UINT> sources = reader.getSources();
+
+		if (argc > 3)
+		{
+			UINT source = (UINT)std::strtoul(argv[3], nullptr, 10);
+
+			if (!std::ranges::binary_search(sources, source))
+			{
+				std::fprintf(stderr, "the journal has no events of input %u\n", source);
+				return 1;
+			}
+
+			sources = { source };
+		}
+
+		// every track starts at the first event of the journal, so the inputs stay aligned with each other.
+		int64_t first_time = events.empty() ? 0 : std::ranges::min_element(events, {}, &JournalEvent::time)->time;
+
+		Track tempo_track;
+		tempo_track.writeMeta(0, 0x51, { (uint8_t)(MICROSECONDS_PER_QUARTER >> 16), (uint8_t)(MICROSECONDS_PER_QUARTER >> 8), (uint8_t)MICROSECONDS_PER_QUARTER });
+		tempo_track.end();
+
+		std::vector<uint8_t> file;
+		std::vector<uint8_t> header;
+
+		writeBigEndian(header, 1, 2);
+		writeBigEndian(header, (uint32_t)sources.size() + 1, 2);
+		writeBigEndian(header, TICKS_PER_QUARTER, 2);
+
+		writeChunk(file, "MThd", header);
+		writeChunk(file, "MTrk", tempo_track.data);
+
+		size_t skipped_count = 0;
+
+		for (UINT source : sources)
+		{
+			// events of different inputs may be appended slightly out of order, the order within an input is kept.
+			std::vector<const JournalEvent*> track_events;
+
+			for (const JournalEvent& event : events)
+			{
+				if (event.source == source)
+					track_events.push_back(&event);
+			}
+
+			std::ranges::stable_sort(track_events, {}, [](const JournalEvent* event) { return event->time; });
+
+			std::string name = "Input " + std::to_string(source);
+
+			Track track;
+			track.writeMeta(0, 0x03, std::vector<uint8_t>(name.begin(), name.end()));
+
+			for (const JournalEvent* event : track_events)
+			{
+				if (!track.writeEvent((event->time - first_time) / NANOSECONDS_PER_TICK, *event))
+					skipped_count++;
+			}
+
+			track.end();
+
+			writeChunk(file, "MTrk", track.data);
+
+			std::printf("input %u: %zu events\n", source, track_events.size());
+		}
+
+		std::ofstream out(argv[2], std::ios::binary);
+		out.write((const char*)file.data(), (std::streamsize)file.size());
+
+		if (!out)
+		{
+			std::fprintf(stderr, "could not write %s\n", argv[2]);
+			return 1;
+		}
+
+		double duration = events.empty() ? 0 : (std::ranges::max_element(events, {}, &JournalEvent::time)->time - first_time) / 1e9;
+
+		std::printf("%zu tracks, %.3f s, %zu realtime messages skipped\n", sources.size(), duration, skipped_count);
+	}
+	catch (const MIDIEchoExcept& e)
+	{
+		std::fprintf(stderr, "%s\n", e.what());
+		return 1;
+	}
+
+	return 0;
+}
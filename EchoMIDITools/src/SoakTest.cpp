@@ -0,0 +1,532 @@
+// drives an Echoer per traffic profile through the loopback backend for as long as requested, and checks that nothing was lost or left hanging.
+// every profile plays into its own loopback port, and its Echoer echoes it to a sink of its own, and to a sink shared by every profile,
+// so shared outputs are merged the whole time. the profiles are:
+//   chords  dense 8 note chords every 10 ms, with the sustain pedal held over every other bar.
+//   clock   midi clock at 300 bpm, with a stop and start every 16 bars.
+//   cc      storms of 320 controller and pitch bend messages every 20 ms.
+//   sysex   a 4 KB bulk dump every 100 ms.
+//   focus   overlapping notes every 2 ms, while the focus send of its own sink flips every few milliseconds.
+//
+// at the end, every sink must have recieved every message, less the ones the library accounted for, e.g. queue drops,
+// and no note may still be sounding on any sink. the process exits with 1 otherwise, so the soak test can gate a release.
+// the memory growth is the resident set size at the end, minus the one after the first second.
+//
+// usage: EchoMIDISoak [seconds] [sync|async] [report interval s]
+
+#include "Echoer.h"
+#include "FocusHook.h"
+#include "NoteTracker.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+using namespace EchoMIDI;
+using Clock = std::chrono::steady_clock;
+
+// ============ Sinks ============
+
+// the sink shared by every profile, the sinks of the profiles start at OWN_SINK_BASE.
+static constexpr UINT SHARED_SINK = LoopbackBackend::PORT_COUNT - 1;
+static constexpr UINT OWN_SINK_BASE = 8;
+
+// stands in for the synth behind an output, counts what arrives, and keeps track of the notes left sounding.
+struct Sink
+{
+	UINT id = 0;
+	Backend::InputHandle handle = {};
+	InputCallbacks callbacks = { this, &Sink::onShort, &Sink::onLong };
+
+	std::atomic<uint64_t> count = 0;
+	std::atomic<uint64_t> sysex_bytes = 0;
+	NoteTracker notes;
+
+	static void onShort(void* user, uint32_t msg, DWORD timestamp)
+	{
+		Sink* sink = (Sink*)user;
+
+		sink->notes.track(msg);
+		sink->count.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	static void onLong(void* user, const uint8_t* data, size_t length, DWORD timestamp)
+	{
+		Sink* sink = (Sink*)user;
+
+		sink->count.fetch_add(1, std::memory_order_relaxed);
+		sink->sysex_bytes.fetch_add(length, std::memory_order_relaxed);
+	}
+};
+
+// ============ Profiles ============
+
+// plays a profile into its loopback port, and counts every message sent.
+struct Generator
+{
+	Backend::OutputHandle output = {};
+	Clock::time_point deadline;
+	std::mt19937 rng;
+
+	std::atomic<uint64_t> count = 0;
+	std::atomic<uint64_t> sysex_bytes = 0;
+
+	bool running() const
+	{
+		return Clock::now() < deadline;
+	}
+
+	void sendShort(uint32_t msg)
+	{
+		Backend::sendShort(output, msg);
+		count.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	void sendLong(const std::vector<uint8_t>& data)
+	{
+		Backend::sendLong(output, data.data(), data.size());
+		count.fetch_add(1, std::memory_order_relaxed);
+		sysex_bytes.fetch_add(data.size(), std::memory_order_relaxed);
+	}
+};
+
+uint32_t noteOn(uint32_t channel, uint32_t note, uint32_t velocity = 100) { return 0x90 | channel | note << 8 | velocity << 16; }
+uint32_t noteOff(uint32_t channel, uint32_t note) { return 0x80 | channel | note << 8; }
+uint32_t controlChange(uint32_t channel, uint32_t controller, uint32_t value) { return 0xB0 | channel | controller << 8 | value << 16; }
+
+void playChords(Generator& gen)
+{
+	static constexpr uint32_t CHANNEL = 0;
+	static constexpr uint32_t CHORD_SIZE = 8;
+
+	auto next = Clock::now();
+
+	for (uint32_t chord = 0; gen.running(); chord++)
+	{
+		uint32_t root = 24 + gen.rng() % 64;
+
+		// a bar is 16 chords, the pedal goes down at the start of every other bar, and up again halfway through it.
+		if (chord % 32 == 0)
+			gen.sendShort(controlChange(CHANNEL, 64, 127));
+		else if (chord % 32 == 8)
+			gen.sendShort(controlChange(CHANNEL, 64, 0));
+
+		for (uint32_t i = 0; i < CHORD_SIZE; i++)
+			gen.sendShort(noteOn(CHANNEL, root + i * 4, 64 + gen.rng() % 64));
+
+		std::this_thread::sleep_until(next += std::chrono::milliseconds(5));
+
+		for (uint32_t i = 0; i < CHORD_SIZE; i++)
+			gen.sendShort(noteOff(CHANNEL, root + i * 4));
+
+		std::this_thread::sleep_until(next += std::chrono::milliseconds(5));
+	}
+
+	gen.sendShort(controlChange(CHANNEL, 64, 0));
+}
+
+void playClock(Generator& gen)
+{
+	// 24 clocks per quarter note, at 300 quarter notes per minute.
+	static constexpr auto CLOCK_INTERVAL = std::chrono::nanoseconds(60'000'000'000ll / (300 * 24));
+	static constexpr uint32_t CLOCKS_PER_BAR = 4 * 24;
+
+	auto next = Clock::now();
+
+	gen.sendShort(0xFA);
+
+	for (uint32_t clock = 1; gen.running(); clock++)
+	{
+		gen.sendShort(0xF8);
+
+		if (clock % (16 * CLOCKS_PER_BAR) == 0)
+		{
+			gen.sendShort(0xFC);
+			gen.sendShort(0xFA);
+		}
+
+		std::this_thread::sleep_until(next += CLOCK_INTERVAL);
+	}
+
+	gen.sendShort(0xFC);
+}
+
+void playControllerStorms(Generator& gen)
+{
+	static constexpr uint32_t CHANNEL = 3;
+	static constexpr uint32_t CONTROLLERS_PER_STORM = 256;
+	static constexpr uint32_t BENDS_PER_STORM = 64;
+
+	auto next = Clock::now();
+
+	while (gen.running())
+	{
+		for (uint32_t i = 0; i < CONTROLLERS_PER_STORM; i++)
+		{
+			// the sustain pedal and the channel mode messages would change the notes of the channel.
+			uint32_t controller = 1 + gen.rng() % 118;
+
+			if (controller == 64)
+				controller = 1;
+
+			gen.sendShort(controlChange(CHANNEL, controller, gen.rng() % 128));
+		}
+
+		for (uint32_t i = 0; i < BENDS_PER_STORM; i++)
+		{
+			uint32_t bend = gen.rng() % 16384;
+
+			gen.sendShort(0xE0 | CHANNEL | (bend & 0x7F) << 8 | (bend >> 7) << 16);
+		}
+
+		std::this_thread::sleep_until(next += std::chrono::milliseconds(20));
+	}
+}
+
+void playSysExDumps(Generator& gen)
+{
+	static constexpr size_t DUMP_SIZE = 4096;
+
+	std::vector<uint8_t> dump(DUMP_SIZE);
+	auto next = Clock::now();
+
+	while (gen.running())
+	{
+		// 0x7D is the manufacturer id reserved for non-commercial use.
+		dump[0] = 0xF0;
+		dump[1] = 0x7D;
+
+		for (size_t i = 2; i < DUMP_SIZE - 1; i++)
+			dump[i] = gen.rng() % 128;
+
+		dump[DUMP_SIZE - 1] = 0xF7;
+
+		gen.sendLong(dump);
+
+		std::this_thread::sleep_until(next += std::chrono::milliseconds(100));
+	}
+}
+
+void playOverlappingNotes(Generator& gen)
+{
+	static constexpr uint32_t CHANNEL = 2;
+	// every note is held until this many newer notes have started.
+	static constexpr size_t HELD_NOTES = 4;
+
+	std::array<uint32_t, HELD_NOTES> held = {};
+	size_t held_count = 0;
+	auto next = Clock::now();
+
+	for (size_t i = 0; gen.running(); i++)
+	{
+		if (held_count == HELD_NOTES)
+			gen.sendShort(noteOff(CHANNEL, held[i % HELD_NOTES]));
+
+		held[i % HELD_NOTES] = 24 + gen.rng() % 80;
+		held_count = std::min(held_count + 1, HELD_NOTES);
+
+		gen.sendShort(noteOn(CHANNEL, held[i % HELD_NOTES]));
+
+		std::this_thread::sleep_until(next += std::chrono::milliseconds(2));
+	}
+
+	// the same note may be held twice, a single note off ends both.
+	for (size_t i = 0; i < held_count; i++)
+		gen.sendShort(noteOff(CHANNEL, held[i]));
+}
+
+// mutes and unmutes the own sink of the focus profile, by flipping its focus send between no executable, and one that is never focused.
+void flipFocus(Echoer& echoer, UINT target, Clock::time_point deadline, std::atomic<uint64_t>& flip_count)
+{
+	std::mt19937 rng(5);
+
+	for (bool muted = false; Clock::now() < deadline; muted = !muted)
+	{
+		echoer.focusSend(target, muted ? "EchoMIDISoak-never-focused" : "");
+		flip_count.fetch_add(1, std::memory_order_relaxed);
+
+		std::this_thread::sleep_for(std::chrono::microseconds(500 + rng() % 4500));
+	}
+
+	echoer.focusSend(target, "");
+}
+
+struct Profile
+{
+	const char* name;
+	void (*play)(Generator& gen);
+	// wether the own sink is focus muted whilst playing, its messages cannot be accounted for exactly then.
+	bool focus_flips = false;
+};
+
+static const Profile PROFILES[] = {
+	{ "chords", &playChords },
+	{ "clock", &playClock },
+	{ "cc", &playControllerStorms },
+	{ "sysex", &playSysExDumps },
+	{ "focus", &playOverlappingNotes, true },
+};
+
+static constexpr size_t PROFILE_COUNT = std::size(PROFILES);
+
+static_assert(OWN_SINK_BASE >= PROFILE_COUNT && OWN_SINK_BASE + PROFILE_COUNT <= SHARED_SINK, "every profile needs a port of its own, and a sink of its own");
+
+// ============ Memory ============
+
+// resident set size of the process in bytes, 0 where it cannot be read.
+size_t residentBytes()
+{
+#ifdef __linux__
+	size_t pages = 0;
+	size_t resident_pages = 0;
+
+	if (FILE* statm = std::fopen("/proc/self/statm", "r"))
+	{
+		if (std::fscanf(statm, "%zu %zu", &pages, &resident_pages) != 2)
+			resident_pages = 0;
+
+		std::fclose(statm);
+	}
+
+	return resident_pages * (size_t)sysconf(_SC_PAGESIZE);
+#else
+	return 0;
+#endif
+}
+
+// ============ Main ============
+
+// messages the library reports as not sent to the target, for a reason it knows about.
+uint64_t accountedCount(const TargetMetrics& target)
+{
+	return target.muted_count + target.focus_muted_count + target.filtered_count + target.error_count + target.queue_dropped_count + target.coalesced_count;
+}
+
+const TargetMetrics* findTarget(const EchoerMetrics& metrics, UINT id)
+{
+	auto it = std::ranges::find(metrics.targets, id, &TargetMetrics::id);
+
+	return it != metrics.targets.end() ? &*it : nullptr;
+}
+
+int main(int argc, char** argv)
+{
+	double seconds = argc > 1 ? std::strtod(argv[1], nullptr) : 60;
+	bool async = argc > 2 && std::strcmp(argv[2], "async") == 0;
+	double report_interval = argc > 3 ? std::strtod(argv[3], nullptr) : 10;
+
+	EchoMIDIInit();
+
+	std::array<Sink, LoopbackBackend::PORT_COUNT> sinks;
+	std::vector<UINT> sink_ids = { SHARED_SINK };
+
+	for (size_t i = 0; i < PROFILE_COUNT; i++)
+		sink_ids.push_back(OWN_SINK_BASE + (UINT)i);
+
+	for (UINT id : sink_ids)
+	{
+		sinks[id].id = id;
+		Backend::openInput(sinks[id].handle, id, sinks[id].callbacks);
+		Backend::startInput(sinks[id].handle);
+	}
+
+	std::array<std::unique_ptr<Echoer>, PROFILE_COUNT> echoers;
+	std::array<Generator, PROFILE_COUNT> generators;
+	size_t errors = 0;
+
+	try
+	{
+		for (size_t i = 0; i < PROFILE_COUNT; i++)
+		{
+			UINT own_sink = OWN_SINK_BASE + (UINT)i;
+
+			echoers[i] = std::make_unique<Echoer>();
+			echoers[i]->open((UINT)i);
+			echoers[i]->setAsync(async);
+			echoers[i]->add(own_sink);
+			echoers[i]->add(SHARED_SINK);
+			echoers[i]->start();
+
+			Backend::openOutput(generators[i].output, (UINT)i);
+			generators[i].rng.seed((uint32_t)i + 1);
+		}
+	}
+	catch (const MIDIEchoExcept& e)
+	{
+		std::fprintf(stderr, "could not set up the soak test: %s\n", e.what());
+		return 1;
+	}
+
+	std::printf("soaking %zu profiles for %.0f s, %s\n", PROFILE_COUNT, seconds, async ? "async" : "sync");
+
+	auto start = Clock::now();
+	auto deadline = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+
+	std::vector<std::thread> threads;
+	std::atomic<uint64_t> flip_count = 0;
+
+	for (size_t i = 0; i < PROFILE_COUNT; i++)
+	{
+		generators[i].deadline = deadline;
+		threads.emplace_back(PROFILES[i].play, std::ref(generators[i]));
+
+		if (PROFILES[i].focus_flips)
+			threads.emplace_back(&flipFocus, std::ref(*echoers[i]), OWN_SINK_BASE + (UINT)i, deadline, std::ref(flip_count));
+	}
+
+	// the baseline is taken once every thread, queue and route table has been set up, and warmed up.
+	std::this_thread::sleep_for(std::chrono::seconds(1));
+
+	size_t baseline_rss = residentBytes();
+	size_t peak_rss = baseline_rss;
+
+	auto report_time = start;
+
+	while (Clock::now() < deadline)
+	{
+		report_time += std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(report_interval));
+		std::this_thread::sleep_until(std::min(report_time, deadline));
+
+		for (auto& echoer : echoers)
+			errors += echoer->drainErrors().size();
+
+		uint64_t sent = 0;
+		uint64_t received = 0;
+
+		for (Generator& gen : generators)
+			sent += gen.count.load(std::memory_order_relaxed);
+
+		for (UINT id : sink_ids)
+			received += sinks[id].count.load(std::memory_order_relaxed);
+
+		size_t rss = residentBytes();
+		peak_rss = std::max(peak_rss, rss);
+
+		double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+		std::printf("%8.0f s %12llu sent %12llu received %8zu errors %8.1f MB resident\n",
+			elapsed, (unsigned long long)sent, (unsigned long long)received, errors, rss / (1024.0 * 1024.0));
+		std::fflush(stdout);
+	}
+
+	for (std::thread& thread : threads)
+		thread.join();
+
+	// the sender threads and the merge thread may still hold messages, they are done once no target has anything queued.
+	auto drain_deadline = Clock::now() + std::chrono::seconds(5);
+
+	while (Clock::now() < drain_deadline)
+	{
+		bool drained = true;
+
+		for (auto& echoer : echoers)
+		{
+			for (const TargetMetrics& target : echoer->getMetrics().targets)
+				drained &= target.queue_depth == 0;
+		}
+
+		if (drained)
+			break;
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+
+	// longer than any merge window.
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+	size_t end_rss = residentBytes();
+	peak_rss = std::max(peak_rss, end_rss);
+
+	// ============ Report ============
+
+	std::printf("\n%8s %12s %12s %12s %10s %10s %12s %12s %8s\n", "profile", "sent", "received", "missing", "dropped", "coalesced", "p99.9 us", "max us", "stuck");
+
+	bool failed = false;
+	uint64_t shared_expected = 0;
+	uint64_t dropped_total = 0;
+
+	for (size_t i = 0; i < PROFILE_COUNT; i++)
+	{
+		Echoer& echoer = *echoers[i];
+		Sink& sink = sinks[OWN_SINK_BASE + i];
+
+		errors += echoer.drainErrors().size();
+
+		EchoerMetrics metrics = echoer.getMetrics();
+		const TargetMetrics* own = findTarget(metrics, sink.id);
+		const TargetMetrics* shared = findTarget(metrics, SHARED_SINK);
+
+		uint64_t sent = generators[i].count.load(std::memory_order_relaxed);
+		uint64_t received = sink.count.load(std::memory_order_relaxed);
+
+		shared_expected += sent - accountedCount(*shared);
+
+		uint64_t dropped = own->queue_dropped_count + own->error_count + shared->queue_dropped_count + shared->error_count + metrics.dropped_error_count;
+		uint64_t coalesced = own->coalesced_count + shared->coalesced_count;
+		dropped_total += dropped;
+
+		LatencySummary own_latency = echoer.getDispatchLatency(sink.id);
+		LatencySummary shared_latency = echoer.getDispatchLatency(SHARED_SINK);
+
+		// the focus flips add the note offs of every release, so only the notes left sounding are checked.
+		std::string missing = "-";
+
+		if (!PROFILES[i].focus_flips)
+		{
+			int64_t missing_count = (int64_t)(sent - accountedCount(*own)) - (int64_t)received;
+
+			missing = std::to_string(missing_count);
+			failed |= missing_count != 0;
+		}
+
+		failed |= !sink.notes.empty() || dropped > 0;
+
+		std::printf("%8s %12llu %12llu %12s %10llu %10llu %12.1f %12.1f %8zu\n",
+			PROFILES[i].name, (unsigned long long)sent, (unsigned long long)received, missing.c_str(), (unsigned long long)dropped, (unsigned long long)coalesced,
+			std::max(own_latency.p999, shared_latency.p999) / 1000.0, std::max(own_latency.max, shared_latency.max) / 1000.0, sink.notes.getNoteCount());
+	}
+
+	Sink& shared_sink = sinks[SHARED_SINK];
+	uint64_t shared_received = shared_sink.count.load(std::memory_order_relaxed);
+	int64_t shared_missing = (int64_t)shared_expected - (int64_t)shared_received;
+
+	failed |= shared_missing != 0 || !shared_sink.notes.empty() || errors > 0;
+
+	std::printf("%8s %12llu %12llu %12lld %10s %10s %12s %12s %8zu\n",
+		"shared", (unsigned long long)shared_expected, (unsigned long long)shared_received, (long long)shared_missing, "", "", "", "", shared_sink.notes.getNoteCount());
+
+	std::printf("\n%llu focus flips, %llu dropped, %zu errors\n", (unsigned long long)flip_count.load(), (unsigned long long)dropped_total, errors);
+	std::printf("resident %.1f MB after warm up, %.1f MB at the end, %+.1f MB growth, %.1f MB peak\n",
+		baseline_rss / (1024.0 * 1024.0), end_rss / (1024.0 * 1024.0), ((double)end_rss - (double)baseline_rss) / (1024.0 * 1024.0), peak_rss / (1024.0 * 1024.0));
+	std::printf("%s\n", failed ? "FAILED" : "PASSED");
+
+	for (auto& echoer : echoers)
+		echoer->stop();
+
+	echoers = {};
+
+	for (UINT id : sink_ids)
+	{
+		Backend::stopInput(sinks[id].handle);
+		Backend::closeInput(sinks[id].handle);
+	}
+
+	for (Generator& gen : generators)
+		Backend::closeOutput(gen.output);
+
+	EchoMIDICleanup();
+
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "MidiBackend.h"
+
+namespace EchoMIDI
+{
+	/// @brief MidiBackend using the ALSA sequencer.
+	///
+	/// every sequencer port which can be read from and subscribed to is an input device,
+	/// and every port which can be written to and subscribed to is an output device, in the order the sequencer lists them.
+	/// ports created by EchoMIDI itself are never listed.
+	///
+	/// every open input and output gets its own sequencer client and port, subscribed to the device port.
+	/// inputs are read by a dedicated thread per input, which calls the InputCallbacks.
+	/// a single output handle must not be sent to from multiple threads at once, just like winmm handles.
+	/// outputs never block, a send finding no room in the sequencer returns MIDIERR_NOTREADY, and the message is dropped.
+	class AlsaBackend
+	{
+	public:
+		struct Input;
+		struct Output;
+
+		using InputHandle = Input*;
+		using OutputHandle = Output*;
+
+		static constexpr size_t MAX_NAME_LENGTH = 64;
+
+		static UINT getInputCount();
+		static UINT getOutputCount();
+
+		static MMRESULT getInputName(UINT id, std::string& name);
+		static MMRESULT getOutputName(UINT id, std::string& name);
+
+		static MMRESULT openInput(InputHandle& handle, UINT id, const InputCallbacks& callbacks);
+		static MMRESULT startInput(InputHandle handle);
+		static MMRESULT stopInput(InputHandle handle);
+		static MMRESULT resetInput(InputHandle handle);
+		static MMRESULT closeInput(InputHandle handle);
+
+		static MMRESULT openOutput(OutputHandle& handle, UINT id);
+		static MMRESULT closeOutput(OutputHandle handle);
+
+		static MMRESULT sendShort(OutputHandle handle, uint32_t msg);
+		static MMRESULT sendLong(OutputHandle handle, const uint8_t* data, size_t length);
+		/// @brief queues every message in the sequencer output buffer, and writes them to the sequencer at once.
+		static MMRESULT sendBatch(OutputHandle handle, const uint32_t* msgs, size_t count);
+	};
+}
@@ -0,0 +1,175 @@
+#pragma once
+
+#include "SPSCQueue.h"
+#include "RouteTable.h"
+#include "Coalescer.h"
+#include "Backend.h"
+
+#include <atomic>
+#include <array>
+#include <chrono>
+#include <thread>
+
+namespace EchoMIDI
+{
+	class Echoer;
+
+	/// @brief owns a dedicated thread which sends short midi messages to a single midi output device.
+	///
+	/// the midi callback only pushes messages into a lock-free queue, which the sender thread drains in batches.
+	/// this way a slow output device only delays itself, and never the input driver or any of the other targets.
+	///
+	/// if a batch window is passed, the sender thread collects messages for up to the batch window,
+	/// and submits them with a single Backend::sendBatch() call, instead of calling Backend::sendShort() once per message.
+	/// with winmm, a stream handle must be passed as well, and the batch is submitted as a single MIDIEVENT buffer with midiStreamOut().
+	///
+	/// if coalescing is enabled, every batch popped from the queue is passed through a Coalescer before it is sent.
+	/// a batch only holds more than a single message once the output has fallen behind,
+	/// so controller floods are thinned out exactly when the output cannot keep up, and never otherwise.
+	///
+	/// the sender thread follows the realtime config of the library, see setRealtimeConfig().
+	class AsyncSender
+	{
+	public:
+		/// @brief a packed short midi message, and the driver timestamp it was recieved at.
+		struct Message
+		{
+			DWORD msg;
+			DWORD timestamp;
+			/// @brief latencyNow() when the midi callback recieved the message, 0 if latency is not tracked.
+			int64_t received;
+		};
+
+		/// @brief maximum number of messages waiting to be sent, before new messages are dropped.
+		static constexpr size_t QUEUE_SIZE = 1024;
+		/// @brief maximum number of messages the sender thread pops from the queue at a time.
+		static constexpr size_t BATCH_SIZE = 64;
+
+#ifdef ECHOMIDI_BACKEND_WINMM
+		/// @brief number of stream buffers the driver can hold at once, in batched mode.
+		static constexpr size_t STREAM_BUFFER_COUNT = 4;
+#endif
+
+		/// @brief starts a sender thread for the passed output handle.
+		/// the handle must stay open until the AsyncSender has been destroyed.
+		/// 
+		/// @param echoer the Echoer failed sends are reported to, see Echoer::reportError().
+		/// @param slot the MuteMask slot of the target.
+		/// @param stats the counters of the target.
+#ifdef ECHOMIDI_BACKEND_WINMM
+		/// @param stream_handle if not NULL, device_handle must be the same stream handle, and messages are sent in batches.
+		/// @param batch_window how long messages are collected before a batch is submitted, only used with a stream handle.
+		/// 
+		/// @throw MIDIEchoExcept
+		AsyncSender(Echoer& echoer, HMIDIOUT device_handle, UINT device_id, uint32_t slot, TargetStats& stats, HMIDISTRM stream_handle = NULL, std::chrono::microseconds batch_window = std::chrono::microseconds(0));
+#else
+		/// @param batch_window how long messages are collected before a batch is submitted, 0 sends every message on its own.
+		AsyncSender(Echoer& echoer, Backend::OutputHandle device_handle, UINT device_id, uint32_t slot, TargetStats& stats, std::chrono::microseconds batch_window = std::chrono::microseconds(0));
+#endif
+		/// @brief sends any remaining messages, and joins the sender thread.
+		~AsyncSender();
+
+		AsyncSender(const AsyncSender&) = delete;
+		AsyncSender& operator=(const AsyncSender&) = delete;
+
+		/// @brief queues a message for the sender thread, never blocks.
+		/// should only be called from a single thread at a time (the midi callback thread).
+		/// @return false if the queue was full and the message was dropped.
+		bool push(DWORD msg, DWORD timestamp, int64_t received = 0);
+
+		/// @brief number of messages dropped because the queue was full.
+		size_t getDropCount() const { return m_drop_count.load(std::memory_order_relaxed); }
+		/// @brief approximate number of messages currently waiting to be sent.
+		size_t getQueueDepth() const { return m_queue.size(); }
+
+		/// @brief number of messages handed to the driver.
+		size_t getSentCount() const { return m_sent_count.load(std::memory_order_relaxed); }
+		/// @brief number of calls into the driver used for sending them.
+		size_t getSubmitCount() const { return m_submit_count.load(std::memory_order_relaxed); }
+		/// @brief number of driver calls saved by batching, compared to sending every message on its own.
+		size_t getSavedCallCount() const { return getSentCount() - getSubmitCount(); }
+
+#ifdef ECHOMIDI_BACKEND_WINMM
+		bool isBatched() const { return m_stream_handle != NULL; }
+#else
+		bool isBatched() const { return m_batch_window.count() > 0; }
+#endif
+
+		/// @brief enables or disables coalescing of continuous controller messages, see Coalescer.
+		/// takes effect from the next batch on, and may be called from any thread.
+		void setCoalescing(bool coalesce) { m_coalesce.store(coalesce, std::memory_order_relaxed); }
+		bool isCoalescing() const { return m_coalesce.load(std::memory_order_relaxed); }
+
+		/// @brief number of messages never sent, because a newer value of the same controller replaced them.
+		size_t getCoalescedCount() const { return m_coalesced_count.load(std::memory_order_relaxed); }
+
+		/// @brief sets the device id failed sends are reported with, after the devices were renumbered, see Echoer::remapIDs().
+		void setDeviceID(UINT device_id) { m_device_id.store(device_id, std::memory_order_relaxed); }
+
+		/// @brief has the sender thread send the note offs of the passed notes, see NoteTracker::release(), once every message queued so far has been sent.
+		/// may be called from any thread, the notes must stay alive until the sender is destroyed.
+		void releaseNotes(NoteTracker& notes);
+
+	private:
+		void run();
+		void runBatched();
+
+		// touches every page of the queue and stream buffers, if realtime mode asks for it, see RealtimeConfig::prefault.
+		// must be called before the sender thread is started.
+		void prefaultBuffers();
+
+		// pops the next batch from the queue, and coalesces it if enabled.
+		size_t popBatch(Message* batch);
+
+		// total size of the messages of a batch, for TargetStats::sent_bytes.
+		static uint64_t countBytes(const Message* batch, size_t count);
+
+		// records a failed send, and resets the consecutive error count on success.
+		void handleResult(MMRESULT res, DWORD timestamp);
+
+		// sends the note offs requested by releaseNotes(), must only be called once the queue is empty.
+		void sendReleases();
+
+#ifdef ECHOMIDI_BACKEND_WINMM
+		// a prepared stream buffer, holding up to BATCH_SIZE short events of 3 DWORDs each (delta time, stream id, event).
+		struct StreamBuffer
+		{
+			MIDIHDR hdr = {};
+			bool queued = false;
+			DWORD events[BATCH_SIZE * 3] = {};
+		};
+#endif
+
+		Echoer& m_echoer;
+		Backend::OutputHandle m_device_handle;
+		// only used for reporting errors, changes when the devices are renumbered.
+		std::atomic<UINT> m_device_id;
+		uint32_t m_slot;
+		TargetStats& m_stats;
+
+		std::chrono::microseconds m_batch_window;
+#ifdef ECHOMIDI_BACKEND_WINMM
+		HMIDISTRM m_stream_handle;
+		std::array<StreamBuffer, STREAM_BUFFER_COUNT> m_stream_buffers;
+#endif
+
+		SPSCQueue<Message, QUEUE_SIZE> m_queue;
+
+		std::atomic<bool> m_coalesce = false;
+		// only ever used by the sender thread.
+		Coalescer m_coalescer;
+
+		// incremented on every push, the sender thread waits on this when the queue is empty.
+		alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> m_signal = 0;
+		std::atomic<bool> m_running = true;
+		// set by releaseNotes(), taken by the sender thread.
+		std::atomic<NoteTracker*> m_release = nullptr;
+
+		std::atomic<size_t> m_drop_count = 0;
+		std::atomic<size_t> m_sent_count = 0;
+		std::atomic<size_t> m_submit_count = 0;
+		std::atomic<size_t> m_coalesced_count = 0;
+
+		std::thread m_thread;
+	};
+}
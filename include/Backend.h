@@ -0,0 +1,34 @@
+#pragma once
+
+// selects the MidiBackend used by the library at compile time.
+// the build system defines exactly one of ECHOMIDI_BACKEND_WINMM, ECHOMIDI_BACKEND_ALSA or ECHOMIDI_BACKEND_LOOPBACK,
+// if none is defined, winmm is used on windows, and the loopback backend everywhere else.
+
+#if !defined(ECHOMIDI_BACKEND_WINMM) && !defined(ECHOMIDI_BACKEND_ALSA) && !defined(ECHOMIDI_BACKEND_LOOPBACK)
+#ifdef _WIN32
+#define ECHOMIDI_BACKEND_WINMM
+#else
+#define ECHOMIDI_BACKEND_LOOPBACK
+#endif
+#endif
+
+#if defined(ECHOMIDI_BACKEND_WINMM)
+#include "WinMMBackend.h"
+#elif defined(ECHOMIDI_BACKEND_ALSA)
+#include "AlsaBackend.h"
+#else
+#include "LoopbackBackend.h"
+#endif
+
+namespace EchoMIDI
+{
+#if defined(ECHOMIDI_BACKEND_WINMM)
+	using Backend = WinMMBackend;
+#elif defined(ECHOMIDI_BACKEND_ALSA)
+	using Backend = AlsaBackend;
+#else
+	using Backend = LoopbackBackend;
+#endif
+
+	static_assert(MidiBackend<Backend>, "the selected backend does not satisfy the MidiBackend concept");
+}
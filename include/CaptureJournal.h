@@ -0,0 +1,252 @@
+#pragma once
+
+#include "Platform.h"
+#include "SPSCQueue.h"
+
+#include <atomic>
+#include <climits>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace EchoMIDI
+{
+	class Echoer;
+
+	/// @brief the first bytes of every journal file.
+	struct JournalHeader
+	{
+		/// @brief always JOURNAL_MAGIC.
+		char magic[8];
+		uint32_t version;
+		/// @brief offset of the first record in the file.
+		uint32_t header_size;
+		/// @brief number of bytes preallocated for records.
+		uint64_t capacity;
+		/// @brief system clock time the journal was created, in nanoseconds since the epoch.
+		int64_t created;
+		uint8_t reserved[32];
+	};
+
+	/// @brief a single captured event, SysEx records are directly followed by their bytes, and padded to a multiple of 8 bytes.
+	struct JournalRecord
+	{
+		/// @brief size of the entire record, including the SysEx bytes and padding.
+		/// it is written last, so a reader never sees a partially written record, 0 marks the end of the journal.
+		uint32_t size;
+		/// @brief id of the input device that recieved the event.
+		uint32_t source;
+		/// @brief time the event was recieved, in nanoseconds since the journal was created.
+		int64_t time;
+		/// @brief the driver timestamp of the event, relative to the start of its Echoer.
+		uint32_t timestamp;
+		/// @brief the short message, 0 for SysEx.
+		uint32_t msg;
+		/// @brief number of SysEx bytes following the record, 0 for short messages.
+		uint32_t length;
+		uint32_t reserved;
+	};
+
+	static constexpr char JOURNAL_MAGIC[8] = { 'E', 'M', 'J', 'O', 'U', 'R', 'N', 'L' };
+	static constexpr uint32_t JOURNAL_VERSION = 1;
+
+	static_assert(sizeof(JournalHeader) == 64 && sizeof(JournalRecord) == 32, "the journal layout is part of the file format");
+
+	/// @brief appends every event recieved by the Echoers capturing into it to a preallocated, memory mapped file, see Echoer::setCapture().
+	///
+	/// the file is created at its full size up front, and mapped into memory, so appending an event from the midi callback
+	/// is a single atomic add reserving space for the record, and a copy into the mapping, without any syscall or allocation.
+	/// the os writes the pages back in the background, and the file is truncated to the records written, once the journal is destroyed.
+	///
+	/// any number of Echoers may capture into the same journal, records are then ordered by the time they were reserved,
+	/// which may differ slightly from their time field. once the journal is full, every further event is dropped, see getDropCount().
+	class CaptureJournal
+	{
+	public:
+		/// @brief default number of bytes preallocated for records, room for about two million short messages.
+		static constexpr size_t DEFAULT_CAPACITY = 64 * 1024 * 1024;
+
+		/// @brief creates the file, replacing any existing file, and maps it into memory.
+		/// @throw MIDIEchoExcept if the file cannot be created, preallocated or mapped.
+		CaptureJournal(std::filesystem::path file, size_t capacity = DEFAULT_CAPACITY);
+		/// @brief unmaps the file, and truncates it to the records written.
+		/// no Echoer may capture into the journal anymore.
+		~CaptureJournal();
+
+		CaptureJournal(const CaptureJournal&) = delete;
+		CaptureJournal& operator=(const CaptureJournal&) = delete;
+
+		/// @brief appends a short message, time is the latencyNow() time it was recieved. never blocks or allocates.
+		/// @return false if the journal is full, the event is dropped in that case.
+		bool appendShort(UINT source, uint32_t msg, DWORD timestamp, int64_t time) noexcept;
+		/// @brief appends a SysEx message, or a part of it, see appendShort().
+		bool appendLong(UINT source, const uint8_t* data, size_t length, DWORD timestamp, int64_t time) noexcept;
+
+		const std::filesystem::path& getFile() const
+		{
+			return m_file;
+		}
+
+		size_t getCapacity() const
+		{
+			return m_capacity;
+		}
+
+		/// @return number of bytes reserved for records so far, may exceed the capacity once events are dropped.
+		size_t getUsedBytes() const
+		{
+			return m_write_offset.load(std::memory_order_relaxed);
+		}
+
+		/// @return number of events written to the journal.
+		size_t getEventCount() const
+		{
+			return m_event_count.load(std::memory_order_relaxed);
+		}
+
+		/// @return number of events dropped because the journal was full.
+		size_t getDropCount() const
+		{
+			return m_drop_count.load(std::memory_order_relaxed);
+		}
+
+	private:
+		// reserves space for a record of the passed size, nullptr if it does not fit.
+		JournalRecord* reserve(size_t record_size) noexcept;
+		// publishes a filled in record to readers.
+		void commit(JournalRecord* record, size_t record_size) noexcept;
+
+		std::filesystem::path m_file;
+		size_t m_capacity;
+		// latencyNow() when the journal was created, record times are relative to this.
+		int64_t m_start_time;
+
+		// the header, directly followed by the records.
+		uint8_t* m_view = nullptr;
+#ifdef _WIN32
+		void* m_file_handle = nullptr;
+		void* m_mapping = nullptr;
+#else
+		int m_fd = -1;
+#endif
+
+		// offset of the next record, relative to the first record.
+		alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> m_write_offset = 0;
+		alignas(CACHE_LINE_SIZE) std::atomic<size_t> m_event_count = 0;
+		std::atomic<size_t> m_drop_count = 0;
+	};
+
+	/// @brief a single event read from a journal, see JournalRecord.
+	struct JournalEvent
+	{
+		UINT source;
+		/// @brief time the event was recieved, in nanoseconds since the journal was created.
+		int64_t time;
+		DWORD timestamp;
+		/// @brief the short message, 0 for SysEx.
+		uint32_t msg;
+		/// @brief the SysEx bytes, owned by the JournalReader, nullptr for short messages.
+		const uint8_t* data;
+		size_t length;
+
+		bool isLong() const
+		{
+			return data != nullptr;
+		}
+	};
+
+	/// @brief reads every event of a journal file, e.g. for replaying it, see JournalReplay, or exporting it.
+	/// the file may still be written to, only the events committed at the time it is read are seen.
+	class JournalReader
+	{
+	public:
+		/// @brief reads the entire file into memory.
+		/// @throw MIDIEchoExcept if the file cannot be read, or is not a journal.
+		JournalReader(const std::filesystem::path& file);
+
+		JournalReader(const JournalReader&) = delete;
+		JournalReader& operator=(const JournalReader&) = delete;
+
+		const JournalHeader& getHeader() const
+		{
+			return m_header;
+		}
+
+		/// @return every event of the journal, in the order they were appended.
+		const std::vector<JournalEvent>& getEvents() const
+		{
+			return m_events;
+		}
+
+		/// @return the ids of every input with at least one event, in ascending order.
+		std::vector<UINT> getSources() const;
+
+	private:
+		JournalHeader m_header = {};
+		std::vector<uint8_t> m_data;
+		std::vector<JournalEvent> m_events;
+	};
+
+	/// @brief how a JournalReplay feeds the events of a journal to an Echoer.
+	struct ReplayConfig
+	{
+		/// @brief 1 replays the events at the pace they were recieved, 2 twice as fast, and 0 as fast as possible.
+		double speed = 1.0;
+		/// @brief only the events of this input are replayed, INVALID_MIDI_ID (UINT_MAX) replays the events of every input.
+		UINT source = UINT_MAX;
+	};
+
+	/// @brief feeds the events of a journal to an Echoer, as if its input device had just recieved them, see Echoer::injectShort().
+	/// the events are sent to the current targets of the Echoer, including its mute state, transforms, and capture journal.
+	/// the Echoer must not be echoing, a replay ends early if it is started in the meantime.
+	class JournalReplay
+	{
+	public:
+		/// @brief starts replaying on a thread owned by the replay, the first event is injected right away.
+		/// the reader and the echoer must outlive the replay.
+		/// @throw MIDIEchoExcept if the echoer is echoing.
+		JournalReplay(const JournalReader& reader, Echoer& echoer, const ReplayConfig& config = {});
+		/// @brief stops and joins the replay thread, events not yet injected are skipped.
+		~JournalReplay();
+
+		JournalReplay(const JournalReplay&) = delete;
+		JournalReplay& operator=(const JournalReplay&) = delete;
+
+		/// @brief blocks until every event was injected, or the replay was stopped.
+		void wait();
+		/// @brief skips every event not yet injected.
+		void stop();
+
+		/// @return wether every event was injected, or the replay was stopped.
+		bool isDone() const
+		{
+			return m_done.load(std::memory_order_acquire);
+		}
+
+		/// @return number of events injected so far.
+		size_t getReplayedCount() const
+		{
+			return m_replayed_count.load(std::memory_order_relaxed);
+		}
+
+	private:
+		void run();
+
+		const JournalReader& m_reader;
+		Echoer& m_echoer;
+		ReplayConfig m_config;
+
+		std::atomic<size_t> m_replayed_count = 0;
+		std::atomic<bool> m_done = false;
+
+		std::mutex m_stop_mutex;
+		std::condition_variable m_stop_cv;
+		bool m_stopping = false;
+
+		std::thread m_thread;
+	};
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+
+namespace EchoMIDI
+{
+	/// @brief latest-value-wins coalescing of continuous controller messages.
+	///
+	/// when an output falls behind, messages like pitch bend, mod wheel or aftertouch pile up in its queue,
+	/// even though only the newest value of each controller matters.
+	/// coalesce() keeps only the newest message per (status, channel, controller), at the position where the first one arrived,
+	/// so a pending batch shrinks to at most one message per controller, sent in arrival order.
+	///
+	/// only poly aftertouch, control change, channel pressure and pitch bend are coalesced.
+	/// every other message (note on / off, program change, system messages) is never coalesced, and acts as a barrier:
+	/// controllers are never merged across it, so their order relative to notes is preserved.
+	/// the same goes for controllers whose order matters on its own, like bank select, sustain and (N)RPN / data entry.
+	///
+	/// the slot table is tagged with a generation, so a barrier or a new batch resets it in constant time.
+	class Coalescer
+	{
+	public:
+		Coalescer()
+		{
+			m_index.fill(0);
+		}
+
+		/// @brief coalesces count messages in place.
+		/// @tparam TMessage any type with a packed short midi message in a msg member.
+		/// @return the number of messages left, which now occupy the front of messages.
+		/// count minus the returned value is the number of messages replaced by a newer value.
+		template<typename TMessage>
+		size_t coalesce(TMessage* messages, size_t count)
+		{
+			nextGeneration();
+
+			size_t out = 0;
+
+			for (size_t i = 0; i < count; i++)
+			{
+				uint32_t key = getKey(messages[i].msg);
+
+				if (key == NO_KEY)
+				{
+					messages[out++] = messages[i];
+					nextGeneration();
+					continue;
+				}
+
+				uint32_t& entry = m_index[key];
+
+				if (entry >> 16 == m_generation)
+				{
+					// newest value wins, but keeps the position of the first arrival.
+					messages[entry & 0xFFFF] = messages[i];
+				}
+				else
+				{
+					entry = (uint32_t)m_generation << 16 | (uint32_t)out;
+					messages[out++] = messages[i];
+				}
+			}
+
+			return out;
+		}
+
+		/// @brief checks wether the passed message may ever be coalesced.
+		static bool isCoalescable(uint32_t msg)
+		{
+			return getKey(msg) != NO_KEY;
+		}
+
+	private:
+		static constexpr uint32_t NO_KEY = UINT32_MAX;
+
+		// 16 channels * 128 notes of poly aftertouch, 16 * 128 controllers, 16 channel pressures and 16 pitch bends.
+		static constexpr size_t KEY_COUNT = 16 * 128 * 2 + 16 * 2;
+
+		// controllers that are never coalesced, one bit per controller number.
+		static constexpr uint64_t ORDERED_CONTROLLERS[2] = {
+			// bank select msb (0), data entry msb (6), bank select lsb (32), data entry lsb (38), sustain, portamento, sostenuto, soft, legato and hold 2 (64 - 69)
+			(1ull << 0) | (1ull << 6) | (1ull << 32) | (1ull << 38),
+			(0x3Full << (64 - 64)) |
+			// data increment / decrement and (N)RPN selection (96 - 101), channel mode messages (120 - 127)
+			(0x3Full << (96 - 64)) | (0xFFull << (120 - 64))
+		};
+
+		static uint32_t getKey(uint32_t msg)
+		{
+			uint32_t channel = msg & 0x0F;
+			uint32_t data_1 = msg >> 8 & 0x7F;
+
+			switch (msg & 0xF0)
+			{
+			case 0xA0:
+				return channel * 128 + data_1;
+			case 0xB0:
+				if (ORDERED_CONTROLLERS[data_1 >> 6] >> (data_1 & 63) & 1)
+					return NO_KEY;
+
+				return 16 * 128 + channel * 128 + data_1;
+			case 0xD0:
+				return 16 * 128 * 2 + channel;
+			case 0xE0:
+				return 16 * 128 * 2 + 16 + channel;
+			default:
+				return NO_KEY;
+			}
+		}
+
+		void nextGeneration()
+		{
+			// generation 0 is reserved for never used entries, so the index must be cleared whenever it wraps around.
+			if (++m_generation == 0)
+			{
+				m_index.fill(0);
+				m_generation = 1;
+			}
+		}
+
+		// upper 16 bits is the generation the entry was written in, lower 16 bits its position in the batch.
+		std::array<uint32_t, KEY_COUNT> m_index;
+		uint16_t m_generation = 0;
+	};
+}
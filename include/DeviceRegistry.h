@@ -0,0 +1,113 @@
+#pragma once
+
+#include "Backend.h"
+
+#include <atomic>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace EchoMIDI
+{
+	/// @brief the difference between two enumerations of the midi devices, see DeviceRegistry::rescan().
+	///
+	/// devices are matched by name, devices sharing a name are matched in id order.
+	struct DeviceChanges
+	{
+		std::vector<std::string> added_inputs;
+		std::vector<std::string> removed_inputs;
+		std::vector<std::string> added_outputs;
+		std::vector<std::string> removed_outputs;
+
+		/// @brief the new id of the device at every old id, INVALID_MIDI_ID (UINT_MAX) if it was removed.
+		/// pass these to Echoer::remapIDs(), as removing a device shifts the ids of every device after it.
+		std::vector<UINT> input_ids;
+		std::vector<UINT> output_ids;
+
+		/// @brief wether any device that is still present got a different id.
+		bool renumbered = false;
+
+		/// @brief true if no device appeared, vanished or got a different id.
+		bool empty() const
+		{
+			return added_inputs.empty() && removed_inputs.empty() && added_outputs.empty() && removed_outputs.empty() && !renumbered;
+		}
+	};
+
+	/// @brief cached list of every midi input and output device, indexed by id and by name.
+	///
+	/// the devices are enumerated through the Backend once, on first use, and kept until rescan() is called,
+	/// e.g. when the os reports a device change. every lookup in between is O(1), and never queries the driver.
+	/// lookups never enumerate the devices again by themselves, as the ids of the shared outputs must follow every renumbering, see rescan().
+	///
+	/// if multiple devices share a name, name lookups return the lowest id, just like a linear search would.
+	/// every function may be called from any thread.
+	class DeviceRegistry
+	{
+	public:
+		/// @brief what is known about a single device, stored at the index of its id.
+		struct DeviceCaps
+		{
+			std::string name;
+			/// @brief the error the driver reported when the device was enumerated, the name is empty if this is set.
+			MMRESULT err = MMSYSERR_NOERROR;
+		};
+
+		/// @brief every input or output device, indexed by id, and by name.
+		struct DeviceList
+		{
+			std::vector<DeviceCaps> caps;
+			std::unordered_map<std::string, UINT> ids;
+
+			MMRESULT getName(UINT id, std::string& name) const;
+			UINT getID(const std::string& name) const;
+		};
+
+		/// @brief adds the names of devices only present in one of the lists to added and removed, and maps every old id to its new id, see DeviceChanges.
+		/// only the caps of the lists are compared.
+		/// @return wether any remaining device got a different id.
+		static bool diff(const DeviceList& old_list, const DeviceList& new_list, std::vector<std::string>& added, std::vector<std::string>& removed, std::vector<UINT>& ids);
+
+		UINT getInputCount();
+		UINT getOutputCount();
+
+		/// @return the error code of the enumeration, or MMSYSERR_BADDEVICEID if the id is not a device.
+		MMRESULT getInputName(UINT id, std::string& name);
+		MMRESULT getOutputName(UINT id, std::string& name);
+
+		/// @return the id of the device with the passed name, INVALID_MIDI_ID (UINT_MAX) if there is none.
+		UINT getInputID(const std::string& name);
+		UINT getOutputID(const std::string& name);
+
+		/// @brief enumerates every device again, right away, and remaps the shared outputs of the OutputPool to the new ids.
+		/// the Echoers must then be remapped by the caller, see Echoer::remapIDs(), so this should run on the thread that owns them.
+		/// @return the changes since the previous enumeration, empty if this is the first.
+		DeviceChanges rescan();
+
+		/// @brief incremented every time the devices are enumerated.
+		uint64_t getGeneration() const
+		{
+			return m_generation.load(std::memory_order_acquire);
+		}
+
+	private:
+		template<typename TGetName>
+		static void enumerate(DeviceList& list, UINT count, TGetName get_name);
+
+		// m_mutex must be held exclusively by the caller.
+		DeviceChanges rescanLocked();
+
+		// enumerates the devices if this has never been done, and returns holding a shared lock on them.
+		std::shared_lock<std::shared_mutex> lockScanned();
+
+		std::shared_mutex m_mutex;
+		DeviceList m_inputs;
+		DeviceList m_outputs;
+
+		std::atomic<uint64_t> m_generation = 0;
+	};
+
+	/// @brief the registry used by getMidiInIDByName(), getMidiInputName() and the other device functions.
+	DeviceRegistry& getDeviceRegistry();
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+
+namespace EchoMIDI
+{
+	/// @brief listens for midi devices being plugged in or removed.
+	///
+	/// the os notifies the watcher thread of every device change, WM_DEVICECHANGE with winmm, and the announce port of the sequencer with ALSA.
+	/// nothing is polled, the thread sleeps until the os reports a change.
+	/// a single usb device often triggers several notifications, so the watcher waits until no further notification arrives for settle_time,
+	/// before calling the callback once.
+	///
+	/// the callback is called from the watcher thread, and does not rescan anything itself.
+	/// DeviceRegistry::rescan() renumbers the OutputPool right away, so it must run on the thread that owns the Echoers,
+	/// directly followed by remapping them, see Echoer::remapIDs(), the callback should only hand the notification over to that thread.
+	/// a notification does not mean any midi device changed, e.g. the ALSA ports EchoMIDI opens itself are announced as well, rescanning then finds no changes.
+	/// the loopback backend has a fixed set of ports, so no thread is started, and the callback is never called.
+	class DeviceWatcher
+	{
+	public:
+		using Callback = std::function<void()>;
+
+		/// @brief default time the device list must stay unchanged, before it is rescanned.
+		static constexpr std::chrono::milliseconds DEFAULT_SETTLE_TIME = std::chrono::milliseconds(20);
+
+		/// @brief starts the watcher thread, the callback is called for every change from here on.
+		/// changes that happened before the watcher was started are not reported, call DeviceRegistry::rescan() beforehand to handle these.
+		DeviceWatcher(Callback callback, std::chrono::milliseconds settle_time = DEFAULT_SETTLE_TIME);
+		/// @brief stops and joins the watcher thread, the callback is not called anymore once this returns.
+		~DeviceWatcher();
+
+		DeviceWatcher(const DeviceWatcher&) = delete;
+		DeviceWatcher& operator=(const DeviceWatcher&) = delete;
+
+		/// @return wether the os notifications could be subscribed to, if not, changes are never reported.
+		bool isWatching() const
+		{
+			return m_watching.load(std::memory_order_acquire);
+		}
+
+	private:
+		void run();
+
+		// calls the callback, unless the watcher is being destroyed.
+		void notify();
+
+		Callback m_callback;
+		std::chrono::milliseconds m_settle_time;
+
+		std::atomic<bool> m_watching = false;
+		// set by the watcher thread, once it is subscribed to the os notifications.
+		std::atomic<bool> m_ready = false;
+		std::atomic<bool> m_running = true;
+#ifdef ECHOMIDI_BACKEND_ALSA
+		// wakes up the watcher thread when the watcher is destroyed.
+		int m_wake_pipe[2] = { -1, -1 };
+#endif
+		std::thread m_thread;
+	};
+}
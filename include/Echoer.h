@@ -1,12 +1,31 @@
 #pragma once
 
-#include <Windows.h>
+#include "AsyncSender.h"
+#include "RouteTable.h"
+#include "MuteMask.h"
+#include "MPSCQueue.h"
+#include "LatencyHistogram.h"
+#include "FanOut.h"
+#include "Metrics.h"
+#include "OutputPool.h"
+#include "CaptureJournal.h"
+#include "Backend.h"
+
+#ifdef ECHOMIDI_BACKEND_WINMM
+#include "SysExPool.h"
+#endif
+
 #include <cassert>
+#include <climits>
 #include <map>
 #include <string>
 #include <stdexcept>
-#include <format>
 #include <filesystem>
+#include <memory>
+#include <bitset>
+#include <chrono>
+#include <vector>
+#include <mutex>
 
 namespace EchoMIDI
 {
@@ -36,17 +55,19 @@ namespace EchoMIDI
 
 	/// @brief retrieves the id of an input midi device by name.
 	/// the name passed must match excactly to the device name, before it is recognized as a match.
+	/// the lookup is a single hash lookup in the DeviceRegistry, see DeviceRegistry::rescan() for refreshing the devices.
 	/// 
-	/// @note if name.size() > MAXPNAMELEN (32), it will return INVALID_MIDI_ID no matter what,
-	/// as a midi device name cannot be longer than MAXPNAMELEN.
+	/// @note if name.size() > Backend::MAX_NAME_LENGTH, it will return INVALID_MIDI_ID no matter what,
+	/// as a midi device name cannot be longer than Backend::MAX_NAME_LENGTH.
 	/// 
 	/// @return the id of the found device. if none is found, INVALID_MIDI_ID is returned
 	UINT getMidiInIDByName(const std::string& name);
 	/// @brief retrieves the id of an output midi device by name.
 	/// the name passed must match excactly to the device name, before it is recognized as a match.
+	/// the lookup is a single hash lookup in the DeviceRegistry, see DeviceRegistry::rescan() for refreshing the devices.
 	/// 
-	/// @note if name.size() > MAXPNAMELEN (32), it will return INVALID_MIDI_ID no matter what,
-	/// as a midi device name cannot be longer than MAXPNAMELEN.
+	/// @note if name.size() > Backend::MAX_NAME_LENGTH, it will return INVALID_MIDI_ID no matter what,
+	/// as a midi device name cannot be longer than Backend::MAX_NAME_LENGTH.
 	/// 
 	/// @return the id of the found device. if none is found, INVALID_MIDI_ID is returned
 	UINT getMidiOutIDByName(const std::string& name);
@@ -58,6 +79,22 @@ namespace EchoMIDI
 	/// @throw MIDIEchoExcept
 	std::string getMidiName(MIDIIOType midi_io_type, UINT midi_id);
 
+	/// @brief compact description of an error that occured on a realtime thread.
+	/// realtime threads never throw, instead they record an ErrorRecord, which is later rethrown by Echoer::rethrowErrors().
+	struct ErrorRecord
+	{
+		/// @brief the underlying MMRESULT code.
+		MMRESULT err_code = MMSYSERR_NOERROR;
+		/// @brief the io type of the id that caused the error.
+		MIDIIOType type = MIDIIOType::UNKNOWN;
+		/// @brief the device id that caused the error.
+		UINT device_id = INVALID_MIDI_ID;
+		/// @brief the driver timestamp of the message that failed, in milliseconds since the Echoer was started.
+		DWORD timestamp = 0;
+		/// @brief wether the target was disabled as a result of this error.
+		bool disabled_target = false;
+	};
+
 	/// @brief echoes the output of a midi output device into 1 or more midi input devices.
 	///
 	/// the Echoer only echoes midi data once start() is called, and stops again if stop() is called.
@@ -65,18 +102,110 @@ namespace EchoMIDI
 	/// use add and remove in order to modify the target input devices.
 	/// if a device should temporarily be muted, meaning no data will be sent to it, use the setMute() function.
 	/// 
+	/// the midi devices are accessed through the Backend selected at compile time, see Backend.h.
+	/// 
+	/// by default, midi data is sent to every target from the midi callback thread, one target after another.
+	/// if setAsync() is enabled, each target instead gets its own sender thread, see AsyncSender.
+	/// 
+	/// errors happening whilst echoing are never thrown from the midi callback or sender threads.
+	/// they are recorded in a lock-free queue instead, and rethrown from the calling thread by rethrowErrors().
+	/// a target that fails too many sends in a row is disabled, see setMaxTargetErrors().
+	/// 
+	/// the latency every message spends inside EchoMIDI is recorded in lock-free histograms, see setLatencyTracking().
+	/// 
 	class Echoer
 	{
 	public:
-		/// @brief struct used for storing a midi output device and its current mute status + path.
+		/// @brief struct used for storing a midi output device and its focus send path.
+		/// the mute status of the device is stored in the Echoers MuteMask, at the devices slot.
 		struct MIDIOutDevice
 		{
-			bool user_muted = false;
-			bool focus_muted = false;
+			/// @brief index of the device in the MuteMask.
+			uint32_t slot = 0;
+			std::filesystem::path focus_send_path;
+			/// @brief the device shared with every other Echoer routed to it, device_handle is the handle of the port.
+			OutputPort* port = nullptr;
+			/// @brief the index of the Echoer in port, see OutputPool::acquire().
+			size_t feeder = 0;
+			Backend::OutputHandle device_handle = {};
+#ifdef ECHOMIDI_BACKEND_WINMM
+			/// @brief only set if the device was opened as a stream, for batched output, device_handle holds the same handle.
+			HMIDISTRM stream_handle = NULL;
+#endif
+			/// @brief only present if the Echoer is in async mode.
+			std::unique_ptr<AsyncSender> sender;
+			/// @brief counters updated by the realtime threads, kept behind a pointer so the address is stable.
+			std::unique_ptr<TargetStats> stats = std::make_unique<TargetStats>();
+			/// @brief the notes sounding on the target, updated by the midi callback.
+			std::unique_ptr<NoteTracker> notes = std::make_unique<NoteTracker>();
+			TransformRules transform_rules;
+			/// @brief compiled from transform_rules, null if the rules leave every message untouched.
+			std::unique_ptr<const TransformTable> transform;
+			/// @brief wether controller floods are coalesced when the target falls behind, see setCoalescing().
+			bool coalesce = false;
+		};
+
+		/// @brief the complete state of a single target, as applied by commitTargets().
+		struct TargetConfig
+		{
+			UINT id = INVALID_MIDI_ID;
+			bool mute = false;
 			std::filesystem::path focus_send_path;
-			HMIDIOUT device_handle = NULL;
+			TransformRules transform_rules;
+			bool coalesce = false;
 		};
 
+		/// @brief a set of target changes created by prepareTargets(), which the midi callback does not see until commitTargets() is called.
+		///
+		/// the output devices of new targets are opened with open(), which may be called from several threads at once, as long as every index is only opened once.
+		/// the mode of the Echoer, see setAsync() and setBatchWindow(), must not change until the batch is committed.
+		///
+		/// a batch destroyed without being committed closes every device it opened, and frees the slots it reserved,
+		/// which leaves the Echoer exactly as it was before prepareTargets() was called.
+		class TargetBatch
+		{
+		public:
+			TargetBatch() = default;
+			TargetBatch(TargetBatch&& other) noexcept;
+			~TargetBatch();
+
+			TargetBatch(const TargetBatch&) = delete;
+			TargetBatch& operator=(const TargetBatch&) = delete;
+
+			/// @return number of new targets, every one of them must be opened before the batch can be committed.
+			size_t getOpenCount() const
+			{
+				return m_new_targets.size();
+			}
+
+			/// @brief opens the output device of the new target at index, see getOpenCount().
+			///
+			/// @throw MIDIEchoExcept
+			/// @throw BadDeviceID
+			/// @throw DeviceAllocated
+			void open(size_t index);
+
+		private:
+			friend class Echoer;
+
+			struct NewTarget
+			{
+				UINT id = INVALID_MIDI_ID;
+				MIDIOutDevice device;
+				bool opened = false;
+			};
+
+			Echoer* m_echoer = nullptr;
+			std::vector<TargetConfig> m_configs;
+			std::vector<NewTarget> m_new_targets;
+			std::vector<UINT> m_removed_ids;
+		};
+
+		/// @brief default number of consecutive failed sends, after which a target is disabled.
+		static constexpr uint32_t DEFAULT_MAX_TARGET_ERRORS = 8;
+		/// @brief maximum number of errors waiting to be rethrown, any further errors are dropped.
+		static constexpr size_t ERROR_QUEUE_SIZE = 256;
+
 	public:
 
 		/// @brief Constructs an Echoer instance with an invalid input device id.
@@ -93,7 +222,11 @@ namespace EchoMIDI
 		~Echoer();
 
 		/// @brief adds a midi output target.
-		/// @return the wether the id was added (true) or not (false).
+		/// at most MuteMask::MAX_TARGETS targets can be added to a single Echoer.
+		/// a device that is already a target of another Echoer is shared with it, instead of being opened again, see OutputPool.
+		/// whilst it is shared, short messages to it are sent by the merge thread of the port, bypassing async mode, coalescing and batched output,
+		/// which adds the wake up latency of that thread, and up to the merge window whilst another input is still in the midi callback of an older message, see OutputPort.
+		/// @return the wether the id was added (true) or not (false), false if the id already is a target.
 		/// 
 		/// @throw MIDIEchoExcept
 		/// @throw BadDeviceID
@@ -101,37 +234,203 @@ namespace EchoMIDI
 		bool add(UINT id);
 		/// @brief removes an id from the targets list.
 		/// if the id is not present, nothing happens.
+		/// the target is sent a note off for every note still sounding on it before it is closed, so no note is left hanging, see NoteTracker.
 		/// 
 		/// if this is only temporary, setMute() should be used as a better alternative
 		/// 
 		/// @throw MIDIEchoExcept
 		void remove(UINT id);
 
+		/// @brief updates the input id and the id of every target, after the devices were renumbered, see DeviceRegistry::rescan().
+		///
+		/// the maps hold the new id at the index of every old id, ids outside of the maps are left unchanged.
+		/// targets mapped to INVALID_MIDI_ID have vanished, and are removed, the input must be closed before its id is invalidated.
+		/// every other target keeps its handle, mute state, transform and sender thread, so nothing is reopened.
+		/// 
+		/// @throw MIDIEchoExcept if closing a vanished target fails, the remaining targets are still closed.
+		void remapIDs(const std::vector<UINT>& input_ids, const std::vector<UINT>& output_ids);
+
+		/// @brief prepares applying every config at once, ids that are not yet a target are added, every other target is updated,
+		/// and the targets in removed_ids are removed.
+		/// only a slot is reserved for every new target, see TargetBatch for opening their devices, nothing changes until commitTargets() is called.
+		///
+		/// @throw MIDIEchoExcept if the new targets do not fit into the free slots, nothing is reserved in that case.
+		TargetBatch prepareTargets(std::vector<TargetConfig> configs, std::vector<UINT> removed_ids = {});
+
+		/// @brief adds every new target of the batch, applies every config, removes the removed targets, and publishes the resulting routes in a single swap.
+		/// targets not mentioned by the batch are left untouched.
+		/// removed targets are sent a note off for every held note, just like remove() does, and closed once the new routes are published.
+		///
+		/// @throw MIDIEchoExcept if a new target of the batch has not been opened, the Echoer is left unchanged in that case.
+		/// @throw MIDIEchoExcept if closing a removed target fails, the batch is still committed, and the remaining targets are still closed.
+		void commitTargets(TargetBatch& batch);
+
 		/// @brief sets the mute status of the target output device.
-		void setMute(UINT id, bool state)
-		{
-			assert(m_midi_targets.contains(id));
-			m_midi_targets[id].user_muted = state;
-		}
+		/// muting a target sends a note off for every note still sounding on it, see releaseMutedNotes().
+		void setMute(UINT id, bool state);
 
 		/// @return returns wether the device is muted or not. 
-		bool isMuted(UINT id)
-		{
-			assert(m_midi_targets.contains(id));
-			m_midi_targets[id].user_muted;
-		}
+		bool isMuted(UINT id);
+
+		/// @brief sets the rules used for transforming messages before they are sent to the target.
+		/// the rules are compiled into lookup tables, and take effect from the next message on.
+		void setTransform(UINT id, const TransformRules& rules);
+
+		/// @return the transform rules of the target.
+		TransformRules getTransform(UINT id);
+
+		/// @brief enables or disables latest-value-wins coalescing of continuous controller messages for the target.
+		/// 
+		/// once the target falls behind, only the newest pitch bend, channel pressure, aftertouch and control change value
+		/// of every channel and controller is sent, note and SysEx messages are never coalesced, see Coalescer.
+		/// coalescing only takes effect in async mode, as only a sender thread can fall behind.
+		void setCoalescing(UINT id, bool coalesce);
+
+		/// @return wether controller floods sent to the target are coalesced.
+		bool isCoalescing(UINT id);
+
+		/// @return number of messages not sent to the target, because a newer value of the same controller replaced them.
+		size_t getCoalescedCount(UINT id);
 
 		void focusSend(UINT id, std::filesystem::path exec);
 
 		std::filesystem::path getFocusSendExec(UINT id);
 
 		/// @brief retrieve the current midi output devices which are recieving data from the midi input device.
+		/// @note the map is only safe to use from the thread that modifies the targets.
 		/// @return a map from the device id and its midi output handler and mute status.
 		const std::map<UINT, MIDIOutDevice>& getTargets()
 		{
 			return m_midi_targets;
 		}
 
+		/// @brief sets the number of consecutive failed sends, after which a target is disabled.
+		/// a disabled target recieves no data until enable() is called, 0 means targets are never disabled.
+		void setMaxTargetErrors(uint32_t count)
+		{
+			m_max_target_errors.store(count, std::memory_order_relaxed);
+		}
+
+		/// @return wether the target has been disabled because of too many failed sends.
+		bool isDisabled(UINT id);
+
+		/// @brief re-enables a target that has been disabled because of too many failed sends.
+		void enable(UINT id);
+
+		/// @return total number of failed sends of the target.
+		size_t getErrorCount(UINT id);
+
+		/// @brief sends a note off for every note still sounding on a target that no longer recieves, because it is muted, focus muted or disabled,
+		/// and releases the sustain pedal where it is held down.
+		/// only the notes recorded by the NoteTracker of the target are ended, so this costs nothing for targets without sounding notes.
+		/// called by setMute(), commitTargets() and the focus hook, whenever a target may have stopped recieving.
+		/// the note offs take the same path as the messages did, e.g. through the sender thread in async mode, so they never overtake a queued note.
+		/// @warning waits for every midi callback in progress, so it must not be called whilst holding a guard returned by getRoutes().
+		void releaseMutedNotes();
+
+		/// @brief removes every pending error record from the error queue.
+		std::vector<ErrorRecord> drainErrors();
+
+		/// @brief rethrows the oldest pending error record as a MIDIEchoExcept, if any.
+		/// call repeatedly until it returns, in order to handle every pending error.
+		/// 
+		/// @throw MIDIEchoExcept
+		/// @throw BadDeviceID
+		/// @throw DeviceAllocated
+		void rethrowErrors();
+
+		/// @return number of error records dropped because the error queue was full.
+		size_t getDroppedErrorCount() const
+		{
+			return m_errors.getDropCount();
+		}
+
+		/// @brief records a failed send to the target in the passed slot, disabling the target if it has failed too many times in a row.
+		/// never blocks, allocates or throws, and is safe to call from any realtime thread.
+		/// @warning this function is called by the midi callback and sender threads, and should never be used outside of these.
+		void reportError(UINT id, uint32_t slot, TargetStats& stats, MMRESULT err, DWORD timestamp) noexcept;
+
+		/// @brief enables or disables latency tracking, which is enabled by default.
+		/// 
+		/// every message is timed at three points, the driver timestamp, entering the midi callback, and the send to each target returning.
+		/// driver timestamps only have a resolution of 1 ms, so the input latency and total latency are only accurate to about 1 ms,
+		/// the dispatch latency is measured with the high resolution clock on both ends.
+		void setLatencyTracking(bool track)
+		{
+			m_track_latency.store(track, std::memory_order_relaxed);
+		}
+
+		bool isTrackingLatency() const
+		{
+			return m_track_latency.load(std::memory_order_relaxed);
+		}
+
+		/// @return time from the driver timestamp, until the midi callback was entered.
+		LatencySummary getInputLatency() const
+		{
+			return m_input_latency.getSummary();
+		}
+
+		/// @return time from entering the midi callback, until the send to the target returned.
+		/// in async mode, this includes the time spent in the targets queue.
+		LatencySummary getDispatchLatency(UINT id);
+
+		/// @return time from the driver timestamp, until the send to the target returned.
+		LatencySummary getTotalLatency(UINT id);
+
+		/// @brief clears the latency histograms of the Echoer and all of its targets.
+		void resetLatency();
+
+		/// @brief records the input latency of a message with the passed driver timestamp.
+		/// @return the time the message was recieved, to be passed to recordSent(), 0 if latency is not tracked.
+		/// @warning this function is called by the midi callback, and should never be used outside of it.
+		int64_t recordReceived(DWORD timestamp) noexcept;
+
+		/// @return the latencyNow() time the input device recieved a message with the passed driver timestamp.
+		int64_t getInputTime(DWORD timestamp) const noexcept
+		{
+			return m_start_time.load(std::memory_order_relaxed) + (int64_t)timestamp * 1'000'000;
+		}
+
+		/// @return the latencyNow() time the running midi callback was entered, INT64_MAX if it is not running.
+		/// used by the merge thread of a shared output, which holds back older messages only, see OutputPort.
+		int64_t getReceiveTime() const noexcept
+		{
+			if (m_receiving.load() == 0)
+				return INT64_MAX;
+
+			return m_receive_time.load();
+		}
+
+		/// @brief records the dispatch and total latency of a message sent to a target, does nothing if received is 0.
+		/// @warning this function is called by the midi callback and sender threads, and should never be used outside of these.
+		void recordSent(TargetStats& stats, DWORD timestamp, int64_t received) noexcept;
+
+		/// @brief takes a snapshot of the counters of the input device and every target, see EchoerMetrics.
+		/// the counters are read with relaxed atomic loads, so the midi callback and sender threads are never blocked,
+		/// but the snapshot may be torn between counters, e.g. a message may already count as recieved, but not as sent.
+		/// the device names are left empty, see getMetrics() for the snapshot of every Echoer with names.
+		EchoerMetrics getMetrics();
+
+		/// @brief retrieve the mute state of all targets, as used by the midi callback.
+		const MuteMask& getMuteMask() const
+		{
+			return m_mute_mask;
+		}
+
+		/// @brief incremented every time the user or focus mute state of any target changes.
+		uint64_t getMuteGeneration() const
+		{
+			return m_mute_mask.getGeneration();
+		}
+
+		/// @brief retrieve the current route table, as used by the midi callback.
+		/// this never blocks or allocates, and the returned table stays valid for as long as the guard is alive.
+		Snapshot<RouteTable<Backend::OutputHandle>>::ReadGuard getRoutes() const
+		{
+			return m_routes.read();
+		}
+
 		/// @brief 
 		/// 
 		/// @throw MIDIEchoExcept
@@ -163,10 +462,78 @@ namespace EchoMIDI
 		/// @return returns wether the midi source device currently is getting its midi data echoed into the target devices. 
 		bool isEchoing()
 		{
-			return m_is_echoing;
+			return m_is_echoing.load();
 		}
 
+#ifdef ECHOMIDI_BACKEND_WINMM
+		/// @brief reallocates the SysEx arena with the passed number of blocks and block size.
+		/// SysEx messages larger than block_size are forwarded in multiple parts, so block_size should fit the largest expected patch dump.
+		/// 
+		/// @throw MIDIEchoExcept if the Echoer is open or has any targets.
+		void setSysExBuffers(size_t block_count, size_t block_size);
+
+		/// @brief retrieve the arena used for forwarding SysEx messages.
+		SysExPool& getSysExPool()
+		{
+			return *m_sysex_pool;
+		}
+#endif
+
+		/// @brief enables or disables async mode.
+		/// in async mode, the midi callback only queues short messages, and a dedicated thread per target sends them to the output device.
+		/// this prevents a single slow output device from delaying the input driver and all other targets.
+		/// 
+		/// @throw MIDIEchoExcept if the Echoer is currently echoing.
+		void setAsync(bool async);
+
+		/// @return returns wether the Echoer is in async mode.
+		bool isAsync()
+		{
+			return m_is_async;
+		}
+
+		/// @brief sets the batch window used for batched output, a window of 0 disables batched output.
+		/// 
+		/// batched output only takes effect in async mode.
+		/// the sender thread of every target then collects messages for up to window,
+		/// before submitting all of them to the driver at once, see MidiBackend::sendBatch().
+		/// with winmm, every target is opened as a midi stream, and a batch is submitted in a single midiStreamOut() call.
+		/// this trades up to window of extra latency, for far fewer calls into the driver during dense passages.
+		/// see AsyncSender::getSavedCallCount() for the number of calls saved.
+		/// 
+		/// @throw MIDIEchoExcept if the Echoer is currently echoing.
+		void setBatchWindow(std::chrono::microseconds window);
+
+		/// @return the current batch window, 0 if batched output is disabled.
+		std::chrono::microseconds getBatchWindow()
+		{
+			return m_batch_window;
+		}
+
+		/// @brief appends every message recieved by the input device to the passed journal, from the midi callback, see CaptureJournal.
+		/// the journal may be shared between Echoers, null stops capturing.
+		/// may be called whilst echoing, once this returns, the midi callback no longer appends anything to the previous journal.
+		void setCapture(std::shared_ptr<CaptureJournal> journal);
+
+		/// @return the journal the Echoer captures into, null if it is not capturing.
+		std::shared_ptr<CaptureJournal> getCapture();
+
+		/// @brief sends a short message to the targets, as if the input device had just recieved it, e.g. for replaying a journal, see JournalReplay.
+		/// the message takes the same path as one recieved by the midi callback, and is counted, tracked and captured as such.
+		/// it takes the place of the midi callback, which is the only producer of the AsyncSender queues, so the Echoer must not be echoing,
+		/// it may be open, and in async mode, and must only be injected into from a single thread at a time.
+		/// start() waits for an injection that is still running.
+		/// 
+		/// @throw MIDIEchoExcept if the Echoer is echoing.
+		void injectShort(uint32_t msg);
+		/// @brief sends a SysEx message, or a part of it, to the targets, see injectShort().
+		/// every target is sent to before this returns.
+		/// 
+		/// @throw MIDIEchoExcept if the Echoer is echoing.
+		void injectLong(const uint8_t* data, size_t length);
+
 		/// @brief begin iterator for all the midi output targets
+		/// @note see getTargets() for thread safety.
 		auto begin()
 		{
 			return m_midi_targets.begin();
@@ -186,12 +553,122 @@ namespace EchoMIDI
 		}
 
 	private:
-		HMIDIIN m_midi_source = NULL;
+		// recieve every message of the input device, and fan it out to the targets, see InputCallbacks.
+		static void receiveShort(void* user, uint32_t msg, DWORD timestamp);
+		static void receiveLong(void* user, const uint8_t* data, size_t length, DWORD timestamp);
+
+		// rebuilds the route table from m_midi_targets, and publishes it to the midi callback.
+		// also republishes the focus rules, as the slots of the targets may have changed.
+		// m_targets_mutex must be held by the caller.
+		void publishRoutes();
+
+		// passes the focus send executable of every target to the focus hook, see setFocusRules().
+		// m_targets_mutex must be held by the caller.
+		void publishFocusRules();
+
+		// opens the output device of the target, and sets up everything needed for sending to it, based on the current mode.
+		// target.slot must be set beforehand.
+		void openTarget(UINT id, MIDIOutDevice& target);
+		// reverts openTarget().
+		void closeTarget(UINT id, MIDIOutDevice& target);
+
+		// stops the sender thread of a target that is no longer routed to, and releases every note it may still hold.
+		// errors are ignored, as the target is closed right after.
+		void releaseNotes(MIDIOutDevice& target);
+		// sends the note offs of the route, through the merge thread, the sender thread or directly, whichever the messages of the route take.
+		void releaseNotes(const Route<Backend::OutputHandle>& route);
+
+		// closes every target, applies the mode change, and opens them again in the new mode.
+		// m_targets_mutex must be held by the caller.
+		template<typename TModeChange>
+		void reopenTargets(TModeChange change_mode)
+		{
+			// make sure the midi callback no longer references any of the targets.
+			m_routes.publish(std::make_unique<RouteTable<Backend::OutputHandle>>());
+
+			for (auto& [id, target] : m_midi_targets)
+				closeTarget(id, target);
+
+			change_mode();
+
+			// targets that fail to reopen are removed, the first error is rethrown once the rest have been reopened.
+			std::exception_ptr err;
+
+			for (auto it = m_midi_targets.begin(); it != m_midi_targets.end();)
+			{
+				try
+				{
+					openTarget(it->first, it->second);
+					it++;
+				}
+				catch (...)
+				{
+					if (!err)
+						err = std::current_exception();
+
+					m_used_slots[it->second.slot] = false;
+					it = m_midi_targets.erase(it);
+				}
+			}
+
+			publishRoutes();
+
+			if (err)
+				std::rethrow_exception(err);
+		}
+
+		// batched output is only used in async mode.
+		bool usesBatches()
+		{
+			return m_is_async && m_batch_window.count() > 0;
+		}
+
+		Backend::InputHandle m_midi_source = {};
 		UINT m_midi_id;
-		std::map<UINT, MIDIOutDevice> m_midi_targets;
+		// passed to the input device, must stay alive for as long as the device is open.
+		const InputCallbacks m_input_callbacks = { this, &Echoer::receiveShort, &Echoer::receiveLong };
 
-		bool m_is_echoing = false;
+		// m_midi_targets is the authoritative target state, modified from the user and focus hook thread.
+		// the midi callback only ever reads m_routes, which is rebuilt from it on every change.
+		std::mutex m_targets_mutex;
+		std::map<UINT, MIDIOutDevice> m_midi_targets;
+		std::bitset<MuteMask::MAX_TARGETS> m_used_slots;
+		Snapshot<RouteTable<Backend::OutputHandle>> m_routes;
+
+		// mute bits are flipped in place, without republishing the routes.
+		MuteMask m_mute_mask;
+
+#ifdef ECHOMIDI_BACKEND_WINMM
+		std::unique_ptr<SysExPool> m_sysex_pool = std::make_unique<SysExPool>();
+#endif
+
+		MPSCQueue<ErrorRecord, ERROR_QUEUE_SIZE> m_errors;
+		std::mutex m_errors_mutex;
+		std::atomic<uint32_t> m_max_target_errors = DEFAULT_MAX_TARGET_ERRORS;
+
+		// latencyNow() when the input device was started, driver timestamps are relative to this.
+		// injected messages are timestamped relative to it as well, so it is set on construction, for Echoers that are never started.
+		std::atomic<int64_t> m_start_time = latencyNow();
+		std::atomic<bool> m_track_latency = true;
+		LatencyHistogram m_input_latency;
+
+		InputStats m_input_stats;
+		// number of midi callbacks, and injections, currently sending short messages, and the time the last one started, see getReceiveTime().
+		alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> m_receiving = 0;
+		std::atomic<int64_t> m_receive_time = 0;
+
+		// the journal is kept alive here, the midi callback only loads the raw pointer, whilst holding a guard of m_routes.
+		// m_capture is only accessed whilst m_targets_mutex is held.
+		std::shared_ptr<CaptureJournal> m_capture;
+		std::atomic<CaptureJournal*> m_capture_journal = nullptr;
+
+		// atomic, as injectShort() and injectLong() check it against start() from another thread.
+		std::atomic<bool> m_is_echoing = false;
+		// number of injections currently running, see injectShort().
+		std::atomic<uint32_t> m_injecting = 0;
 		bool m_is_open = false;
+		bool m_is_async = false;
+		std::chrono::microseconds m_batch_window = std::chrono::microseconds(0);
 	};
 
 	// ============ EXCEPTIONS ============
@@ -205,7 +682,7 @@ namespace EchoMIDI
 		{}
 
 		MIDIEchoExcept(MMRESULT err_code, MIDIIOType type = MIDIIOType::UNKNOWN, UINT device_id = INVALID_MIDI_ID)
-			: MIDIEchoExcept(std::format("Error occured!\nMMSYRESULT: {}\nID: {}\nI/O TYPE: {}", err_code, device_id, (short)type),
+			: MIDIEchoExcept("Error occured!\nMMSYRESULT: " + std::to_string(err_code) + "\nID: " + std::to_string(device_id) + "\nI/O TYPE: " + std::to_string((short)type),
 				"UNKNOWN", err_code, type, device_id)
 		{}
 
@@ -233,11 +710,10 @@ namespace EchoMIDI
 		/// @param bad_id the invalid id passed.
 		/// @param max_id the maximum valid id, used for generating the error messag.
 		BadDeviceID(MIDIIOType type, UINT bad_id, UINT max_id)
-			: MIDIEchoExcept(std::format(
-				"Bad device ID passed to function: {}\n"
-				"Device ID must be in the range [0 - {}]",
-				bad_id, max_id - 1
-			), "BADID", MMSYSERR_BADDEVICEID, type, bad_id)
+			: MIDIEchoExcept(
+				"Bad device ID passed to function: " + std::to_string(bad_id) + "\n"
+				"Device ID must be in the range [0 - " + std::to_string(max_id - 1) + "]",
+				"BADID", MMSYSERR_BADDEVICEID, type, bad_id)
 		{}
 	};
 
@@ -252,12 +728,11 @@ namespace EchoMIDI
 	{
 	public:
 		DeviceAllocated(MIDIIOType type, UINT device_id)
-			: MIDIEchoExcept(std::format(
+			: MIDIEchoExcept(
 				"Device has already been allocated\n"
-				"ID:\t{}\n"
-				"Name:\t'{}'",
-				device_id,
-				getMidiName(type, device_id)), "OCCUPIED", MMSYSERR_ALLOCATED, type, device_id)
+				"ID:\t" + std::to_string(device_id) + "\n"
+				"Name:\t'" + getMidiName(type, device_id) + "'",
+				"OCCUPIED", MMSYSERR_ALLOCATED, type, device_id)
 		{}
 	};
 }
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "RouteTable.h"
+#include "MuteMask.h"
+
+#include <cstdint>
+#include <cstddef>
+
+namespace EchoMIDI
+{
+	/// @brief the platform independent core of the midi callback, which decides which routes a message is sent to.
+	///
+	/// the actual sending is left to a sink, so the exact same fan-out can be driven by the midi callback,
+	/// or by a fake in-memory sink in benchmarks, without any midi driver present.
+	///
+	/// a sink used with fanOutShort() must provide:
+	///		void sendShort(const Route<THandle>& route, uint32_t msg);
+	///
+	/// a sink used with fanOutLong() must provide:
+	///		void sendLong(const Route<THandle>& route);
+	///
+	/// neither function may block, allocate or throw, as they are called from the midi callback.
+	///
+	/// every message a route is skipped for is counted in the TargetStats of the route, as muted, focus muted or filtered.
+
+	/// @brief the send bits of every MuteMask word used by a route table, loaded once per message.
+	/// see MuteMask::getSendBits().
+	struct SendBits
+	{
+		uint32_t words[MuteMask::WORD_COUNT];
+		/// @brief the targets which are only focus muted, used for counting why a message was not sent.
+		uint32_t focus_words[MuteMask::WORD_COUNT];
+
+		/// @brief loads the send bits of the first word_count words of the mask.
+		void load(const MuteMask& mute_mask, size_t word_count)
+		{
+			for (size_t i = 0; i < word_count; i++)
+				words[i] = mute_mask.getSendBits(i, focus_words[i]);
+		}
+
+		/// @brief checks wether the target in the passed slot should recieve data.
+		bool isSending(uint32_t slot) const
+		{
+			return words[slot / MuteMask::TARGETS_PER_WORD] >> (slot % MuteMask::TARGETS_PER_WORD) & 1;
+		}
+
+		/// @brief checks wether the target in the passed slot is focus muted, but neither user muted nor disabled.
+		bool isFocusMuted(uint32_t slot) const
+		{
+			return focus_words[slot / MuteMask::TARGETS_PER_WORD] >> (slot % MuteMask::TARGETS_PER_WORD) & 1;
+		}
+	};
+
+	/// @brief counts a message that was not sent to the route, because it is muted.
+	template<typename THandle>
+	void countMuted(const Route<THandle>& route, const SendBits& send_bits)
+	{
+		if (send_bits.isFocusMuted(route.slot))
+			route.stats->focus_muted_count.fetch_add(1, std::memory_order_relaxed);
+		else
+			route.stats->muted_count.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	/// @brief sends a short message to every sending route, after applying its transform.
+	template<typename THandle, typename TSink>
+	void fanOutShort(const RouteTable<THandle>& routes, const SendBits& send_bits, uint32_t msg, TSink& sink)
+	{
+		for (const Route<THandle>& route : routes)
+		{
+			if (!send_bits.isSending(route.slot))
+			{
+				countMuted(route, send_bits);
+				continue;
+			}
+
+			uint32_t out_msg = msg;
+
+			if (route.transform && !route.transform->apply(out_msg))
+			{
+				route.stats->filtered_count.fetch_add(1, std::memory_order_relaxed);
+				continue;
+			}
+
+			sink.sendShort(route, out_msg);
+		}
+	}
+
+	/// @brief sends a SysEx message to every sending route which transform lets SysEx pass.
+	template<typename THandle, typename TSink>
+	void fanOutLong(const RouteTable<THandle>& routes, const SendBits& send_bits, TSink& sink)
+	{
+		for (const Route<THandle>& route : routes)
+		{
+			if (!send_bits.isSending(route.slot))
+			{
+				countMuted(route, send_bits);
+				continue;
+			}
+
+			if (route.transform && !route.transform->passes(0xF0))
+			{
+				route.stats->filtered_count.fetch_add(1, std::memory_order_relaxed);
+				continue;
+			}
+
+			sink.sendLong(route);
+		}
+	}
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <thread>
+
+namespace EchoMIDI
+{
+	/// @brief listens for changes to the contents of a single file, e.g. a preset that is edited whilst the application is running.
+	///
+	/// the directory of the file is watched through the os, ReadDirectoryChangesW on windows, and inotify on linux, nothing is polled.
+	/// editors usually save in several steps, e.g. truncate, write and rename, so the watcher waits until no further change arrives for settle_time,
+	/// before reading the file once.
+	///
+	/// the callback is called from the watcher thread, and only if the contents differ from the last contents seen by the watcher,
+	/// so touching the file, or saving it unchanged, is not reported.
+	/// on any other platform, no thread is started, and the callback is never called.
+	class FileWatcher
+	{
+	public:
+		using Callback = std::function<void()>;
+
+		/// @brief default time the file must stay unchanged, before it is read.
+		static constexpr std::chrono::milliseconds DEFAULT_SETTLE_TIME = std::chrono::milliseconds(100);
+
+		/// @brief starts the watcher thread, the current contents of the file are only used for detecting later changes.
+		/// the file does not need to exist yet, its directory does.
+		FileWatcher(std::filesystem::path file, Callback callback, std::chrono::milliseconds settle_time = DEFAULT_SETTLE_TIME);
+		/// @brief stops and joins the watcher thread, the callback is not called anymore once this returns.
+		~FileWatcher();
+
+		FileWatcher(const FileWatcher&) = delete;
+		FileWatcher& operator=(const FileWatcher&) = delete;
+
+		/// @return wether the directory of the file could be watched, if not, changes are never reported.
+		bool isWatching() const
+		{
+			return m_watching.load(std::memory_order_acquire);
+		}
+
+		const std::filesystem::path& getFile() const
+		{
+			return m_file;
+		}
+
+	private:
+		void run();
+
+		// reads the file, and calls the callback if its contents changed.
+		void notify();
+
+		// hash of the contents of the file, empty if it cannot be read.
+		std::optional<size_t> readFingerprint();
+
+		std::filesystem::path m_file;
+		Callback m_callback;
+		std::chrono::milliseconds m_settle_time;
+
+		// only ever accessed from the watcher thread, once it is started.
+		std::optional<size_t> m_fingerprint;
+
+		std::atomic<bool> m_watching = false;
+		// set by the watcher thread, once it is watching the directory.
+		std::atomic<bool> m_ready = false;
+		std::atomic<bool> m_running = true;
+#if defined(_WIN32)
+		// signaled when the watcher is destroyed.
+		void* m_stop_event = nullptr;
+#elif defined(__linux__)
+		// wakes up the watcher thread when the watcher is destroyed.
+		int m_wake_pipe[2] = { -1, -1 };
+#endif
+		std::thread m_thread;
+	};
+}
@@ -1,39 +1,88 @@
 #pragma once
 
 #include "Echoer.h"
+#include "FocusIndex.h"
+#include "Logger.h"
 
+#include <chrono>
 #include <filesystem>
+
+#ifdef _WIN32
 #include <Windows.h>
+#endif
 
 namespace EchoMIDI
 {
 
-	/// @brief sets the output of winErr, the underlying windows error message handler function.
-	/// the output of winErr will be written to lout as well as cout.
-	/// if clear is set to true, the file passed will be cleared before writing.
-	void setLogFile(std::filesystem::path lout, bool clear);
-
-	/// @brief close and save the log file
-	void closeLogFile();
-
+#ifdef _WIN32
 	/// @brief returns the executable path of the passed window
 	std::filesystem::path getHWNDPath(HWND window);
+#endif
+
+	/// @brief get the path of the executable that owns the currently focused window.
+	/// once the focus hook has seen a foreground change, this is the executable it last applied, without querying the os.
+	/// returns an empty path, if it cannot be retrieved on the current platform.
+	std::filesystem::path getFocusedPath();
+
+	/// @brief default time the foreground window must stay unchanged, before the focus mute state is updated.
+	static constexpr std::chrono::milliseconds FOCUS_DEBOUNCE_TIME = std::chrono::milliseconds(10);
+
+	/// @brief sets how long the foreground window must stay unchanged, before the focus mute state of every Echoer is updated.
+	/// a burst of foreground changes, e.g. alt tabbing past several windows, is then resolved only once, for the window it ends on.
+	/// takes effect from the next foreground change on.
+	void setFocusDebounce(std::chrono::milliseconds debounce);
+	std::chrono::milliseconds getFocusDebounce();
+
+	/// @brief counters of the focus hook, see getFocusStats().
+	struct FocusStats
+	{
+		/// @brief number of foreground change events recieved from the os.
+		size_t event_count = 0;
+		/// @brief number of times the focused executable changed, and the focus mute state of every Echoer was updated.
+		size_t switch_count = 0;
+		/// @brief number of executable paths resolved from the process cache, and through the os.
+		size_t cache_hit_count = 0;
+		size_t cache_miss_count = 0;
+		/// @brief time from the first foreground change of a burst, until every Echoer has updated its focus mute state.
+		/// includes the debounce time.
+		LatencySummary switch_latency;
+	};
+
+	FocusStats getFocusStats();
+	void resetFocusStats();
 
 	/// @brief initializes a windows hook that listens for focus changes.
+	/// on linux, an X11 focus provider is started instead, which listens for changes of _NET_ACTIVE_WINDOW,
+	/// if the library was built with ECHOMIDI_FOCUS_X11, and a display can be opened.
 	/// if this is not called, the Echoer::focusMute() function will not work properly. 
+	/// does nothing on platforms without a focus hook.
+	/// also starts the logger thread, see startLogger().
 	void EchoMIDIInit();
 	/// @brief cleansup the previously installed windows hook.
 	/// as soon as this is called, the Echoer focus mute functionallity will not work.
+	/// every pending log record is written, and the logger thread is stopped.
 	void EchoMIDICleanup();
 
-	/// @brief get the path of the executable that owns the passed window.
-	std::filesystem::path getHWNDPath(HWND window);
+	/// @brief checks wether the focus send executable matches the executable of the focused window.
+	/// if focus_send_path has a parent path, the two paths must match excactly,
+	/// otherwise only the executable name is compared, with or without its extension.
+	/// paths are compared by their FocusIndex::getKey(), the same way the focus hook matches them.
+	bool focusSendMatches(const std::filesystem::path& focus_send_path, const std::filesystem::path& window_path);
 
-	/// @brief registers an Echoer instance to be monitored for focus changes.
+	/// @brief registers an Echoer instance to be monitored for focus changes, the focus mute bits of its targets are stored in mask.
+	/// may be called from any thread.
 	/// @warning this function is automaticly called in the constructor of Echoer, and should never be used outside of this.
-	void registerEchoer(Echoer* echoer);
+	void registerEchoer(Echoer* echoer, MuteMask& mask);
 
 	/// @brief unregisters an Echoer instance to be monitored for focus changes.
+	/// once this returns, the focus hook no longer references the Echoer or its mask.
 	/// @warning this function is automaticly called in the destructor of Echoer, and should never be used outside of this.
 	void unregisterEchoer(Echoer* echoer);
+
+	/// @brief replaces the focus send rules of the Echoer, and publishes a new FocusIndex to the focus hook, if they changed.
+	/// @warning this function is automaticly called by the Echoer whenever its targets change, and should never be used outside of this.
+	void setFocusRules(Echoer* echoer, std::vector<FocusRule> rules);
+
+	/// @return the number of focus send rules in the index currently used by the focus hook.
+	size_t getFocusRuleCount();
 }
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "MuteMask.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace EchoMIDI
+{
+	/// @brief the focus send executable of a single target, see Echoer::focusSend().
+	struct FocusRule
+	{
+		/// @brief the MuteMask slot of the target.
+		uint32_t slot;
+		std::filesystem::path exec;
+
+		bool operator==(const FocusRule&) const = default;
+	};
+
+	/// @brief the focus send rules of every Echoer, compiled into a single lookup table, published to the focus hook through a Snapshot.
+	///
+	/// every rule is stored under the normalized key of its executable, its full path if it has a parent path, otherwise its file name.
+	/// a focus change then costs at most three hash lookups, the full path, file name and file name without extension of the focused executable,
+	/// and a single atomic write per MuteMask word holding any rule, no matter how many Echoers and targets there are.
+	/// the table is never modified after it has been published.
+	class FocusIndex
+	{
+	public:
+		/// @brief adds the rules of a single Echoer, the focus mute bits of its targets are stored in mask.
+		/// the mask must stay alive for as long as the index is in use.
+		void add(MuteMask& mask, const std::vector<FocusRule>& rules);
+
+		/// @brief focus mutes every target with a rule, except the targets whose executable matches window_path.
+		void apply(const std::filesystem::path& window_path) const;
+
+		/// @brief number of rules added to the index.
+		size_t getRuleCount() const { return m_rule_count; }
+
+		/// @brief retrieves the key a path is stored and looked up under.
+		/// paths are compared lexically, and without regard to case on windows.
+		static std::string getKey(const std::filesystem::path& path);
+
+	private:
+		// a MuteMask word holding at least one target with a rule.
+		struct MaskWord
+		{
+			MuteMask* mask;
+			uint32_t word;
+			// the slots of the word with a rule.
+			uint32_t slots;
+		};
+
+		// the targets to unmute, when the key of a rule matches.
+		struct Match
+		{
+			// index into m_words.
+			uint32_t mask_word;
+			uint32_t slots;
+		};
+
+		std::vector<MaskWord> m_words;
+		std::unordered_map<std::string, std::vector<Match>> m_matches;
+		size_t m_rule_count = 0;
+	};
+}
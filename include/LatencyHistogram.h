@@ -0,0 +1,144 @@
+#pragma once
+
+#include "SPSCQueue.h"
+
+#include <algorithm>
+#include <atomic>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+namespace EchoMIDI
+{
+	/// @brief current time of the clock all latencies are measured with, in nanoseconds.
+	inline int64_t latencyNow()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	/// @brief percentiles of a LatencyHistogram, all values are in nanoseconds.
+	struct LatencySummary
+	{
+		uint64_t count = 0;
+		uint64_t p50 = 0;
+		uint64_t p99 = 0;
+		uint64_t p999 = 0;
+		uint64_t max = 0;
+	};
+
+	/// @brief lock-free log-linear histogram of latencies, in nanoseconds.
+	///
+	/// like a HDR histogram, every power of two is split into SUB_BUCKET_COUNT linear buckets,
+	/// so every recorded value is kept with a relative error of at most 1 / SUB_BUCKET_COUNT (~3%),
+	/// from single nanoseconds up to MAX_VALUE, using a fixed number of buckets.
+	///
+	/// record() is a handful of relaxed atomic operations, and may be called from any number of threads at once.
+	/// queries read the buckets one by one, so they may miss values recorded whilst they run, but never block the recording threads.
+	class LatencyHistogram
+	{
+	public:
+		static constexpr size_t SUB_BUCKET_BITS = 5;
+		static constexpr size_t SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;
+		/// @brief values above this (~9 minutes) are recorded as MAX_VALUE.
+		static constexpr uint64_t MAX_VALUE = (1ull << 39) - 1;
+		static constexpr size_t BUCKET_COUNT = (std::bit_width(MAX_VALUE) - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT;
+
+		LatencyHistogram() = default;
+
+		LatencyHistogram(const LatencyHistogram&) = delete;
+		LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+		/// @brief records a single latency, negative values are recorded as 0.
+		void record(int64_t ns)
+		{
+			uint64_t value = ns > 0 ? (uint64_t)ns : 0;
+
+			if (value > MAX_VALUE)
+				value = MAX_VALUE;
+
+			m_buckets[getBucket(value)].fetch_add(1, std::memory_order_relaxed);
+			m_count.fetch_add(1, std::memory_order_relaxed);
+
+			uint64_t max = m_max.load(std::memory_order_relaxed);
+
+			while (value > max && !m_max.compare_exchange_weak(max, value, std::memory_order_relaxed));
+		}
+
+		/// @brief retrieves the value below which the passed percentage (0 - 100) of all recorded values lie.
+		/// the value is rounded up to the upper bound of its bucket, but never exceeds getMax().
+		uint64_t getPercentile(double percentile) const
+		{
+			uint64_t count = getCount();
+
+			if (count == 0)
+				return 0;
+
+			uint64_t rank = (uint64_t)(percentile / 100 * count + 0.5);
+
+			if (rank == 0)
+				rank = 1;
+
+			uint64_t seen = 0;
+
+			for (size_t bucket = 0; bucket < BUCKET_COUNT; bucket++)
+			{
+				seen += m_buckets[bucket].load(std::memory_order_relaxed);
+
+				if (seen >= rank)
+					return std::min(getUpperBound(bucket), getMax());
+			}
+
+			return getMax();
+		}
+
+		uint64_t getCount() const { return m_count.load(std::memory_order_relaxed); }
+		uint64_t getMax() const { return m_max.load(std::memory_order_relaxed); }
+
+		/// @brief retrieves the count, p50, p99, p99.9 and max of the histogram.
+		LatencySummary getSummary() const
+		{
+			return { getCount(), getPercentile(50), getPercentile(99), getPercentile(99.9), getMax() };
+		}
+
+		/// @brief clears every recorded value.
+		/// values recorded whilst the histogram is reset may be partially kept.
+		void reset()
+		{
+			for (std::atomic<uint64_t>& bucket : m_buckets)
+				bucket.store(0, std::memory_order_relaxed);
+
+			m_count.store(0, std::memory_order_relaxed);
+			m_max.store(0, std::memory_order_relaxed);
+		}
+
+	private:
+		// values below SUB_BUCKET_COUNT get a bucket each,
+		// larger values are bucketed by their highest SUB_BUCKET_BITS + 1 bits.
+		static size_t getBucket(uint64_t value)
+		{
+			if (value < SUB_BUCKET_COUNT)
+				return (size_t)value;
+
+			size_t shift = std::bit_width(value) - 1 - SUB_BUCKET_BITS;
+
+			return (shift + 1) * SUB_BUCKET_COUNT + (size_t)(value >> shift) - SUB_BUCKET_COUNT;
+		}
+
+		static uint64_t getUpperBound(size_t bucket)
+		{
+			if (bucket < SUB_BUCKET_COUNT)
+				return bucket;
+
+			size_t shift = bucket / SUB_BUCKET_COUNT - 1;
+			uint64_t top = bucket % SUB_BUCKET_COUNT + SUB_BUCKET_COUNT;
+
+			return ((top + 1) << shift) - 1;
+		}
+
+		alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> m_count = 0;
+		std::atomic<uint64_t> m_max = 0;
+		std::array<std::atomic<uint64_t>, BUCKET_COUNT> m_buckets = {};
+	};
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <initializer_list>
+#include <string_view>
+#include <type_traits>
+
+/// @brief log records below this level are compiled out entirely, see LogLevel for the numeric values.
+/// e.g. define ECHOMIDI_LOG_LEVEL=2 to only keep warnings and errors.
+#ifndef ECHOMIDI_LOG_LEVEL
+#define ECHOMIDI_LOG_LEVEL 0
+#endif
+
+// the relative file name is only defined for the library sources, see CMakeLists.txt.
+#ifdef __RELATIVE_FILE__
+#define ECHOMIDI_LOG_FILE __RELATIVE_FILE__
+#else
+#define ECHOMIDI_LOG_FILE __FILE__
+#endif
+
+/// @brief logs message, optionally followed by a short text and up to LogRecord::MAX_VALUES integers.
+/// message must be a string literal, as only the pointer is stored.
+/// e.g. ECHOMIDI_LOG(LogLevel::WARN, "could not open device", name, { id }).
+#define ECHOMIDI_LOG(level, message, ...) \
+	do \
+	{ \
+		if constexpr ((int)(level) >= ECHOMIDI_LOG_LEVEL) \
+			::EchoMIDI::logMessage(level, ECHOMIDI_LOG_FILE, __LINE__, message __VA_OPT__(,) __VA_ARGS__); \
+	} while (0)
+
+/// @brief logs message, followed by the description of the os error code err.
+#define ECHOMIDI_LOG_OS_ERROR(level, message, err) \
+	do \
+	{ \
+		if constexpr ((int)(level) >= ECHOMIDI_LOG_LEVEL) \
+			::EchoMIDI::logOSError(level, ECHOMIDI_LOG_FILE, __LINE__, message, err); \
+	} while (0)
+
+namespace EchoMIDI
+{
+	/// @brief severity of a log record, records below the compile time and runtime level are discarded.
+	enum class LogLevel : uint8_t
+	{
+		TRACE = 0,
+		INFO = 1,
+		WARN = 2,
+		ERR = 3,
+		/// @brief only used as a level filter, disables logging.
+		OFF = 4
+	};
+
+	/// @brief a single log record, as it is stored in the log ring.
+	///
+	/// records have a fixed size, and are never formatted by the thread that logs them.
+	/// the logging thread only copies the pointers, values and a truncated copy of the text into the ring,
+	/// the logger thread then formats and writes it, see startLogger().
+	struct LogRecord
+	{
+		static constexpr size_t MAX_VALUES = 4;
+		static constexpr size_t MAX_TEXT = 47;
+
+		/// @brief wall clock time the record was logged at, in nanoseconds since the epoch.
+		int64_t timestamp = 0;
+		/// @brief static strings, these are never copied.
+		const char* file = nullptr;
+		const char* message = nullptr;
+		uint32_t line = 0;
+		LogLevel level = LogLevel::INFO;
+		uint8_t value_count = 0;
+		/// @brief wether values[0] is an os error code, which is described by the logger thread.
+		bool os_error = false;
+		int64_t values[MAX_VALUES] = {};
+		char text[MAX_TEXT + 1] = {};
+	};
+
+	static_assert(std::is_trivially_copyable_v<LogRecord>, "LogRecord is copied through a lock-free ring");
+
+	/// @brief number of records the log ring can hold, before further records are dropped.
+	static constexpr size_t LOG_RING_SIZE = 1024;
+
+	/// @brief queues a log record, never blocks, allocates or formats anything, so it is safe to call from midi callbacks and hook threads.
+	/// records below the runtime level are discarded, and if the ring is full the record is dropped and counted, see getLogDropCount().
+	/// prefer the ECHOMIDI_LOG macro, which also applies the compile time level.
+	void logMessage(LogLevel level, const char* file, uint32_t line, const char* message, std::string_view text = {}, std::initializer_list<int64_t> values = {});
+
+	/// @brief queues a log record for the os error err, see logMessage().
+	/// on windows err is a GetLastError() code, otherwise an errno value.
+	void logOSError(LogLevel level, const char* file, uint32_t line, const char* message, int64_t err);
+
+	/// @brief sets the minimum level of records that are logged, records below ECHOMIDI_LOG_LEVEL are always discarded.
+	void setLogLevel(LogLevel level);
+	LogLevel getLogLevel();
+
+	/// @brief sets wether log records are written to cout, enabled by default.
+	void setLogConsole(bool enabled);
+
+	/// @brief sets the file log records are written to, in addition to cout.
+	/// if clear is set to true, the file passed will be cleared before writing.
+	void setLogFile(std::filesystem::path lout, bool clear);
+
+	/// @brief writes every pending record, then closes and saves the log file.
+	void closeLogFile();
+
+	/// @brief starts the logger thread, which formats and writes queued records.
+	/// called by EchoMIDIInit(), records logged before are kept in the ring until the thread starts.
+	void startLogger();
+
+	/// @brief writes every pending record, and stops the logger thread, called by EchoMIDICleanup().
+	void stopLogger();
+
+	/// @brief blocks until every record queued so far has been written, must not be called from a realtime thread.
+	void flushLog();
+
+	/// @brief number of records dropped because the log ring was full.
+	size_t getLogDropCount();
+}
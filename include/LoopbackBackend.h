@@ -0,0 +1,51 @@
+#pragma once
+
+#include "MidiBackend.h"
+
+#include <atomic>
+
+namespace EchoMIDI
+{
+	/// @brief in-process MidiBackend with PORT_COUNT virtual ports, which needs no midi driver or hardware at all.
+	///
+	/// every port is both an input and an output device with the same id,
+	/// anything sent to output n is delivered straight to the callbacks of input n, on the sending thread, if input n is open and started.
+	/// outputs can be opened any number of times, inputs only once at a time.
+	class LoopbackBackend
+	{
+	public:
+		static constexpr UINT PORT_COUNT = 16;
+		static constexpr size_t MAX_NAME_LENGTH = 32;
+
+		struct Port
+		{
+			std::atomic<const InputCallbacks*> callbacks = nullptr;
+			std::atomic<bool> started = false;
+			std::atomic<int64_t> start_time = 0;
+			// number of threads currently delivering to the port, closing the input waits for these to finish.
+			std::atomic<uint32_t> senders = 0;
+		};
+
+		using InputHandle = Port*;
+		using OutputHandle = Port*;
+
+		static UINT getInputCount() { return PORT_COUNT; }
+		static UINT getOutputCount() { return PORT_COUNT; }
+
+		static MMRESULT getInputName(UINT id, std::string& name);
+		static MMRESULT getOutputName(UINT id, std::string& name);
+
+		static MMRESULT openInput(InputHandle& handle, UINT id, const InputCallbacks& callbacks);
+		static MMRESULT startInput(InputHandle handle);
+		static MMRESULT stopInput(InputHandle handle);
+		static MMRESULT resetInput(InputHandle handle);
+		static MMRESULT closeInput(InputHandle handle);
+
+		static MMRESULT openOutput(OutputHandle& handle, UINT id);
+		static MMRESULT closeOutput(OutputHandle handle);
+
+		static MMRESULT sendShort(OutputHandle handle, uint32_t msg);
+		static MMRESULT sendLong(OutputHandle handle, const uint8_t* data, size_t length);
+		static MMRESULT sendBatch(OutputHandle handle, const uint32_t* msgs, size_t count);
+	};
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "SPSCQueue.h"
+
+#include <atomic>
+#include <array>
+#include <cstddef>
+
+namespace EchoMIDI
+{
+	/// @brief bounded lock-free multi producer / single consumer queue.
+	///
+	/// any number of threads may call push() concurrently, but only a single thread at a time may call pop().
+	/// every cell carries a sequence number, which tells producers and the consumer wether the cell is free or filled,
+	/// so producers only contend on a single atomic index, and never wait for each other.
+	///
+	/// @tparam T the element type, should be trivially copyable.
+	/// @tparam CAPACITY the maximum number of elements the queue can hold, must be a power of two.
+	template<typename T, size_t CAPACITY>
+	class MPSCQueue
+	{
+		static_assert(CAPACITY >= 2 && (CAPACITY & (CAPACITY - 1)) == 0, "MPSCQueue capacity must be a power of two");
+
+	public:
+		MPSCQueue()
+		{
+			for (size_t i = 0; i < CAPACITY; i++)
+				m_cells[i].sequence.store(i, std::memory_order_relaxed);
+		}
+
+		MPSCQueue(const MPSCQueue&) = delete;
+		MPSCQueue& operator=(const MPSCQueue&) = delete;
+
+		/// @brief pushes a single element to the back of the queue, never blocks.
+		/// @return false if the queue was full, in which case the element is discarded and counted as dropped.
+		bool push(const T& elem)
+		{
+			size_t pos = m_tail.load(std::memory_order_relaxed);
+
+			while (true)
+			{
+				Cell& cell = m_cells[pos & MASK];
+				size_t sequence = cell.sequence.load(std::memory_order_acquire);
+				std::ptrdiff_t diff = (std::ptrdiff_t)sequence - (std::ptrdiff_t)pos;
+
+				if (diff == 0)
+				{
+					if (m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					{
+						cell.data = elem;
+						cell.sequence.store(pos + 1, std::memory_order_release);
+
+						return true;
+					}
+				}
+				else if (diff < 0)
+				{
+					m_drop_count.fetch_add(1, std::memory_order_relaxed);
+					return false;
+				}
+				else
+				{
+					pos = m_tail.load(std::memory_order_relaxed);
+				}
+			}
+		}
+
+		/// @brief pops a single element from the front of the queue.
+		/// @return false if the queue was empty, in which case elem is left untouched.
+		bool pop(T& elem)
+		{
+			Cell& cell = m_cells[m_head & MASK];
+
+			if (cell.sequence.load(std::memory_order_acquire) != m_head + 1)
+				return false;
+
+			elem = cell.data;
+			cell.sequence.store(m_head + CAPACITY, std::memory_order_release);
+			m_head++;
+
+			return true;
+		}
+
+		/// @brief number of elements discarded because the queue was full.
+		size_t getDropCount() const { return m_drop_count.load(std::memory_order_relaxed); }
+
+		static constexpr size_t capacity() { return CAPACITY; }
+
+	private:
+		static constexpr size_t MASK = CAPACITY - 1;
+
+		struct Cell
+		{
+			std::atomic<size_t> sequence;
+			T data;
+		};
+
+		alignas(CACHE_LINE_SIZE) std::atomic<size_t> m_tail = 0;
+		alignas(CACHE_LINE_SIZE) size_t m_head = 0;
+		std::atomic<size_t> m_drop_count = 0;
+
+		alignas(CACHE_LINE_SIZE) std::array<Cell, CAPACITY> m_cells;
+	};
+}
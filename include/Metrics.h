@@ -0,0 +1,83 @@
+#pragma once
+
+#include "Platform.h"
+#include "SPSCQueue.h"
+
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace EchoMIDI
+{
+	class Echoer;
+
+	/// @brief per Echoer counters of the input device, updated from the midi callback.
+	struct alignas(CACHE_LINE_SIZE) InputStats
+	{
+		/// @brief messages recieved from the input device, every SysEx block counts as a single message.
+		std::atomic<uint64_t> received_count = 0;
+		/// @brief bytes of the messages in received_count.
+		std::atomic<uint64_t> received_bytes = 0;
+
+		void countReceived(uint64_t bytes)
+		{
+			received_count.fetch_add(1, std::memory_order_relaxed);
+			received_bytes.fetch_add(bytes, std::memory_order_relaxed);
+		}
+	};
+
+	/// @brief the counters of a single target, at the time of the snapshot, see TargetStats and AsyncSender.
+	/// every count only ever increases, for as long as the target is not removed.
+	struct TargetMetrics
+	{
+		UINT id = UINT_MAX;
+		/// @brief name of the output device, only set by getMetrics().
+		std::string name;
+
+		uint64_t sent_count = 0;
+		uint64_t sent_bytes = 0;
+		uint64_t muted_count = 0;
+		uint64_t focus_muted_count = 0;
+		uint64_t filtered_count = 0;
+		uint64_t error_count = 0;
+
+		/// @brief the counters below are only ever non zero in async mode, except queue_dropped_count, which also counts drops of a shared output, see OutputPort.
+		uint64_t queue_dropped_count = 0;
+		uint64_t coalesced_count = 0;
+		/// @brief approximate number of messages waiting in the queue of the target.
+		uint64_t queue_depth = 0;
+	};
+
+	/// @brief the counters of a single Echoer and all of its targets, at the time of the snapshot, see Echoer::getMetrics().
+	struct EchoerMetrics
+	{
+		UINT id = UINT_MAX;
+		/// @brief name of the input device, only set by getMetrics().
+		std::string name;
+
+		uint64_t received_count = 0;
+		uint64_t received_bytes = 0;
+		/// @brief error records dropped because the error queue of the Echoer was full.
+		uint64_t dropped_error_count = 0;
+
+		std::vector<TargetMetrics> targets;
+	};
+
+	/// @brief adds the Echoer to the set of Echoers reported by getMetrics(), called by the Echoer constructors.
+	void registerMetrics(Echoer* echoer);
+
+	/// @brief removes the Echoer from the set reported by getMetrics(), called first thing by the Echoer destructor.
+	/// once this returns, getMetrics() no longer references the Echoer.
+	void unregisterMetrics(Echoer* echoer);
+
+	/// @brief takes a snapshot of the counters of every Echoer with a valid input device id, and resolves the device names.
+	/// may be called from any thread, the midi callbacks are never blocked by it.
+	std::vector<EchoerMetrics> getMetrics();
+
+	/// @brief formats the snapshot in the prometheus text exposition format (version 0.0.4).
+	/// every counter is labeled with the name and id of its input device, and the name and id of its output device for target counters.
+	std::string formatPrometheus(const std::vector<EchoerMetrics>& metrics);
+}
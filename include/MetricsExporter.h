@@ -0,0 +1,106 @@
+#pragma once
+
+#include "Metrics.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace EchoMIDI
+{
+	/// @brief where and how often a MetricsExporter exports the metrics of every Echoer.
+	struct MetricsConfig
+	{
+		/// @brief the file the metrics are written to, e.g. for the textfile collector of the prometheus node exporter, empty disables it.
+		std::filesystem::path file;
+		/// @brief the port the metrics are served on, at http://127.0.0.1:port/metrics, 0 disables it.
+		uint16_t port = 0;
+		/// @brief how often a new snapshot is taken, and the file is rewritten.
+		std::chrono::milliseconds interval = std::chrono::milliseconds(1000);
+
+		bool operator==(const MetricsConfig&) const = default;
+
+		bool enabled() const
+		{
+			return !file.empty() || port != 0;
+		}
+	};
+
+	/// @brief periodically takes a snapshot of the metrics of every Echoer, see getMetrics(), and exports it in the prometheus text format.
+	///
+	/// the snapshot is taken and formatted on a thread owned by the exporter, which never touches the midi callbacks or sender threads,
+	/// the counters are only read with relaxed atomic loads.
+	///
+	/// the file is written next to its destination, and then renamed, so a reader never sees a partially written file.
+	/// the http endpoint is bound to the loopback interface only, and serves the last snapshot to every GET request,
+	/// one connection at a time.
+	class MetricsExporter
+	{
+	public:
+		/// @brief starts the exporter thread, the first snapshot is exported right away.
+		/// @throw MIDIEchoExcept if the http port cannot be bound.
+		MetricsExporter(const MetricsConfig& config);
+		/// @brief stops and joins the exporter thread, the file is left in place.
+		~MetricsExporter();
+
+		MetricsExporter(const MetricsExporter&) = delete;
+		MetricsExporter& operator=(const MetricsExporter&) = delete;
+
+		const MetricsConfig& getConfig() const
+		{
+			return m_config;
+		}
+
+		/// @return the port the http endpoint is bound to, which differs from the config if it was 0, and no endpoint is served.
+		uint16_t getPort() const
+		{
+			return m_port;
+		}
+
+		/// @return number of snapshots exported so far.
+		size_t getExportCount() const
+		{
+			return m_export_count.load(std::memory_order_relaxed);
+		}
+
+	private:
+#ifdef _WIN32
+		using Socket = uintptr_t;
+#else
+		using Socket = int;
+#endif
+		static constexpr Socket INVALID_SOCKET_HANDLE = (Socket)-1;
+
+		void run();
+
+		// takes a new snapshot, and writes it to the file, if any.
+		void exportMetrics();
+		void writeFile();
+
+		// answers a single http request with the last snapshot.
+		void serveClient(Socket client);
+
+		// waits for up to timeout for a connection, or until the exporter is stopped.
+		void waitForClient(std::chrono::milliseconds timeout);
+
+		MetricsConfig m_config;
+		uint16_t m_port = 0;
+		Socket m_listen_socket = INVALID_SOCKET_HANDLE;
+
+		// only ever accessed from the exporter thread.
+		std::string m_text;
+
+		std::atomic<size_t> m_export_count = 0;
+
+		std::mutex m_stop_mutex;
+		std::condition_variable m_stop_cv;
+		bool m_stopping = false;
+
+		std::thread m_thread;
+	};
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "Platform.h"
+
+#include <concepts>
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+namespace EchoMIDI
+{
+	/// @brief functions an input device calls for every message it recieves, see MidiBackend::openInput().
+	///
+	/// both functions are called from a thread owned by the backend, and must never block.
+	/// timestamps are in milliseconds since the input was started.
+	struct InputCallbacks
+	{
+		void* user = nullptr;
+		/// @brief recieves a packed short midi message, status byte in the lowest byte.
+		void (*on_short)(void* user, uint32_t msg, DWORD timestamp) = nullptr;
+		/// @brief recieves a complete or partial SysEx message.
+		/// data is only valid during the call, unless the backend lends out its own buffers (winmm, see SysExPool).
+		void (*on_long)(void* user, const uint8_t* data, size_t length, DWORD timestamp) = nullptr;
+	};
+
+	/// @brief number of bytes in a short message with the passed status byte.
+	inline size_t getShortMessageLength(uint8_t status)
+	{
+		switch (status & 0xF0)
+		{
+		case 0xC0:
+		case 0xD0:
+			return 2;
+		case 0xF0:
+			if (status == 0xF1 || status == 0xF3)
+				return 2;
+			if (status == 0xF2)
+				return 3;
+			return 1;
+		default:
+			return 3;
+		}
+	}
+
+	/// @brief a midi driver api, which devices can be enumerated, opened, sent to and recieved from through.
+	///
+	/// every backend is a type with only static functions, selected at compile time (see Backend.h),
+	/// so sending to a target is a direct call into the driver api, without any virtual dispatch.
+	/// every function reports errors as one of the winmm MMSYSERR codes, and never throws.
+	///
+	/// device ids are indexes into the current list of input or output devices, just like winmm device ids.
+	template<typename T>
+	concept MidiBackend = requires(
+		typename T::InputHandle& in_handle, typename T::OutputHandle& out_handle, UINT id, std::string& name,
+		const InputCallbacks& callbacks, uint32_t msg, const uint32_t* msgs, const uint8_t* data, size_t length)
+	{
+		// device names longer than this never match any device, see getMidiInIDByName().
+		{ T::MAX_NAME_LENGTH } -> std::convertible_to<size_t>;
+
+		{ T::getInputCount() } -> std::same_as<UINT>;
+		{ T::getOutputCount() } -> std::same_as<UINT>;
+		{ T::getInputName(id, name) } -> std::same_as<MMRESULT>;
+		{ T::getOutputName(id, name) } -> std::same_as<MMRESULT>;
+
+		// callbacks must stay alive until the input is closed.
+		{ T::openInput(in_handle, id, callbacks) } -> std::same_as<MMRESULT>;
+		{ T::startInput(in_handle) } -> std::same_as<MMRESULT>;
+		{ T::stopInput(in_handle) } -> std::same_as<MMRESULT>;
+		{ T::resetInput(in_handle) } -> std::same_as<MMRESULT>;
+		{ T::closeInput(in_handle) } -> std::same_as<MMRESULT>;
+
+		{ T::openOutput(out_handle, id) } -> std::same_as<MMRESULT>;
+		{ T::closeOutput(out_handle) } -> std::same_as<MMRESULT>;
+
+		// sends a single packed short midi message, must be safe to call from the input callbacks.
+		{ T::sendShort(out_handle, msg) } -> std::same_as<MMRESULT>;
+		// sends a complete SysEx message.
+		{ T::sendLong(out_handle, data, length) } -> std::same_as<MMRESULT>;
+		// sends multiple packed short midi messages, with as few calls into the driver as the backend allows.
+		{ T::sendBatch(out_handle, msgs, length) } -> std::same_as<MMRESULT>;
+	};
+}
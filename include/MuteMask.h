@@ -0,0 +1,136 @@
+#pragma once
+
+#include "SPSCQueue.h"
+
+#include <atomic>
+#include <array>
+#include <cstdint>
+#include <cstddef>
+
+namespace EchoMIDI
+{
+	/// @brief lock-free mute state of up to MAX_TARGETS output targets, identified by their slot index.
+	///
+	/// every target has a user mute bit and a focus mute bit.
+	/// the bits of 32 targets are packed into a single 64 bit word, user mute bits in the lower half and focus mute bits in the upper half,
+	/// so a reader gets a consistent view of both bits of 32 targets from a single relaxed load.
+	///
+	/// targets can additionally be disabled, which happens when they fail too many sends in a row.
+	/// the disabled bits of 32 targets are kept in a separate word, as they are set from the realtime threads themselves.
+	///
+	/// any thread may modify the mask at any time, every modification increments the generation counter.
+	class MuteMask
+	{
+	public:
+		/// @brief maximum number of targets a single mask can hold.
+		static constexpr size_t MAX_TARGETS = 256;
+		/// @brief number of targets covered by a single word.
+		static constexpr size_t TARGETS_PER_WORD = 32;
+		static constexpr size_t WORD_COUNT = MAX_TARGETS / TARGETS_PER_WORD;
+
+		void setUserMuted(size_t slot, bool muted)
+		{
+			setBit(slot, 0, muted);
+		}
+
+		void setFocusMuted(size_t slot, bool muted)
+		{
+			setBit(slot, TARGETS_PER_WORD, muted);
+		}
+
+		/// @brief sets the focus mute bits of several targets of a single word at once, with a single atomic operation.
+		/// bit n of slots and muted corresponds to slot word * TARGETS_PER_WORD + n, only the bits set in slots are changed.
+		void setFocusMutedWord(size_t word, uint32_t slots, uint32_t muted)
+		{
+			uint64_t mask = (uint64_t)slots << TARGETS_PER_WORD;
+			uint64_t bits = (uint64_t)(muted & slots) << TARGETS_PER_WORD;
+			std::atomic<uint64_t>& target_word = m_words[word];
+
+			uint64_t prev = target_word.load(std::memory_order_relaxed);
+
+			// the user mute bits of the word may change concurrently, so they are kept as they are.
+			while ((prev & mask) != bits && !target_word.compare_exchange_weak(prev, (prev & ~mask) | bits, std::memory_order_release, std::memory_order_relaxed))
+				;
+
+			if ((prev & mask) != bits)
+				m_generation.fetch_add(1, std::memory_order_release);
+		}
+
+		void setDisabled(size_t slot, bool disabled)
+		{
+			uint32_t bit = 1u << (slot % TARGETS_PER_WORD);
+			std::atomic<uint32_t>& word = m_disabled[slot / TARGETS_PER_WORD];
+
+			uint32_t prev = disabled ? word.fetch_or(bit, std::memory_order_release) : word.fetch_and(~bit, std::memory_order_release);
+
+			if ((prev & bit) != (disabled ? bit : 0))
+				m_generation.fetch_add(1, std::memory_order_release);
+		}
+
+		bool isDisabled(size_t slot) const
+		{
+			return m_disabled[slot / TARGETS_PER_WORD].load(std::memory_order_relaxed) >> (slot % TARGETS_PER_WORD) & 1;
+		}
+
+		bool isUserMuted(size_t slot) const
+		{
+			return m_words[slot / TARGETS_PER_WORD].load(std::memory_order_relaxed) >> (slot % TARGETS_PER_WORD) & 1;
+		}
+
+		bool isFocusMuted(size_t slot) const
+		{
+			return m_words[slot / TARGETS_PER_WORD].load(std::memory_order_relaxed) >> (slot % TARGETS_PER_WORD + TARGETS_PER_WORD) & 1;
+		}
+
+		/// @brief resets every bit of the slot, should be called before a slot is reused.
+		void clear(size_t slot)
+		{
+			setUserMuted(slot, false);
+			setFocusMuted(slot, false);
+			setDisabled(slot, false);
+		}
+
+		/// @brief retrieves the targets of the passed word, which are neither user muted, focus muted nor disabled.
+		/// bit n of the result corresponds to slot word * TARGETS_PER_WORD + n.
+		uint32_t getSendBits(size_t word) const
+		{
+			uint64_t bits = m_words[word].load(std::memory_order_relaxed);
+
+			return ~((uint32_t)bits | (uint32_t)(bits >> TARGETS_PER_WORD) | m_disabled[word].load(std::memory_order_relaxed));
+		}
+
+		/// @brief see getSendBits(), additionally retrieves the targets which are only focus muted, and neither user muted nor disabled.
+		/// both are taken from a single load of the word, so they are always consistent with each other.
+		uint32_t getSendBits(size_t word, uint32_t& focus_muted) const
+		{
+			uint64_t bits = m_words[word].load(std::memory_order_relaxed);
+			uint32_t muted = (uint32_t)bits | m_disabled[word].load(std::memory_order_relaxed);
+
+			focus_muted = (uint32_t)(bits >> TARGETS_PER_WORD) & ~muted;
+
+			return ~(muted | (uint32_t)(bits >> TARGETS_PER_WORD));
+		}
+
+		/// @brief incremented every time a bit in the mask changes.
+		uint64_t getGeneration() const
+		{
+			return m_generation.load(std::memory_order_acquire);
+		}
+
+	private:
+		void setBit(size_t slot, size_t offset, bool state)
+		{
+			uint64_t bit = 1ull << (slot % TARGETS_PER_WORD + offset);
+			std::atomic<uint64_t>& word = m_words[slot / TARGETS_PER_WORD];
+
+			uint64_t prev = state ? word.fetch_or(bit, std::memory_order_release) : word.fetch_and(~bit, std::memory_order_release);
+
+			if ((prev & bit) != (state ? bit : 0))
+				m_generation.fetch_add(1, std::memory_order_release);
+		}
+
+		alignas(CACHE_LINE_SIZE) std::array<std::atomic<uint64_t>, WORD_COUNT> m_words = {};
+		std::array<std::atomic<uint32_t>, WORD_COUNT> m_disabled = {};
+		std::atomic<uint64_t> m_generation = 0;
+	};
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <cstddef>
+
+namespace EchoMIDI
+{
+	/// @brief compact set of the notes sounding on a single target, and the channels holding the sustain pedal down.
+	///
+	/// every short message routed to the target passes through track(), which only touches a single bit for note on / off and sustain,
+	/// and returns right away for anything else.
+	/// once the target stops recieving, e.g. because it was muted, focus muted or removed,
+	/// release() produces exactly the note offs needed to end every sounding note, instead of an all notes off on every channel.
+	///
+	/// the set is 16 x 128 bits, plus 16 sustain bits, a little over 256 bytes per target.
+	/// every bit is updated with a single atomic operation, so track() and release() may run on different threads.
+	class NoteTracker
+	{
+	public:
+		/// @brief number of 64 bit words holding the notes of a single channel.
+		static constexpr size_t WORDS_PER_CHANNEL = 128 / 64;
+
+		/// @brief updates the set with a short message that is sent to the target. never blocks or allocates.
+		void track(uint32_t msg) noexcept
+		{
+			uint8_t status = msg & 0xF0;
+			size_t channel = msg & 0x0F;
+			uint8_t data1 = (msg >> 8) & 0x7F;
+			uint8_t data2 = (msg >> 16) & 0x7F;
+
+			switch (status)
+			{
+			case 0x90:
+				// a note on with velocity 0 is a note off.
+				if (data2 != 0)
+				{
+					m_notes[channel * WORDS_PER_CHANNEL + data1 / 64].fetch_or(1ull << (data1 % 64), std::memory_order_relaxed);
+					return;
+				}
+
+				[[fallthrough]];
+			case 0x80:
+				m_notes[channel * WORDS_PER_CHANNEL + data1 / 64].fetch_and(~(1ull << (data1 % 64)), std::memory_order_relaxed);
+				return;
+			case 0xB0:
+				if (data1 == SUSTAIN_CONTROLLER)
+				{
+					if (data2 >= 64)
+						m_sustain.fetch_or((uint16_t)(1u << channel), std::memory_order_relaxed);
+					else
+						m_sustain.fetch_and((uint16_t)~(1u << channel), std::memory_order_relaxed);
+				}
+				// all sound off and all notes off end every note of the channel, the pedal stays down.
+				else if (data1 == 120 || data1 == 123)
+				{
+					for (size_t i = 0; i < WORDS_PER_CHANNEL; i++)
+						m_notes[channel * WORDS_PER_CHANNEL + i].store(0, std::memory_order_relaxed);
+				}
+
+				return;
+			default:
+				return;
+			}
+		}
+
+		/// @brief takes every sounding note out of the set, and calls send(msg) with a note off for each of them,
+		/// followed by sustain off for every channel holding the pedal down.
+		/// the work done is proportional to the number of sounding notes, a set without any costs 33 atomic loads.
+		/// @return the number of messages passed to send.
+		template<typename TSend>
+		size_t release(TSend send)
+		{
+			size_t count = 0;
+
+			for (size_t word = 0; word < m_notes.size(); word++)
+			{
+				// most words are empty, and are only read.
+				if (m_notes[word].load(std::memory_order_relaxed) == 0)
+					continue;
+
+				uint64_t notes = m_notes[word].exchange(0, std::memory_order_relaxed);
+				uint32_t channel = (uint32_t)(word / WORDS_PER_CHANNEL);
+
+				while (notes != 0)
+				{
+					uint32_t note = (uint32_t)(word % WORDS_PER_CHANNEL * 64 + std::countr_zero(notes));
+					notes &= notes - 1;
+
+					send(0x80 | channel | note << 8);
+					count++;
+				}
+			}
+
+			uint16_t sustain = m_sustain.load(std::memory_order_relaxed) != 0 ? m_sustain.exchange(0, std::memory_order_relaxed) : 0;
+
+			while (sustain != 0)
+			{
+				uint32_t channel = (uint32_t)std::countr_zero(sustain);
+				sustain &= sustain - 1;
+
+				send(0xB0 | channel | SUSTAIN_CONTROLLER << 8);
+				count++;
+			}
+
+			return count;
+		}
+
+		/// @return the number of notes currently sounding.
+		size_t getNoteCount() const
+		{
+			size_t count = 0;
+
+			for (const std::atomic<uint64_t>& word : m_notes)
+				count += std::popcount(word.load(std::memory_order_relaxed));
+
+			return count;
+		}
+
+		/// @return wether release() would not send anything.
+		bool empty() const
+		{
+			for (const std::atomic<uint64_t>& word : m_notes)
+			{
+				if (word.load(std::memory_order_relaxed) != 0)
+					return false;
+			}
+
+			return m_sustain.load(std::memory_order_relaxed) == 0;
+		}
+
+	private:
+		static constexpr uint32_t SUSTAIN_CONTROLLER = 64;
+
+		std::array<std::atomic<uint64_t>, 16 * WORDS_PER_CHANNEL> m_notes = {};
+		std::atomic<uint16_t> m_sustain = 0;
+	};
+}
@@ -0,0 +1,252 @@
+#pragma once
+
+#include "Backend.h"
+#include "MPSCQueue.h"
+#include "RouteTable.h"
+
+#ifdef ECHOMIDI_BACKEND_WINMM
+#include "SysExPool.h"
+#endif
+
+#include <atomic>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace EchoMIDI
+{
+	class Echoer;
+
+	/// @brief a single open output device, shared by every Echoer routed to it, see OutputPool.
+	///
+	/// while only a single Echoer feeds the port, it is sent to exactly as before, from the midi callback or the AsyncSender of that Echoer.
+	/// once a second Echoer feeds it, the midi callbacks push short messages to a lock-free queue per feeder instead,
+	/// and a merge thread sends them in the order of their input timestamps, so messages played on different inputs keep their relative order.
+	///
+	/// the merge thread sends the oldest queued message as soon as no other feeder can still push an older one,
+	/// that is once every other feeder either has a later message queued, or is not inside a midi callback it entered before the message was recieved.
+	/// a message is only held back while such a callback is still running, for at most the merge window, see OutputPool::setMergeWindow().
+	/// merged messages still take a trip through the merge thread, which adds its wake up latency, usually a few microseconds up to a scheduler tick.
+	///
+	/// SysEx is never merged, it is sent from the midi callback of its input, and may overtake short messages queued for the merge thread.
+	/// merged messages bypass the AsyncSender of their Echoer, so coalescing and batched output only apply while the port is not merging.
+	/// once the port stops merging, a feeder keeps queueing until every message queued so far has been sent, so it never overtakes its own messages.
+	class OutputPort
+	{
+	public:
+		/// @brief a short message waiting to be merged.
+		struct Event
+		{
+			/// @brief latencyNow() time the input device recieved the message, messages are sent in this order.
+			int64_t input_time;
+			uint32_t msg;
+			/// @brief the driver timestamp of the message, relative to the start of its Echoer.
+			DWORD timestamp;
+			/// @brief passed to Echoer::recordSent(), 0 if latency is not tracked.
+			int64_t received;
+			Echoer* echoer;
+			uint32_t slot;
+			TargetStats* stats;
+		};
+
+		/// @brief capacity of the merge queue of every Echoer feeding the port.
+		static constexpr size_t QUEUE_SIZE = 1024;
+		/// @brief maximum number of Echoers feeding a single port.
+		static constexpr size_t MAX_FEEDERS = 64;
+
+		/// @brief stops the merge thread, after every queued message has been sent.
+		~OutputPort();
+
+		OutputPort(const OutputPort&) = delete;
+		OutputPort& operator=(const OutputPort&) = delete;
+
+		/// @return the current id of the device, INVALID_MIDI_ID (UINT_MAX) if it has vanished.
+		UINT getID() const
+		{
+			return m_id.load(std::memory_order_relaxed);
+		}
+
+		Backend::OutputHandle getHandle() const
+		{
+			return m_handle;
+		}
+
+#ifdef ECHOMIDI_BACKEND_WINMM
+		/// @brief only set if the device was opened as a stream, getHandle() returns the same handle.
+		HMIDISTRM getStreamHandle() const
+		{
+			return m_stream_handle;
+		}
+
+		/// @brief lets the output callback of the port hand the SysEx blocks of the passed pool back to it, see SysExPool::release().
+		/// @return false if MAX_FEEDERS pools are already attached.
+		bool attachSysExPool(SysExPool* sysex_pool);
+		/// @brief waits until the output callback no longer uses the pool.
+		void detachSysExPool(SysExPool* sysex_pool);
+#endif
+
+		/// @brief number of Echoers currently routed to the port.
+		size_t getFeederCount() const
+		{
+			return m_feeder_count.load(std::memory_order_relaxed);
+		}
+
+		/// @return wether short messages must be pushed to the merge queue, instead of being sent to the handle.
+		/// stays set after the port stopped merging, until the merge thread has sent every message queued so far.
+		bool isMerging() const
+		{
+			return m_merging.load(std::memory_order_acquire) || m_queued_count.load(std::memory_order_acquire) != 0;
+		}
+
+		/// @brief queues a short message for the merge thread, never blocks or allocates.
+		/// @param feeder the index OutputPool::acquire() returned to the Echoer of the message.
+		/// @return false if the queue was full, the message is dropped in that case.
+		/// @warning this function is called by the midi callback, and should never be used outside of it.
+		bool push(size_t feeder, const Event& event);
+
+		/// @brief wakes the merge thread up, if it is holding back a message until the midi callback of a feeder is done.
+		/// @warning this function is called by the midi callback, once it no longer pushes anything, and should never be used outside of it.
+		void wake();
+
+		/// @return number of messages dropped because a merge queue was full.
+		size_t getDropCount() const
+		{
+			return m_drop_count.load(std::memory_order_relaxed);
+		}
+
+		/// @return number of messages sent by the merge thread.
+		size_t getMergedCount() const
+		{
+			return m_merged_count.load(std::memory_order_relaxed);
+		}
+
+	private:
+		friend class OutputPool;
+
+		OutputPort(UINT id, const std::atomic<int64_t>& merge_window);
+
+		MMRESULT open(bool stream);
+		// stops the merge thread, and closes the device.
+		MMRESULT close();
+
+		// a single Echoer feeding the port, only modified whilst m_feeder_mutex is held.
+		struct Feeder
+		{
+			// allocated the first time the slot is used, and kept until the port is destroyed.
+			std::unique_ptr<MPSCQueue<Event, QUEUE_SIZE>> queue;
+			// null whilst the slot is free.
+			Echoer* echoer = nullptr;
+			// messages pushed, but not yet sent, by the merge thread.
+			alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> queued_count = 0;
+		};
+
+		// adds a feeder, starting the merge thread once the port is shared for the first time.
+		// the thread keeps running until the port is closed, so a message pushed just as a feeder leaves is still sent.
+		// @return the index of the feeder, MAX_FEEDERS if every slot is taken.
+		size_t addFeeder(Echoer& echoer);
+		// waits until every message the feeder queued has been sent, as they reference its counters, the feeder must no longer push.
+		void drainFeeder(size_t feeder);
+		// removes a drained feeder.
+		void removeFeeder(size_t feeder);
+
+		void run();
+		void send(const Event& event);
+
+#ifdef ECHOMIDI_BACKEND_WINMM
+		static void CALLBACK outputCallback(HMIDIOUT hMidiOut, UINT wMsg, DWORD_PTR dwInstance, DWORD_PTR dwParam1, DWORD_PTR dwParam2);
+#endif
+
+		std::atomic<UINT> m_id;
+		Backend::OutputHandle m_handle = {};
+#ifdef ECHOMIDI_BACKEND_WINMM
+		HMIDISTRM m_stream_handle = NULL;
+
+		std::array<std::atomic<SysExPool*>, MAX_FEEDERS> m_sysex_pools = {};
+		// number of output callbacks currently looking at m_sysex_pools.
+		std::atomic<uint32_t> m_callbacks = 0;
+#endif
+
+		// only modified whilst the OutputPool mutex is held.
+		std::atomic<size_t> m_feeder_count = 0;
+		// set whilst the device is opened outside of the OutputPool mutex, acquire() waits for it to clear.
+		bool m_opening = false;
+		std::atomic<bool> m_merging = false;
+
+		const std::atomic<int64_t>& m_merge_window;
+
+		// guards the slots, not the queues, the merge thread holds it whilst it looks for the next message to send.
+		std::mutex m_feeder_mutex;
+		std::array<Feeder, MAX_FEEDERS> m_feeders;
+		// messages of every feeder pushed, but not yet sent, see isMerging().
+		alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> m_queued_count = 0;
+		std::atomic<size_t> m_drop_count = 0;
+		std::atomic<size_t> m_merged_count = 0;
+
+		// incremented on every push, and by wake(), the merge thread waits on this whilst it holds no message.
+		std::atomic<uint32_t> m_signal = 0;
+		// set whilst the merge thread holds back a message, it then waits on m_hold_cv for m_signal to change, or the merge window to pass.
+		std::atomic<bool> m_holding = false;
+		std::mutex m_hold_mutex;
+		std::condition_variable m_hold_cv;
+		std::atomic<bool> m_running = true;
+		std::thread m_thread;
+	};
+
+	/// @brief opens every output device once, and shares it between every Echoer routed to it.
+	///
+	/// most drivers only allow a single handle per device, so routing a second input to the same output used to fail with DeviceAllocated.
+	/// the pool refcounts the open devices instead, every Echoer acquires the port of its target, and the device is only closed once the last one releases it.
+	/// ports are matched by id, and kept up to date when the devices are renumbered, see DeviceRegistry::rescan().
+	/// every function may be called from any thread.
+	class OutputPool
+	{
+	public:
+		/// @brief default maximum time a merged message is held back, waiting for another input that is still recieving a message.
+		static constexpr std::chrono::microseconds DEFAULT_MERGE_WINDOW = std::chrono::microseconds(1000);
+
+		/// @brief opens the device, or adds a reference to the port already open for it.
+		/// with winmm, the device is opened as a midi stream if stream is set, a port that is already open keeps the mode it was opened with.
+		/// @param feeder set to the index the echoer passes to OutputPort::push().
+		/// @return the error of opening the device, port and feeder are only set on success.
+		MMRESULT acquire(OutputPort*& port, size_t& feeder, Echoer& echoer, UINT id, bool stream = false);
+
+		/// @brief removes a reference to the port, and closes the device once no reference is left.
+		/// the caller must no longer route any message to the port, every message it already queued is sent before this returns.
+		/// @return the error of closing the device, the port is gone either way.
+		MMRESULT release(OutputPort* port, size_t feeder);
+
+		/// @brief updates the ids of the open ports, after the devices were renumbered.
+		/// called by DeviceRegistry::rescan(), ports mapped to INVALID_MIDI_ID are never acquired again.
+		void remapIDs(const std::vector<UINT>& output_ids);
+
+		/// @return number of open devices.
+		size_t getPortCount();
+
+		/// @brief sets how long a merged message is held back at most, whilst the midi callback of another input feeding the same port is running.
+		/// a longer window keeps the order across inputs with slow callbacks, at the cost of that much extra latency in the worst case.
+		void setMergeWindow(std::chrono::microseconds window)
+		{
+			m_merge_window.store(std::chrono::duration_cast<std::chrono::nanoseconds>(window).count(), std::memory_order_relaxed);
+		}
+
+		std::chrono::microseconds getMergeWindow() const
+		{
+			return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::nanoseconds(m_merge_window.load(std::memory_order_relaxed)));
+		}
+
+	private:
+		std::mutex m_mutex;
+		std::vector<std::unique_ptr<OutputPort>> m_ports;
+		// notified every time a port is done opening, devices are opened without holding m_mutex, so different devices open in parallel.
+		std::condition_variable m_opened;
+
+		std::atomic<int64_t> m_merge_window = std::chrono::duration_cast<std::chrono::nanoseconds>(DEFAULT_MERGE_WINDOW).count();
+	};
+
+	/// @brief the pool every Echoer opens its targets through.
+	OutputPool& getOutputPool();
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+// the library uses the winmm types and result codes on every platform,
+// so errors look the same no matter which backend produced them, see MidiBackend.h.
+
+#ifdef _WIN32
+
+#include <Windows.h>
+
+#else
+
+#include <cstdint>
+#include <climits>
+
+namespace EchoMIDI
+{
+	using UINT = unsigned int;
+	using DWORD = uint32_t;
+	using DWORD_PTR = uintptr_t;
+	using MMRESULT = UINT;
+
+	// same values as the winmm result codes.
+	constexpr MMRESULT MMSYSERR_NOERROR = 0;
+	constexpr MMRESULT MMSYSERR_ERROR = 1;
+	constexpr MMRESULT MMSYSERR_BADDEVICEID = 2;
+	constexpr MMRESULT MMSYSERR_NOTENABLED = 3;
+	constexpr MMRESULT MMSYSERR_ALLOCATED = 4;
+	constexpr MMRESULT MMSYSERR_INVALHANDLE = 5;
+	constexpr MMRESULT MMSYSERR_NODRIVER = 6;
+	constexpr MMRESULT MMSYSERR_NOMEM = 7;
+	constexpr MMRESULT MMSYSERR_NOTSUPPORTED = 8;
+	constexpr MMRESULT MMSYSERR_INVALPARAM = 11;
+	constexpr MMRESULT MIDIERR_NOTREADY = 67;
+}
+
+#endif
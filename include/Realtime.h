@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+namespace EchoMIDI
+{
+	/// @brief scheduling settings for every thread owned by the library, see setRealtimeConfig().
+	struct RealtimeConfig
+	{
+		/// @brief if false, every thread runs with the default scheduling of the os, and memory is not locked.
+		bool enabled = false;
+		/// @brief SCHED_FIFO priority (1 - 99) on linux.
+		/// on windows, threads join the MMCSS "Pro Audio" task, with AVRT_PRIORITY_CRITICAL from 90, AVRT_PRIORITY_HIGH from 50, and AVRT_PRIORITY_NORMAL below.
+		int priority = 80;
+		/// @brief bit n pins the threads to cpu n, 0 lets the threads run on any cpu.
+		uint64_t cpu_mask = 0;
+		/// @brief locks every current and future page of the process into memory (mlockall()),
+		/// on windows, the minimum working set is raised instead.
+		bool lock_memory = true;
+		/// @brief touches PREFAULT_STACK_SIZE bytes of stack of every thread, and the preallocated buffers of every sender,
+		/// so no page faults happen once messages start arriving.
+		bool prefault = true;
+
+		bool operator==(const RealtimeConfig&) const = default;
+	};
+
+	/// @brief the outcome of applying the current RealtimeConfig, the os error code of every setting it refused.
+	struct RealtimeStatus
+	{
+		/// @brief os error code of the last thread that could not get realtime priority, 0 if none failed.
+		int priority_err = 0;
+		/// @brief os error code of the last thread that could not be pinned to the configured cpus, 0 if none failed.
+		int affinity_err = 0;
+		/// @brief os error code of locking the process memory, 0 if it succeeded or was not requested.
+		int memory_lock_err = 0;
+		/// @brief number of threads the config has been applied to, including those with errors.
+		uint32_t thread_count = 0;
+
+		bool ok() const
+		{
+			return priority_err == 0 && affinity_err == 0 && memory_lock_err == 0;
+		}
+
+		/// @return a message naming every refused setting and the reason the os gave, "OK" if nothing was refused.
+		std::string describe() const;
+	};
+
+	static constexpr size_t PREFAULT_STACK_SIZE = 64 * 1024;
+
+	/// @brief sets the scheduling of every thread owned by the library, and locks or unlocks the process memory.
+	///
+	/// this covers the sender threads of async Echoers, the input threads of the ALSA backend and the focus hook thread.
+	/// threads already running pick up the new config the next time they wake up, new threads apply it as they start.
+	/// threads owned by the midi driver, e.g. the winmm midi callback, are left untouched.
+	///
+	/// the os refusing any of the settings is never an error, the threads keep running with the default scheduling,
+	/// see getRealtimeStatus() for what was refused and why.
+	void setRealtimeConfig(const RealtimeConfig& config);
+
+	RealtimeConfig getRealtimeConfig();
+
+	/// @brief retrieve the outcome of the current config, reset every time setRealtimeConfig() is called.
+	RealtimeStatus getRealtimeStatus();
+
+	/// @brief applies the current RealtimeConfig to the calling thread, if it changed since the last call from this thread.
+	/// a single relaxed atomic load if nothing changed, so it can be called from every iteration of a realtime loop.
+	/// @warning this function is called by the threads owned by the library, and should never be used outside of these.
+	void updateThreadRealtime() noexcept;
+
+	/// @brief touches every page of the passed buffer, so they are mapped before any realtime thread uses them.
+	/// the contents are left unchanged, but the buffer must not be in use by any other thread.
+	void prefault(void* data, size_t size) noexcept;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "Snapshot.h"
+#include "Transform.h"
+#include "LatencyHistogram.h"
+#include "NoteTracker.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace EchoMIDI
+{
+	class AsyncSender;
+	class OutputPort;
+
+	/// @brief per target counters, updated from the midi callback and sender threads.
+	/// in async mode the midi callback and the sender thread write different counters,
+	/// so these are kept on separate cache lines, and never bounce between the two threads.
+	struct alignas(CACHE_LINE_SIZE) TargetStats
+	{
+		// ============ Written by the midi callback ============
+
+		/// @brief messages not sent, because the target was user muted or disabled.
+		std::atomic<uint64_t> muted_count = 0;
+		/// @brief messages not sent, because the target was focus muted only.
+		std::atomic<uint64_t> focus_muted_count = 0;
+		/// @brief messages not sent, because the transform of the target filtered them out.
+		std::atomic<uint64_t> filtered_count = 0;
+		/// @brief messages not sent, because the merge queue of the shared output device was full, see OutputPort.
+		std::atomic<uint64_t> merge_dropped_count = 0;
+
+		// ============ Written by the thread sending to the target ============
+
+		/// @brief messages handed to the driver without an error.
+		alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> sent_count = 0;
+		/// @brief bytes of the messages in sent_count.
+		std::atomic<uint64_t> sent_bytes = 0;
+		/// @brief total number of failed sends.
+		std::atomic<uint32_t> error_count = 0;
+		/// @brief number of failed sends since the last successful one.
+		std::atomic<uint32_t> consecutive_errors = 0;
+
+		/// @brief time from entering the midi callback, until the send to the target returned.
+		LatencyHistogram dispatch_latency;
+		/// @brief time from the driver timestamp of the message, until the send to the target returned.
+		LatencyHistogram total_latency;
+
+		void countSent(uint64_t count, uint64_t bytes)
+		{
+			sent_count.fetch_add(count, std::memory_order_relaxed);
+			sent_bytes.fetch_add(bytes, std::memory_order_relaxed);
+		}
+	};
+
+	/// @brief a single output target, as seen by the midi callback.
+	/// the mute state is not part of the route, as it changes far more often than the targets themselves, see MuteMask.
+	/// @tparam THandle the type of the output device handle.
+	template<typename THandle>
+	struct Route
+	{
+		THandle handle;
+		uint32_t id;
+		/// @brief the MuteMask slot of the target.
+		uint32_t slot;
+		/// @brief only non null if the owning Echoer is in async mode.
+		AsyncSender* sender;
+		TargetStats* stats;
+		/// @brief null if messages are sent to the target untouched.
+		const TransformTable* transform;
+		/// @brief the shared device of the target, see OutputPool, null if the route does not belong to an Echoer.
+		OutputPort* port = nullptr;
+		/// @brief the index of the owning Echoer in port, passed to OutputPort::push().
+		size_t feeder = 0;
+		/// @brief the notes sounding on the target, updated with every message routed to it, null if notes are not tracked.
+		NoteTracker* notes = nullptr;
+	};
+
+	/// @brief flat, read only array of routes, published to the midi callback through a Snapshot.
+	/// a new table is built every time the targets change, it is never modified after it has been published.
+	template<typename THandle>
+	struct RouteTable
+	{
+		std::vector<Route<THandle>> routes;
+		/// @brief number of MuteMask words needed to cover the slots of all the routes.
+		size_t word_count = 0;
+
+		auto begin() const { return routes.begin(); }
+		auto end() const { return routes.end(); }
+	};
+}
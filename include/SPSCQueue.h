@@ -0,0 +1,99 @@
+#pragma once
+
+#include <atomic>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace EchoMIDI
+{
+	/// @brief size used for padding data shared between threads, so they do not end up on the same cache line.
+	static constexpr size_t CACHE_LINE_SIZE = 64;
+
+	/// @brief bounded lock-free single producer / single consumer ring buffer.
+	///
+	/// exactly one thread may call push(), and exactly one (possibly different) thread may call pop() / popBatch().
+	/// none of the methods allocate or block, which makes it safe to push from a midi driver callback.
+	///
+	/// @tparam T the element type, should be trivially copyable.
+	/// @tparam CAPACITY the maximum number of elements the queue can hold, must be a power of two.
+	template<typename T, size_t CAPACITY>
+	class SPSCQueue
+	{
+		static_assert(CAPACITY >= 2 && (CAPACITY & (CAPACITY - 1)) == 0, "SPSCQueue capacity must be a power of two");
+
+	public:
+		/// @brief pushes a single element to the back of the queue.
+		/// @return false if the queue was full, in which case the element is discarded.
+		bool push(const T& elem)
+		{
+			size_t tail = m_tail.load(std::memory_order_relaxed);
+
+			if (tail - m_cached_head == CAPACITY)
+			{
+				m_cached_head = m_head.load(std::memory_order_acquire);
+
+				if (tail - m_cached_head == CAPACITY)
+					return false;
+			}
+
+			m_buffer[tail & MASK] = elem;
+			m_tail.store(tail + 1, std::memory_order_release);
+
+			return true;
+		}
+
+		/// @brief pops a single element from the front of the queue.
+		/// @return false if the queue was empty, in which case elem is left untouched.
+		bool pop(T& elem)
+		{
+			return popBatch(&elem, 1) == 1;
+		}
+
+		/// @brief pops up to max_count elements into out, in the order they were pushed.
+		/// @return the number of elements written to out.
+		size_t popBatch(T* out, size_t max_count)
+		{
+			size_t head = m_head.load(std::memory_order_relaxed);
+
+			if (m_cached_tail == head)
+				m_cached_tail = m_tail.load(std::memory_order_acquire);
+
+			size_t count = m_cached_tail - head;
+
+			if (count > max_count)
+				count = max_count;
+
+			for (size_t i = 0; i < count; i++)
+				out[i] = m_buffer[(head + i) & MASK];
+
+			m_head.store(head + count, std::memory_order_release);
+
+			return count;
+		}
+
+		/// @brief approximate number of elements currently in the queue.
+		/// only exact when called from the producer or consumer thread while the other side is idle.
+		size_t size() const
+		{
+			return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire);
+		}
+
+		bool empty() const { return size() == 0; }
+
+		static constexpr size_t capacity() { return CAPACITY; }
+
+	private:
+		static constexpr size_t MASK = CAPACITY - 1;
+
+		// consumer owned
+		alignas(CACHE_LINE_SIZE) std::atomic<size_t> m_head = 0;
+		size_t m_cached_tail = 0;
+
+		// producer owned
+		alignas(CACHE_LINE_SIZE) std::atomic<size_t> m_tail = 0;
+		size_t m_cached_head = 0;
+
+		alignas(CACHE_LINE_SIZE) std::array<T, CAPACITY> m_buffer;
+	};
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "SPSCQueue.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace EchoMIDI
+{
+	/// @brief holds an immutable object, which can be replaced atomically while other threads are reading it.
+	///
+	/// readers call read(), which never blocks or allocates, and keep the returned ReadGuard alive for as long as they use the object.
+	/// writers call publish(), which swaps in the new object, and waits until every reader of the old object is done, before deleting it (epoch based reclamation).
+	/// publish() is not reentrant, concurrent writers must be serialized by the caller.
+	/// synchronize() on its own may be called from any thread, concurrently with a writer.
+	///
+	/// readers are tracked by two counters, one per epoch parity.
+	/// a writer flips the epoch twice, waiting for the counter of the previous parity to reach zero each time,
+	/// which guarantees any reader that could have seen the old object has finished, while new readers are never blocked.
+	template<typename T>
+	class Snapshot
+	{
+	public:
+		/// @brief keeps the snapshot it was created from alive until destroyed.
+		class ReadGuard
+		{
+		public:
+			ReadGuard(const T* value, std::atomic<uint32_t>& readers)
+				: m_value(value), m_readers(readers)
+			{}
+
+			~ReadGuard()
+			{
+				m_readers.fetch_sub(1, std::memory_order_release);
+			}
+
+			ReadGuard(const ReadGuard&) = delete;
+			ReadGuard& operator=(const ReadGuard&) = delete;
+
+			const T& operator*() const { return *m_value; }
+			const T* operator->() const { return m_value; }
+
+		private:
+			const T* m_value;
+			std::atomic<uint32_t>& m_readers;
+		};
+
+		/// @brief starts out with a default constructed object, so readers never see a null snapshot.
+		Snapshot()
+			: m_current(new T())
+		{}
+
+		~Snapshot()
+		{
+			delete m_current.load();
+		}
+
+		Snapshot(const Snapshot&) = delete;
+		Snapshot& operator=(const Snapshot&) = delete;
+
+		/// @brief retrieves the current snapshot.
+		/// safe to call from a realtime thread, as it consists of a few atomic operations only.
+		ReadGuard read() const
+		{
+			std::atomic<uint32_t>& readers = m_readers[m_epoch.load() & 1].count;
+
+			readers.fetch_add(1);
+
+			return ReadGuard(m_current.load(), readers);
+		}
+
+		/// @brief replaces the current snapshot with next.
+		/// blocks until no reader is using the previous snapshot anymore, and then deletes it.
+		void publish(std::unique_ptr<T> next)
+		{
+			T* prev = m_current.exchange(next.release());
+
+			synchronize();
+
+			delete prev;
+		}
+
+		/// @brief waits for a grace period, after which every reader that called read() before this call is done.
+		/// used as a barrier, e.g. to make sure no reader still acts on state it loaded alongside the snapshot.
+		void synchronize()
+		{
+			// two grace periods running at once could each skip a parity the other one flipped past.
+			std::lock_guard lock(m_sync_mutex);
+
+			for (int i = 0; i < 2; i++)
+			{
+				std::atomic<uint32_t>& readers = m_readers[m_epoch.fetch_add(1) & 1].count;
+
+				while (readers.load() != 0)
+					std::this_thread::yield();
+			}
+		}
+
+	private:
+		struct alignas(CACHE_LINE_SIZE) ReaderCount
+		{
+			std::atomic<uint32_t> count = 0;
+		};
+
+		std::atomic<T*> m_current;
+		std::mutex m_sync_mutex;
+		mutable std::atomic<uint32_t> m_epoch = 0;
+		mutable ReaderCount m_readers[2];
+	};
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "MuteMask.h"
+
+#include <Windows.h>
+#include <atomic>
+#include <array>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+namespace EchoMIDI
+{
+	/// @brief preallocated arena of prepared midi headers, used for forwarding SysEx messages without any allocation on the midi callback thread.
+	///
+	/// the arena consists of block_count payload blocks of block_size bytes.
+	/// every block has a prepared input header, which is handed to the input device with midiInAddBuffer(),
+	/// and a prepared output header per attached output target, pointing at the same payload.
+	///
+	/// when the input device fills a block, the block is sent to every target through its own output header,
+	/// sharing the payload instead of copying it, and a reference count tracks how many targets are still sending it.
+	/// once the last target reports MOM_DONE, the block is handed back to the input device.
+	///
+	/// SysEx messages larger than block_size are split over multiple consecutive blocks by the driver, and forwarded in order.
+	class SysExPool
+	{
+	public:
+		static constexpr size_t DEFAULT_BLOCK_COUNT = 8;
+		static constexpr size_t DEFAULT_BLOCK_SIZE = 64 * 1024;
+		/// @brief how long detachOutput() waits for queued headers, if the device is not reset.
+		static constexpr std::chrono::milliseconds DETACH_TIMEOUT = std::chrono::milliseconds(1000);
+
+		/// @brief allocates the entire arena up front.
+		SysExPool(size_t block_count = DEFAULT_BLOCK_COUNT, size_t block_size = DEFAULT_BLOCK_SIZE);
+		~SysExPool();
+
+		SysExPool(const SysExPool&) = delete;
+		SysExPool& operator=(const SysExPool&) = delete;
+
+		/// @brief prepares the input headers for the passed device, and hands every free block to it.
+		///
+		/// @throw MIDIEchoExcept
+		void attachInput(HMIDIIN midi_in, UINT id);
+		/// @brief stops handing blocks back to the input device, resets it so it returns every block, and unprepares the input headers.
+		///
+		/// @throw MIDIEchoExcept
+		void detachInput(UINT id);
+
+		/// @brief prepares an output header for every block, for the target at the passed MuteMask slot.
+		///
+		/// @throw MIDIEchoExcept
+		void attachOutput(HMIDIOUT midi_out, uint32_t slot, UINT id);
+		/// @brief resets the output device of the passed slot, so no header is still queued, and unprepares its output headers.
+		/// if reset is false, e.g. because other Echoers still send to the device, see OutputPool, the queued headers of the slot are waited for instead,
+		/// and the device is only reset if they are not done within DETACH_TIMEOUT.
+		///
+		/// @throw MIDIEchoExcept
+		void detachOutput(uint32_t slot, UINT id, bool reset = true);
+
+		/// @brief takes the initial reference to a block returned by the input device.
+		/// must be called from the midi callback, before the block is shared with any target, and released again once all targets have been sent to.
+		void acquire(LPMIDIHDR in_hdr);
+
+		/// @brief adds a reference to the block of the input header, and retrieves the output header of the passed slot, pointing at the same payload.
+		/// if sending the returned header fails, it must be released again.
+		LPMIDIHDR share(LPMIDIHDR in_hdr, uint32_t slot);
+
+		/// @brief checks wether the header points into the arena.
+		/// output devices also report MOM_DONE for headers not owned by the pool, e.g. midi stream buffers.
+		bool owns(LPMIDIHDR hdr) const
+		{
+			return hdr->lpData >= m_payload.get() && hdr->lpData < m_payload.get() + m_block_count * m_block_size;
+		}
+
+		/// @brief retrieves the input header of the block the passed data points into.
+		/// used for mapping the data passed to InputCallbacks::on_long back to its block.
+		LPMIDIHDR getInputHeader(const uint8_t* data)
+		{
+			return &m_in_headers[((const char*)data - m_payload.get()) / m_block_size];
+		}
+
+		/// @brief releases a single reference to the block of the passed input or output header.
+		/// when the last reference is released, the block is handed back to the input device.
+		void release(LPMIDIHDR hdr);
+
+		size_t getBlockCount() const { return m_block_count; }
+		size_t getBlockSize() const { return m_block_size; }
+
+		/// @brief number of blocks that were filled completely, meaning a SysEx message was split over multiple blocks.
+		/// if this happens often, a larger block size should be used.
+		size_t getFullBlockCount() const { return m_full_blocks.load(std::memory_order_relaxed); }
+
+	private:
+		size_t m_block_count;
+		size_t m_block_size;
+
+		std::unique_ptr<char[]> m_payload;
+		std::unique_ptr<std::atomic<uint32_t>[]> m_ref_counts;
+
+		// dwUser of every header holds the index of its block.
+		std::vector<MIDIHDR> m_in_headers;
+		std::array<std::unique_ptr<MIDIHDR[]>, MuteMask::MAX_TARGETS> m_out_headers;
+		std::array<HMIDIOUT, MuteMask::MAX_TARGETS> m_out_handles = {};
+
+		// NULL whenever blocks should not be handed back to an input device.
+		std::atomic<HMIDIIN> m_midi_in = NULL;
+		HMIDIIN m_prepared_in = NULL;
+
+		std::atomic<size_t> m_full_blocks = 0;
+	};
+}
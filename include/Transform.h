@@ -0,0 +1,115 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+namespace EchoMIDI
+{
+	/// @brief per target lookup tables, compiled from a set of TransformRules.
+	///
+	/// applying the table to a short midi message costs a filter lookup and a few table lookups,
+	/// no matter how many rules it was compiled from.
+	struct TransformTable
+	{
+		/// @brief one bit per status byte, a message only passes if the bit of its status byte is set.
+		std::array<uint64_t, 4> status_mask;
+		/// @brief output channel of every input channel.
+		std::array<uint8_t, 16> channel_map;
+		/// @brief output note of every input note, NOTE_DROPPED if the note should not pass.
+		std::array<uint8_t, 128> note_map;
+		/// @brief output velocity of every note on velocity.
+		std::array<uint8_t, 128> velocity_map;
+
+		static constexpr uint8_t NOTE_DROPPED = 0xFF;
+
+		/// @brief checks wether the status byte passes the filter.
+		bool passes(uint8_t status) const
+		{
+			return status_mask[status >> 6] >> (status & 63) & 1;
+		}
+
+		/// @brief applies the table to a packed short midi message.
+		/// @return false if the message should not be sent at all.
+		bool apply(uint32_t& msg) const
+		{
+			uint8_t status = msg & 0xFF;
+
+			if (!passes(status))
+				return false;
+
+			// system messages have no channel or note, and are left untouched.
+			if (status >= 0xF0)
+				return true;
+
+			uint8_t type = status & 0xF0;
+			uint8_t data_1 = msg >> 8 & 0x7F;
+			uint8_t data_2 = msg >> 16 & 0x7F;
+
+			// note off, note on and poly aftertouch all carry a note number.
+			if (type <= 0xA0)
+			{
+				data_1 = note_map[data_1];
+
+				if (data_1 == NOTE_DROPPED)
+					return false;
+			}
+
+			// a note on with 0 velocity is a note off, and velocity_map never maps to 0.
+			if (type == 0x90 && data_2 != 0)
+				data_2 = velocity_map[data_2];
+
+			msg = (uint32_t)data_2 << 16 | (uint32_t)data_1 << 8 | type | channel_map[status & 0x0F];
+
+			return true;
+		}
+	};
+
+	/// @brief user facing description of how messages are transformed, before they are sent to a target.
+	/// rules are compiled into a TransformTable, which is what the midi callback actually uses.
+	struct TransformRules
+	{
+		/// @brief bits of type_mask, one per message type.
+		enum MessageType : uint8_t
+		{
+			NOTE_OFF = 1 << 0,
+			NOTE_ON = 1 << 1,
+			POLY_AFTERTOUCH = 1 << 2,
+			CONTROL_CHANGE = 1 << 3,
+			PROGRAM_CHANGE = 1 << 4,
+			CHANNEL_PRESSURE = 1 << 5,
+			PITCH_BEND = 1 << 6,
+			/// @brief SysEx, clock, transport and other system messages.
+			SYSTEM = 1 << 7,
+			ALL_TYPES = 0xFF
+		};
+
+		/// @brief output channel (0 - 15) of every input channel.
+		std::array<uint8_t, 16> channel_map = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 };
+		/// @brief input channels that pass, bit n corresponds to channel n.
+		uint16_t channel_mask = 0xFFFF;
+		/// @brief message types that pass, see MessageType.
+		uint8_t type_mask = ALL_TYPES;
+
+		/// @brief lowest input note that passes, used for keyboard splits.
+		uint8_t note_low = 0;
+		/// @brief highest input note that passes, used for keyboard splits.
+		uint8_t note_high = 127;
+		/// @brief semitones added to every passing note, notes transposed outside 0 - 127 are dropped.
+		int8_t transpose = 0;
+
+		/// @brief exponent of the velocity curve, values below 1 make soft playing louder, values above 1 make it softer.
+		float velocity_curve = 1;
+		/// @brief lowest note on velocity sent, must be at least 1.
+		uint8_t velocity_min = 1;
+		/// @brief highest note on velocity sent.
+		uint8_t velocity_max = 127;
+
+		/// @brief checks wether the rules leave every message untouched.
+		bool isIdentity() const;
+
+		/// @brief compiles the rules into lookup tables.
+		TransformTable compile() const;
+
+		bool operator==(const TransformRules&) const = default;
+	};
+}
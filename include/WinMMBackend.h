@@ -0,0 +1,51 @@
+#pragma once
+
+#include "MidiBackend.h"
+
+#include <Windows.h>
+
+namespace EchoMIDI
+{
+	/// @brief MidiBackend using the windows multimedia api (winmm).
+	///
+	/// SysEx is only recieved once buffers have been added to the input, which is done by the SysExPool.
+	/// the data passed to InputCallbacks::on_long points into these buffers, and stays valid until the buffer is added to the input again.
+	class WinMMBackend
+	{
+	public:
+		using InputHandle = HMIDIIN;
+		using OutputHandle = HMIDIOUT;
+
+		static constexpr size_t MAX_NAME_LENGTH = MAXPNAMELEN;
+
+		static UINT getInputCount() { return midiInGetNumDevs(); }
+		static UINT getOutputCount() { return midiOutGetNumDevs(); }
+
+		static MMRESULT getInputName(UINT id, std::string& name);
+		static MMRESULT getOutputName(UINT id, std::string& name);
+
+		static MMRESULT openInput(InputHandle& handle, UINT id, const InputCallbacks& callbacks);
+		static MMRESULT startInput(InputHandle handle) { return midiInStart(handle); }
+		static MMRESULT stopInput(InputHandle handle) { return midiInStop(handle); }
+		static MMRESULT resetInput(InputHandle handle) { return midiInReset(handle); }
+		static MMRESULT closeInput(InputHandle handle) { return midiInClose(handle); }
+
+		/// @brief the output callback only wakes sendLong() up, see waitDone().
+		static MMRESULT openOutput(OutputHandle& handle, UINT id);
+		static MMRESULT closeOutput(OutputHandle handle) { return midiOutClose(handle); }
+
+		static MMRESULT sendShort(OutputHandle handle, uint32_t msg) { return midiOutShortMsg(handle, msg); }
+		/// @brief blocks until the driver is done with the message, as the header must stay prepared until then.
+		/// the Echoer forwards SysEx through the SysExPool instead, which never blocks.
+		static MMRESULT sendLong(OutputHandle handle, const uint8_t* data, size_t length);
+		/// @brief winmm has no batched short message call, see AsyncSender for batching through midi streams.
+		static MMRESULT sendBatch(OutputHandle handle, const uint32_t* msgs, size_t count);
+
+		/// @brief sleeps until the driver is done with a header passed to midiOutLongMsg() or midiStreamOut().
+		/// the output callback of the device must call notifyDone() on MOM_DONE, like the one of OutputPort.
+		static void waitDone(const MIDIHDR& hdr);
+		/// @brief wakes the threads waiting for the header in waitDone().
+		/// only the address of the header is used, so the header may already be gone.
+		static void notifyDone(LPMIDIHDR hdr) { WakeByAddressAll(&hdr->dwFlags); }
+	};
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace EchoMIDI
+{
+	/// @brief default maximum number of threads used by runParallel().
+	/// opening a device is mostly spent waiting on the driver, so this is not tied to the number of cores.
+	static constexpr size_t DEFAULT_WORKER_COUNT = 8;
+
+	/// @brief calls job(index) for every index in [0, count), spread over up to worker_count short lived threads, and waits for all of them.
+	/// the calling thread is one of the workers, so a single job never starts a thread.
+	///
+	/// once a job throws, the jobs that have not started yet are skipped, and the first exception is rethrown once every worker is done.
+	/// the caller is responsible for undoing the jobs that did run.
+	template<typename TJob>
+	void runParallel(size_t count, TJob job, size_t worker_count = DEFAULT_WORKER_COUNT)
+	{
+		std::atomic<size_t> next_index = 0;
+		std::atomic<bool> failed = false;
+
+		std::mutex err_mutex;
+		std::exception_ptr err;
+
+		auto work = [&]()
+		{
+			while (!failed.load(std::memory_order_relaxed))
+			{
+				size_t index = next_index.fetch_add(1, std::memory_order_relaxed);
+
+				if (index >= count)
+					return;
+
+				try
+				{
+					job(index);
+				}
+				catch (...)
+				{
+					std::lock_guard lock(err_mutex);
+
+					if (!err)
+						err = std::current_exception();
+
+					failed.store(true, std::memory_order_relaxed);
+				}
+			}
+		};
+
+		std::vector<std::thread> workers;
+		size_t thread_count = std::min(count, std::max<size_t>(worker_count, 1));
+
+		for (size_t i = 1; i < thread_count; i++)
+		{
+			// running out of threads only means fewer workers, the jobs still run on the remaining ones.
+			try
+			{
+				workers.emplace_back(work);
+			}
+			catch (const std::system_error&)
+			{
+				break;
+			}
+		}
+
+		work();
+
+		for (std::thread& worker : workers)
+			worker.join();
+
+		if (err)
+			std::rethrow_exception(err);
+	}
+}
@@ -0,0 +1,483 @@
+#include "AlsaBackend.h"
+#include "LatencyHistogram.h"
+#include "Realtime.h"
+
+#include <alsa/asoundlib.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cerrno>
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace EchoMIDI
+{
+	// ============ Local defines ============
+
+	struct AlsaBackend::Input
+	{
+		snd_seq_t* seq = nullptr;
+		snd_midi_event_t* decoder = nullptr;
+		const InputCallbacks* callbacks = nullptr;
+
+		std::thread thread;
+		// written to by closeInput(), so the thread sleeps in poll() until an event arrives, or the input is closed.
+		int wake_pipe[2] = { -1, -1 };
+		std::atomic<bool> running = true;
+		std::atomic<bool> started = false;
+		std::atomic<int64_t> start_time = 0;
+	};
+
+	struct AlsaBackend::Output
+	{
+		snd_seq_t* seq = nullptr;
+		int port = -1;
+		snd_midi_event_t* encoder = nullptr;
+		// the encoder and the output buffer are not thread safe, but an output may be shared by the threads of several Echoers, see OutputPool.
+		// the client is nonblocking, so sends are short, and a contending thread only sleeps on the flag until the other send returns.
+		std::atomic_flag busy;
+	};
+
+	// holds the busy flag of an output for the duration of a send.
+	class AlsaOutputLock
+	{
+	public:
+		AlsaOutputLock(AlsaBackend::Output& output)
+			: m_output(output)
+		{
+			while (m_output.busy.test_and_set(std::memory_order_acquire))
+				m_output.busy.wait(true, std::memory_order_relaxed);
+		}
+
+		~AlsaOutputLock()
+		{
+			m_output.busy.clear(std::memory_order_release);
+			m_output.busy.notify_one();
+		}
+
+	private:
+		AlsaBackend::Output& m_output;
+	};
+
+	static constexpr unsigned int ALSA_INPUT_CAPS = SND_SEQ_PORT_CAP_READ | SND_SEQ_PORT_CAP_SUBS_READ;
+	static constexpr unsigned int ALSA_OUTPUT_CAPS = SND_SEQ_PORT_CAP_WRITE | SND_SEQ_PORT_CAP_SUBS_WRITE;
+
+	// ports of EchoMIDI itself are created with SND_SEQ_PORT_CAP_NO_EXPORT, so they are never listed as devices.
+	static constexpr unsigned int ALSA_OWN_PORT_TYPE = SND_SEQ_PORT_TYPE_MIDI_GENERIC | SND_SEQ_PORT_TYPE_APPLICATION;
+
+	// a single sequencer client is used for listing devices, it is opened on first use.
+	std::mutex alsa_query_mutex;
+	snd_seq_t* alsa_query_seq = nullptr;
+
+	// calls func(index, addr, name) for every port with all of the passed capabilities, until func returns true.
+	template<typename TFunc>
+	MMRESULT forEachAlsaPort(unsigned int caps, TFunc func)
+	{
+		std::lock_guard lock(alsa_query_mutex);
+
+		if (alsa_query_seq == nullptr && snd_seq_open(&alsa_query_seq, "default", SND_SEQ_OPEN_DUPLEX, 0) < 0)
+		{
+			alsa_query_seq = nullptr;
+			return MMSYSERR_NODRIVER;
+		}
+
+		snd_seq_client_info_t* client_info;
+		snd_seq_port_info_t* port_info;
+
+		snd_seq_client_info_alloca(&client_info);
+		snd_seq_port_info_alloca(&port_info);
+
+		snd_seq_client_info_set_client(client_info, -1);
+
+		UINT index = 0;
+
+		while (snd_seq_query_next_client(alsa_query_seq, client_info) >= 0)
+		{
+			int client = snd_seq_client_info_get_client(client_info);
+
+			// the system client only holds the timer and announce ports.
+			if (client == SND_SEQ_CLIENT_SYSTEM)
+				continue;
+
+			snd_seq_port_info_set_client(port_info, client);
+			snd_seq_port_info_set_port(port_info, -1);
+
+			while (snd_seq_query_next_port(alsa_query_seq, port_info) >= 0)
+			{
+				unsigned int port_caps = snd_seq_port_info_get_capability(port_info);
+
+				if ((port_caps & caps) != caps || (port_caps & SND_SEQ_PORT_CAP_NO_EXPORT))
+					continue;
+
+				if (func(index++, *snd_seq_port_info_get_addr(port_info), snd_seq_port_info_get_name(port_info)))
+					return MMSYSERR_NOERROR;
+			}
+		}
+
+		return MMSYSERR_NOERROR;
+	}
+
+	UINT countAlsaPorts(unsigned int caps)
+	{
+		UINT count = 0;
+
+		forEachAlsaPort(caps, [&](UINT, const snd_seq_addr_t&, const char*) { count++; return false; });
+
+		return count;
+	}
+
+	MMRESULT findAlsaPort(UINT id, unsigned int caps, snd_seq_addr_t* addr, std::string* name)
+	{
+		bool found = false;
+
+		MMRESULT res = forEachAlsaPort(caps, [&](UINT index, const snd_seq_addr_t& port_addr, const char* port_name)
+			{
+				if (index != id)
+					return false;
+
+				if (addr)
+					*addr = port_addr;
+
+				if (name)
+					*name = port_name;
+
+				found = true;
+
+				return true;
+			});
+
+		if (res != MMSYSERR_NOERROR)
+			return res;
+
+		return found ? MMSYSERR_NOERROR : MMSYSERR_BADDEVICEID;
+	}
+
+	// opens a sequencer client with a single port of its own, for a single input or output.
+	MMRESULT openAlsaClient(snd_seq_t*& seq, int& port, int stream, int mode, const char* port_name, unsigned int caps)
+	{
+		if (snd_seq_open(&seq, "default", stream, mode) < 0)
+		{
+			seq = nullptr;
+			return MMSYSERR_NODRIVER;
+		}
+
+		snd_seq_set_client_name(seq, "EchoMIDI");
+
+		port = snd_seq_create_simple_port(seq, port_name, caps | SND_SEQ_PORT_CAP_NO_EXPORT, ALSA_OWN_PORT_TYPE);
+
+		if (port < 0)
+		{
+			snd_seq_close(seq);
+			seq = nullptr;
+
+			return MMSYSERR_ERROR;
+		}
+
+		return MMSYSERR_NOERROR;
+	}
+
+	// maps the result of writing events to an output, -EAGAIN means the sequencer had no room for them, they are dropped.
+	MMRESULT getAlsaOutputResult(int res)
+	{
+		if (res == -EAGAIN)
+			return MIDIERR_NOTREADY;
+
+		return res < 0 ? MMSYSERR_ERROR : MMSYSERR_NOERROR;
+	}
+
+	// fills ev with the packed short message, addressed to every subscriber of the output port.
+	bool encodeAlsaEvent(AlsaBackend::Output& output, uint32_t msg, snd_seq_event_t& ev)
+	{
+		uint8_t bytes[3] = { (uint8_t)(msg & 0xFF), (uint8_t)(msg >> 8 & 0xFF), (uint8_t)(msg >> 16 & 0xFF) };
+
+		snd_seq_ev_clear(&ev);
+		snd_midi_event_reset_encode(output.encoder);
+
+		if (snd_midi_event_encode(output.encoder, bytes, (long)getShortMessageLength(bytes[0]), &ev) <= 0 || ev.type == SND_SEQ_EVENT_NONE)
+			return false;
+
+		snd_seq_ev_set_source(&ev, output.port);
+		snd_seq_ev_set_subs(&ev);
+		snd_seq_ev_set_direct(&ev);
+
+		return true;
+	}
+
+	void alsaInputThread(AlsaBackend::Input* input)
+	{
+		// the last descriptor is the read end of the wake pipe.
+		std::vector<pollfd> fds(snd_seq_poll_descriptors_count(input->seq, POLLIN));
+		snd_seq_poll_descriptors(input->seq, fds.data(), (unsigned int)fds.size(), POLLIN);
+		fds.push_back({ input->wake_pipe[0], POLLIN, 0 });
+
+		while (input->running.load(std::memory_order_acquire))
+		{
+			updateThreadRealtime();
+
+			if (poll(fds.data(), fds.size(), -1) < 0)
+			{
+				if (errno == EINTR)
+					continue;
+
+				break;
+			}
+
+			snd_seq_event_t* ev;
+			int res;
+
+			// -ENOSPC means events were lost because the input buffer overran, reading can continue right away.
+			while ((res = snd_seq_event_input(input->seq, &ev)) >= 0 || res == -ENOSPC)
+			{
+				if (res < 0 || !input->started.load(std::memory_order_acquire))
+					continue;
+
+				DWORD timestamp = (DWORD)((latencyNow() - input->start_time.load(std::memory_order_relaxed)) / 1'000'000);
+				const InputCallbacks& callbacks = *input->callbacks;
+
+				if (ev->type == SND_SEQ_EVENT_SYSEX)
+				{
+					callbacks.on_long(callbacks.user, (const uint8_t*)ev->data.ext.ptr, ev->data.ext.len, timestamp);
+				}
+				else
+				{
+					uint8_t bytes[3] = {};
+
+					// events without a midi representation, like port announcements, decode to nothing.
+					if (snd_midi_event_decode(input->decoder, bytes, sizeof(bytes), ev) > 0)
+						callbacks.on_short(callbacks.user, (uint32_t)bytes[0] | (uint32_t)bytes[1] << 8 | (uint32_t)bytes[2] << 16, timestamp);
+				}
+			}
+		}
+	}
+
+	// ============ AlsaBackend ============
+
+	UINT AlsaBackend::getInputCount()
+	{
+		return countAlsaPorts(ALSA_INPUT_CAPS);
+	}
+
+	UINT AlsaBackend::getOutputCount()
+	{
+		return countAlsaPorts(ALSA_OUTPUT_CAPS);
+	}
+
+	MMRESULT AlsaBackend::getInputName(UINT id, std::string& name)
+	{
+		return findAlsaPort(id, ALSA_INPUT_CAPS, nullptr, &name);
+	}
+
+	MMRESULT AlsaBackend::getOutputName(UINT id, std::string& name)
+	{
+		return findAlsaPort(id, ALSA_OUTPUT_CAPS, nullptr, &name);
+	}
+
+	MMRESULT AlsaBackend::openInput(InputHandle& handle, UINT id, const InputCallbacks& callbacks)
+	{
+		snd_seq_addr_t source;
+		MMRESULT res = findAlsaPort(id, ALSA_INPUT_CAPS, &source, nullptr);
+
+		if (res != MMSYSERR_NOERROR)
+			return res;
+
+		Input* input = new Input();
+		input->callbacks = &callbacks;
+
+		int port;
+		res = openAlsaClient(input->seq, port, SND_SEQ_OPEN_INPUT, SND_SEQ_NONBLOCK, "EchoMIDI Input", SND_SEQ_PORT_CAP_WRITE | SND_SEQ_PORT_CAP_SUBS_WRITE);
+
+		if (res == MMSYSERR_NOERROR && snd_seq_connect_from(input->seq, port, source.client, source.port) < 0)
+			res = MMSYSERR_ALLOCATED;
+
+		if (res == MMSYSERR_NOERROR && snd_midi_event_new(16, &input->decoder) < 0)
+			res = MMSYSERR_NOMEM;
+
+		if (res == MMSYSERR_NOERROR && pipe(input->wake_pipe) != 0)
+			res = MMSYSERR_ERROR;
+
+		if (res != MMSYSERR_NOERROR)
+		{
+			closeInput(input);
+			return res;
+		}
+
+		// running status would leave out the status byte of repeated messages.
+		snd_midi_event_no_status(input->decoder, 1);
+
+		input->thread = std::thread(alsaInputThread, input);
+		handle = input;
+
+		return MMSYSERR_NOERROR;
+	}
+
+	MMRESULT AlsaBackend::startInput(InputHandle handle)
+	{
+		if (handle == nullptr)
+			return MMSYSERR_INVALHANDLE;
+
+		// timestamps restart at 0 every time the input is started, like winmm.
+		handle->start_time.store(latencyNow(), std::memory_order_relaxed);
+		handle->started.store(true, std::memory_order_release);
+
+		return MMSYSERR_NOERROR;
+	}
+
+	MMRESULT AlsaBackend::stopInput(InputHandle handle)
+	{
+		if (handle == nullptr)
+			return MMSYSERR_INVALHANDLE;
+
+		handle->started.store(false, std::memory_order_release);
+
+		return MMSYSERR_NOERROR;
+	}
+
+	MMRESULT AlsaBackend::resetInput(InputHandle handle)
+	{
+		if (handle == nullptr)
+			return MMSYSERR_INVALHANDLE;
+
+		return snd_seq_drop_input(handle->seq) < 0 ? MMSYSERR_ERROR : MMSYSERR_NOERROR;
+	}
+
+	MMRESULT AlsaBackend::closeInput(InputHandle handle)
+	{
+		if (handle == nullptr)
+			return MMSYSERR_INVALHANDLE;
+
+		handle->running.store(false, std::memory_order_release);
+
+		char wake = 0;
+
+		// the pipe is empty, so the write cannot fail or block.
+		if (handle->wake_pipe[1] >= 0)
+		{
+			[[maybe_unused]] ssize_t written = write(handle->wake_pipe[1], &wake, 1);
+		}
+
+		if (handle->thread.joinable())
+			handle->thread.join();
+
+		if (handle->wake_pipe[0] >= 0)
+		{
+			close(handle->wake_pipe[0]);
+			close(handle->wake_pipe[1]);
+		}
+
+		if (handle->decoder)
+			snd_midi_event_free(handle->decoder);
+
+		if (handle->seq)
+			snd_seq_close(handle->seq);
+
+		delete handle;
+
+		return MMSYSERR_NOERROR;
+	}
+
+	MMRESULT AlsaBackend::openOutput(OutputHandle& handle, UINT id)
+	{
+		snd_seq_addr_t dest;
+		MMRESULT res = findAlsaPort(id, ALSA_OUTPUT_CAPS, &dest, nullptr);
+
+		if (res != MMSYSERR_NOERROR)
+			return res;
+
+		Output* output = new Output();
+
+		// nonblocking, a full sequencer fails the send, instead of stalling the midi callback or sender thread, and every thread waiting on the output lock.
+		res = openAlsaClient(output->seq, output->port, SND_SEQ_OPEN_OUTPUT, SND_SEQ_NONBLOCK, "EchoMIDI Output", SND_SEQ_PORT_CAP_READ | SND_SEQ_PORT_CAP_SUBS_READ);
+
+		if (res == MMSYSERR_NOERROR && snd_seq_connect_to(output->seq, output->port, dest.client, dest.port) < 0)
+			res = MMSYSERR_ALLOCATED;
+
+		if (res == MMSYSERR_NOERROR && snd_midi_event_new(16, &output->encoder) < 0)
+			res = MMSYSERR_NOMEM;
+
+		if (res != MMSYSERR_NOERROR)
+		{
+			closeOutput(output);
+			return res;
+		}
+
+		handle = output;
+
+		return MMSYSERR_NOERROR;
+	}
+
+	MMRESULT AlsaBackend::closeOutput(OutputHandle handle)
+	{
+		if (handle == nullptr)
+			return MMSYSERR_INVALHANDLE;
+
+		if (handle->encoder)
+			snd_midi_event_free(handle->encoder);
+
+		if (handle->seq)
+		{
+			// events still in the output buffer are sent, before the client goes away, waiting for room in the sequencer if needed.
+			snd_seq_nonblock(handle->seq, 0);
+			snd_seq_drain_output(handle->seq);
+			snd_seq_close(handle->seq);
+		}
+
+		delete handle;
+
+		return MMSYSERR_NOERROR;
+	}
+
+	MMRESULT AlsaBackend::sendShort(OutputHandle handle, uint32_t msg)
+	{
+		AlsaOutputLock lock(*handle);
+		snd_seq_event_t ev;
+
+		if (!encodeAlsaEvent(*handle, msg, ev))
+			return MMSYSERR_INVALPARAM;
+
+		return getAlsaOutputResult(snd_seq_event_output_direct(handle->seq, &ev));
+	}
+
+	MMRESULT AlsaBackend::sendLong(OutputHandle handle, const uint8_t* data, size_t length)
+	{
+		AlsaOutputLock lock(*handle);
+		snd_seq_event_t ev;
+
+		snd_seq_ev_clear(&ev);
+		snd_seq_ev_set_sysex(&ev, (unsigned int)length, (void*)data);
+		snd_seq_ev_set_source(&ev, handle->port);
+		snd_seq_ev_set_subs(&ev);
+		snd_seq_ev_set_direct(&ev);
+
+		return getAlsaOutputResult(snd_seq_event_output_direct(handle->seq, &ev));
+	}
+
+	MMRESULT AlsaBackend::sendBatch(OutputHandle handle, const uint32_t* msgs, size_t count)
+	{
+		AlsaOutputLock lock(*handle);
+		MMRESULT res = MMSYSERR_NOERROR;
+		snd_seq_event_t ev;
+		int buffered;
+
+		// events are only buffered here, the buffer is written to the sequencer in a single call once the batch is complete.
+		for (size_t i = 0; i < count; i++)
+		{
+			if (!encodeAlsaEvent(*handle, msgs[i], ev))
+				res = MMSYSERR_INVALPARAM;
+			else if ((buffered = snd_seq_event_output_buffer(handle->seq, &ev)) < 0)
+				res = getAlsaOutputResult(buffered);
+		}
+
+		int drained = snd_seq_drain_output(handle->seq);
+
+		// events the sequencer had no room for are dropped, rather than sent late, ahead of the next direct send.
+		if (drained < 0)
+		{
+			snd_seq_drop_output_buffer(handle->seq);
+			res = getAlsaOutputResult(drained);
+		}
+
+		return res;
+	}
+}
@@ -0,0 +1,321 @@
+#include "AsyncSender.h"
+#include "Echoer.h"
+#include "Realtime.h"
+
+namespace EchoMIDI
+{
+	// ============ Local defines ============
+
+	// defined in Echoer.cpp
+	void handleOutputErr(MMRESULT err, UINT id);
+
+	// ============ AsyncSender ============
+
+#ifdef ECHOMIDI_BACKEND_WINMM
+	AsyncSender::AsyncSender(Echoer& echoer, HMIDIOUT device_handle, UINT device_id, uint32_t slot, TargetStats& stats, HMIDISTRM stream_handle, std::chrono::microseconds batch_window)
+		: m_echoer(echoer), m_device_handle(device_handle), m_device_id(device_id), m_slot(slot), m_stats(stats),
+		m_batch_window(batch_window), m_stream_handle(stream_handle)
+	{
+		if (isBatched())
+		{
+			for (StreamBuffer& buffer : m_stream_buffers)
+			{
+				buffer.hdr.lpData = (LPSTR)buffer.events;
+				buffer.hdr.dwBufferLength = sizeof(buffer.events);
+
+				handleOutputErr(midiOutPrepareHeader(m_device_handle, &buffer.hdr, sizeof(MIDIHDR)), device_id);
+			}
+		}
+
+		prefaultBuffers();
+
+		// the thread is started last, so every member is initialized before run() reads them.
+		m_thread = std::thread(&AsyncSender::run, this);
+	}
+#else
+	AsyncSender::AsyncSender(Echoer& echoer, Backend::OutputHandle device_handle, UINT device_id, uint32_t slot, TargetStats& stats, std::chrono::microseconds batch_window)
+		: m_echoer(echoer), m_device_handle(device_handle), m_device_id(device_id), m_slot(slot), m_stats(stats),
+		m_batch_window(batch_window)
+	{
+		prefaultBuffers();
+
+		m_thread = std::thread(&AsyncSender::run, this);
+	}
+#endif
+
+	AsyncSender::~AsyncSender()
+	{
+		m_running.store(false, std::memory_order_release);
+
+		m_signal.fetch_add(1, std::memory_order_release);
+		m_signal.notify_one();
+
+		m_thread.join();
+
+#ifdef ECHOMIDI_BACKEND_WINMM
+		// the sender thread waits for all stream buffers to be done, before it exits.
+		if (isBatched())
+		{
+			for (StreamBuffer& buffer : m_stream_buffers)
+				midiOutUnprepareHeader(m_device_handle, &buffer.hdr, sizeof(MIDIHDR));
+		}
+#endif
+	}
+
+	bool AsyncSender::push(DWORD msg, DWORD timestamp, int64_t received)
+	{
+		if (!m_queue.push({ msg, timestamp, received }))
+		{
+			m_drop_count.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+
+		m_signal.fetch_add(1, std::memory_order_release);
+		m_signal.notify_one();
+
+		return true;
+	}
+
+	void AsyncSender::run()
+	{
+		if (isBatched())
+		{
+			runBatched();
+			return;
+		}
+
+		Message batch[BATCH_SIZE];
+
+		while (true)
+		{
+			updateThreadRealtime();
+
+			// read the signal before draining, so a push happening after the drain always wakes the thread up again.
+			uint32_t signal = m_signal.load(std::memory_order_acquire);
+
+			size_t count;
+
+			while ((count = popBatch(batch)) > 0)
+			{
+				for (size_t i = 0; i < count; i++)
+				{
+					MMRESULT res = Backend::sendShort(m_device_handle, batch[i].msg);
+
+					if (res == MMSYSERR_NOERROR)
+					{
+						m_sent_count.fetch_add(1, std::memory_order_relaxed);
+						m_submit_count.fetch_add(1, std::memory_order_relaxed);
+						m_stats.countSent(1, getShortMessageLength(batch[i].msg & 0xFF));
+					}
+
+					handleResult(res, batch[i].timestamp);
+					m_echoer.recordSent(m_stats, batch[i].timestamp, batch[i].received);
+				}
+			}
+
+			sendReleases();
+
+			if (!m_running.load(std::memory_order_acquire))
+				break;
+
+			m_signal.wait(signal, std::memory_order_acquire);
+		}
+	}
+
+#ifdef ECHOMIDI_BACKEND_WINMM
+	void AsyncSender::runBatched()
+	{
+		// the default timer resolution is far too coarse for millisecond batch windows.
+		timeBeginPeriod(1);
+
+		Message batch[BATCH_SIZE];
+		size_t next_buffer = 0;
+
+		while (true)
+		{
+			updateThreadRealtime();
+
+			uint32_t signal = m_signal.load(std::memory_order_acquire);
+
+			if (m_queue.empty())
+			{
+				sendReleases();
+
+				if (!m_running.load(std::memory_order_acquire))
+					break;
+
+				m_signal.wait(signal, std::memory_order_acquire);
+				continue;
+			}
+
+			// let the window fill up, unless there already is a full batch waiting.
+			if (m_queue.size() < BATCH_SIZE && m_running.load(std::memory_order_acquire))
+				std::this_thread::sleep_for(m_batch_window);
+
+			StreamBuffer& buffer = m_stream_buffers[next_buffer];
+			next_buffer = (next_buffer + 1) % STREAM_BUFFER_COUNT;
+
+			// the driver sets MHDR_DONE once it has played the buffer, after which it can be reused.
+			if (buffer.queued)
+				Backend::waitDone(buffer.hdr);
+
+			size_t count = popBatch(batch);
+
+			// all events have a delta time of 0, so they are played as soon as the driver recieves the buffer.
+			for (size_t i = 0; i < count; i++)
+			{
+				buffer.events[i * 3 + 0] = 0;
+				buffer.events[i * 3 + 1] = 0;
+				buffer.events[i * 3 + 2] = ((DWORD)MEVT_SHORTMSG << 24) | (batch[i].msg & 0x00FFFFFF);
+			}
+
+			buffer.hdr.dwBytesRecorded = (DWORD)(count * 3 * sizeof(DWORD));
+
+			MMRESULT res = midiStreamOut(m_stream_handle, &buffer.hdr, sizeof(MIDIHDR));
+
+			buffer.queued = res == MMSYSERR_NOERROR;
+
+			if (buffer.queued)
+			{
+				m_sent_count.fetch_add(count, std::memory_order_relaxed);
+				m_submit_count.fetch_add(1, std::memory_order_relaxed);
+				m_stats.countSent(count, countBytes(batch, count));
+
+				// every message of the batch is handed to the driver at the same time.
+				for (size_t i = 0; i < count; i++)
+					m_echoer.recordSent(m_stats, batch[i].timestamp, batch[i].received);
+			}
+
+			handleResult(res, batch[0].timestamp);
+		}
+
+		// the buffers cannot be unprepared before the driver is done with them.
+		for (StreamBuffer& buffer : m_stream_buffers)
+		{
+			if (buffer.queued)
+				Backend::waitDone(buffer.hdr);
+		}
+
+		timeEndPeriod(1);
+	}
+#else
+	void AsyncSender::runBatched()
+	{
+		Message batch[BATCH_SIZE];
+		uint32_t msgs[BATCH_SIZE];
+
+		while (true)
+		{
+			updateThreadRealtime();
+
+			uint32_t signal = m_signal.load(std::memory_order_acquire);
+
+			if (m_queue.empty())
+			{
+				sendReleases();
+
+				if (!m_running.load(std::memory_order_acquire))
+					break;
+
+				m_signal.wait(signal, std::memory_order_acquire);
+				continue;
+			}
+
+			// let the window fill up, unless there already is a full batch waiting.
+			if (m_queue.size() < BATCH_SIZE && m_running.load(std::memory_order_acquire))
+				std::this_thread::sleep_for(m_batch_window);
+
+			size_t count = popBatch(batch);
+
+			for (size_t i = 0; i < count; i++)
+				msgs[i] = batch[i].msg;
+
+			MMRESULT res = Backend::sendBatch(m_device_handle, msgs, count);
+
+			// a failed batch is reported through handleResult(), and never counts as sent.
+			if (res == MMSYSERR_NOERROR)
+			{
+				m_sent_count.fetch_add(count, std::memory_order_relaxed);
+				m_submit_count.fetch_add(1, std::memory_order_relaxed);
+				m_stats.countSent(count, countBytes(batch, count));
+			}
+
+			for (size_t i = 0; i < count; i++)
+				m_echoer.recordSent(m_stats, batch[i].timestamp, batch[i].received);
+
+			handleResult(res, batch[0].timestamp);
+		}
+	}
+#endif
+
+	void AsyncSender::releaseNotes(NoteTracker& notes)
+	{
+		m_release.store(&notes, std::memory_order_release);
+
+		m_signal.fetch_add(1, std::memory_order_release);
+		m_signal.notify_one();
+	}
+
+	void AsyncSender::sendReleases()
+	{
+		NoteTracker* notes = m_release.exchange(nullptr, std::memory_order_acquire);
+
+		if (notes == nullptr)
+			return;
+
+#ifdef ECHOMIDI_BACKEND_WINMM
+		// short messages are sent right away, and would overtake the stream buffers the driver has yet to play.
+		for (StreamBuffer& buffer : m_stream_buffers)
+		{
+			if (buffer.queued)
+				Backend::waitDone(buffer.hdr);
+		}
+#endif
+
+		// errors are ignored, a target that cannot be sent to has no sounding notes either.
+		notes->release([&](uint32_t msg) { Backend::sendShort(m_device_handle, msg); });
+	}
+
+	void AsyncSender::prefaultBuffers()
+	{
+		RealtimeConfig config = getRealtimeConfig();
+
+		// the queue and stream buffers are part of the sender itself.
+		if (config.enabled && config.prefault)
+			prefault(this, sizeof(AsyncSender));
+	}
+
+	size_t AsyncSender::popBatch(Message* batch)
+	{
+		size_t count = m_queue.popBatch(batch, BATCH_SIZE);
+
+		if (count < 2 || !m_coalesce.load(std::memory_order_relaxed))
+			return count;
+
+		size_t coalesced_count = m_coalescer.coalesce(batch, count);
+
+		if (coalesced_count != count)
+			m_coalesced_count.fetch_add(count - coalesced_count, std::memory_order_relaxed);
+
+		return coalesced_count;
+	}
+
+	uint64_t AsyncSender::countBytes(const Message* batch, size_t count)
+	{
+		uint64_t bytes = 0;
+
+		for (size_t i = 0; i < count; i++)
+			bytes += getShortMessageLength(batch[i].msg & 0xFF);
+
+		return bytes;
+	}
+
+	void AsyncSender::handleResult(MMRESULT res, DWORD timestamp)
+	{
+		// errors cannot be thrown from the sender thread, they are reported to the Echoer, which rethrows them later.
+		if (res != MMSYSERR_NOERROR)
+			m_echoer.reportError(m_device_id.load(std::memory_order_relaxed), m_slot, m_stats, res, timestamp);
+		else if (m_stats.consecutive_errors.load(std::memory_order_relaxed) != 0)
+			m_stats.consecutive_errors.store(0, std::memory_order_relaxed);
+	}
+}
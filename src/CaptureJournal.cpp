@@ -0,0 +1,340 @@
+#include "CaptureJournal.h"
+#include "Echoer.h"
+#include "Logger.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <system_error>
+
+namespace EchoMIDI
+{
+	// ============ Local defines ============
+
+	size_t recordSize(size_t length)
+	{
+		return (sizeof(JournalRecord) + length + 7) & ~(size_t)7;
+	}
+
+	[[noreturn]] void throwJournalErr(const std::string& action, const std::filesystem::path& file, int err)
+	{
+		throw MIDIEchoExcept("Cannot " + action + " the capture journal " + file.string() + ": " + std::system_category().message(err), "Journal Err", MMSYSERR_ERROR);
+	}
+
+	// ============ CaptureJournal ============
+
+	CaptureJournal::CaptureJournal(std::filesystem::path file, size_t capacity)
+		: m_file(std::move(file)), m_capacity(capacity), m_start_time(latencyNow())
+	{
+		size_t file_size = sizeof(JournalHeader) + m_capacity;
+
+#ifdef _WIN32
+		m_file_handle = CreateFileW(m_file.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+
+		if (m_file_handle == INVALID_HANDLE_VALUE)
+		{
+			m_file_handle = nullptr;
+			throwJournalErr("create", m_file, GetLastError());
+		}
+
+		// creating the mapping extends the file to its full size.
+		m_mapping = CreateFileMappingW(m_file_handle, NULL, PAGE_READWRITE, (DWORD)((uint64_t)file_size >> 32), (DWORD)file_size, NULL);
+
+		if (m_mapping)
+			m_view = (uint8_t*)MapViewOfFile(m_mapping, FILE_MAP_WRITE, 0, 0, file_size);
+
+		if (!m_view)
+		{
+			DWORD err = GetLastError();
+
+			if (m_mapping)
+				CloseHandle(m_mapping);
+
+			CloseHandle(m_file_handle);
+			throwJournalErr("map", m_file, err);
+		}
+
+		// windows has no MAP_POPULATE, so every page is touched once, instead of faulting it in from the midi callback.
+		for (size_t offset = 0; offset < file_size; offset += 4096)
+			((volatile uint8_t*)m_view)[offset] = 0;
+#else
+		m_fd = open(m_file.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+		if (m_fd < 0)
+			throwJournalErr("create", m_file, errno);
+
+		// allocates the blocks up front, so writing to the mapping never has to.
+		int err = posix_fallocate(m_fd, 0, (off_t)file_size);
+
+		if (err == 0)
+		{
+			int flags = MAP_SHARED;
+#ifdef MAP_POPULATE
+			flags |= MAP_POPULATE;
+#endif
+			void* view = mmap(nullptr, file_size, PROT_READ | PROT_WRITE, flags, m_fd, 0);
+
+			if (view != MAP_FAILED)
+				m_view = (uint8_t*)view;
+			else
+				err = errno;
+		}
+
+		if (!m_view)
+		{
+			close(m_fd);
+			throwJournalErr("map", m_file, err);
+		}
+#endif
+
+		JournalHeader& header = *(JournalHeader*)m_view;
+
+		std::memcpy(header.magic, JOURNAL_MAGIC, sizeof(header.magic));
+		header.version = JOURNAL_VERSION;
+		header.header_size = sizeof(JournalHeader);
+		header.capacity = m_capacity;
+		header.created = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+	}
+
+	CaptureJournal::~CaptureJournal()
+	{
+		size_t file_size = sizeof(JournalHeader) + m_capacity;
+		// a record that did not fit may have moved the offset past the capacity, the space before it is empty.
+		size_t used_size = sizeof(JournalHeader) + std::min<size_t>(m_write_offset.load(std::memory_order_acquire), m_capacity);
+
+#ifdef _WIN32
+		UnmapViewOfFile(m_view);
+		CloseHandle(m_mapping);
+
+		LARGE_INTEGER end;
+		end.QuadPart = (LONGLONG)used_size;
+
+		if (!SetFilePointerEx(m_file_handle, end, NULL, FILE_BEGIN) || !SetEndOfFile(m_file_handle))
+			ECHOMIDI_LOG_OS_ERROR(LogLevel::WARN, "could not truncate the capture journal", GetLastError());
+
+		CloseHandle(m_file_handle);
+#else
+		munmap(m_view, file_size);
+
+		if (ftruncate(m_fd, (off_t)used_size) != 0)
+			ECHOMIDI_LOG_OS_ERROR(LogLevel::WARN, "could not truncate the capture journal", errno);
+
+		close(m_fd);
+#endif
+
+		if (getDropCount() > 0)
+			ECHOMIDI_LOG(LogLevel::WARN, "the capture journal was full, events were dropped", m_file.filename().string(), { (int64_t)getDropCount() });
+	}
+
+	JournalRecord* CaptureJournal::reserve(size_t record_size) noexcept
+	{
+		uint64_t offset = m_write_offset.fetch_add(record_size, std::memory_order_relaxed);
+
+		if (offset + record_size > m_capacity)
+		{
+			m_drop_count.fetch_add(1, std::memory_order_relaxed);
+			return nullptr;
+		}
+
+		return (JournalRecord*)(m_view + sizeof(JournalHeader) + offset);
+	}
+
+	void CaptureJournal::commit(JournalRecord* record, size_t record_size) noexcept
+	{
+		std::atomic_ref<uint32_t>(record->size).store((uint32_t)record_size, std::memory_order_release);
+
+		m_event_count.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	bool CaptureJournal::appendShort(UINT source, uint32_t msg, DWORD timestamp, int64_t time) noexcept
+	{
+		JournalRecord* record = reserve(sizeof(JournalRecord));
+
+		if (!record)
+			return false;
+
+		record->source = source;
+		record->time = time - m_start_time;
+		record->timestamp = timestamp;
+		record->msg = msg;
+		record->length = 0;
+
+		commit(record, sizeof(JournalRecord));
+
+		return true;
+	}
+
+	bool CaptureJournal::appendLong(UINT source, const uint8_t* data, size_t length, DWORD timestamp, int64_t time) noexcept
+	{
+		size_t record_size = recordSize(length);
+
+		// the size of a record must fit its 32 bit field.
+		JournalRecord* record = record_size <= UINT32_MAX ? reserve(record_size) : nullptr;
+
+		if (!record)
+			return false;
+
+		record->source = source;
+		record->time = time - m_start_time;
+		record->timestamp = timestamp;
+		record->msg = 0;
+		record->length = (uint32_t)length;
+
+		std::memcpy(record + 1, data, length);
+
+		commit(record, record_size);
+
+		return true;
+	}
+
+	// ============ JournalReader ============
+
+	JournalReader::JournalReader(const std::filesystem::path& file)
+	{
+		std::ifstream stream(file, std::ios::binary);
+
+		if (!stream)
+			throw MIDIEchoExcept("Cannot read the capture journal " + file.string(), "Journal Err", MMSYSERR_ERROR);
+
+		m_data.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+
+		if (m_data.size() >= sizeof(JournalHeader))
+			std::memcpy(&m_header, m_data.data(), sizeof(JournalHeader));
+
+		if (m_data.size() < sizeof(JournalHeader) || std::memcmp(m_header.magic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) != 0
+			|| m_header.version != JOURNAL_VERSION || m_header.header_size < sizeof(JournalHeader) || m_header.header_size > m_data.size())
+			throw MIDIEchoExcept(file.string() + " is not a capture journal, or was written by an incompatible version", "Journal Err", MMSYSERR_ERROR);
+
+		// the file of a journal that is still open is preallocated, the first record that was never committed ends it.
+		size_t offset = m_header.header_size;
+
+		while (offset + sizeof(JournalRecord) <= m_data.size())
+		{
+			JournalRecord record;
+			std::memcpy(&record, m_data.data() + offset, sizeof(JournalRecord));
+
+			if (record.size == 0 || record.size != recordSize(record.length) || offset + record.size > m_data.size())
+				break;
+
+			const uint8_t* data = record.length > 0 ? m_data.data() + offset + sizeof(JournalRecord) : nullptr;
+
+			m_events.push_back({ record.source, record.time, record.timestamp, record.msg, data, record.length });
+
+			offset += record.size;
+		}
+	}
+
+	std::vector<UINT> JournalReader::getSources() const
+	{
+		std::vector<UINT> sources;
+
+		for (const JournalEvent& event : m_events)
+		{
+			if (!std::ranges::binary_search(sources, event.source))
+				sources.insert(std::ranges::upper_bound(sources, event.source), event.source);
+		}
+
+		return sources;
+	}
+
+	// ============ JournalReplay ============
+
+	JournalReplay::JournalReplay(const JournalReader& reader, Echoer& echoer, const ReplayConfig& config)
+		: m_reader(reader), m_echoer(echoer), m_config(config)
+	{
+		if (m_echoer.isEchoing())
+			throw MIDIEchoExcept("Cannot replay into an Echoer whilst it is echoing", "Replay Err", MMSYSERR_ERROR, MIDIIOType::INPUT);
+
+		m_thread = std::thread(&JournalReplay::run, this);
+	}
+
+	JournalReplay::~JournalReplay()
+	{
+		stop();
+		wait();
+	}
+
+	void JournalReplay::wait()
+	{
+		if (m_thread.joinable())
+			m_thread.join();
+	}
+
+	void JournalReplay::stop()
+	{
+		{
+			std::lock_guard lock(m_stop_mutex);
+			m_stopping = true;
+		}
+
+		m_stop_cv.notify_all();
+	}
+
+	void JournalReplay::run()
+	{
+#ifdef ECHOMIDI_BACKEND_WINMM
+		// the default timer resolution is far too coarse for replaying at the original pace.
+		timeBeginPeriod(1);
+#endif
+
+		const std::vector<JournalEvent>& events = m_reader.getEvents();
+
+		auto is_replayed = [&](const JournalEvent& event) { return m_config.source == UINT_MAX || event.source == m_config.source; };
+
+		// the pace is relative to the first replayed event, so events of other sources before it are not waited for.
+		auto first = std::ranges::find_if(events, is_replayed);
+
+		auto start = std::chrono::steady_clock::now();
+		int64_t first_time = first != events.end() ? first->time : 0;
+
+		for (const JournalEvent& event : events)
+		{
+			if (!is_replayed(event))
+				continue;
+
+			{
+				std::unique_lock lock(m_stop_mutex);
+
+				if (m_config.speed > 0)
+				{
+					auto due = start + std::chrono::nanoseconds((int64_t)((event.time - first_time) / m_config.speed));
+
+					m_stop_cv.wait_until(lock, due, [&]() { return m_stopping; });
+				}
+
+				if (m_stopping)
+					break;
+			}
+
+			// the echoer was started in the meantime, its midi callback now owns the queues of its targets.
+			try
+			{
+				if (event.isLong())
+					m_echoer.injectLong(event.data, event.length);
+				else
+					m_echoer.injectShort(event.msg);
+			}
+			catch (const MIDIEchoExcept& e)
+			{
+				ECHOMIDI_LOG(LogLevel::WARN, "the replay was stopped, as the Echoer was started", e.short_msg, { (int64_t)m_replayed_count.load(std::memory_order_relaxed) });
+				break;
+			}
+
+			m_replayed_count.fetch_add(1, std::memory_order_relaxed);
+		}
+
+#ifdef ECHOMIDI_BACKEND_WINMM
+		timeEndPeriod(1);
+#endif
+
+		m_done.store(true, std::memory_order_release);
+	}
+}
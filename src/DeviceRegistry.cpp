@@ -0,0 +1,197 @@
+#include "DeviceRegistry.h"
+#include "OutputPool.h"
+
+#include <climits>
+#include <mutex>
+
+namespace EchoMIDI
+{
+	// ============ DeviceRegistry ============
+
+	MMRESULT DeviceRegistry::DeviceList::getName(UINT id, std::string& name) const
+	{
+		if (id >= caps.size())
+			return MMSYSERR_BADDEVICEID;
+
+		if (caps[id].err == MMSYSERR_NOERROR)
+			name = caps[id].name;
+
+		return caps[id].err;
+	}
+
+	UINT DeviceRegistry::DeviceList::getID(const std::string& name) const
+	{
+		auto it = ids.find(name);
+
+		return it != ids.end() ? it->second : UINT_MAX;
+	}
+
+	template<typename TGetName>
+	void DeviceRegistry::enumerate(DeviceList& list, UINT count, TGetName get_name)
+	{
+		list.caps.assign(count, {});
+		list.ids.clear();
+		list.ids.reserve(count);
+
+		for (UINT id = 0; id < count; id++)
+		{
+			DeviceCaps& caps = list.caps[id];
+
+			caps.err = get_name(id, caps.name);
+
+			// emplace keeps the first id of a name, so the lowest id wins.
+			if (caps.err == MMSYSERR_NOERROR)
+				list.ids.emplace(caps.name, id);
+			else
+				caps.name.clear();
+		}
+	}
+
+	bool DeviceRegistry::diff(const DeviceList& old_list, const DeviceList& new_list, std::vector<std::string>& added, std::vector<std::string>& removed, std::vector<UINT>& ids)
+	{
+		// every id of every name in the new list, in id order.
+		std::unordered_map<std::string, std::vector<UINT>> new_ids;
+
+		for (UINT id = 0; id < new_list.caps.size(); id++)
+		{
+			if (new_list.caps[id].err == MMSYSERR_NOERROR)
+				new_ids[new_list.caps[id].name].push_back(id);
+		}
+
+		// the n-th old device of a name is matched with the n-th new device of that name.
+		std::unordered_map<std::string, size_t> matched;
+		bool renumbered = false;
+
+		ids.assign(old_list.caps.size(), UINT_MAX);
+
+		for (UINT id = 0; id < old_list.caps.size(); id++)
+		{
+			const DeviceCaps& caps = old_list.caps[id];
+
+			if (caps.err != MMSYSERR_NOERROR)
+				continue;
+
+			auto it = new_ids.find(caps.name);
+			size_t& match = matched[caps.name];
+
+			if (it == new_ids.end() || match >= it->second.size())
+			{
+				removed.push_back(caps.name);
+				continue;
+			}
+
+			ids[id] = it->second[match++];
+			renumbered |= ids[id] != id;
+		}
+
+		for (auto& [name, name_ids] : new_ids)
+		{
+			for (size_t i = matched[name]; i < name_ids.size(); i++)
+				added.push_back(name);
+		}
+
+		return renumbered;
+	}
+
+	UINT DeviceRegistry::getInputCount()
+	{
+		auto lock = lockScanned();
+
+		return (UINT)m_inputs.caps.size();
+	}
+
+	UINT DeviceRegistry::getOutputCount()
+	{
+		auto lock = lockScanned();
+
+		return (UINT)m_outputs.caps.size();
+	}
+
+	MMRESULT DeviceRegistry::getInputName(UINT id, std::string& name)
+	{
+		auto lock = lockScanned();
+
+		return m_inputs.getName(id, name);
+	}
+
+	MMRESULT DeviceRegistry::getOutputName(UINT id, std::string& name)
+	{
+		auto lock = lockScanned();
+
+		return m_outputs.getName(id, name);
+	}
+
+	UINT DeviceRegistry::getInputID(const std::string& name)
+	{
+		auto lock = lockScanned();
+
+		return m_inputs.getID(name);
+	}
+
+	UINT DeviceRegistry::getOutputID(const std::string& name)
+	{
+		auto lock = lockScanned();
+
+		return m_outputs.getID(name);
+	}
+
+	DeviceChanges DeviceRegistry::rescan()
+	{
+		std::unique_lock lock(m_mutex);
+
+		DeviceChanges changes = rescanLocked();
+
+		// the shared output devices are matched by id, so they must follow the renumbering right away.
+		if (changes.renumbered || !changes.removed_outputs.empty())
+			getOutputPool().remapIDs(changes.output_ids);
+
+		return changes;
+	}
+
+	DeviceChanges DeviceRegistry::rescanLocked()
+	{
+		bool first_scan = m_generation.load(std::memory_order_relaxed) == 0;
+
+		DeviceList old_inputs = std::move(m_inputs);
+		DeviceList old_outputs = std::move(m_outputs);
+
+		enumerate(m_inputs, Backend::getInputCount(), &Backend::getInputName);
+		enumerate(m_outputs, Backend::getOutputCount(), &Backend::getOutputName);
+
+		m_generation.fetch_add(1, std::memory_order_release);
+
+		DeviceChanges changes;
+
+		if (!first_scan)
+		{
+			changes.renumbered |= diff(old_inputs, m_inputs, changes.added_inputs, changes.removed_inputs, changes.input_ids);
+			changes.renumbered |= diff(old_outputs, m_outputs, changes.added_outputs, changes.removed_outputs, changes.output_ids);
+		}
+
+		return changes;
+	}
+
+	std::shared_lock<std::shared_mutex> DeviceRegistry::lockScanned()
+	{
+		// only the first enumeration happens here, it has nothing to diff against, so no id can change.
+		if (m_generation.load(std::memory_order_acquire) == 0)
+		{
+			std::unique_lock lock(m_mutex);
+
+			// another thread may have enumerated whilst this one was waiting.
+			if (m_generation.load(std::memory_order_acquire) == 0)
+				rescanLocked();
+		}
+
+		return std::shared_lock(m_mutex);
+	}
+
+	// ============ Header defines ============
+
+	DeviceRegistry& getDeviceRegistry()
+	{
+		static DeviceRegistry registry;
+
+		return registry;
+	}
+}
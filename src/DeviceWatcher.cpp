@@ -0,0 +1,242 @@
+#include "DeviceWatcher.h"
+#include "Logger.h"
+
+#if defined(ECHOMIDI_BACKEND_WINMM)
+#include <Windows.h>
+#include <Dbt.h>
+#elif defined(ECHOMIDI_BACKEND_ALSA)
+#include <alsa/asoundlib.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+#include <algorithm>
+#include <vector>
+
+namespace EchoMIDI
+{
+	// ============ Local defines ============
+
+#if defined(ECHOMIDI_BACKEND_WINMM)
+	static constexpr const char* WATCHER_CLASS_NAME = "EchoMIDI Device Watcher";
+	static constexpr UINT_PTR SETTLE_TIMER_ID = 1;
+
+	// device notifications are sent straight to the window, timer messages are dispatched from the message loop in DeviceWatcher::run().
+	LRESULT CALLBACK watcherWndProc(HWND window, UINT msg, WPARAM wparam, LPARAM lparam)
+	{
+		switch (msg)
+		{
+		case WM_DEVICECHANGE:
+			if (wparam == DBT_DEVICEARRIVAL || wparam == DBT_DEVICEREMOVECOMPLETE || wparam == DBT_DEVNODES_CHANGED)
+			{
+				UINT settle_time = (UINT)GetWindowLongPtr(window, GWLP_USERDATA);
+
+				// restarts the timer if it is already running, so a burst of notifications only triggers a single rescan.
+				SetTimer(window, SETTLE_TIMER_ID, settle_time, NULL);
+			}
+
+			return TRUE;
+		case WM_TIMER:
+			KillTimer(window, SETTLE_TIMER_ID);
+			return 0;
+		default:
+			return DefWindowProc(window, msg, wparam, lparam);
+		}
+	}
+#endif
+
+	// ============ DeviceWatcher ============
+
+	DeviceWatcher::DeviceWatcher(Callback callback, std::chrono::milliseconds settle_time)
+		: m_callback(std::move(callback)), m_settle_time(settle_time)
+	{
+#if defined(ECHOMIDI_BACKEND_ALSA)
+		if (pipe(m_wake_pipe) != 0)
+			m_wake_pipe[0] = m_wake_pipe[1] = -1;
+#endif
+
+#if defined(ECHOMIDI_BACKEND_WINMM) || defined(ECHOMIDI_BACKEND_ALSA)
+		m_thread = std::thread(&DeviceWatcher::run, this);
+
+		// wait until the thread has subscribed to the notifications, so no change after the constructor returns is missed,
+		// and the thread has a message queue the destructor can post to.
+		m_ready.wait(false, std::memory_order_acquire);
+
+		if (!isWatching())
+			ECHOMIDI_LOG(LogLevel::WARN, "could not subscribe to device notifications, hotplugged devices are not detected");
+#endif
+	}
+
+	DeviceWatcher::~DeviceWatcher()
+	{
+		m_running.store(false, std::memory_order_release);
+
+#if defined(ECHOMIDI_BACKEND_WINMM)
+		PostThreadMessage(GetThreadId(m_thread.native_handle()), WM_QUIT, NULL, NULL);
+#elif defined(ECHOMIDI_BACKEND_ALSA)
+		char wake = 0;
+
+		// the pipe is empty, so the write cannot fail or block.
+		if (m_wake_pipe[1] >= 0)
+		{
+			[[maybe_unused]] ssize_t written = write(m_wake_pipe[1], &wake, 1);
+		}
+#endif
+
+		if (m_thread.joinable())
+			m_thread.join();
+
+#if defined(ECHOMIDI_BACKEND_ALSA)
+		if (m_wake_pipe[0] >= 0)
+		{
+			close(m_wake_pipe[0]);
+			close(m_wake_pipe[1]);
+		}
+#endif
+	}
+
+	void DeviceWatcher::notify()
+	{
+		if (m_running.load(std::memory_order_acquire))
+			m_callback();
+	}
+
+#if defined(ECHOMIDI_BACKEND_WINMM)
+	void DeviceWatcher::run()
+	{
+		WNDCLASSEXA window_class = {};
+		window_class.cbSize = sizeof(WNDCLASSEXA);
+		window_class.lpfnWndProc = watcherWndProc;
+		window_class.hInstance = GetModuleHandle(NULL);
+		window_class.lpszClassName = WATCHER_CLASS_NAME;
+
+		// fails harmlessly if another watcher already registered the class.
+		RegisterClassExA(&window_class);
+
+		// a message only window, it is never shown, and only recieves the notifications it registers for.
+		HWND window = CreateWindowExA(0, WATCHER_CLASS_NAME, WATCHER_CLASS_NAME, 0, 0, 0, 0, 0, HWND_MESSAGE, NULL, window_class.hInstance, NULL);
+		HDEVNOTIFY notify_handle = NULL;
+
+		if (window != NULL)
+		{
+			SetWindowLongPtr(window, GWLP_USERDATA, (LONG_PTR)m_settle_time.count());
+
+			// midi devices may use any interface class, e.g. usb audio or bluetooth le midi.
+			DEV_BROADCAST_DEVICEINTERFACE_A filter = {};
+			filter.dbcc_size = sizeof(filter);
+			filter.dbcc_devicetype = DBT_DEVTYP_DEVICEINTERFACE;
+
+			notify_handle = RegisterDeviceNotificationA(window, &filter, DEVICE_NOTIFY_WINDOW_HANDLE | DEVICE_NOTIFY_ALL_INTERFACE_CLASSES);
+		}
+
+		// makes sure the thread has a message queue, before the constructor returns.
+		MSG msg;
+		PeekMessage(&msg, NULL, WM_USER, WM_USER, PM_NOREMOVE);
+
+		m_watching.store(notify_handle != NULL, std::memory_order_release);
+		m_ready.store(true, std::memory_order_release);
+		m_ready.notify_all();
+
+		while (GetMessage(&msg, NULL, NULL, NULL))
+		{
+			bool settled = msg.message == WM_TIMER && msg.hwnd == window && msg.wParam == SETTLE_TIMER_ID;
+
+			DispatchMessage(&msg);
+
+			if (settled)
+				notify();
+		}
+
+		if (notify_handle != NULL)
+			UnregisterDeviceNotification(notify_handle);
+
+		if (window != NULL)
+			DestroyWindow(window);
+	}
+#elif defined(ECHOMIDI_BACKEND_ALSA)
+	void DeviceWatcher::run()
+	{
+		snd_seq_t* seq = nullptr;
+		int port = -1;
+
+		// the system announce port broadcasts every client and port that starts, exits or changes.
+		if (m_wake_pipe[0] >= 0 && snd_seq_open(&seq, "default", SND_SEQ_OPEN_INPUT, SND_SEQ_NONBLOCK) >= 0)
+		{
+			snd_seq_set_client_name(seq, "EchoMIDI Device Watcher");
+
+			port = snd_seq_create_simple_port(seq, "EchoMIDI Device Watcher", SND_SEQ_PORT_CAP_WRITE | SND_SEQ_PORT_CAP_NO_EXPORT, SND_SEQ_PORT_TYPE_APPLICATION);
+
+			if (port < 0 || snd_seq_connect_from(seq, port, SND_SEQ_CLIENT_SYSTEM, SND_SEQ_PORT_SYSTEM_ANNOUNCE) < 0)
+			{
+				snd_seq_close(seq);
+				seq = nullptr;
+			}
+		}
+
+		m_watching.store(seq != nullptr, std::memory_order_release);
+		m_ready.store(true, std::memory_order_release);
+		m_ready.notify_all();
+
+		if (seq == nullptr)
+			return;
+
+		// the last descriptor is the read end of the wake pipe, written to by the destructor.
+		std::vector<pollfd> fds(snd_seq_poll_descriptors_count(seq, POLLIN));
+		snd_seq_poll_descriptors(seq, fds.data(), (unsigned int)fds.size(), POLLIN);
+		fds.push_back({ m_wake_pipe[0], POLLIN, 0 });
+
+		bool pending = false;
+		auto settle_deadline = std::chrono::steady_clock::now();
+
+		while (m_running.load(std::memory_order_acquire))
+		{
+			// without a pending change, the thread sleeps until the next announcement.
+			int timeout = -1;
+
+			if (pending)
+				timeout = (int)std::max<int64_t>(0, std::chrono::duration_cast<std::chrono::milliseconds>(settle_deadline - std::chrono::steady_clock::now()).count());
+
+			if (poll(fds.data(), fds.size(), timeout) < 0 && errno != EINTR)
+				break;
+
+			snd_seq_event_t* ev;
+			int res;
+
+			while ((res = snd_seq_event_input(seq, &ev)) >= 0 || res == -ENOSPC)
+			{
+				if (res < 0)
+					continue;
+
+				switch (ev->type)
+				{
+				case SND_SEQ_EVENT_CLIENT_START:
+				case SND_SEQ_EVENT_CLIENT_EXIT:
+				case SND_SEQ_EVENT_CLIENT_CHANGE:
+				case SND_SEQ_EVENT_PORT_START:
+				case SND_SEQ_EVENT_PORT_EXIT:
+				case SND_SEQ_EVENT_PORT_CHANGE:
+					// the ports EchoMIDI opens itself are announced as well, these are never listed, so rescanning finds no changes.
+					pending = true;
+					settle_deadline = std::chrono::steady_clock::now() + m_settle_time;
+					break;
+				default:
+					break;
+				}
+			}
+
+			if (pending && std::chrono::steady_clock::now() >= settle_deadline)
+			{
+				pending = false;
+				notify();
+			}
+		}
+
+		snd_seq_close(seq);
+	}
+#else
+	void DeviceWatcher::run()
+	{
+	}
+#endif
+}
@@ -1,12 +1,16 @@
 #include "Echoer.h"
 #include "FocusHook.h"
+#include "DeviceRegistry.h"
+
+#include <algorithm>
+#include <utility>
 
 namespace EchoMIDI
 {
 	// ============ Local defines ============
 
-#define BADOUTID(bad_id) BadDeviceID(MIDIIOType::INPUT, bad_id, midiOutGetNumDevs())
-#define BADINID(bad_id) BadDeviceID(MIDIIOType::OUTPUT, bad_id, midiInGetNumDevs())
+#define BADOUTID(bad_id) BadDeviceID(MIDIIOType::INPUT, bad_id, Backend::getOutputCount())
+#define BADINID(bad_id) BadDeviceID(MIDIIOType::OUTPUT, bad_id, Backend::getInputCount())
 
 // cast the correct exception, assuming err came from a function which handled input devices
 // with all the neccecarry information based on err.
@@ -72,58 +76,46 @@ namespace EchoMIDI
 
 	bool isValidInID(UINT id)
 	{
-		return id < midiInGetNumDevs();
+		return id < getDeviceRegistry().getInputCount();
 	}
 
 	bool isValidOutID(UINT id)
 	{
-		return id < midiOutGetNumDevs();
+		return id < getDeviceRegistry().getOutputCount();
 	}
 
 	std::string getMidiInputName(UINT midi_in_id)
 	{
-		MIDIINCAPS midi_info;
+		std::string name;
 
-		handleInputErr(midiInGetDevCaps(midi_in_id, &midi_info, sizeof(MIDIINCAPS)), midi_in_id);
+		handleInputErr(getDeviceRegistry().getInputName(midi_in_id, name), midi_in_id);
 
-		return midi_info.szPname;
+		return name;
 	}
 
 	std::string getMidiOutputName(UINT midi_out_id)
 	{
-		MIDIOUTCAPS midi_info;
+		std::string name;
 
-		handleOutputErr(midiOutGetDevCaps(midi_out_id, &midi_info, sizeof(MIDIOUTCAPS)), midi_out_id);
+		handleOutputErr(getDeviceRegistry().getOutputName(midi_out_id, name), midi_out_id);
 
-		return midi_info.szPname;
+		return name;
 	}
 
 	UINT getMidiInIDByName(const std::string& name)
 	{
-		if (name.size() <= MAXPNAMELEN)
-		{
-			for (UINT i = 0; i < midiInGetNumDevs(); i++)
-			{
-				if (name == getMidiInputName(i))
-					return i;
-			}
-		}
+		if (name.size() > Backend::MAX_NAME_LENGTH)
+			return INVALID_MIDI_ID;
 
-		return UINT_MAX;
+		return getDeviceRegistry().getInputID(name);
 	}
 
 	UINT getMidiOutIDByName(const std::string& name)
 	{
-		if (name.size() <= MAXPNAMELEN)
-		{
-			for (UINT i = 0; i < midiOutGetNumDevs(); i++)
-			{
-				if (name == getMidiOutputName(i))
-					return i;
-			}
-		}
+		if (name.size() > Backend::MAX_NAME_LENGTH)
+			return INVALID_MIDI_ID;
 
-		return UINT_MAX;
+		return getDeviceRegistry().getOutputID(name);
 	}
 
 	std::string getMidiName(MIDIIOType midi_io_type, UINT midi_id)
@@ -139,88 +131,820 @@ namespace EchoMIDI
 		}
 	}
 
-	void CALLBACK midiCallback(HMIDIIN hMidiIn, UINT wMsg, DWORD_PTR dwInstance, DWORD_PTR dwParam1, DWORD_PTR dwParam2)
+	// sends short messages to the targets from the midi callback, see fanOutShort().
+	struct CallbackShortSink
+	{
+		Echoer& echoer;
+		DWORD timestamp;
+		int64_t received;
+
+		void sendShort(const Route<Backend::OutputHandle>& route, uint32_t msg)
+		{
+			// a device shared with other Echoers is sent to by its merge thread, in the order the inputs recieved the messages.
+			if (route.port && route.port->isMerging())
+			{
+				// driver timestamps only have a resolution of 1 ms, within that millisecond, the time the callback was entered is the best estimate.
+				int64_t input_time = std::min(echoer.getInputTime(timestamp + 1), received != 0 ? received : latencyNow());
+
+				if (!route.port->push(route.feeder, { input_time, msg, timestamp, received, &echoer, route.slot, route.stats }))
+				{
+					route.stats->merge_dropped_count.fetch_add(1, std::memory_order_relaxed);
+					return;
+				}
+
+				// only queued messages are tracked, a dropped note never sounds.
+				// notes are released after the routes were synchronized, so the callback is done tracking by then.
+				route.notes->track(msg);
+				return;
+			}
+
+			// in async mode, the message is only queued, the sender thread takes care of the rest.
+			if (route.sender)
+			{
+				if (route.sender->push(msg, timestamp, received))
+					route.notes->track(msg);
+
+				return;
+			}
+
+			route.notes->track(msg);
+
+			MMRESULT res = Backend::sendShort(route.handle, msg);
+
+			echoer.recordSent(*route.stats, timestamp, received);
+
+			// exceptions cannot cross the driver boundary, errors are recorded and rethrown by rethrowErrors() instead.
+			if (res != MMSYSERR_NOERROR)
+			{
+				echoer.reportError(route.id, route.slot, *route.stats, res, timestamp);
+				return;
+			}
+
+			route.stats->countSent(1, getShortMessageLength(msg & 0xFF));
+
+			if (route.stats->consecutive_errors.load(std::memory_order_relaxed) != 0)
+				route.stats->consecutive_errors.store(0, std::memory_order_relaxed);
+		}
+	};
+
+#ifdef ECHOMIDI_BACKEND_WINMM
+	// shares a SysEx block with the targets from the midi callback, see fanOutLong().
+	struct CallbackLongSink
 	{
-		Echoer* _this = (Echoer*)dwInstance;
+		Echoer& echoer;
+		SysExPool& sysex_pool;
+		LPMIDIHDR in_hdr;
+		DWORD timestamp;
+		int64_t received;
 
-		// Only midi data should be sent to the outputs.
-		if (wMsg == MIM_DATA)
+		void sendLong(const Route<HMIDIOUT>& route)
 		{
-			for (auto [id, midi_out] : _this->getTargets())
+			LPMIDIHDR out_hdr = sysex_pool.share(in_hdr, route.slot);
+			MMRESULT res = midiOutLongMsg(route.handle, out_hdr, sizeof(MIDIHDR));
+
+			echoer.recordSent(*route.stats, timestamp, received);
+
+			// no MOM_DONE will arrive for a header that was never queued.
+			if (res != MMSYSERR_NOERROR)
 			{
-				if (!(midi_out.user_muted || midi_out.focus_muted))
-					handleOutputErr(midiOutShortMsg(midi_out.device_handle, (DWORD)dwParam1), id);
+				sysex_pool.release(out_hdr);
+				echoer.reportError(route.id, route.slot, *route.stats, res, timestamp);
+				return;
+			}
+
+			route.stats->countSent(1, in_hdr->dwBytesRecorded);
+
+			if (route.stats->consecutive_errors.load(std::memory_order_relaxed) != 0)
+				route.stats->consecutive_errors.store(0, std::memory_order_relaxed);
+		}
+	};
+
+#endif
+
+	// sends a SysEx message to the targets, see fanOutLong().
+	// the message is only valid during the call, so every target is sent to before it returns.
+	// used by the midi callback, except with winmm, which shares the blocks of its SysExPool instead, and for injected messages.
+	struct DirectLongSink
+	{
+		Echoer& echoer;
+		const uint8_t* data;
+		size_t length;
+		DWORD timestamp;
+		int64_t received;
 
+		void sendLong(const Route<Backend::OutputHandle>& route)
+		{
+			MMRESULT res = Backend::sendLong(route.handle, data, length);
+
+			echoer.recordSent(*route.stats, timestamp, received);
+
+			if (res != MMSYSERR_NOERROR)
+			{
+				echoer.reportError(route.id, route.slot, *route.stats, res, timestamp);
+				return;
 			}
+
+			route.stats->countSent(1, length);
+
+			if (route.stats->consecutive_errors.load(std::memory_order_relaxed) != 0)
+				route.stats->consecutive_errors.store(0, std::memory_order_relaxed);
 		}
-		else if (wMsg == MIM_LONGDATA)
+	};
+
+	void Echoer::receiveShort(void* user, uint32_t msg, DWORD timestamp)
+	{
+		Echoer* _this = (Echoer*)user;
+
+		// set before the routes are loaded, so the merge thread of a shared output waits for the messages below, see OutputPort::run().
+		// the time is stored first, a merge thread seeing the count set never reads the time of an earlier callback, which would only hold it back longer.
+		_this->m_receive_time.store(latencyNow());
+		_this->m_receiving.fetch_add(1);
+
+		_this->m_input_stats.countReceived(getShortMessageLength(msg & 0xFF));
+
+		// the route table is immutable, and stays alive until the guard goes out of scope,
+		// even if the targets are modified by another thread in the meantime.
+		auto routes = _this->getRoutes();
+
+		// load the mute state of every target once, so the entire message is sent to a consistent set of targets.
+		SendBits send_bits;
+		send_bits.load(_this->getMuteMask(), routes->word_count);
+
+		int64_t received = _this->recordReceived(timestamp);
+
+		// the journal stays alive for as long as the route guard, see setCapture().
+		if (CaptureJournal* journal = _this->m_capture_journal.load(std::memory_order_acquire))
+			journal->appendShort(_this->m_midi_id, msg, timestamp, received != 0 ? received : latencyNow());
+
+		CallbackShortSink sink = { *_this, timestamp, received };
+
+		fanOutShort(*routes, send_bits, msg, sink);
+
+		// the merge thread of a shared output may hold back a message of another input, until this callback is done.
+		if (_this->m_receiving.fetch_sub(1) == 1)
 		{
-			for (auto [id, midi_out] : _this->getTargets())
+			for (const auto& route : routes->routes)
 			{
-				if (!(midi_out.user_muted || midi_out.focus_muted))
-					handleOutputErr(midiOutLongMsg(midi_out.device_handle, (LPMIDIHDR)dwParam1, (UINT)dwParam2), id);
+				if (route.port && route.port->isMerging())
+					route.port->wake();
 			}
 		}
 	}
 
+	void Echoer::receiveLong(void* user, const uint8_t* data, size_t length, DWORD timestamp)
+	{
+		Echoer* _this = (Echoer*)user;
+
+		auto routes = _this->getRoutes();
+
+		SendBits send_bits;
+		send_bits.load(_this->getMuteMask(), routes->word_count);
+
+#ifdef ECHOMIDI_BACKEND_WINMM
+		SysExPool& sysex_pool = _this->getSysExPool();
+		LPMIDIHDR in_hdr = sysex_pool.getInputHeader(data);
+
+		// the timestamp of a SysEx block is the time the block was filled, not when the message started.
+		int64_t received = _this->recordReceived(timestamp);
+		CallbackLongSink sink = { *_this, sysex_pool, in_hdr, timestamp, received };
+
+		// the callback holds its own reference while sharing the block,
+		// so targets finishing early cannot hand it back to the input device in the meantime.
+		sysex_pool.acquire(in_hdr);
+
+		// blocks returned by midiInReset() carry no data.
+		if (length > 0)
+		{
+			_this->m_input_stats.countReceived(length);
+
+			if (CaptureJournal* journal = _this->m_capture_journal.load(std::memory_order_acquire))
+				journal->appendLong(_this->m_midi_id, data, length, timestamp, received != 0 ? received : latencyNow());
+
+			fanOutLong(*routes, send_bits, sink);
+		}
+
+		sysex_pool.release(in_hdr);
+#else
+		if (length == 0)
+			return;
+
+		_this->m_input_stats.countReceived(length);
+
+		int64_t received = _this->recordReceived(timestamp);
+
+		if (CaptureJournal* journal = _this->m_capture_journal.load(std::memory_order_acquire))
+			journal->appendLong(_this->m_midi_id, data, length, timestamp, received != 0 ? received : latencyNow());
+
+		DirectLongSink sink = { *_this, data, length, timestamp, received };
+
+		fanOutLong(*routes, send_bits, sink);
+#endif
+	}
+
+	// the midi callback is the only producer of the AsyncSender queues, an injection may only take its place whilst it cannot run.
+	// start() sets the echoing flag before waiting for m_injecting to clear, so either the injection sees the flag, or start() waits for it.
+	struct InjectGuard
+	{
+		std::atomic<uint32_t>& injecting;
+
+		InjectGuard(std::atomic<uint32_t>& injecting, const std::atomic<bool>& echoing, UINT midi_id)
+			: injecting(injecting)
+		{
+			injecting.fetch_add(1);
+
+			if (echoing.load())
+			{
+				injecting.fetch_sub(1);
+				throw MIDIEchoExcept("Cannot inject messages whilst echoing", "Inject Err", MMSYSERR_ERROR, MIDIIOType::INPUT, midi_id);
+			}
+		}
+
+		~InjectGuard()
+		{
+			injecting.fetch_sub(1);
+		}
+	};
+
+	void Echoer::injectShort(uint32_t msg)
+	{
+		InjectGuard guard(m_injecting, m_is_echoing, m_midi_id);
+
+		receiveShort(this, msg, (DWORD)((latencyNow() - m_start_time.load(std::memory_order_relaxed)) / 1'000'000));
+	}
+
+	void Echoer::injectLong(const uint8_t* data, size_t length)
+	{
+		InjectGuard guard(m_injecting, m_is_echoing, m_midi_id);
+
+		DWORD timestamp = (DWORD)((latencyNow() - m_start_time.load(std::memory_order_relaxed)) / 1'000'000);
+
+#ifdef ECHOMIDI_BACKEND_WINMM
+		// the midi callback shares the blocks of the SysExPool, an injected message is not in one of them, so it is sent directly.
+		if (length == 0)
+			return;
+
+		auto routes = getRoutes();
+
+		SendBits send_bits;
+		send_bits.load(getMuteMask(), routes->word_count);
+
+		m_input_stats.countReceived(length);
+
+		int64_t received = recordReceived(timestamp);
+
+		if (CaptureJournal* journal = m_capture_journal.load(std::memory_order_acquire))
+			journal->appendLong(m_midi_id, data, length, timestamp, received != 0 ? received : latencyNow());
+
+		DirectLongSink sink = { *this, data, length, timestamp, received };
+
+		fanOutLong(*routes, send_bits, sink);
+#else
+		receiveLong(this, data, length, timestamp);
+#endif
+	}
+
 	// ============ Echoer ============
 
 	Echoer::Echoer()
 		: m_midi_id(INVALID_MIDI_ID)
 	{
-		registerEchoer(this);
+		registerEchoer(this, m_mute_mask);
+		registerMetrics(this);
 	}
 
 	Echoer::Echoer(UINT source)
 		: m_midi_id(source)
 	{
-		registerEchoer(this);
+		registerEchoer(this, m_mute_mask);
+		registerMetrics(this);
 	}
 
 	Echoer::~Echoer()
 	{
+		// the targets are closed below, without publishing new routes first.
+		// the focus hook is unregistered first, as it releases the notes of focus muted targets through the routes.
+		unregisterMetrics(this);
+		unregisterEchoer(this);
+
 		if (isEchoing())
 			stop();
 		
 		if(isOpen())
 			close();
 
-		for (auto [id, target] : getTargets())
+		// a shared device is not reset when a single Echoer goes away, so its notes are ended one by one.
+		for (auto& [id, target] : m_midi_targets)
 		{
-			handleOutputErr(midiOutReset(target.device_handle), id);
-			handleOutputErr(midiOutClose(target.device_handle), id);
+			releaseNotes(target);
+			closeTarget(id, target);
 		}
-
-		unregisterEchoer(this);
 	}
 
 	bool Echoer::add(UINT id)
 	{
-		MMRESULT res = midiOutOpen(&m_midi_targets[id].device_handle, id, NULL, NULL, CALLBACK_NULL);
+		std::lock_guard lock(m_targets_mutex);
 
-		if (res != MMSYSERR_NOERROR)
+		if (m_midi_targets.contains(id))
+			return false;
+
+		if (m_used_slots.all())
+			throw MIDIEchoExcept("Cannot add more than " + std::to_string(MuteMask::MAX_TARGETS) + " targets to a single Echoer", "Target Err", MMSYSERR_ERROR, MIDIIOType::OUTPUT, id);
+
+		// use the lowest free slot, this keeps the number of mute words the callback has to load as small as possible.
+		uint32_t slot = 0;
+
+		while (m_used_slots[slot])
+			slot++;
+
+		MIDIOutDevice& target = m_midi_targets[id];
+		target.slot = slot;
+
+		try
+		{
+			openTarget(id, target);
+		}
+		catch (...)
+		{
 			m_midi_targets.erase(id);
+			throw;
+		}
 
-		handleOutputErr(res, id);
+		m_used_slots[slot] = true;
+		m_mute_mask.clear(slot);
 
-		return res == MMSYSERR_NOERROR;
+		publishRoutes();
+
+		return true;
 	}
 
 	void Echoer::remove(UINT id)
 	{
+		std::lock_guard lock(m_targets_mutex);
+
 		if (m_midi_targets.contains(id))
 		{
-			handleInputErr(midiOutClose(m_midi_targets[id].device_handle), id);
-			m_midi_targets.erase(id);
+			auto target = m_midi_targets.extract(id);
+
+			// once the new routes are published, the midi callback can no longer reference the removed target.
+			publishRoutes();
+
+			m_used_slots[target.mapped().slot] = false;
+
+			releaseNotes(target.mapped());
+			closeTarget(id, target.mapped());
+		}
+	}
+
+	void Echoer::remapIDs(const std::vector<UINT>& input_ids, const std::vector<UINT>& output_ids)
+	{
+		std::lock_guard lock(m_targets_mutex);
+
+		if (m_midi_id < input_ids.size())
+			m_midi_id = input_ids[m_midi_id];
+
+		auto remapped = [&](UINT id) { return id < output_ids.size() ? output_ids[id] : id; };
+
+		if (std::ranges::all_of(m_midi_targets, [&](auto& target) { return remapped(target.first) == target.first; }))
+			return;
+
+		// the targets are rekeyed all at once, as a new id may still be used by another target that has yet to be moved.
+		std::map<UINT, MIDIOutDevice> targets;
+		std::vector<std::pair<UINT, MIDIOutDevice>> vanished;
+
+		while (!m_midi_targets.empty())
+		{
+			auto target = m_midi_targets.extract(m_midi_targets.begin());
+			UINT new_id = remapped(target.key());
+
+			if (new_id == INVALID_MIDI_ID)
+			{
+				vanished.emplace_back(target.key(), std::move(target.mapped()));
+				continue;
+			}
+
+			if (target.mapped().sender)
+				target.mapped().sender->setDeviceID(new_id);
+
+			target.key() = new_id;
+			targets.insert(std::move(target));
+		}
+
+		m_midi_targets = std::move(targets);
+
+		// once the new routes are published, the midi callback can no longer reference the vanished targets.
+		publishRoutes();
+
+		std::exception_ptr err;
+
+		for (auto& [id, target] : vanished)
+		{
+			m_used_slots[target.slot] = false;
+
+			try
+			{
+				closeTarget(id, target);
+			}
+			catch (...)
+			{
+				if (!err)
+					err = std::current_exception();
+			}
+		}
+
+		if (err)
+			std::rethrow_exception(err);
+	}
+
+	Echoer::TargetBatch Echoer::prepareTargets(std::vector<TargetConfig> configs, std::vector<UINT> removed_ids)
+	{
+		std::lock_guard lock(m_targets_mutex);
+
+		// slots are only reserved once every new target fits, so a failure leaves nothing to undo.
+		std::bitset<MuteMask::MAX_TARGETS> used_slots = m_used_slots;
+		std::vector<TargetBatch::NewTarget> new_targets;
+
+		for (const TargetConfig& config : configs)
+		{
+			if (m_midi_targets.contains(config.id) || std::ranges::any_of(new_targets, [&](auto& target) { return target.id == config.id; }))
+				continue;
+
+			if (used_slots.all())
+				throw MIDIEchoExcept("Cannot add more than " + std::to_string(MuteMask::MAX_TARGETS) + " targets to a single Echoer", "Target Err", MMSYSERR_ERROR, MIDIIOType::OUTPUT, config.id);
+
+			uint32_t slot = 0;
+
+			while (used_slots[slot])
+				slot++;
+
+			used_slots[slot] = true;
+
+			TargetBatch::NewTarget& new_target = new_targets.emplace_back();
+			new_target.id = config.id;
+			new_target.device.slot = slot;
+			new_target.device.coalesce = config.coalesce;
+		}
+
+		m_used_slots = used_slots;
+
+		TargetBatch batch;
+		batch.m_echoer = this;
+		batch.m_configs = std::move(configs);
+		batch.m_new_targets = std::move(new_targets);
+		batch.m_removed_ids = std::move(removed_ids);
+
+		return batch;
+	}
+
+	void Echoer::commitTargets(TargetBatch& batch)
+	{
+		assert(batch.m_echoer == this);
+
+		std::lock_guard lock(m_targets_mutex);
+
+		// everything that may fail is done before the first target is touched.
+		std::map<UINT, MIDIOutDevice> added;
+
+		for (TargetBatch::NewTarget& new_target : batch.m_new_targets)
+		{
+			if (!new_target.opened)
+				throw MIDIEchoExcept("Cannot commit a target that has not been opened", "Target Err", MMSYSERR_ERROR, MIDIIOType::OUTPUT, new_target.id);
 		}
+
+		std::vector<std::unique_ptr<const TransformTable>> transforms;
+		transforms.reserve(batch.m_configs.size());
+
+		bool uses_focus = false;
+
+		for (const TargetConfig& config : batch.m_configs)
+		{
+			transforms.push_back(config.transform_rules.isIdentity() ? nullptr : std::make_unique<const TransformTable>(config.transform_rules.compile()));
+			uses_focus |= !config.focus_send_path.empty();
+		}
+
+		std::filesystem::path focused_path = uses_focus ? getFocusedPath() : std::filesystem::path();
+
+		for (TargetBatch::NewTarget& new_target : batch.m_new_targets)
+			added.emplace(new_target.id, std::move(new_target.device));
+
+		// from here on, the batch owns nothing that has to be closed.
+		batch.m_new_targets.clear();
+		batch.m_echoer = nullptr;
+
+		std::vector<std::pair<UINT, MIDIOutDevice>> removed;
+
+		for (UINT id : batch.m_removed_ids)
+		{
+			auto target = m_midi_targets.extract(id);
+
+			if (!target.empty())
+				removed.emplace_back(id, std::move(target.mapped()));
+		}
+
+		for (auto& [id, target] : added)
+			m_mute_mask.clear(target.slot);
+
+		m_midi_targets.merge(added);
+
+		// the previous tables must outlive any midi callback still using them, which is guaranteed once the new routes are published.
+		std::vector<std::unique_ptr<const TransformTable>> prev_transforms;
+		prev_transforms.reserve(batch.m_configs.size());
+
+		for (size_t i = 0; i < batch.m_configs.size(); i++)
+		{
+			const TargetConfig& config = batch.m_configs[i];
+
+			// a target removed since the batch was prepared stays removed.
+			if (!m_midi_targets.contains(config.id))
+				continue;
+
+			MIDIOutDevice& target = m_midi_targets[config.id];
+
+			m_mute_mask.setUserMuted(target.slot, config.mute);
+			m_mute_mask.setFocusMuted(target.slot, !config.focus_send_path.empty() && !focusSendMatches(config.focus_send_path, focused_path));
+			target.focus_send_path = config.focus_send_path;
+
+			prev_transforms.push_back(std::move(target.transform));
+			target.transform_rules = config.transform_rules;
+			target.transform = std::move(transforms[i]);
+
+			target.coalesce = config.coalesce;
+
+			if (target.sender)
+				target.sender->setCoalescing(config.coalesce);
+		}
+
+		// once the new routes are published, the midi callback can no longer reference the removed targets.
+		publishRoutes();
+
+		// targets the batch muted, or focus muted, end their notes just like removed ones.
+		releaseMutedNotes();
+
+		std::exception_ptr err;
+
+		for (auto& [id, target] : removed)
+		{
+			m_used_slots[target.slot] = false;
+
+			releaseNotes(target);
+
+			try
+			{
+				closeTarget(id, target);
+			}
+			catch (...)
+			{
+				if (!err)
+					err = std::current_exception();
+			}
+		}
+
+		if (err)
+			std::rethrow_exception(err);
+	}
+
+	Echoer::TargetBatch::TargetBatch(TargetBatch&& other) noexcept
+		: m_echoer(std::exchange(other.m_echoer, nullptr)), m_configs(std::move(other.m_configs)), m_new_targets(std::move(other.m_new_targets)),
+			m_removed_ids(std::move(other.m_removed_ids))
+	{}
+
+	Echoer::TargetBatch::~TargetBatch()
+	{
+		if (!m_echoer)
+			return;
+
+		// the new targets were never published, so the midi callback cannot reference them.
+		for (NewTarget& new_target : m_new_targets)
+		{
+			if (!new_target.opened)
+				continue;
+
+			try
+			{
+				m_echoer->closeTarget(new_target.id, new_target.device);
+			}
+			catch (const MIDIEchoExcept& e)
+			{
+				ECHOMIDI_LOG(LogLevel::WARN, "could not close an uncommitted target", e.short_msg, { new_target.id });
+			}
+		}
+
+		std::lock_guard lock(m_echoer->m_targets_mutex);
+
+		for (NewTarget& new_target : m_new_targets)
+			m_echoer->m_used_slots[new_target.device.slot] = false;
+	}
+
+	void Echoer::TargetBatch::open(size_t index)
+	{
+		NewTarget& new_target = m_new_targets[index];
+
+		assert(!new_target.opened);
+
+		// only touches the device and slot of this target, so different indexes may be opened concurrently.
+		m_echoer->openTarget(new_target.id, new_target.device);
+		new_target.opened = true;
+	}
+
+	void Echoer::setMute(UINT id, bool state)
+	{
+		std::lock_guard lock(m_targets_mutex);
+
+		assert(m_midi_targets.contains(id));
+		m_mute_mask.setUserMuted(m_midi_targets[id].slot, state);
+
+		if (state)
+			releaseMutedNotes();
+	}
+
+	bool Echoer::isMuted(UINT id)
+	{
+		std::lock_guard lock(m_targets_mutex);
+
+		assert(m_midi_targets.contains(id));
+		return m_mute_mask.isUserMuted(m_midi_targets[id].slot);
+	}
+
+	bool Echoer::isDisabled(UINT id)
+	{
+		std::lock_guard lock(m_targets_mutex);
+
+		assert(m_midi_targets.contains(id));
+		return m_mute_mask.isDisabled(m_midi_targets[id].slot);
+	}
+
+	void Echoer::enable(UINT id)
+	{
+		std::lock_guard lock(m_targets_mutex);
+
+		assert(m_midi_targets.contains(id));
+
+		MIDIOutDevice& target = m_midi_targets[id];
+
+		target.stats->consecutive_errors.store(0, std::memory_order_relaxed);
+		m_mute_mask.setDisabled(target.slot, false);
+	}
+
+	size_t Echoer::getErrorCount(UINT id)
+	{
+		std::lock_guard lock(m_targets_mutex);
+
+		assert(m_midi_targets.contains(id));
+		return m_midi_targets[id].stats->error_count.load(std::memory_order_relaxed);
+	}
+
+	std::vector<ErrorRecord> Echoer::drainErrors()
+	{
+		std::lock_guard lock(m_errors_mutex);
+
+		std::vector<ErrorRecord> errors;
+		ErrorRecord record;
+
+		while (m_errors.pop(record))
+			errors.push_back(record);
+
+		return errors;
+	}
+
+	void Echoer::rethrowErrors()
+	{
+		ErrorRecord record;
+
+		{
+			std::lock_guard lock(m_errors_mutex);
+
+			if (!m_errors.pop(record))
+				return;
+		}
+
+		// the exception is only constructed here, as some exceptions query the driver for additional information.
+		if (record.type == MIDIIOType::INPUT)
+			handleInputErr(record.err_code, record.device_id);
+		else
+			handleOutputErr(record.err_code, record.device_id);
+	}
+
+	void Echoer::reportError(UINT id, uint32_t slot, TargetStats& stats, MMRESULT err, DWORD timestamp) noexcept
+	{
+		stats.error_count.fetch_add(1, std::memory_order_relaxed);
+
+		uint32_t consecutive_errors = stats.consecutive_errors.fetch_add(1, std::memory_order_relaxed) + 1;
+		uint32_t max_target_errors = m_max_target_errors.load(std::memory_order_relaxed);
+
+		bool disable = max_target_errors != 0 && consecutive_errors == max_target_errors;
+
+		if (disable)
+			m_mute_mask.setDisabled(slot, true);
+
+		// if the queue is full, the record is dropped and counted by the queue.
+		m_errors.push({ err, MIDIIOType::OUTPUT, id, timestamp, disable });
+	}
+
+	LatencySummary Echoer::getDispatchLatency(UINT id)
+	{
+		std::lock_guard lock(m_targets_mutex);
+
+		assert(m_midi_targets.contains(id));
+		return m_midi_targets[id].stats->dispatch_latency.getSummary();
+	}
+
+	LatencySummary Echoer::getTotalLatency(UINT id)
+	{
+		std::lock_guard lock(m_targets_mutex);
+
+		assert(m_midi_targets.contains(id));
+		return m_midi_targets[id].stats->total_latency.getSummary();
+	}
+
+	EchoerMetrics Echoer::getMetrics()
+	{
+		std::lock_guard lock(m_targets_mutex);
+
+		EchoerMetrics metrics;
+		metrics.id = m_midi_id;
+		metrics.received_count = m_input_stats.received_count.load(std::memory_order_relaxed);
+		metrics.received_bytes = m_input_stats.received_bytes.load(std::memory_order_relaxed);
+		metrics.dropped_error_count = m_errors.getDropCount();
+
+		metrics.targets.reserve(m_midi_targets.size());
+
+		for (auto& [id, target] : m_midi_targets)
+		{
+			TargetMetrics& target_metrics = metrics.targets.emplace_back();
+			target_metrics.id = id;
+			target_metrics.sent_count = target.stats->sent_count.load(std::memory_order_relaxed);
+			target_metrics.sent_bytes = target.stats->sent_bytes.load(std::memory_order_relaxed);
+			target_metrics.muted_count = target.stats->muted_count.load(std::memory_order_relaxed);
+			target_metrics.focus_muted_count = target.stats->focus_muted_count.load(std::memory_order_relaxed);
+			target_metrics.filtered_count = target.stats->filtered_count.load(std::memory_order_relaxed);
+			target_metrics.error_count = target.stats->error_count.load(std::memory_order_relaxed);
+			target_metrics.queue_dropped_count = target.stats->merge_dropped_count.load(std::memory_order_relaxed);
+
+			if (target.sender)
+			{
+				target_metrics.queue_dropped_count += target.sender->getDropCount();
+				target_metrics.coalesced_count = target.sender->getCoalescedCount();
+				target_metrics.queue_depth = target.sender->getQueueDepth();
+			}
+		}
+
+		return metrics;
+	}
+
+	void Echoer::resetLatency()
+	{
+		std::lock_guard lock(m_targets_mutex);
+
+		m_input_latency.reset();
+
+		for (auto& [id, target] : m_midi_targets)
+		{
+			target.stats->dispatch_latency.reset();
+			target.stats->total_latency.reset();
+		}
+	}
+
+	int64_t Echoer::recordReceived(DWORD timestamp) noexcept
+	{
+		if (!m_track_latency.load(std::memory_order_relaxed))
+			return 0;
+
+		int64_t received = latencyNow();
+
+		m_input_latency.record(received - getInputTime(timestamp));
+
+		return received;
+	}
+
+	void Echoer::recordSent(TargetStats& stats, DWORD timestamp, int64_t received) noexcept
+	{
+		if (received == 0)
+			return;
+
+		int64_t sent = latencyNow();
+
+		stats.dispatch_latency.record(sent - received);
+		stats.total_latency.record(sent - getInputTime(timestamp));
 	}
 
 	void Echoer::open(UINT id)
 	{
 		if (isOpen())
-			throw MIDIEchoExcept("Cannot open an already open Echoer", "Open Err", NULL, MIDIIOType::INPUT, m_midi_id);
+			throw MIDIEchoExcept("Cannot open an already open Echoer", "Open Err", MMSYSERR_ERROR, MIDIIOType::INPUT, m_midi_id);
+
+		handleInputErr(Backend::openInput(m_midi_source, id, m_input_callbacks), id);
 
-		handleInputErr(midiInOpen(&m_midi_source, id, (DWORD_PTR)&midiCallback, (DWORD_PTR)this, CALLBACK_FUNCTION), id);
+#ifdef ECHOMIDI_BACKEND_WINMM
+		// without any buffers, the input device drops all SysEx messages.
+		try
+		{
+			m_sysex_pool->attachInput(m_midi_source, id);
+		}
+		catch (...)
+		{
+			Backend::closeInput(m_midi_source);
+			throw;
+		}
+#endif
 		
 		m_midi_id = id;
 		m_is_open = true;
@@ -234,33 +958,162 @@ namespace EchoMIDI
 	void Echoer::close()
 	{
 		if (isEchoing())
-			throw MIDIEchoExcept("Cannot close midi device if it is currently echoing", "Close Err", NULL, MIDIIOType::INPUT, m_midi_id);
+			throw MIDIEchoExcept("Cannot close midi device if it is currently echoing", "Close Err", MMSYSERR_ERROR, MIDIIOType::INPUT, m_midi_id);
 
-		handleInputErr(midiInReset(m_midi_source), m_midi_id);
-		handleInputErr(midiInClose(m_midi_source), m_midi_id);
+#ifdef ECHOMIDI_BACKEND_WINMM
+		// also resets the input device, so every SysEx block is returned.
+		m_sysex_pool->detachInput(m_midi_id);
+#endif
+		handleInputErr(Backend::closeInput(m_midi_source), m_midi_id);
 
 		m_is_open = false;
 	}
 
 	void Echoer::reset()
 	{
-		handleOutputErr(midiInReset(m_midi_source), m_midi_id);
+		handleOutputErr(Backend::resetInput(m_midi_source), m_midi_id);
 	}
 
 	void Echoer::start()
 	{
 		m_is_echoing = true;
-		handleOutputErr(midiInStart(m_midi_source), m_midi_id);
+
+		// an injection that checked the flag before it was set must be done, before the midi callback may push to the same queues.
+		while (m_injecting.load() != 0)
+			std::this_thread::yield();
+
+		// driver timestamps restart at 0 every time the input is started.
+		m_start_time.store(latencyNow(), std::memory_order_relaxed);
+		handleOutputErr(Backend::startInput(m_midi_source), m_midi_id);
 	}
 
 	void Echoer::stop()
 	{
 		m_is_echoing = false;
-		handleOutputErr(midiInStop(m_midi_source), m_midi_id);
+		handleOutputErr(Backend::stopInput(m_midi_source), m_midi_id);
+	}
+
+#ifdef ECHOMIDI_BACKEND_WINMM
+	void Echoer::setSysExBuffers(size_t block_count, size_t block_size)
+	{
+		std::lock_guard lock(m_targets_mutex);
+
+		if (isOpen() || !m_midi_targets.empty())
+			throw MIDIEchoExcept("Cannot change SysEx buffers of an open Echoer, or an Echoer with targets", "SysEx Err", MMSYSERR_ERROR, MIDIIOType::INPUT, m_midi_id);
+
+		m_sysex_pool = std::make_unique<SysExPool>(block_count, block_size);
+	}
+#endif
+
+	void Echoer::setCapture(std::shared_ptr<CaptureJournal> journal)
+	{
+		std::lock_guard lock(m_targets_mutex);
+
+		m_capture_journal.store(journal.get());
+
+		// a midi callback that loaded the previous journal holds a route guard until it is done appending to it.
+		m_routes.synchronize();
+
+		m_capture = std::move(journal);
+	}
+
+	std::shared_ptr<CaptureJournal> Echoer::getCapture()
+	{
+		std::lock_guard lock(m_targets_mutex);
+
+		return m_capture;
+	}
+
+	void Echoer::setAsync(bool async)
+	{
+		if (isEchoing())
+			throw MIDIEchoExcept("Cannot change async mode whilst echoing", "Async Err", MMSYSERR_ERROR, MIDIIOType::INPUT, m_midi_id);
+
+		std::lock_guard lock(m_targets_mutex);
+
+		if (async == m_is_async)
+			return;
+
+		reopenTargets([&]() { m_is_async = async; });
+	}
+
+	void Echoer::setBatchWindow(std::chrono::microseconds window)
+	{
+		if (isEchoing())
+			throw MIDIEchoExcept("Cannot change the batch window whilst echoing", "Batch Err", MMSYSERR_ERROR, MIDIIOType::INPUT, m_midi_id);
+
+		std::lock_guard lock(m_targets_mutex);
+
+		if (window == m_batch_window)
+			return;
+
+		reopenTargets([&]() { m_batch_window = window; });
+	}
+
+	void Echoer::setTransform(UINT id, const TransformRules& rules)
+	{
+		std::lock_guard lock(m_targets_mutex);
+
+		if (!m_midi_targets.contains(id))
+			throw BADOUTID(id);
+
+		MIDIOutDevice& target = m_midi_targets[id];
+
+		// the previous table must outlive any midi callback still using it, which is guaranteed once the new routes are published.
+		std::unique_ptr<const TransformTable> prev_transform = std::move(target.transform);
+
+		target.transform_rules = rules;
+
+		if (!rules.isIdentity())
+			target.transform = std::make_unique<const TransformTable>(rules.compile());
+
+		publishRoutes();
+	}
+
+	TransformRules Echoer::getTransform(UINT id)
+	{
+		std::lock_guard lock(m_targets_mutex);
+
+		return m_midi_targets[id].transform_rules;
+	}
+
+	void Echoer::setCoalescing(UINT id, bool coalesce)
+	{
+		std::lock_guard lock(m_targets_mutex);
+
+		if (!m_midi_targets.contains(id))
+			throw BADOUTID(id);
+
+		MIDIOutDevice& target = m_midi_targets[id];
+
+		target.coalesce = coalesce;
+
+		if (target.sender)
+			target.sender->setCoalescing(coalesce);
+	}
+
+	bool Echoer::isCoalescing(UINT id)
+	{
+		std::lock_guard lock(m_targets_mutex);
+
+		assert(m_midi_targets.contains(id));
+		return m_midi_targets[id].coalesce;
+	}
+
+	size_t Echoer::getCoalescedCount(UINT id)
+	{
+		std::lock_guard lock(m_targets_mutex);
+
+		assert(m_midi_targets.contains(id));
+		MIDIOutDevice& target = m_midi_targets[id];
+
+		return target.sender ? target.sender->getCoalescedCount() : 0;
 	}
 
 	void Echoer::focusSend(UINT id, std::filesystem::path exec)
 	{
+		std::lock_guard lock(m_targets_mutex);
+
 		if (!m_midi_targets.contains(id))
 		{
 			throw BADOUTID(id);
@@ -270,15 +1123,194 @@ namespace EchoMIDI
 		// as a focus event does not occur when this is called, the top window needs to be retrieved manually.
 		// if the GUI is used, this will almost always be false, as the GUI window always will be in focus, when this is called.
 		if (exec != "")
-			m_midi_targets[id].focus_muted = exec != getHWNDPath(GetTopWindow(NULL));
+			m_mute_mask.setFocusMuted(m_midi_targets[id].slot, !focusSendMatches(exec, getFocusedPath()));
 		else
-			m_midi_targets[id].focus_muted = false;
+			m_mute_mask.setFocusMuted(m_midi_targets[id].slot, false);
 
 		m_midi_targets[id].focus_send_path = exec;
+
+		publishFocusRules();
+		releaseMutedNotes();
 	}
 
 	std::filesystem::path Echoer::getFocusSendExec(UINT id)
 	{
+		std::lock_guard lock(m_targets_mutex);
+
 		return m_midi_targets[id].focus_send_path;
 	}
+
+	void Echoer::openTarget(UINT id, MIDIOutDevice& target)
+	{
+		// every Echoer routed to the same device shares a single handle, see OutputPool.
+		MMRESULT res = getOutputPool().acquire(target.port, target.feeder, *this, id, usesBatches());
+
+		if (res != MMSYSERR_NOERROR)
+			target.port = nullptr;
+
+		handleOutputErr(res, id);
+
+		target.device_handle = target.port->getHandle();
+
+#ifdef ECHOMIDI_BACKEND_WINMM
+		// a device shared with an Echoer that does not batch may not be a stream, in which case this target is not batched either.
+		target.stream_handle = target.port->getStreamHandle();
+
+		try
+		{
+			if (!target.port->attachSysExPool(m_sysex_pool.get()))
+				throw MIDIEchoExcept("Too many inputs are routed to the same output device", "Open Err", MMSYSERR_ALLOCATED, MIDIIOType::OUTPUT, id);
+
+			try
+			{
+				m_sysex_pool->attachOutput(target.device_handle, target.slot, id);
+			}
+			catch (...)
+			{
+				target.port->detachSysExPool(m_sysex_pool.get());
+				throw;
+			}
+		}
+		catch (...)
+		{
+			getOutputPool().release(target.port, target.feeder);
+			target.port = nullptr;
+			target.device_handle = NULL;
+			target.stream_handle = NULL;
+
+			throw;
+		}
+
+		if (m_is_async)
+		{
+			target.sender = std::make_unique<AsyncSender>(*this, target.device_handle, id, target.slot, *target.stats, target.stream_handle, m_batch_window);
+			target.sender->setCoalescing(target.coalesce);
+		}
+#else
+		if (m_is_async)
+		{
+			target.sender = std::make_unique<AsyncSender>(*this, target.device_handle, id, target.slot, *target.stats,
+				usesBatches() ? m_batch_window : std::chrono::microseconds(0));
+			target.sender->setCoalescing(target.coalesce);
+		}
+#endif
+	}
+
+	void Echoer::closeTarget(UINT id, MIDIOutDevice& target)
+	{
+		// the sender thread must be done with the handle, before it is closed.
+		target.sender.reset();
+
+		if (!target.port)
+			return;
+
+#ifdef ECHOMIDI_BACKEND_WINMM
+		// the device is only reset if no other Echoer is sending to it.
+		try
+		{
+			m_sysex_pool->detachOutput(target.slot, id, target.port->getFeederCount() == 1);
+		}
+		catch (...)
+		{
+			target.port->detachSysExPool(m_sysex_pool.get());
+			getOutputPool().release(target.port, target.feeder);
+			target.port = nullptr;
+			target.device_handle = NULL;
+			target.stream_handle = NULL;
+
+			throw;
+		}
+
+		target.port->detachSysExPool(m_sysex_pool.get());
+		target.stream_handle = NULL;
+#endif
+
+		// the device itself is only closed once no other Echoer is routed to it.
+		MMRESULT res = getOutputPool().release(target.port, target.feeder);
+
+		target.port = nullptr;
+		target.device_handle = {};
+
+		handleOutputErr(res, id);
+	}
+
+	void Echoer::releaseNotes(MIDIOutDevice& target)
+	{
+		// the sender thread sends every message still queued before it exits, so the note offs arrive after them.
+		target.sender.reset();
+
+		releaseNotes({ target.device_handle, INVALID_MIDI_ID, target.slot, nullptr, target.stats.get(), nullptr, target.port, target.feeder, target.notes.get() });
+	}
+
+	void Echoer::releaseNotes(const Route<Backend::OutputHandle>& route)
+	{
+		if (route.notes->empty())
+			return;
+
+		// the note offs take the same path as the notes did, so they cannot overtake any of them.
+		if (route.port && route.port->isMerging())
+		{
+			int64_t now = latencyNow();
+			DWORD timestamp = (DWORD)((now - m_start_time.load(std::memory_order_relaxed)) / 1'000'000);
+
+			route.notes->release([&](uint32_t msg)
+				{
+					if (!route.port->push(route.feeder, { now, msg, timestamp, 0, this, route.slot, route.stats }))
+						route.stats->merge_dropped_count.fetch_add(1, std::memory_order_relaxed);
+				});
+		}
+		else if (route.sender)
+		{
+			route.sender->releaseNotes(*route.notes);
+		}
+		else
+		{
+			// errors are ignored, a target that cannot be sent to has no sounding notes either.
+			route.notes->release([&](uint32_t msg) { Backend::sendShort(route.handle, msg); });
+		}
+	}
+
+	void Echoer::releaseMutedNotes()
+	{
+		// a midi callback that loaded the mute state before it changed may still be sending to a muted target.
+		m_routes.synchronize();
+
+		auto routes = getRoutes();
+
+		for (const Route<Backend::OutputHandle>& route : *routes)
+		{
+			if (!(m_mute_mask.getSendBits(route.slot / MuteMask::TARGETS_PER_WORD) >> (route.slot % MuteMask::TARGETS_PER_WORD) & 1))
+				releaseNotes(route);
+		}
+	}
+
+	void Echoer::publishRoutes()
+	{
+		auto routes = std::make_unique<RouteTable<Backend::OutputHandle>>();
+
+		routes->routes.reserve(m_midi_targets.size());
+
+		for (auto& [id, midi_out] : m_midi_targets)
+		{
+			routes->routes.push_back({ midi_out.device_handle, id, midi_out.slot, midi_out.sender.get(), midi_out.stats.get(), midi_out.transform.get(), midi_out.port, midi_out.feeder, midi_out.notes.get() });
+			routes->word_count = std::max(routes->word_count, midi_out.slot / MuteMask::TARGETS_PER_WORD + 1);
+		}
+
+		m_routes.publish(std::move(routes));
+
+		publishFocusRules();
+	}
+
+	void Echoer::publishFocusRules()
+	{
+		std::vector<FocusRule> rules;
+
+		for (auto& [id, midi_out] : m_midi_targets)
+		{
+			if (!midi_out.focus_send_path.empty())
+				rules.push_back({ midi_out.slot, midi_out.focus_send_path });
+		}
+
+		setFocusRules(this, std::move(rules));
+	}
 }
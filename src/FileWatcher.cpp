@@ -0,0 +1,287 @@
+#include "FileWatcher.h"
+#include "Logger.h"
+
+#if defined(_WIN32)
+#include <Windows.h>
+#elif defined(__linux__)
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+
+namespace EchoMIDI
+{
+	// ============ Local defines ============
+
+	// large enough for a burst of notifications, if it still overflows, the file is simply read again.
+	static constexpr size_t NOTIFY_BUFFER_SIZE = 16 * 1024;
+
+	int64_t remainingMs(std::chrono::steady_clock::time_point deadline)
+	{
+		return std::max<int64_t>(0, std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count());
+	}
+
+#if defined(_WIN32)
+	// checks wether any of the notifications in the buffer refer to file_name.
+	bool mentionsFile(const BYTE* buffer, const std::wstring& file_name)
+	{
+		const FILE_NOTIFY_INFORMATION* info = (const FILE_NOTIFY_INFORMATION*)buffer;
+
+		while (true)
+		{
+			size_t name_length = info->FileNameLength / sizeof(WCHAR);
+
+			// file names are case insensitive on windows.
+			if (name_length == file_name.size() && CompareStringOrdinal(info->FileName, (int)name_length, file_name.c_str(), (int)file_name.size(), TRUE) == CSTR_EQUAL)
+				return true;
+
+			if (info->NextEntryOffset == 0)
+				return false;
+
+			info = (const FILE_NOTIFY_INFORMATION*)((const BYTE*)info + info->NextEntryOffset);
+		}
+	}
+#endif
+
+	// ============ FileWatcher ============
+
+	FileWatcher::FileWatcher(std::filesystem::path file, Callback callback, std::chrono::milliseconds settle_time)
+		: m_file(std::filesystem::absolute(file)), m_callback(std::move(callback)), m_settle_time(settle_time)
+	{
+		m_fingerprint = readFingerprint();
+
+#if defined(_WIN32)
+		m_stop_event = CreateEvent(NULL, TRUE, FALSE, NULL);
+#elif defined(__linux__)
+		if (pipe(m_wake_pipe) != 0)
+			m_wake_pipe[0] = m_wake_pipe[1] = -1;
+#endif
+
+#if defined(_WIN32) || defined(__linux__)
+		m_thread = std::thread(&FileWatcher::run, this);
+
+		// wait until the thread is watching the directory, so no change after the constructor returns is missed.
+		m_ready.wait(false, std::memory_order_acquire);
+
+		if (!isWatching())
+			ECHOMIDI_LOG(LogLevel::WARN, "could not watch the directory of a file, changes are not detected", m_file.filename().string());
+#endif
+	}
+
+	FileWatcher::~FileWatcher()
+	{
+		m_running.store(false, std::memory_order_release);
+
+#if defined(_WIN32)
+		if (m_stop_event != NULL)
+			SetEvent(m_stop_event);
+#elif defined(__linux__)
+		char wake = 0;
+
+		// the pipe is empty, so the write cannot fail or block.
+		if (m_wake_pipe[1] >= 0)
+		{
+			[[maybe_unused]] ssize_t written = write(m_wake_pipe[1], &wake, 1);
+		}
+#endif
+
+		if (m_thread.joinable())
+			m_thread.join();
+
+#if defined(_WIN32)
+		if (m_stop_event != NULL)
+			CloseHandle(m_stop_event);
+#elif defined(__linux__)
+		if (m_wake_pipe[0] >= 0)
+		{
+			close(m_wake_pipe[0]);
+			close(m_wake_pipe[1]);
+		}
+#endif
+	}
+
+	std::optional<size_t> FileWatcher::readFingerprint()
+	{
+		std::ifstream file_in(m_file, std::ios_base::binary);
+
+		if (!file_in)
+			return std::nullopt;
+
+		std::string contents((std::istreambuf_iterator<char>(file_in)), std::istreambuf_iterator<char>());
+
+		return std::hash<std::string>()(contents);
+	}
+
+	void FileWatcher::notify()
+	{
+		std::optional<size_t> fingerprint = readFingerprint();
+
+		// a file that was deleted, or is still locked by the editor, is reported once it can be read again.
+		if (!fingerprint || fingerprint == m_fingerprint)
+			return;
+
+		m_fingerprint = fingerprint;
+
+		if (m_running.load(std::memory_order_acquire))
+			m_callback();
+	}
+
+#if defined(_WIN32)
+	void FileWatcher::run()
+	{
+		// the directory is watched instead of the file, as editors often replace the file, instead of writing to it.
+		HANDLE directory = CreateFileW(m_file.parent_path().wstring().c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+			NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, NULL);
+
+		OVERLAPPED overlapped = {};
+		overlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+
+		// FILE_NOTIFY_INFORMATION must be DWORD aligned.
+		auto buffer = std::make_unique<DWORD[]>(NOTIFY_BUFFER_SIZE / sizeof(DWORD));
+		std::wstring file_name = m_file.filename().wstring();
+
+		auto watch = [&]()
+		{
+			return ReadDirectoryChangesW(directory, buffer.get(), (DWORD)NOTIFY_BUFFER_SIZE, FALSE,
+				FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_SIZE, NULL, &overlapped, NULL) != FALSE;
+		};
+
+		bool watching = directory != INVALID_HANDLE_VALUE && overlapped.hEvent != NULL && m_stop_event != NULL && watch();
+
+		m_watching.store(watching, std::memory_order_release);
+		m_ready.store(true, std::memory_order_release);
+		m_ready.notify_all();
+
+		bool pending = false;
+		auto settle_deadline = std::chrono::steady_clock::now();
+
+		HANDLE handles[2] = { overlapped.hEvent, m_stop_event };
+
+		while (watching && m_running.load(std::memory_order_acquire))
+		{
+			// without a pending change, the thread sleeps until the next notification.
+			DWORD timeout = pending ? (DWORD)remainingMs(settle_deadline) : INFINITE;
+			DWORD res = WaitForMultipleObjects(2, handles, FALSE, timeout);
+
+			if (res == WAIT_OBJECT_0)
+			{
+				DWORD bytes = 0;
+
+				// an overflowed buffer reports no notifications at all, in which case the file may have changed as well.
+				if (GetOverlappedResult(directory, &overlapped, &bytes, FALSE) && (bytes == 0 || mentionsFile((const BYTE*)buffer.get(), file_name)))
+				{
+					pending = true;
+					settle_deadline = std::chrono::steady_clock::now() + m_settle_time;
+				}
+
+				ResetEvent(overlapped.hEvent);
+
+				if (!watch())
+				{
+					ECHOMIDI_LOG_OS_ERROR(LogLevel::WARN, "stopped watching the directory of a file", GetLastError());
+					break;
+				}
+			}
+			else if (res != WAIT_TIMEOUT)
+			{
+				break;
+			}
+
+			if (pending && std::chrono::steady_clock::now() >= settle_deadline)
+			{
+				pending = false;
+				notify();
+			}
+		}
+
+		if (watching)
+		{
+			DWORD bytes = 0;
+
+			// the buffer must stay alive until the cancelled read has completed.
+			CancelIoEx(directory, &overlapped);
+			GetOverlappedResult(directory, &overlapped, &bytes, TRUE);
+		}
+
+		if (overlapped.hEvent != NULL)
+			CloseHandle(overlapped.hEvent);
+
+		if (directory != INVALID_HANDLE_VALUE)
+			CloseHandle(directory);
+	}
+#elif defined(__linux__)
+	void FileWatcher::run()
+	{
+		int notify_fd = m_wake_pipe[0] >= 0 ? inotify_init1(IN_NONBLOCK | IN_CLOEXEC) : -1;
+
+		// the directory is watched instead of the file, as editors often replace the file, instead of writing to it.
+		if (notify_fd >= 0 && inotify_add_watch(notify_fd, m_file.parent_path().c_str(), IN_CLOSE_WRITE | IN_MODIFY | IN_CREATE | IN_MOVED_TO | IN_DELETE) < 0)
+		{
+			close(notify_fd);
+			notify_fd = -1;
+		}
+
+		m_watching.store(notify_fd >= 0, std::memory_order_release);
+		m_ready.store(true, std::memory_order_release);
+		m_ready.notify_all();
+
+		if (notify_fd < 0)
+			return;
+
+		pollfd fds[2] = { { notify_fd, POLLIN, 0 }, { m_wake_pipe[0], POLLIN, 0 } };
+
+		alignas(inotify_event) char buffer[NOTIFY_BUFFER_SIZE];
+		std::string file_name = m_file.filename().string();
+
+		bool pending = false;
+		auto settle_deadline = std::chrono::steady_clock::now();
+
+		while (m_running.load(std::memory_order_acquire))
+		{
+			// without a pending change, the thread sleeps until the next notification.
+			int timeout = pending ? (int)remainingMs(settle_deadline) : -1;
+
+			if (poll(fds, 2, timeout) < 0 && errno != EINTR)
+				break;
+
+			ssize_t length;
+
+			while ((length = read(notify_fd, buffer, sizeof(buffer))) > 0)
+			{
+				for (char* ptr = buffer; ptr < buffer + length;)
+				{
+					const inotify_event* ev = (const inotify_event*)ptr;
+
+					// an overflowed queue drops notifications, in which case the file may have changed as well.
+					if ((ev->mask & IN_Q_OVERFLOW) || (ev->len > 0 && file_name == ev->name))
+					{
+						pending = true;
+						settle_deadline = std::chrono::steady_clock::now() + m_settle_time;
+					}
+
+					ptr += sizeof(inotify_event) + ev->len;
+				}
+			}
+
+			if (pending && std::chrono::steady_clock::now() >= settle_deadline)
+			{
+				pending = false;
+				notify();
+			}
+		}
+
+		close(notify_fd);
+	}
+#else
+	void FileWatcher::run()
+	{
+	}
+#endif
+}
@@ -1,39 +1,133 @@
-// Any HWIND specific code will be defined in this file
+// Any HWIND specific code will be defined in this file, as well as the X11 focus provider used on linux.
 
 #include "FocusHook.h"
 #include "Echoer.h"
+#include "FocusIndex.h"
+#include "Logger.h"
+#include "Realtime.h"
+#include "Snapshot.h"
 
-#include <iostream>
-#include <fstream>
-#include <set>
+#include <algorithm>
+#include <mutex>
 #include <thread>
+#include <unordered_map>
+
+// xlib defines macros like None, Bool and Status, so it is included after everything else.
+#ifdef ECHOMIDI_FOCUS_X11
+#include <X11/Xlib.h>
+#include <X11/Xatom.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <cerrno>
+#endif
 
 namespace EchoMIDI
 {
 
-#define BADOUTID(bad_id) BadDeviceID(MIDIIOType::INPUT, bad_id, midiOutGetNumDevs())
-#define BADINID(bad_id) BadDeviceID(MIDIIOType::OUTPUT, bad_id, midiInGetNumDevs())
+#define BADOUTID(bad_id) BadDeviceID(MIDIIOType::INPUT, bad_id, Backend::getOutputCount())
+#define BADINID(bad_id) BadDeviceID(MIDIIOType::OUTPUT, bad_id, Backend::getInputCount())
 
-	std::ofstream log_file;
+	// the mask and focus send rules of every registered Echoer, compiled into focus_index on every change.
+	struct RegisteredEchoer
+	{
+		MuteMask* mask;
+		std::vector<FocusRule> rules;
+	};
 
-	HWINEVENTHOOK focus_hook;
+	// serializes every change to the registered echoers, and thereby every publish of focus_index.
+	std::mutex echoers_mutex;
+	std::unordered_map<Echoer*, RegisteredEchoer> registered_echoers;
+	Snapshot<FocusIndex> focus_index;
 
-	std::set<Echoer*> registered_echoers;
+	// echoers_mutex must be held by the caller.
+	void publishFocusIndex()
+	{
+		auto index = std::make_unique<FocusIndex>();
 
-	std::thread msg_thread;
+		for (auto& [echoer, registered] : registered_echoers)
+			index->add(*registered.mask, registered.rules);
 
-	HRESULT winErr(HRESULT err, const char* file, size_t line)
+		// waits until the focus hook is done with the previous index, so no unregistered Echoer is referenced after this returns.
+		focus_index.publish(std::move(index));
+	}
+
+	// the executable the focus mute state of every Echoer was last updated for.
+	std::mutex focused_path_mutex;
+	std::filesystem::path focused_path;
+
+	std::atomic<uint32_t> focus_debounce_ms = (uint32_t)FOCUS_DEBOUNCE_TIME.count();
+
+	std::atomic<size_t> focus_event_count = 0;
+	std::atomic<size_t> focus_switch_count = 0;
+	std::atomic<size_t> path_cache_hit_count = 0;
+	std::atomic<size_t> path_cache_miss_count = 0;
+	LatencyHistogram focus_switch_latency;
+
+	// updates every Echoer, if the focused executable changed, and records how long ago the change started.
+	// changed_at is 0 for the focus found on startup, which is not counted as a switch.
+	void applyFocusedPath(const std::filesystem::path& window_path, int64_t changed_at)
 	{
-		std::stringstream msg;
+		{
+			std::lock_guard lock(focused_path_mutex);
+
+			// switching between windows of the same executable leaves every mute state unchanged.
+			if (window_path == focused_path)
+				return;
+
+			focused_path = window_path;
+		}
+
+		focus_index.read()->apply(window_path);
 
-		if (err != ERROR_SUCCESS)
 		{
-			msg << std::system_category().message(err) << " (" << err << "): at " << file << " : " << line << '\n';
+			std::lock_guard lock(echoers_mutex);
 
-			log_file << msg.str();
-			std::cout << msg.str();
+			// targets that just lost focus would never recieve the note offs of the notes still sounding on them.
+			for (auto& [echoer, registered] : registered_echoers)
+			{
+				if (!registered.rules.empty())
+					echoer->releaseMutedNotes();
+			}
 		}
 
+		if (changed_at == 0)
+			return;
+
+		focus_switch_count.fetch_add(1, std::memory_order_relaxed);
+		focus_switch_latency.record(latencyNow() - changed_at);
+	}
+
+#ifdef _WIN32
+	HWINEVENTHOOK focus_hook;
+
+	std::thread msg_thread;
+	DWORD msg_thread_id = 0;
+
+	// posted to the msg thread by processExited(), the wparam holds the pid of the process.
+	static constexpr UINT WM_PROCESS_EXITED = WM_APP + 1;
+
+	// an executable path resolved by getProcessPath(), kept until the process exits, as its pid may then be reused.
+	struct CachedProcess
+	{
+		std::filesystem::path path;
+		HANDLE process = NULL;
+		HANDLE exit_wait = NULL;
+	};
+
+	// only ever accessed from the msg thread.
+	std::unordered_map<DWORD, CachedProcess> process_cache;
+
+	// the pending debounce timer, and latencyNow() of the first foreground event since the focus was last applied, 0 if none is pending.
+	UINT_PTR debounce_timer = 0;
+	int64_t foreground_changed_at = 0;
+
+	// only queues a log record, so a failing call never blocks the hook thread on file or console output.
+	HRESULT winErr(HRESULT err, const char* file, size_t line)
+	{
+		if (err != ERROR_SUCCESS)
+			logOSError(LogLevel::ERR, file, (uint32_t)line, "windows api call failed", err);
+
 		return err;
 	}
 
@@ -47,24 +141,9 @@ namespace EchoMIDI
 
 #define WINERR(err) winErr((DWORD) err, TEXT(__RELATIVE_FILE__), __LINE__)
 #define WINERRB(err) winErrB((std::ptrdiff_t) err, TEXT(__RELATIVE_FILE__), __LINE__)
+#endif
 
-	void setLogFile(std::filesystem::path lout, bool clear)
-	{
-		if (!clear && std::filesystem::exists(lout))
-			log_file.open(lout, std::ios_base::app);
-		else
-			log_file.open(lout);
-
-		log_file << "======================== LOG STARTED ========================\n";
-	}
-
-	// close and save the log file
-	void closeLogFile()
-	{
-		log_file << "========================= LOG ENDED =========================\n";
-		log_file.close();
-	}
-
+#ifdef _WIN32
 	std::filesystem::path getHWNDPath(HWND window)
 	{
 		if (!IsWindow(window))
@@ -93,70 +172,487 @@ namespace EchoMIDI
 		return win_path;
 	}
 
-	void registerEchoer(Echoer* echoer)
+	std::filesystem::path getFocusedPath()
 	{
-		registered_echoers.insert(echoer);
+		{
+			std::lock_guard lock(focused_path_mutex);
+
+			// kept up to date by the focus hook, once it has seen the first foreground change.
+			if (!focused_path.empty())
+				return focused_path;
+		}
+
+		return getHWNDPath(GetForegroundWindow());
 	}
 
-	void unregisterEchoer(Echoer* echoer)
+	// runs on a thread pool thread, the cache itself is only modified by the msg thread.
+	void CALLBACK processExited(void* pid, BOOLEAN timed_out)
 	{
-		registered_echoers.erase(echoer);
+		PostThreadMessage(msg_thread_id, WM_PROCESS_EXITED, (WPARAM)pid, NULL);
 	}
 
-	// In order to reduce overhead, a single global hook is used for all Echoer instances.
-	void focusHook(HWINEVENTHOOK hwin_hook, DWORD event_id, HWND window, LONG id_object, LONG id_child, DWORD id_event_thread, DWORD event_time)
+	void forgetProcess(DWORD pid)
 	{
-		if (event_id == EVENT_OBJECT_FOCUS)
+		auto it = process_cache.find(pid);
+
+		if (it == process_cache.end())
+			return;
+
+		// the wait has already fired or is cancelled here, so this never blocks the msg thread for long.
+		if (it->second.exit_wait != NULL)
+			UnregisterWaitEx(it->second.exit_wait, INVALID_HANDLE_VALUE);
+
+		WINERRB(CloseHandle(it->second.process));
+
+		process_cache.erase(it);
+	}
+
+	// returns the executable path of the process, resolved once per process, and cached until it exits.
+	std::filesystem::path getProcessPath(DWORD pid)
+	{
+		auto it = process_cache.find(pid);
+
+		if (it != process_cache.end())
 		{
-			std::filesystem::path window_path = getHWNDPath(window);
+			// the exit notification may still be on its way, in which case the pid may already belong to another process.
+			if (WaitForSingleObject(it->second.process, 0) != WAIT_OBJECT_0)
+			{
+				path_cache_hit_count.fetch_add(1, std::memory_order_relaxed);
+				return it->second.path;
+			}
 
-			// ignore if invalid window was passed.
-			if (window_path == "")
-				return;
+			forgetProcess(pid);
+		}
+
+		path_cache_miss_count.fetch_add(1, std::memory_order_relaxed);
+
+		// limited information is enough for the image name, and is also granted for most elevated processes.
+		HANDLE process = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION | SYNCHRONIZE, FALSE, pid);
+
+		// not high enough privilages
+		if (process == NULL)
+			return "";
 
-			for (Echoer* echoer : registered_echoers)
+		TCHAR win_path[MAX_PATH];
+		DWORD len = MAX_PATH;
+
+		if (!WINERRB(QueryFullProcessImageName(process, NULL, win_path, &len)))
+		{
+			WINERRB(CloseHandle(process));
+			return "";
+		}
+
+		CachedProcess& cached = process_cache[pid];
+		cached.path = win_path;
+		cached.process = process;
+
+		if (!WINERRB(RegisterWaitForSingleObject(&cached.exit_wait, process, processExited, (void*)(uintptr_t)pid, INFINITE, WT_EXECUTEONLYONCE)))
+			cached.exit_wait = NULL;
+
+		return cached.path;
+	}
+#else
+	std::filesystem::path getFocusedPath()
+	{
+		std::lock_guard lock(focused_path_mutex);
+
+		return focused_path;
+	}
+#endif
+
+#ifdef ECHOMIDI_FOCUS_X11
+	std::thread focus_thread;
+	Display* focus_display = nullptr;
+	XErrorHandler previous_error_handler = nullptr;
+
+	// wakes up the focus thread, when EchoMIDICleanup() is called.
+	int focus_wake_pipe[2] = { -1, -1 };
+
+	// an executable path resolved by getProcessPath(), kept until the process exits, as its pid may then be reused.
+	struct CachedProcess
+	{
+		std::filesystem::path path;
+		// becomes readable once the process exits.
+		int pidfd = -1;
+	};
+
+	// only ever accessed from the focus thread.
+	std::unordered_map<pid_t, CachedProcess> process_cache;
+
+	// the active window may be destroyed before its properties are read, which must not end the process like the default handler does.
+	int ignoreFocusErrors(Display* display, XErrorEvent* err)
+	{
+		if (display == focus_display)
+			return 0;
+
+		return previous_error_handler ? previous_error_handler(display, err) : 0;
+	}
+
+	void forgetProcess(pid_t pid)
+	{
+		auto it = process_cache.find(pid);
+
+		if (it == process_cache.end())
+			return;
+
+		close(it->second.pidfd);
+
+		process_cache.erase(it);
+	}
+
+	// returns the executable path of the process, resolved once per process, and cached until it exits.
+	std::filesystem::path getProcessPath(pid_t pid)
+	{
+		auto it = process_cache.find(pid);
+
+		if (it != process_cache.end())
+		{
+			pollfd exited = { it->second.pidfd, POLLIN, 0 };
+
+			// the exit may not have been noticed by the focus thread yet, in which case the pid may already belong to another process.
+			if (poll(&exited, 1, 0) == 0)
 			{
-				for (auto& [id, midi_out] : *echoer)
-				{
-					if (midi_out.focus_send_path.empty())
-						continue;
-
-					if (// check if the two paths match excactly
-						midi_out.focus_send_path.has_parent_path() && midi_out.focus_send_path == window_path ||
-						// if the path is relative, only check the executable name, accounting for a lack of extension aswell
-						!midi_out.focus_send_path.has_parent_path() &&
-						(midi_out.focus_send_path.has_extension() && midi_out.focus_send_path.filename() == window_path.filename() ||
-							midi_out.focus_send_path.filename() == window_path.filename().replace_extension("")))
-					{
-						midi_out.focus_muted = false;
-					}
-					else
-					{
-						midi_out.focus_muted = true;
-					}
-				}
+				path_cache_hit_count.fetch_add(1, std::memory_order_relaxed);
+				return it->second.path;
 			}
+
+			forgetProcess(pid);
 		}
+
+		path_cache_miss_count.fetch_add(1, std::memory_order_relaxed);
+
+		std::error_code err;
+		std::filesystem::path path = std::filesystem::read_symlink("/proc/" + std::to_string(pid) + "/exe", err);
+
+		// processes of other users cannot be queried.
+		if (err)
+			return "";
+
+		int pidfd = -1;
+
+#ifdef SYS_pidfd_open
+		pidfd = (int)syscall(SYS_pidfd_open, pid, 0);
+#endif
+
+		// without pidfds (linux < 5.3), the exit of the process cannot be noticed, so the path is not cached.
+		if (pidfd < 0)
+			return path;
+
+		process_cache[pid] = { path, pidfd };
+
+		return path;
+	}
+
+	// reads a single 32 bit value of a window property, xlib returns these as longs.
+	bool getWindowProperty(Display* display, Window window, Atom property, Atom type, unsigned long& value)
+	{
+		Atom actual_type;
+		int actual_format;
+		unsigned long count, remaining;
+		unsigned char* data = nullptr;
+
+		if (XGetWindowProperty(display, window, property, 0, 1, False, type, &actual_type, &actual_format, &count, &remaining, &data) != Success)
+			return false;
+
+		bool found = data != nullptr && actual_type == type && actual_format == 32 && count == 1;
+
+		if (found)
+			value = *(unsigned long*)data;
+
+		if (data != nullptr)
+			XFree(data);
+
+		return found;
+	}
+
+	// resolves the active window to its executable, through its _NET_WM_PID, and updates every Echoer.
+	void applyActiveWindow(Display* display, Window root, Atom active_window, Atom wm_pid, int64_t changed_at)
+	{
+		unsigned long window = None;
+		unsigned long pid = 0;
+
+		if (!getWindowProperty(display, root, active_window, XA_WINDOW, window) || window == None)
+			return;
+
+		if (!getWindowProperty(display, (Window)window, wm_pid, XA_CARDINAL, pid) || pid == 0)
+			return;
+
+		std::filesystem::path window_path = getProcessPath((pid_t)pid);
+
+		// ignore windows of processes which cannot be queried.
+		if (window_path == "")
+			return;
+
+		applyFocusedPath(window_path, changed_at);
+	}
+
+	void focusThread(Display* display)
+	{
+		Window root = DefaultRootWindow(display);
+		Atom active_window = XInternAtom(display, "_NET_ACTIVE_WINDOW", False);
+		Atom wm_pid = XInternAtom(display, "_NET_WM_PID", False);
+
+		// the window manager announces every change of the active window, as a property change of the root window.
+		XSelectInput(display, root, PropertyChangeMask);
+
+		applyActiveWindow(display, root, active_window, wm_pid, 0);
+
+		updateThreadRealtime();
+
+		// latencyNow() of the first change since the focus was last applied, 0 if none is pending.
+		int64_t changed_at = 0;
+		int64_t settle_deadline = 0;
+
+		std::vector<pollfd> fds;
+		std::vector<pid_t> fd_pids;
+
+		while (true)
+		{
+			if (changed_at != 0 && latencyNow() >= settle_deadline)
+			{
+				applyActiveWindow(display, root, active_window, wm_pid, changed_at);
+				changed_at = 0;
+			}
+
+			// xlib may already have read events into its own queue, e.g. whilst reading a property, which poll() cannot see.
+			while (XPending(display) > 0)
+			{
+				XEvent ev;
+				XNextEvent(display, &ev);
+
+				if (ev.type != PropertyNotify || ev.xproperty.atom != active_window)
+					continue;
+
+				focus_event_count.fetch_add(1, std::memory_order_relaxed);
+
+				int64_t now = latencyNow();
+
+				if (changed_at == 0)
+					changed_at = now;
+
+				// a burst of changes is only resolved once, after it has settled.
+				settle_deadline = now + (int64_t)focus_debounce_ms.load(std::memory_order_relaxed) * 1'000'000;
+			}
+
+			// the display, the wake pipe, and the pidfd of every cached process.
+			fds.clear();
+			fd_pids.clear();
+
+			fds.push_back({ ConnectionNumber(display), POLLIN, 0 });
+			fds.push_back({ focus_wake_pipe[0], POLLIN, 0 });
+
+			for (auto& [pid, cached] : process_cache)
+			{
+				fds.push_back({ cached.pidfd, POLLIN, 0 });
+				fd_pids.push_back(pid);
+			}
+
+			// without a pending change, the thread sleeps until the next event.
+			int timeout = -1;
+
+			if (changed_at != 0)
+				timeout = (int)std::max<int64_t>(0, (settle_deadline - latencyNow() + 999'999) / 1'000'000);
+
+			if (poll(fds.data(), fds.size(), timeout) < 0 && errno != EINTR)
+				break;
+
+			if (fds[1].revents != 0)
+				break;
+
+			for (size_t i = 2; i < fds.size(); i++)
+			{
+				if (fds[i].revents != 0)
+					forgetProcess(fd_pids[i - 2]);
+			}
+
+			// a changed realtime config is picked up with the next focus change.
+			updateThreadRealtime();
+		}
+
+		while (!process_cache.empty())
+			forgetProcess(process_cache.begin()->first);
+	}
+#endif
+
+	void setFocusDebounce(std::chrono::milliseconds debounce)
+	{
+		focus_debounce_ms.store((uint32_t)std::max<int64_t>(debounce.count(), 0), std::memory_order_relaxed);
+	}
+
+	std::chrono::milliseconds getFocusDebounce()
+	{
+		return std::chrono::milliseconds(focus_debounce_ms.load(std::memory_order_relaxed));
+	}
+
+	FocusStats getFocusStats()
+	{
+		FocusStats stats;
+
+		stats.event_count = focus_event_count.load(std::memory_order_relaxed);
+		stats.switch_count = focus_switch_count.load(std::memory_order_relaxed);
+		stats.cache_hit_count = path_cache_hit_count.load(std::memory_order_relaxed);
+		stats.cache_miss_count = path_cache_miss_count.load(std::memory_order_relaxed);
+		stats.switch_latency = focus_switch_latency.getSummary();
+
+		return stats;
+	}
+
+	void resetFocusStats()
+	{
+		focus_event_count.store(0, std::memory_order_relaxed);
+		focus_switch_count.store(0, std::memory_order_relaxed);
+		path_cache_hit_count.store(0, std::memory_order_relaxed);
+		path_cache_miss_count.store(0, std::memory_order_relaxed);
+		focus_switch_latency.reset();
+	}
+
+	void registerEchoer(Echoer* echoer, MuteMask& mask)
+	{
+		std::lock_guard lock(echoers_mutex);
+
+		// an Echoer without any rules is left out of the index, so nothing needs to be published yet.
+		registered_echoers[echoer] = { &mask, {} };
+	}
+
+	void unregisterEchoer(Echoer* echoer)
+	{
+		std::lock_guard lock(echoers_mutex);
+
+		auto it = registered_echoers.find(echoer);
+
+		if (it == registered_echoers.end())
+			return;
+
+		bool had_rules = !it->second.rules.empty();
+
+		registered_echoers.erase(it);
+
+		if (had_rules)
+			publishFocusIndex();
+	}
+
+	void setFocusRules(Echoer* echoer, std::vector<FocusRule> rules)
+	{
+		std::lock_guard lock(echoers_mutex);
+
+		auto it = registered_echoers.find(echoer);
+
+		if (it == registered_echoers.end() || it->second.rules == rules)
+			return;
+
+		it->second.rules = std::move(rules);
+
+		publishFocusIndex();
+	}
+
+	size_t getFocusRuleCount()
+	{
+		return focus_index.read()->getRuleCount();
+	}
+
+	bool focusSendMatches(const std::filesystem::path& focus_send_path, const std::filesystem::path& window_path)
+	{
+		// check if the two paths match excactly
+		if (focus_send_path.has_parent_path())
+			return FocusIndex::getKey(focus_send_path) == FocusIndex::getKey(window_path);
+
+		// if the path is relative, only check the executable name, accounting for a lack of extension aswell
+		std::string name_key = FocusIndex::getKey(focus_send_path.filename());
+		std::filesystem::path file_name = window_path.filename();
+
+		return name_key == FocusIndex::getKey(file_name) || name_key == FocusIndex::getKey(file_name.replace_extension(""));
+	}
+
+#ifdef _WIN32
+	// resolves the window that is in the foreground once the debounce timer fires, and updates every Echoer.
+	void applyForegroundWindow()
+	{
+		int64_t changed_at = foreground_changed_at;
+		foreground_changed_at = 0;
+
+		DWORD pid = 0;
+		HWND window = GetForegroundWindow();
+
+		if (window == NULL || GetWindowThreadProcessId(window, &pid) == 0)
+			return;
+
+		std::filesystem::path window_path = getProcessPath(pid);
+
+		// ignore windows of processes which cannot be queried.
+		if (window_path == "")
+			return;
+
+		applyFocusedPath(window_path, changed_at);
+	}
+
+	// In order to reduce overhead, a single global hook is used for all Echoer instances.
+	// only foreground changes are hooked, focus changes between the controls of a single application never change the executable.
+	void focusHook(HWINEVENTHOOK hwin_hook, DWORD event_id, HWND window, LONG id_object, LONG id_child, DWORD id_event_thread, DWORD event_time)
+	{
+		if (event_id != EVENT_SYSTEM_FOREGROUND)
+			return;
+
+		focus_event_count.fetch_add(1, std::memory_order_relaxed);
+
+		if (foreground_changed_at == 0)
+			foreground_changed_at = latencyNow();
+
+		// restarts the timer if it is already pending, so a burst of foreground changes, e.g. alt tabbing past several windows,
+		// is only resolved once, after it has settled.
+		debounce_timer = SetTimer(NULL, debounce_timer, focus_debounce_ms.load(std::memory_order_relaxed), NULL);
 	}
 
 	void msgThread()
 	{
-		focus_hook = SetWinEventHook(EVENT_OBJECT_FOCUS, EVENT_OBJECT_FOCUS, NULL, focusHook, NULL, NULL, WINEVENT_OUTOFCONTEXT | WINEVENT_SKIPOWNTHREAD);
+		msg_thread_id = GetCurrentThreadId();
+
+		focus_hook = SetWinEventHook(EVENT_SYSTEM_FOREGROUND, EVENT_SYSTEM_FOREGROUND, NULL, focusHook, NULL, NULL, WINEVENT_OUTOFCONTEXT | WINEVENT_SKIPOWNTHREAD);
 		WINERRB(focus_hook);
 
+		updateThreadRealtime();
+
 		MSG msg;
 
 		while (GetMessage(&msg, NULL, NULL, NULL))
 		{
-			TranslateMessage(&msg);
-			DispatchMessage(&msg);
+			// thread timers and messages have no window, so they are handled here instead of being dispatched.
+			if (msg.hwnd == NULL && msg.message == WM_TIMER && msg.wParam == debounce_timer)
+			{
+				KillTimer(NULL, debounce_timer);
+				debounce_timer = 0;
+
+				applyForegroundWindow();
+			}
+			else if (msg.hwnd == NULL && msg.message == WM_PROCESS_EXITED)
+			{
+				forgetProcess((DWORD)msg.wParam);
+			}
+			else
+			{
+				TranslateMessage(&msg);
+				DispatchMessage(&msg);
+			}
+
+			// a changed realtime config is picked up with the next focus change.
+			updateThreadRealtime();
 		}
 
 		WINERRB(UnhookWinEvent(focus_hook));
+
+		if (debounce_timer != 0)
+			KillTimer(NULL, debounce_timer);
+
+		debounce_timer = 0;
+		foreground_changed_at = 0;
+
+		while (!process_cache.empty())
+			forgetProcess(process_cache.begin()->first);
 	}
 
 	void EchoMIDIInit()
 	{
+		startLogger();
+
 		msg_thread = std::thread(msgThread);
 	}
 
@@ -165,5 +661,71 @@ namespace EchoMIDI
 		PostThreadMessage(GetThreadId(msg_thread.native_handle()), WM_QUIT, NULL, NULL);
 
 		msg_thread.join();
+
+		// stopped last, so everything logged by the msg thread is still written.
+		stopLogger();
+	}
+#elif defined(ECHOMIDI_FOCUS_X11)
+	void EchoMIDIInit()
+	{
+		startLogger();
+
+		// without a display, e.g. on a headless machine, the focused executable is never known, and focus send targets stay muted.
+		Display* display = XOpenDisplay(nullptr);
+
+		if (display == nullptr)
+		{
+			ECHOMIDI_LOG(LogLevel::WARN, "no X11 display, focus send targets stay muted");
+			return;
+		}
+
+		if (pipe(focus_wake_pipe) != 0)
+		{
+			ECHOMIDI_LOG_OS_ERROR(LogLevel::ERR, "could not create the focus wake pipe", errno);
+			XCloseDisplay(display);
+			return;
+		}
+
+		focus_display = display;
+		previous_error_handler = XSetErrorHandler(ignoreFocusErrors);
+
+		focus_thread = std::thread(focusThread, display);
+	}
+
+	void EchoMIDICleanup()
+	{
+		if (!focus_thread.joinable())
+		{
+			stopLogger();
+			return;
+		}
+
+		char wake = 0;
+
+		// the pipe is empty, so the write cannot fail or block.
+		[[maybe_unused]] ssize_t written = write(focus_wake_pipe[1], &wake, 1);
+
+		focus_thread.join();
+
+		XSetErrorHandler(previous_error_handler);
+		XCloseDisplay(focus_display);
+		focus_display = nullptr;
+
+		close(focus_wake_pipe[0]);
+		close(focus_wake_pipe[1]);
+		focus_wake_pipe[0] = focus_wake_pipe[1] = -1;
+
+		stopLogger();
+	}
+#else
+	void EchoMIDIInit()
+	{
+		startLogger();
+	}
+
+	void EchoMIDICleanup()
+	{
+		stopLogger();
 	}
+#endif
 }
@@ -0,0 +1,95 @@
+#include "FocusIndex.h"
+
+#include <algorithm>
+#include <cctype>
+
+namespace EchoMIDI
+{
+	void FocusIndex::add(MuteMask& mask, const std::vector<FocusRule>& rules)
+	{
+		// the words of this mask are appended after the words of every previous mask.
+		size_t first_word = m_words.size();
+
+		for (const FocusRule& rule : rules)
+		{
+			if (rule.exec.empty())
+				continue;
+
+			uint32_t word = rule.slot / MuteMask::TARGETS_PER_WORD;
+			uint32_t bit = 1u << (rule.slot % MuteMask::TARGETS_PER_WORD);
+
+			auto mask_word = std::find_if(m_words.begin() + first_word, m_words.end(), [&](const MaskWord& w) { return w.word == word; });
+
+			if (mask_word == m_words.end())
+				mask_word = m_words.insert(m_words.end(), MaskWord{ &mask, word, 0 });
+
+			mask_word->slots |= bit;
+
+			// a relative path only names the executable, and matches it in any directory.
+			std::string key = getKey(rule.exec.has_parent_path() ? rule.exec : rule.exec.filename());
+			std::vector<Match>& matches = m_matches[key];
+			uint32_t index = (uint32_t)(mask_word - m_words.begin());
+
+			auto match = std::find_if(matches.begin(), matches.end(), [&](const Match& m) { return m.mask_word == index; });
+
+			if (match == matches.end())
+				matches.push_back({ index, bit });
+			else
+				match->slots |= bit;
+
+			m_rule_count++;
+		}
+	}
+
+	void FocusIndex::apply(const std::filesystem::path& window_path) const
+	{
+		if (m_words.empty())
+			return;
+
+		// only ever used by the focus hook thread, so it is allocated once instead of on every focus change.
+		thread_local std::vector<uint32_t> muted;
+
+		muted.resize(m_words.size());
+
+		for (size_t i = 0; i < m_words.size(); i++)
+			muted[i] = m_words[i].slots;
+
+		auto unmute = [&](const std::string& key)
+			{
+				auto it = m_matches.find(key);
+
+				if (it == m_matches.end())
+					return;
+
+				for (const Match& match : it->second)
+					muted[match.mask_word] &= ~match.slots;
+			};
+
+		std::filesystem::path file_name = window_path.filename();
+
+		std::string name_key = getKey(file_name);
+		std::string stem_key = getKey(file_name.replace_extension(""));
+
+		unmute(getKey(window_path));
+		unmute(name_key);
+
+		// a rule without an extension matches the executable with any extension.
+		if (stem_key != name_key)
+			unmute(stem_key);
+
+		for (size_t i = 0; i < m_words.size(); i++)
+			m_words[i].mask->setFocusMutedWord(m_words[i].word, m_words[i].slots, muted[i]);
+	}
+
+	std::string FocusIndex::getKey(const std::filesystem::path& path)
+	{
+		std::string key = path.lexically_normal().generic_string();
+
+#ifdef _WIN32
+		// file names are case insensitive on windows.
+		std::transform(key.begin(), key.end(), key.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+#endif
+
+		return key;
+	}
+}
@@ -0,0 +1,302 @@
+#include "Logger.h"
+#include "MPSCQueue.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+
+namespace EchoMIDI
+{
+	// ============ Log ring ============
+
+	MPSCQueue<LogRecord, LOG_RING_SIZE> log_ring;
+
+	std::atomic<LogLevel> log_level = LogLevel::INFO;
+	std::atomic<bool> log_console = true;
+
+	// incremented after every push, the logger thread waits on it while the ring is empty.
+	std::atomic<uint32_t> log_signal = 0;
+	std::atomic<bool> logger_running = false;
+	std::thread logger_thread;
+
+	// serializes the consumer side of log_ring and every write to the sinks, records are pushed without ever taking it.
+	std::mutex sink_mutex;
+	std::ofstream log_file;
+	// the ring drop count the last dropped records line was written for.
+	size_t reported_drop_count = 0;
+	// reused for every record, so formatting only allocates until the line has grown to its largest size.
+	std::string log_line;
+
+	LogRecord makeRecord(LogLevel level, const char* file, uint32_t line, const char* message)
+	{
+		LogRecord record;
+		record.timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+		record.file = file;
+		record.message = message;
+		record.line = line;
+		record.level = level;
+
+		return record;
+	}
+
+	void pushRecord(const LogRecord& record)
+	{
+		// a full ring drops the record, the drop is reported by the logger thread.
+		if (!log_ring.push(record))
+			return;
+
+		log_signal.fetch_add(1, std::memory_order_release);
+		log_signal.notify_one();
+	}
+
+	void logMessage(LogLevel level, const char* file, uint32_t line, const char* message, std::string_view text, std::initializer_list<int64_t> values)
+	{
+		if (level < log_level.load(std::memory_order_relaxed))
+			return;
+
+		LogRecord record = makeRecord(level, file, line, message);
+
+		// longer texts are truncated, the record has a fixed size.
+		std::memcpy(record.text, text.data(), std::min(text.size(), LogRecord::MAX_TEXT));
+
+		for (int64_t value : values)
+		{
+			if (record.value_count == LogRecord::MAX_VALUES)
+				break;
+
+			record.values[record.value_count++] = value;
+		}
+
+		pushRecord(record);
+	}
+
+	void logOSError(LogLevel level, const char* file, uint32_t line, const char* message, int64_t err)
+	{
+		if (level < log_level.load(std::memory_order_relaxed))
+			return;
+
+		LogRecord record = makeRecord(level, file, line, message);
+		record.value_count = 1;
+		record.os_error = true;
+		record.values[0] = err;
+
+		pushRecord(record);
+	}
+
+	// ============ Formatting ============
+
+	const char* levelName(LogLevel level)
+	{
+		switch (level)
+		{
+		case LogLevel::TRACE:
+			return "TRACE";
+		case LogLevel::INFO:
+			return "INFO ";
+		case LogLevel::WARN:
+			return "WARN ";
+		case LogLevel::ERR:
+			return "ERROR";
+		default:
+			return "?????";
+		}
+	}
+
+	// formats a record as "<local time> <level> <message>: <text> (<values>): at <file> : <line>".
+	void formatRecord(const LogRecord& record, std::string& out)
+	{
+		std::time_t seconds = (std::time_t)(record.timestamp / 1'000'000'000);
+		std::tm local_time = {};
+
+#ifdef _WIN32
+		localtime_s(&local_time, &seconds);
+#else
+		localtime_r(&seconds, &local_time);
+#endif
+
+		char time_str[40];
+		size_t time_len = std::strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", &local_time);
+		std::snprintf(time_str + time_len, sizeof(time_str) - time_len, ".%03d ", (int)(record.timestamp / 1'000'000 % 1000));
+
+		out.clear();
+		out += time_str;
+		out += levelName(record.level);
+		out += ' ';
+		out += record.message;
+
+		if (record.os_error)
+		{
+			out += ": ";
+			out += std::system_category().message((int)record.values[0]);
+			out += " (" + std::to_string(record.values[0]) + ')';
+		}
+		else
+		{
+			if (record.text[0] != '\0')
+			{
+				out += ": ";
+				out += record.text;
+			}
+
+			for (uint8_t i = 0; i < record.value_count; i++)
+			{
+				out += i == 0 ? " (" : ", ";
+				out += std::to_string(record.values[i]);
+			}
+
+			if (record.value_count > 0)
+				out += ')';
+		}
+
+		out += ": at ";
+		out += record.file;
+		out += " : " + std::to_string(record.line) + '\n';
+	}
+
+	// sink_mutex must be held by the caller.
+	void writeLine(const std::string& line)
+	{
+		if (log_file.is_open())
+			log_file << line;
+
+		if (log_console.load(std::memory_order_relaxed))
+			std::cout << line;
+	}
+
+	// writes every record in the ring, sink_mutex must be held by the caller.
+	void drainLog()
+	{
+		LogRecord record;
+		bool wrote = false;
+
+		while (log_ring.pop(record))
+		{
+			formatRecord(record, log_line);
+			writeLine(log_line);
+			wrote = true;
+		}
+
+		size_t drop_count = log_ring.getDropCount();
+
+		if (drop_count != reported_drop_count)
+		{
+			writeLine(std::to_string(drop_count - reported_drop_count) + " log records dropped, the log ring was full\n");
+			reported_drop_count = drop_count;
+			wrote = true;
+		}
+
+		// flushed once per batch, instead of once per record.
+		if (wrote)
+		{
+			if (log_file.is_open())
+				log_file.flush();
+
+			std::cout.flush();
+		}
+	}
+
+	void loggerThread()
+	{
+		while (true)
+		{
+			uint32_t signal = log_signal.load(std::memory_order_acquire);
+
+			{
+				std::lock_guard lock(sink_mutex);
+				drainLog();
+			}
+
+			if (!logger_running.load(std::memory_order_acquire))
+				break;
+
+			log_signal.wait(signal, std::memory_order_acquire);
+		}
+	}
+
+	// ============ Configuration ============
+
+	void setLogLevel(LogLevel level)
+	{
+		log_level.store(level, std::memory_order_relaxed);
+	}
+
+	LogLevel getLogLevel()
+	{
+		return log_level.load(std::memory_order_relaxed);
+	}
+
+	void setLogConsole(bool enabled)
+	{
+		log_console.store(enabled, std::memory_order_relaxed);
+	}
+
+	void setLogFile(std::filesystem::path lout, bool clear)
+	{
+		std::lock_guard lock(sink_mutex);
+
+		// records logged before the file was changed still go to the previous file.
+		drainLog();
+
+		if (log_file.is_open())
+			log_file.close();
+
+		if (!clear && std::filesystem::exists(lout))
+			log_file.open(lout, std::ios_base::app);
+		else
+			log_file.open(lout);
+
+		log_file << "======================== LOG STARTED ========================\n";
+	}
+
+	void closeLogFile()
+	{
+		std::lock_guard lock(sink_mutex);
+
+		drainLog();
+
+		log_file << "========================= LOG ENDED =========================\n";
+		log_file.close();
+	}
+
+	void startLogger()
+	{
+		if (logger_thread.joinable())
+			return;
+
+		logger_running.store(true, std::memory_order_release);
+		logger_thread = std::thread(loggerThread);
+	}
+
+	void stopLogger()
+	{
+		if (!logger_thread.joinable())
+			return;
+
+		logger_running.store(false, std::memory_order_release);
+		log_signal.fetch_add(1, std::memory_order_release);
+		log_signal.notify_one();
+
+		// the thread drains the ring once more, before it exits.
+		logger_thread.join();
+	}
+
+	void flushLog()
+	{
+		std::lock_guard lock(sink_mutex);
+		drainLog();
+	}
+
+	size_t getLogDropCount()
+	{
+		return log_ring.getDropCount();
+	}
+}
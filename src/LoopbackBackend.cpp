@@ -0,0 +1,151 @@
+#include "LoopbackBackend.h"
+#include "LatencyHistogram.h"
+
+#include <array>
+#include <thread>
+
+namespace EchoMIDI
+{
+	// ============ Local defines ============
+
+	std::array<LoopbackBackend::Port, LoopbackBackend::PORT_COUNT> loopback_ports;
+
+	// calls deliver with the callbacks of the port, if its input is open and started.
+	// the sender count is raised before the callbacks are loaded, so closeInput() can wait for every delivery that might still use them.
+	template<typename TDeliver>
+	MMRESULT deliverToPort(LoopbackBackend::Port* port, TDeliver deliver)
+	{
+		if (port == nullptr)
+			return MMSYSERR_INVALHANDLE;
+
+		port->senders.fetch_add(1, std::memory_order_seq_cst);
+
+		const InputCallbacks* callbacks = port->callbacks.load(std::memory_order_seq_cst);
+
+		if (callbacks && port->started.load(std::memory_order_acquire))
+		{
+			DWORD timestamp = (DWORD)((latencyNow() - port->start_time.load(std::memory_order_relaxed)) / 1'000'000);
+
+			deliver(*callbacks, timestamp);
+		}
+
+		port->senders.fetch_sub(1, std::memory_order_release);
+
+		return MMSYSERR_NOERROR;
+	}
+
+	// ============ LoopbackBackend ============
+
+	MMRESULT LoopbackBackend::getInputName(UINT id, std::string& name)
+	{
+		if (id >= PORT_COUNT)
+			return MMSYSERR_BADDEVICEID;
+
+		name = "EchoMIDI Loopback " + std::to_string(id);
+
+		return MMSYSERR_NOERROR;
+	}
+
+	MMRESULT LoopbackBackend::getOutputName(UINT id, std::string& name)
+	{
+		return getInputName(id, name);
+	}
+
+	MMRESULT LoopbackBackend::openInput(InputHandle& handle, UINT id, const InputCallbacks& callbacks)
+	{
+		if (id >= PORT_COUNT)
+			return MMSYSERR_BADDEVICEID;
+
+		const InputCallbacks* expected = nullptr;
+
+		if (!loopback_ports[id].callbacks.compare_exchange_strong(expected, &callbacks, std::memory_order_seq_cst))
+			return MMSYSERR_ALLOCATED;
+
+		handle = &loopback_ports[id];
+
+		return MMSYSERR_NOERROR;
+	}
+
+	MMRESULT LoopbackBackend::startInput(InputHandle handle)
+	{
+		if (handle == nullptr)
+			return MMSYSERR_INVALHANDLE;
+
+		// timestamps restart at 0 every time the input is started, like winmm.
+		handle->start_time.store(latencyNow(), std::memory_order_relaxed);
+		handle->started.store(true, std::memory_order_release);
+
+		return MMSYSERR_NOERROR;
+	}
+
+	MMRESULT LoopbackBackend::stopInput(InputHandle handle)
+	{
+		if (handle == nullptr)
+			return MMSYSERR_INVALHANDLE;
+
+		handle->started.store(false, std::memory_order_release);
+
+		return MMSYSERR_NOERROR;
+	}
+
+	MMRESULT LoopbackBackend::resetInput(InputHandle handle)
+	{
+		// nothing is ever buffered, so there is nothing to return.
+		return handle == nullptr ? MMSYSERR_INVALHANDLE : MMSYSERR_NOERROR;
+	}
+
+	MMRESULT LoopbackBackend::closeInput(InputHandle handle)
+	{
+		if (handle == nullptr)
+			return MMSYSERR_INVALHANDLE;
+
+		handle->started.store(false, std::memory_order_release);
+		handle->callbacks.store(nullptr, std::memory_order_seq_cst);
+
+		// the callbacks may be destroyed as soon as this returns.
+		while (handle->senders.load(std::memory_order_seq_cst) != 0)
+			std::this_thread::yield();
+
+		return MMSYSERR_NOERROR;
+	}
+
+	MMRESULT LoopbackBackend::openOutput(OutputHandle& handle, UINT id)
+	{
+		if (id >= PORT_COUNT)
+			return MMSYSERR_BADDEVICEID;
+
+		handle = &loopback_ports[id];
+
+		return MMSYSERR_NOERROR;
+	}
+
+	MMRESULT LoopbackBackend::closeOutput(OutputHandle handle)
+	{
+		return handle == nullptr ? MMSYSERR_INVALHANDLE : MMSYSERR_NOERROR;
+	}
+
+	MMRESULT LoopbackBackend::sendShort(OutputHandle handle, uint32_t msg)
+	{
+		return deliverToPort(handle, [&](const InputCallbacks& callbacks, DWORD timestamp)
+			{
+				callbacks.on_short(callbacks.user, msg, timestamp);
+			});
+	}
+
+	MMRESULT LoopbackBackend::sendLong(OutputHandle handle, const uint8_t* data, size_t length)
+	{
+		return deliverToPort(handle, [&](const InputCallbacks& callbacks, DWORD timestamp)
+			{
+				callbacks.on_long(callbacks.user, data, length, timestamp);
+			});
+	}
+
+	MMRESULT LoopbackBackend::sendBatch(OutputHandle handle, const uint32_t* msgs, size_t count)
+	{
+		return deliverToPort(handle, [&](const InputCallbacks& callbacks, DWORD timestamp)
+			{
+				for (size_t i = 0; i < count; i++)
+					callbacks.on_short(callbacks.user, msgs[i], timestamp);
+			});
+	}
+}
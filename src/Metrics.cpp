@@ -0,0 +1,175 @@
+#include "Metrics.h"
+#include "Echoer.h"
+#include "DeviceRegistry.h"
+
+#include <algorithm>
+#include <mutex>
+
+namespace EchoMIDI
+{
+	// ============ Registered Echoers ============
+
+	// held while the counters of the registered Echoers are read, getMetrics() takes the targets mutex of every Echoer while holding it,
+	// so it must never be taken while holding the targets mutex of an Echoer.
+	std::mutex metrics_mutex;
+	std::vector<Echoer*> metrics_echoers;
+
+	void registerMetrics(Echoer* echoer)
+	{
+		std::lock_guard lock(metrics_mutex);
+		metrics_echoers.push_back(echoer);
+	}
+
+	void unregisterMetrics(Echoer* echoer)
+	{
+		std::lock_guard lock(metrics_mutex);
+		std::erase(metrics_echoers, echoer);
+	}
+
+	std::vector<EchoerMetrics> getMetrics()
+	{
+		std::vector<EchoerMetrics> metrics;
+
+		{
+			std::lock_guard lock(metrics_mutex);
+
+			metrics.reserve(metrics_echoers.size());
+
+			for (Echoer* echoer : metrics_echoers)
+			{
+				EchoerMetrics echoer_metrics = echoer->getMetrics();
+
+				if (echoer_metrics.id != INVALID_MIDI_ID)
+					metrics.push_back(std::move(echoer_metrics));
+			}
+		}
+
+		// devices that vanished since the ids were read are left without a name.
+		DeviceRegistry& registry = getDeviceRegistry();
+
+		for (EchoerMetrics& echoer_metrics : metrics)
+		{
+			registry.getInputName(echoer_metrics.id, echoer_metrics.name);
+
+			for (TargetMetrics& target : echoer_metrics.targets)
+				registry.getOutputName(target.id, target.name);
+		}
+
+		// the registration order changes as devices come and go, sorting keeps the exported series in a stable order.
+		std::sort(metrics.begin(), metrics.end(), [](const EchoerMetrics& a, const EchoerMetrics& b) { return a.id < b.id; });
+
+		return metrics;
+	}
+
+	// ============ Prometheus format ============
+
+	// label values may contain any character, except that backslashes, quotes and line feeds must be escaped.
+	void appendLabelValue(std::string& out, const std::string& value)
+	{
+		for (char c : value)
+		{
+			switch (c)
+			{
+			case '\\':
+				out += "\\\\";
+				break;
+			case '"':
+				out += "\\\"";
+				break;
+			case '\n':
+				out += "\\n";
+				break;
+			default:
+				out += c;
+			}
+		}
+	}
+
+	void appendInputLabels(std::string& out, const EchoerMetrics& echoer)
+	{
+		out += "input=\"";
+		appendLabelValue(out, echoer.name);
+		out += "\",input_id=\"" + std::to_string(echoer.id) + '"';
+	}
+
+	void appendHeader(std::string& out, const char* name, const char* type, const char* help)
+	{
+		out += "# HELP ";
+		out += name;
+		out += ' ';
+		out += help;
+		out += "\n# TYPE ";
+		out += name;
+		out += ' ';
+		out += type;
+		out += '\n';
+	}
+
+	// a metric with one sample per Echoer.
+	template<typename TValue>
+	void appendInputMetric(std::string& out, const std::vector<EchoerMetrics>& metrics, const char* name, const char* type, const char* help, TValue value)
+	{
+		appendHeader(out, name, type, help);
+
+		for (const EchoerMetrics& echoer : metrics)
+		{
+			out += name;
+			out += '{';
+			appendInputLabels(out, echoer);
+			out += "} " + std::to_string(value(echoer)) + '\n';
+		}
+	}
+
+	// a metric with one sample per target of every Echoer.
+	template<typename TValue>
+	void appendTargetMetric(std::string& out, const std::vector<EchoerMetrics>& metrics, const char* name, const char* type, const char* help, TValue value)
+	{
+		appendHeader(out, name, type, help);
+
+		for (const EchoerMetrics& echoer : metrics)
+		{
+			for (const TargetMetrics& target : echoer.targets)
+			{
+				out += name;
+				out += '{';
+				appendInputLabels(out, echoer);
+				out += ",output=\"";
+				appendLabelValue(out, target.name);
+				out += "\",output_id=\"" + std::to_string(target.id) + "\"} " + std::to_string(value(target)) + '\n';
+			}
+		}
+	}
+
+	std::string formatPrometheus(const std::vector<EchoerMetrics>& metrics)
+	{
+		std::string out;
+
+		appendInputMetric(out, metrics, "echomidi_received_messages_total", "counter", "Messages recieved from the input device.",
+			[](const EchoerMetrics& m) { return m.received_count; });
+		appendInputMetric(out, metrics, "echomidi_received_bytes_total", "counter", "Bytes recieved from the input device.",
+			[](const EchoerMetrics& m) { return m.received_bytes; });
+		appendInputMetric(out, metrics, "echomidi_dropped_errors_total", "counter", "Send errors not reported, because the error queue was full.",
+			[](const EchoerMetrics& m) { return m.dropped_error_count; });
+
+		appendTargetMetric(out, metrics, "echomidi_sent_messages_total", "counter", "Messages sent to the output device.",
+			[](const TargetMetrics& m) { return m.sent_count; });
+		appendTargetMetric(out, metrics, "echomidi_sent_bytes_total", "counter", "Bytes sent to the output device.",
+			[](const TargetMetrics& m) { return m.sent_bytes; });
+		appendTargetMetric(out, metrics, "echomidi_muted_messages_total", "counter", "Messages not sent, because the target was muted or disabled.",
+			[](const TargetMetrics& m) { return m.muted_count; });
+		appendTargetMetric(out, metrics, "echomidi_focus_muted_messages_total", "counter", "Messages not sent, because the target was focus muted.",
+			[](const TargetMetrics& m) { return m.focus_muted_count; });
+		appendTargetMetric(out, metrics, "echomidi_filtered_messages_total", "counter", "Messages not sent, because the transform of the target filtered them out.",
+			[](const TargetMetrics& m) { return m.filtered_count; });
+		appendTargetMetric(out, metrics, "echomidi_send_errors_total", "counter", "Failed sends to the output device.",
+			[](const TargetMetrics& m) { return m.error_count; });
+		appendTargetMetric(out, metrics, "echomidi_queue_dropped_messages_total", "counter", "Messages not sent, because the queue of the async target was full.",
+			[](const TargetMetrics& m) { return m.queue_dropped_count; });
+		appendTargetMetric(out, metrics, "echomidi_coalesced_messages_total", "counter", "Controller messages replaced by a newer value, before they were sent.",
+			[](const TargetMetrics& m) { return m.coalesced_count; });
+		appendTargetMetric(out, metrics, "echomidi_queue_depth", "gauge", "Messages waiting in the queue of the async target.",
+			[](const TargetMetrics& m) { return m.queue_depth; });
+
+		return out;
+	}
+}
@@ -0,0 +1,296 @@
+// winsock2.h must be included before Windows.h, which is pulled in by the library headers.
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#endif
+
+#include "MetricsExporter.h"
+#include "Echoer.h"
+#include "Logger.h"
+
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+#include <fstream>
+#include <system_error>
+
+namespace EchoMIDI
+{
+	// ============ Local defines ============
+
+	// requests larger than this are answered without reading the rest.
+	static constexpr size_t MAX_REQUEST_SIZE = 4096;
+	// a client that sends nothing for this long is disconnected, so it cannot stall the exporter.
+	static constexpr int CLIENT_TIMEOUT_MS = 1000;
+
+#ifdef _WIN32
+	using PollFD = WSAPOLLFD;
+
+	int socketError() { return WSAGetLastError(); }
+	void closeSocket(uintptr_t socket) { closesocket((SOCKET)socket); }
+	int pollSockets(PollFD* fds, size_t count, int timeout) { return WSAPoll(fds, (ULONG)count, timeout); }
+	// no SIGPIPE on windows.
+	static constexpr int SEND_FLAGS = 0;
+#else
+	using PollFD = pollfd;
+
+	int socketError() { return errno; }
+	void closeSocket(int socket) { close(socket); }
+	int pollSockets(PollFD* fds, size_t count, int timeout) { return poll(fds, (nfds_t)count, timeout); }
+	// a client closing the connection early must not kill the process.
+	static constexpr int SEND_FLAGS = MSG_NOSIGNAL;
+#endif
+
+	sockaddr_in loopbackAddress(uint16_t port)
+	{
+		sockaddr_in address = {};
+		address.sin_family = AF_INET;
+		address.sin_port = htons(port);
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+		return address;
+	}
+
+	// ============ MetricsExporter ============
+
+	MetricsExporter::MetricsExporter(const MetricsConfig& config)
+		: m_config(config)
+	{
+		if (m_config.port != 0)
+		{
+#ifdef _WIN32
+			WSADATA wsa_data;
+			WSAStartup(MAKEWORD(2, 2), &wsa_data);
+#endif
+
+			m_listen_socket = (Socket)socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+
+			sockaddr_in address = loopbackAddress(m_config.port);
+			int reuse = 1;
+			int err = 0;
+
+			// lets the exporter be restarted right away, while connections of the previous one are still in TIME_WAIT.
+			if (m_listen_socket == INVALID_SOCKET_HANDLE
+				|| setsockopt(m_listen_socket, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse)) != 0
+				|| bind(m_listen_socket, (sockaddr*)&address, sizeof(address)) != 0
+				|| listen(m_listen_socket, 4) != 0)
+			{
+				err = socketError();
+			}
+
+			socklen_t address_len = sizeof(address);
+
+			if (err == 0 && getsockname(m_listen_socket, (sockaddr*)&address, &address_len) != 0)
+				err = socketError();
+
+			if (err != 0)
+			{
+				if (m_listen_socket != INVALID_SOCKET_HANDLE)
+					closeSocket(m_listen_socket);
+
+#ifdef _WIN32
+				WSACleanup();
+#endif
+
+				throw MIDIEchoExcept("Cannot serve metrics on port " + std::to_string(m_config.port) + ": " + std::system_category().message(err), "Metrics Err", MMSYSERR_ERROR);
+			}
+
+			m_port = ntohs(address.sin_port);
+		}
+
+		m_thread = std::thread(&MetricsExporter::run, this);
+	}
+
+	MetricsExporter::~MetricsExporter()
+	{
+		{
+			std::lock_guard lock(m_stop_mutex);
+			m_stopping = true;
+		}
+
+		m_stop_cv.notify_all();
+
+		// the thread may be waiting for a connection, connecting to the endpoint wakes it up on every platform.
+		if (m_listen_socket != INVALID_SOCKET_HANDLE)
+		{
+			Socket wake = (Socket)socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+
+			if (wake != INVALID_SOCKET_HANDLE)
+			{
+				sockaddr_in address = loopbackAddress(m_port);
+				connect(wake, (sockaddr*)&address, sizeof(address));
+				closeSocket(wake);
+			}
+		}
+
+		m_thread.join();
+
+		if (m_listen_socket != INVALID_SOCKET_HANDLE)
+		{
+			closeSocket(m_listen_socket);
+
+#ifdef _WIN32
+			WSACleanup();
+#endif
+		}
+	}
+
+	void MetricsExporter::run()
+	{
+		auto next_export = std::chrono::steady_clock::now();
+
+		while (true)
+		{
+			{
+				std::lock_guard lock(m_stop_mutex);
+
+				if (m_stopping)
+					break;
+			}
+
+			auto now = std::chrono::steady_clock::now();
+
+			if (now >= next_export)
+			{
+				exportMetrics();
+				next_export = now + m_config.interval;
+			}
+
+			waitForClient(std::chrono::duration_cast<std::chrono::milliseconds>(next_export - std::chrono::steady_clock::now()));
+		}
+	}
+
+	void MetricsExporter::exportMetrics()
+	{
+		m_text = formatPrometheus(getMetrics());
+
+		if (!m_config.file.empty())
+			writeFile();
+
+		m_export_count.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	void MetricsExporter::writeFile()
+	{
+		std::filesystem::path temp_file = m_config.file;
+		temp_file += ".tmp";
+
+		{
+			std::ofstream file_out(temp_file, std::ios_base::binary | std::ios_base::trunc);
+
+			file_out << m_text;
+
+			if (!file_out)
+			{
+				ECHOMIDI_LOG(LogLevel::WARN, "could not write the metrics file", temp_file.filename().string());
+				return;
+			}
+		}
+
+		std::error_code err;
+		std::filesystem::rename(temp_file, m_config.file, err);
+
+		if (err)
+			ECHOMIDI_LOG_OS_ERROR(LogLevel::WARN, "could not replace the metrics file", err.value());
+	}
+
+	void MetricsExporter::waitForClient(std::chrono::milliseconds timeout)
+	{
+		if (timeout.count() < 0)
+			timeout = std::chrono::milliseconds(0);
+
+		if (m_listen_socket == INVALID_SOCKET_HANDLE)
+		{
+			std::unique_lock lock(m_stop_mutex);
+			m_stop_cv.wait_for(lock, timeout, [this]() { return m_stopping; });
+
+			return;
+		}
+
+		PollFD fd = {};
+		fd.fd = m_listen_socket;
+		fd.events = POLLIN;
+
+		if (pollSockets(&fd, 1, (int)timeout.count()) <= 0 || !(fd.revents & POLLIN))
+			return;
+
+		{
+			std::lock_guard lock(m_stop_mutex);
+
+			// the connection of the destructor only wakes the thread up.
+			if (m_stopping)
+				return;
+		}
+
+		Socket client = (Socket)accept(m_listen_socket, nullptr, nullptr);
+
+		if (client == INVALID_SOCKET_HANDLE)
+			return;
+
+		serveClient(client);
+		closeSocket(client);
+	}
+
+	void MetricsExporter::serveClient(Socket client)
+	{
+#ifdef _WIN32
+		DWORD recv_timeout = CLIENT_TIMEOUT_MS;
+#else
+		timeval recv_timeout = { CLIENT_TIMEOUT_MS / 1000, CLIENT_TIMEOUT_MS % 1000 * 1000 };
+#endif
+		setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, (const char*)&recv_timeout, sizeof(recv_timeout));
+
+		// only the request line is used, the headers are read until the end of the request, and ignored.
+		std::string request;
+		char buffer[512];
+
+		while (request.size() < MAX_REQUEST_SIZE && request.find("\r\n\r\n") == std::string::npos)
+		{
+			int received = (int)recv(client, buffer, sizeof(buffer), 0);
+
+			if (received <= 0)
+				break;
+
+			request.append(buffer, received);
+		}
+
+		std::string request_line = request.substr(0, request.find("\r\n"));
+		std::string status = "200 OK";
+		std::string body = m_text;
+
+		if (request_line.rfind("GET ", 0) != 0)
+		{
+			status = "405 Method Not Allowed";
+			body = "only GET is supported\n";
+		}
+		else if (request_line.rfind("GET /metrics ", 0) != 0 && request_line.rfind("GET / ", 0) != 0)
+		{
+			status = "404 Not Found";
+			body = "metrics are served at /metrics\n";
+		}
+
+		std::string response = "HTTP/1.0 " + status + "\r\n"
+			"Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+			"Content-Length: " + std::to_string(body.size()) + "\r\n"
+			"Connection: close\r\n\r\n" + body;
+
+		size_t sent = 0;
+
+		while (sent < response.size())
+		{
+			int res = (int)send(client, response.data() + sent, (int)(response.size() - sent), SEND_FLAGS);
+
+			if (res <= 0)
+				break;
+
+			sent += res;
+		}
+	}
+}
@@ -0,0 +1,465 @@
+#include "OutputPool.h"
+#include "Echoer.h"
+#include "Realtime.h"
+
+#include <algorithm>
+
+namespace EchoMIDI
+{
+	// ============ OutputPort ============
+
+	OutputPort::OutputPort(UINT id, const std::atomic<int64_t>& merge_window)
+		: m_id(id), m_merge_window(merge_window)
+	{
+	}
+
+	OutputPort::~OutputPort()
+	{
+		close();
+	}
+
+#ifdef ECHOMIDI_BACKEND_WINMM
+	// recieves MOM_DONE once the device is done sending a SysEx block, which is handed back to the SysExPool owning it.
+	// stream buffers are owned by none of the pools, their AsyncSender waits for them instead, see WinMMBackend::waitDone().
+	void CALLBACK OutputPort::outputCallback(HMIDIOUT hMidiOut, UINT wMsg, DWORD_PTR dwInstance, DWORD_PTR dwParam1, DWORD_PTR dwParam2)
+	{
+		if (wMsg != MOM_DONE)
+			return;
+
+		OutputPort* port = (OutputPort*)dwInstance;
+		LPMIDIHDR hdr = (LPMIDIHDR)dwParam1;
+
+		port->m_callbacks.fetch_add(1, std::memory_order_acquire);
+
+		bool pooled = false;
+
+		for (std::atomic<SysExPool*>& entry : port->m_sysex_pools)
+		{
+			SysExPool* sysex_pool = entry.load(std::memory_order_acquire);
+
+			if (sysex_pool && sysex_pool->owns(hdr))
+			{
+				sysex_pool->release(hdr);
+				pooled = true;
+				break;
+			}
+		}
+
+		if (!pooled)
+			Backend::notifyDone(hdr);
+
+		port->m_callbacks.fetch_sub(1, std::memory_order_release);
+	}
+
+	bool OutputPort::attachSysExPool(SysExPool* sysex_pool)
+	{
+		for (std::atomic<SysExPool*>& entry : m_sysex_pools)
+		{
+			SysExPool* expected = nullptr;
+
+			if (entry.compare_exchange_strong(expected, sysex_pool, std::memory_order_acq_rel))
+				return true;
+		}
+
+		return false;
+	}
+
+	void OutputPort::detachSysExPool(SysExPool* sysex_pool)
+	{
+		for (std::atomic<SysExPool*>& entry : m_sysex_pools)
+		{
+			SysExPool* expected = sysex_pool;
+
+			if (entry.compare_exchange_strong(expected, nullptr, std::memory_order_acq_rel))
+				break;
+		}
+
+		// a callback may have loaded the pool just before it was removed, the pool must outlive it.
+		while (m_callbacks.load(std::memory_order_acquire) != 0)
+			std::this_thread::yield();
+	}
+
+	MMRESULT OutputPort::open(bool stream)
+	{
+		UINT id = getID();
+		MMRESULT res;
+
+		// the output callback is only used for recycling SysEx buffers.
+		if (stream)
+		{
+			res = midiStreamOpen(&m_stream_handle, &id, 1, (DWORD_PTR)&outputCallback, (DWORD_PTR)this, CALLBACK_FUNCTION);
+
+			// stream handles may be used with any of the midiOut functions.
+			if (res == MMSYSERR_NOERROR)
+			{
+				m_handle = (HMIDIOUT)m_stream_handle;
+
+				// streams are opened in a paused state.
+				res = midiStreamRestart(m_stream_handle);
+
+				if (res != MMSYSERR_NOERROR)
+					midiStreamClose(m_stream_handle);
+			}
+		}
+		else
+		{
+			res = midiOutOpen(&m_handle, id, (DWORD_PTR)&outputCallback, (DWORD_PTR)this, CALLBACK_FUNCTION);
+		}
+
+		if (res != MMSYSERR_NOERROR)
+		{
+			m_handle = NULL;
+			m_stream_handle = NULL;
+		}
+
+		return res;
+	}
+#else
+	MMRESULT OutputPort::open(bool stream)
+	{
+		MMRESULT res = Backend::openOutput(m_handle, getID());
+
+		if (res != MMSYSERR_NOERROR)
+			m_handle = {};
+
+		return res;
+	}
+#endif
+
+	MMRESULT OutputPort::close()
+	{
+		if (m_thread.joinable())
+		{
+			m_running.store(false, std::memory_order_release);
+
+			wake();
+
+			// the merge thread sends every message still queued, before it exits.
+			m_thread.join();
+		}
+
+		if (m_handle == Backend::OutputHandle{})
+			return MMSYSERR_NOERROR;
+
+#ifdef ECHOMIDI_BACKEND_WINMM
+		MMRESULT res = m_stream_handle ? midiStreamClose(m_stream_handle) : midiOutClose(m_handle);
+
+		m_stream_handle = NULL;
+#else
+		MMRESULT res = Backend::closeOutput(m_handle);
+#endif
+
+		m_handle = {};
+
+		return res;
+	}
+
+	size_t OutputPort::addFeeder(Echoer& echoer)
+	{
+		size_t feeder = 0;
+
+		{
+			std::lock_guard lock(m_feeder_mutex);
+
+			while (feeder < MAX_FEEDERS && m_feeders[feeder].echoer)
+				feeder++;
+
+			if (feeder == MAX_FEEDERS)
+				return MAX_FEEDERS;
+
+			if (!m_feeders[feeder].queue)
+				m_feeders[feeder].queue = std::make_unique<MPSCQueue<Event, QUEUE_SIZE>>();
+
+			m_feeders[feeder].echoer = &echoer;
+		}
+
+		size_t feeder_count = m_feeder_count.fetch_add(1, std::memory_order_relaxed) + 1;
+
+		if (feeder_count < 2)
+			return feeder;
+
+		if (!m_thread.joinable())
+			m_thread = std::thread(&OutputPort::run, this);
+
+		m_merging.store(true, std::memory_order_release);
+
+		return feeder;
+	}
+
+	void OutputPort::drainFeeder(size_t feeder)
+	{
+		// the feeder no longer pushes anything, so once its count drops to zero, none of its messages is left.
+		std::atomic<uint64_t>& queued_count = m_feeders[feeder].queued_count;
+		uint64_t count;
+
+		while ((count = queued_count.load(std::memory_order_acquire)) != 0)
+			queued_count.wait(count, std::memory_order_acquire);
+	}
+
+	void OutputPort::removeFeeder(size_t feeder)
+	{
+		// the remaining feeder keeps queueing until the merge thread is done with every queued message, see isMerging().
+		if (m_feeder_count.fetch_sub(1, std::memory_order_relaxed) - 1 < 2)
+			m_merging.store(false, std::memory_order_release);
+
+		// the merge thread only looks at the echoer whilst holding the mutex.
+		std::lock_guard lock(m_feeder_mutex);
+
+		m_feeders[feeder].echoer = nullptr;
+	}
+
+	bool OutputPort::push(size_t feeder, const Event& event)
+	{
+		Feeder& slot = m_feeders[feeder];
+
+		if (!slot.queue->push(event))
+		{
+			m_drop_count.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+
+		slot.queued_count.fetch_add(1, std::memory_order_release);
+		m_queued_count.fetch_add(1, std::memory_order_release);
+
+		wake();
+
+		return true;
+	}
+
+	void OutputPort::wake()
+	{
+		// incremented before m_holding is checked, and run() sets m_holding before checking the signal, so either sees the other.
+		m_signal.fetch_add(1);
+		m_signal.notify_one();
+
+		if (m_holding.load())
+		{
+			std::lock_guard lock(m_hold_mutex);
+			m_hold_cv.notify_one();
+		}
+	}
+
+	void OutputPort::send(const Event& event)
+	{
+		MMRESULT res = Backend::sendShort(m_handle, event.msg);
+
+		event.echoer->recordSent(*event.stats, event.timestamp, event.received);
+
+		if (res != MMSYSERR_NOERROR)
+		{
+			event.echoer->reportError(getID(), event.slot, *event.stats, res, event.timestamp);
+			return;
+		}
+
+		event.stats->countSent(1, getShortMessageLength(event.msg & 0xFF));
+
+		if (event.stats->consecutive_errors.load(std::memory_order_relaxed) != 0)
+			event.stats->consecutive_errors.store(0, std::memory_order_relaxed);
+	}
+
+	void OutputPort::run()
+	{
+#ifdef ECHOMIDI_BACKEND_WINMM
+		// the default timer resolution is far too coarse for millisecond merge windows.
+		timeBeginPeriod(1);
+#endif
+
+		// the oldest message of every feeder, popped from its queue, but not yet sent.
+		// the messages of a single feeder are already in order, so only these need to be compared.
+		std::array<Event, MAX_FEEDERS> heads;
+		std::array<bool, MAX_FEEDERS> has_head = {};
+
+		while (true)
+		{
+			updateThreadRealtime();
+
+			// read the signal before popping, so a push happening after the queues were found empty always wakes the thread up again.
+			uint32_t signal = m_signal.load(std::memory_order_acquire);
+			bool running = m_running.load(std::memory_order_acquire);
+
+			int64_t now = latencyNow();
+			size_t next = MAX_FEEDERS;
+			// the earliest time a feeder without a queued message entered its still running midi callback,
+			// it may still push a message recieved after that time, so only older messages are sent right away.
+			int64_t receive_time = INT64_MAX;
+
+			{
+				std::lock_guard lock(m_feeder_mutex);
+
+				for (size_t i = 0; i < MAX_FEEDERS; i++)
+				{
+					Feeder& feeder = m_feeders[i];
+
+					if (!feeder.echoer)
+						continue;
+
+					if (!has_head[i])
+					{
+						// checked before popping, so a callback pushing right after the queue was found empty is either seen running, or its message is popped.
+						int64_t feeder_time = feeder.echoer->getReceiveTime();
+
+						if (feeder.queue->pop(heads[i]))
+						{
+							// a timestamp ahead of the clock would hold the message back for longer than the window.
+							heads[i].input_time = std::min(heads[i].input_time, now);
+							has_head[i] = true;
+						}
+						else
+						{
+							receive_time = std::min(receive_time, feeder_time);
+						}
+					}
+
+					if (has_head[i] && (next == MAX_FEEDERS || heads[i].input_time < heads[next].input_time))
+						next = i;
+				}
+			}
+
+			if (next == MAX_FEEDERS)
+			{
+				// every feeder has left before the port is closed, so nothing can be queued anymore.
+				if (!running)
+					break;
+
+				m_signal.wait(signal, std::memory_order_acquire);
+				continue;
+			}
+
+			int64_t hold_until = heads[next].input_time + m_merge_window.load(std::memory_order_relaxed);
+
+			// the callback of another feeder is usually done within microseconds, and wakes the thread up once it is, see Echoer::receiveShort().
+			// a stuck one only holds the message back for the window.
+			if (running && heads[next].input_time >= receive_time && hold_until > now)
+			{
+				m_holding.store(true);
+
+				{
+					std::unique_lock lock(m_hold_mutex);
+					std::chrono::steady_clock::time_point deadline{ std::chrono::nanoseconds(hold_until) };
+
+					m_hold_cv.wait_until(lock, deadline, [&]() { return m_signal.load() != signal; });
+				}
+
+				m_holding.store(false);
+				continue;
+			}
+
+			send(heads[next]);
+			has_head[next] = false;
+
+			m_merged_count.fetch_add(1, std::memory_order_relaxed);
+
+			// released after the send, so a feeder that stops queueing cannot overtake the message.
+			m_queued_count.fetch_sub(1, std::memory_order_release);
+
+			std::atomic<uint64_t>& queued_count = m_feeders[next].queued_count;
+
+			if (queued_count.fetch_sub(1, std::memory_order_release) == 1)
+				queued_count.notify_all();
+		}
+
+#ifdef ECHOMIDI_BACKEND_WINMM
+		timeEndPeriod(1);
+#endif
+	}
+
+	// ============ OutputPool ============
+
+	MMRESULT OutputPool::acquire(OutputPort*& port, size_t& feeder, Echoer& echoer, UINT id, bool stream)
+	{
+		std::unique_lock lock(m_mutex);
+
+		auto find_port = [&]() { return std::ranges::find_if(m_ports, [&](auto& port) { return port->getID() == id; }); };
+
+		for (auto it = find_port(); it != m_ports.end(); it = find_port())
+		{
+			// another thread is opening the same device, it either succeeds and is shared, or fails and is opened again below.
+			if ((*it)->m_opening)
+			{
+				m_opened.wait(lock);
+				continue;
+			}
+
+			size_t new_feeder = (*it)->addFeeder(echoer);
+
+			if (new_feeder == OutputPort::MAX_FEEDERS)
+				return MMSYSERR_ALLOCATED;
+
+			port = it->get();
+			feeder = new_feeder;
+
+			return MMSYSERR_NOERROR;
+		}
+
+		OutputPort* new_port = m_ports.emplace_back(std::unique_ptr<OutputPort>(new OutputPort(id, m_merge_window))).get();
+		new_port->m_opening = true;
+
+		// the device is opened without holding the mutex, so other devices can be opened at the same time.
+		lock.unlock();
+		MMRESULT res = new_port->open(stream);
+		lock.lock();
+
+		new_port->m_opening = false;
+		m_opened.notify_all();
+
+		if (res != MMSYSERR_NOERROR)
+		{
+			std::erase_if(m_ports, [&](auto& port) { return port.get() == new_port; });
+			return res;
+		}
+
+		feeder = new_port->addFeeder(echoer);
+		port = new_port;
+
+		return MMSYSERR_NOERROR;
+	}
+
+	MMRESULT OutputPool::release(OutputPort* port, size_t feeder)
+	{
+		// drained without holding the mutex, so waiting for the merge thread never blocks other ports from being acquired or released.
+		// the feeder is still counted meanwhile, so the port stays in the pool.
+		port->drainFeeder(feeder);
+
+		std::lock_guard lock(m_mutex);
+
+		port->removeFeeder(feeder);
+
+		if (port->getFeederCount() > 0)
+			return MMSYSERR_NOERROR;
+
+		// the device is closed whilst the mutex is held, so it cannot be opened again before it is closed.
+		auto it = std::ranges::find_if(m_ports, [&](auto& other) { return other.get() == port; });
+		std::unique_ptr<OutputPort> closed = std::move(*it);
+
+		m_ports.erase(it);
+
+		return closed->close();
+	}
+
+	void OutputPool::remapIDs(const std::vector<UINT>& output_ids)
+	{
+		std::lock_guard lock(m_mutex);
+
+		for (auto& port : m_ports)
+		{
+			UINT id = port->getID();
+
+			if (id < output_ids.size())
+				port->m_id.store(output_ids[id], std::memory_order_relaxed);
+		}
+	}
+
+	size_t OutputPool::getPortCount()
+	{
+		std::lock_guard lock(m_mutex);
+
+		return m_ports.size();
+	}
+
+	OutputPool& getOutputPool()
+	{
+		static OutputPool pool;
+
+		return pool;
+	}
+}
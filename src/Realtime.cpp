@@ -0,0 +1,313 @@
+#include "Realtime.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <avrt.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <cerrno>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <system_error>
+
+namespace EchoMIDI
+{
+	// ============ Local defines ============
+
+	// smallest page size of any supported platform, touching every page of this size also touches every larger page.
+	static constexpr size_t PREFAULT_PAGE_SIZE = 4096;
+
+	std::mutex realtime_mutex;
+	RealtimeConfig realtime_config;
+	RealtimeStatus realtime_status;
+	bool memory_locked = false;
+
+	// incremented on every config change, threads compare it against the generation they last applied.
+	std::atomic<uint64_t> realtime_generation = 0;
+
+	thread_local uint64_t thread_generation = 0;
+	// wether the scheduling of the calling thread has been changed, and must be reverted once realtime mode is disabled.
+	thread_local bool thread_realtime = false;
+
+#ifdef _WIN32
+	static constexpr const char* PRIORITY_NAME = "MMCSS Pro Audio priority";
+
+	// the minimum working set used when locking memory, the os only trims the working set below its minimum when memory runs out.
+	static constexpr SIZE_T LOCKED_WORKING_SET_SIZE = 64 * 1024 * 1024;
+
+	SIZE_T unlocked_min_working_set = 0;
+	SIZE_T unlocked_max_working_set = 0;
+
+	thread_local HANDLE thread_mmcss = NULL;
+
+	int setThreadPriority(int priority)
+	{
+		if (thread_mmcss == NULL)
+		{
+			DWORD task_index = 0;
+			thread_mmcss = AvSetMmThreadCharacteristicsA("Pro Audio", &task_index);
+
+			if (thread_mmcss == NULL)
+				return (int)GetLastError();
+		}
+
+		AVRT_PRIORITY avrt_priority = priority >= 90 ? AVRT_PRIORITY_CRITICAL : priority >= 50 ? AVRT_PRIORITY_HIGH : AVRT_PRIORITY_NORMAL;
+
+		return AvSetMmThreadPriority(thread_mmcss, avrt_priority) ? 0 : (int)GetLastError();
+	}
+
+	void resetThreadPriority()
+	{
+		if (thread_mmcss != NULL)
+			AvRevertMmThreadCharacteristics(thread_mmcss);
+
+		thread_mmcss = NULL;
+	}
+
+	int setThreadAffinity(uint64_t cpu_mask)
+	{
+		return SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)cpu_mask) != 0 ? 0 : (int)GetLastError();
+	}
+
+	void resetThreadAffinity()
+	{
+		DWORD_PTR process_mask, system_mask;
+
+		if (GetProcessAffinityMask(GetCurrentProcess(), &process_mask, &system_mask))
+			SetThreadAffinityMask(GetCurrentThread(), process_mask);
+	}
+
+	int lockMemory()
+	{
+		if (!GetProcessWorkingSetSize(GetCurrentProcess(), &unlocked_min_working_set, &unlocked_max_working_set))
+			return (int)GetLastError();
+
+		SIZE_T min_working_set = std::max(unlocked_min_working_set, LOCKED_WORKING_SET_SIZE);
+		SIZE_T max_working_set = std::max(unlocked_max_working_set, min_working_set * 2);
+
+		if (!SetProcessWorkingSetSizeEx(GetCurrentProcess(), min_working_set, max_working_set, QUOTA_LIMITS_HARDWS_MIN_ENABLE | QUOTA_LIMITS_HARDWS_MAX_DISABLE))
+			return (int)GetLastError();
+
+		return 0;
+	}
+
+	void unlockMemory()
+	{
+		SetProcessWorkingSetSizeEx(GetCurrentProcess(), unlocked_min_working_set, unlocked_max_working_set, QUOTA_LIMITS_HARDWS_MIN_DISABLE | QUOTA_LIMITS_HARDWS_MAX_DISABLE);
+	}
+#else
+	static constexpr const char* PRIORITY_NAME = "SCHED_FIFO priority";
+
+	int setThreadPriority(int priority)
+	{
+		sched_param param = {};
+		param.sched_priority = std::clamp(priority, sched_get_priority_min(SCHED_FIFO), sched_get_priority_max(SCHED_FIFO));
+
+		return pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+	}
+
+	void resetThreadPriority()
+	{
+		sched_param param = {};
+
+		pthread_setschedparam(pthread_self(), SCHED_OTHER, &param);
+	}
+
+	int setThreadAffinity(uint64_t cpu_mask)
+	{
+		cpu_set_t cpus;
+		CPU_ZERO(&cpus);
+
+		for (int cpu = 0; cpu < 64; cpu++)
+		{
+			if (cpu_mask >> cpu & 1)
+				CPU_SET(cpu, &cpus);
+		}
+
+		return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpus);
+	}
+
+	void resetThreadAffinity()
+	{
+		// cpus which are offline or outside of the cpuset of the process are ignored by the kernel.
+		cpu_set_t cpus;
+		CPU_ZERO(&cpus);
+
+		for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+			CPU_SET(cpu, &cpus);
+
+		pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpus);
+	}
+
+	int lockMemory()
+	{
+		return mlockall(MCL_CURRENT | MCL_FUTURE) == 0 ? 0 : errno;
+	}
+
+	void unlockMemory()
+	{
+		munlockall();
+	}
+#endif
+
+	// the array is only ever written to, so the compiler cannot leave it out, and the function is never inlined into a larger frame.
+#ifdef _MSC_VER
+	__declspec(noinline)
+#else
+	__attribute__((noinline))
+#endif
+	void prefaultStack()
+	{
+		volatile char stack[PREFAULT_STACK_SIZE];
+
+		for (size_t i = 0; i < PREFAULT_STACK_SIZE; i += PREFAULT_PAGE_SIZE)
+			stack[i] = 0;
+
+		(void)stack;
+	}
+
+	// ============ Header defines ============
+
+	std::string RealtimeStatus::describe() const
+	{
+		if (ok())
+			return "OK";
+
+		std::string msg;
+
+		auto append = [&](const char* setting, int err, const char* hint)
+			{
+				if (err == 0)
+					return;
+
+				if (!msg.empty())
+					msg += "\n";
+
+				msg += std::string(setting) + " refused: " + std::system_category().message(err) + " (" + std::to_string(err) + ")" + hint;
+			};
+
+#ifdef _WIN32
+		append(PRIORITY_NAME, priority_err, "");
+		append("CPU affinity", affinity_err, "");
+		append("Memory lock", memory_lock_err, "");
+#else
+		append(PRIORITY_NAME, priority_err, priority_err == EPERM ? ", requires CAP_SYS_NICE or an rtprio limit" : "");
+		append("CPU affinity", affinity_err, "");
+		append("Memory lock", memory_lock_err, memory_lock_err == EPERM || memory_lock_err == ENOMEM ? ", requires CAP_IPC_LOCK or a memlock limit" : "");
+#endif
+
+		return msg;
+	}
+
+	void setRealtimeConfig(const RealtimeConfig& config)
+	{
+		std::lock_guard lock(realtime_mutex);
+
+		realtime_config = config;
+		realtime_status = {};
+
+		bool lock_memory = config.enabled && config.lock_memory;
+
+		if (lock_memory && !memory_locked)
+		{
+			realtime_status.memory_lock_err = lockMemory();
+			memory_locked = realtime_status.memory_lock_err == 0;
+		}
+		else if (!lock_memory && memory_locked)
+		{
+			unlockMemory();
+			memory_locked = false;
+		}
+
+		realtime_generation.fetch_add(1, std::memory_order_release);
+	}
+
+	RealtimeConfig getRealtimeConfig()
+	{
+		std::lock_guard lock(realtime_mutex);
+
+		return realtime_config;
+	}
+
+	RealtimeStatus getRealtimeStatus()
+	{
+		std::lock_guard lock(realtime_mutex);
+
+		return realtime_status;
+	}
+
+	void updateThreadRealtime() noexcept
+	{
+		uint64_t generation = realtime_generation.load(std::memory_order_acquire);
+
+		if (generation == thread_generation)
+			return;
+
+		thread_generation = generation;
+
+		// the mutex is only taken when the config has changed, never whilst messages are being forwarded.
+		RealtimeConfig config = getRealtimeConfig();
+
+		int priority_err = 0;
+		int affinity_err = 0;
+
+		if (config.enabled)
+		{
+			priority_err = setThreadPriority(config.priority);
+
+			if (config.cpu_mask != 0)
+				affinity_err = setThreadAffinity(config.cpu_mask);
+			else
+				resetThreadAffinity();
+
+			if (config.prefault)
+				prefaultStack();
+
+			thread_realtime = true;
+		}
+		else if (thread_realtime)
+		{
+			resetThreadPriority();
+			resetThreadAffinity();
+
+			thread_realtime = false;
+		}
+		else
+		{
+			return;
+		}
+
+		std::lock_guard lock(realtime_mutex);
+
+		// the status of an older config is of no interest.
+		if (generation != realtime_generation.load(std::memory_order_relaxed))
+			return;
+
+		realtime_status.thread_count++;
+
+		if (priority_err != 0)
+			realtime_status.priority_err = priority_err;
+
+		if (affinity_err != 0)
+			realtime_status.affinity_err = affinity_err;
+	}
+
+	void prefault(void* data, size_t size) noexcept
+	{
+		if (size == 0)
+			return;
+
+		volatile char* bytes = (volatile char*)data;
+
+		// writing the same value back forces the page to be mapped, a read alone may only map the shared zero page.
+		for (size_t i = 0; i < size; i += PREFAULT_PAGE_SIZE)
+			bytes[i] = bytes[i];
+
+		bytes[size - 1] = bytes[size - 1];
+	}
+}
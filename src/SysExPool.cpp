@@ -0,0 +1,155 @@
+#include "SysExPool.h"
+#include "Echoer.h"
+
+#include <algorithm>
+
+namespace EchoMIDI
+{
+	// ============ Local defines ============
+
+	// defined in Echoer.cpp
+	void handleInputErr(MMRESULT err, UINT id);
+	void handleOutputErr(MMRESULT err, UINT id);
+
+	// ============ SysExPool ============
+
+	SysExPool::SysExPool(size_t block_count, size_t block_size)
+		: m_block_count(block_count), m_block_size(block_size),
+		m_payload(std::make_unique<char[]>(block_count * block_size)),
+		m_ref_counts(std::make_unique<std::atomic<uint32_t>[]>(block_count)),
+		m_in_headers(block_count)
+	{
+		for (size_t i = 0; i < m_block_count; i++)
+			m_ref_counts[i].store(0, std::memory_order_relaxed);
+	}
+
+	SysExPool::~SysExPool()
+	{
+		m_midi_in.store(NULL);
+	}
+
+	void SysExPool::attachInput(HMIDIIN midi_in, UINT id)
+	{
+		for (size_t i = 0; i < m_block_count; i++)
+		{
+			m_in_headers[i] = {};
+			m_in_headers[i].lpData = m_payload.get() + i * m_block_size;
+			m_in_headers[i].dwBufferLength = (DWORD)m_block_size;
+			m_in_headers[i].dwUser = i;
+
+			handleInputErr(midiInPrepareHeader(midi_in, &m_in_headers[i], sizeof(MIDIHDR)), id);
+		}
+
+		m_prepared_in = midi_in;
+		m_midi_in.store(midi_in, std::memory_order_release);
+
+		// blocks still being sent by an output are handed to the input device, as soon as they are released.
+		for (size_t i = 0; i < m_block_count; i++)
+		{
+			if (m_ref_counts[i].load(std::memory_order_acquire) == 0)
+				handleInputErr(midiInAddBuffer(midi_in, &m_in_headers[i], sizeof(MIDIHDR)), id);
+		}
+	}
+
+	void SysExPool::detachInput(UINT id)
+	{
+		if (m_prepared_in == NULL)
+			return;
+
+		m_midi_in.store(NULL, std::memory_order_release);
+
+		handleInputErr(midiInReset(m_prepared_in), id);
+
+		for (MIDIHDR& hdr : m_in_headers)
+			handleInputErr(midiInUnprepareHeader(m_prepared_in, &hdr, sizeof(MIDIHDR)), id);
+
+		m_prepared_in = NULL;
+	}
+
+	void SysExPool::attachOutput(HMIDIOUT midi_out, uint32_t slot, UINT id)
+	{
+		auto headers = std::make_unique<MIDIHDR[]>(m_block_count);
+
+		for (size_t i = 0; i < m_block_count; i++)
+		{
+			headers[i] = {};
+			headers[i].lpData = m_payload.get() + i * m_block_size;
+			headers[i].dwBufferLength = (DWORD)m_block_size;
+			headers[i].dwUser = i;
+
+			MMRESULT res = midiOutPrepareHeader(midi_out, &headers[i], sizeof(MIDIHDR));
+
+			if (res != MMSYSERR_NOERROR)
+			{
+				for (size_t j = 0; j < i; j++)
+					midiOutUnprepareHeader(midi_out, &headers[j], sizeof(MIDIHDR));
+
+				handleOutputErr(res, id);
+			}
+		}
+
+		m_out_headers[slot] = std::move(headers);
+		m_out_handles[slot] = midi_out;
+	}
+
+	void SysExPool::detachOutput(uint32_t slot, UINT id, bool reset)
+	{
+		if (!m_out_headers[slot])
+			return;
+
+		MIDIHDR* headers = m_out_headers[slot].get();
+		bool queued = !reset;
+
+		// resetting a shared device would also cut off the SysEx of every other Echoer sending to it.
+		for (auto deadline = std::chrono::steady_clock::now() + DETACH_TIMEOUT; queued && std::chrono::steady_clock::now() < deadline;)
+		{
+			queued = std::any_of(headers, headers + m_block_count, [](const MIDIHDR& hdr) { return (hdr.dwFlags & MHDR_INQUEUE) != 0; });
+
+			if (queued)
+				Sleep(1);
+		}
+
+		// any queued headers are marked as done, and their MOM_DONE callbacks release their blocks.
+		if (reset || queued)
+			handleOutputErr(midiOutReset(m_out_handles[slot]), id);
+
+		for (size_t i = 0; i < m_block_count; i++)
+			handleOutputErr(midiOutUnprepareHeader(m_out_handles[slot], &m_out_headers[slot][i], sizeof(MIDIHDR)), id);
+
+		m_out_headers[slot].reset();
+		m_out_handles[slot] = NULL;
+	}
+
+	void SysExPool::acquire(LPMIDIHDR in_hdr)
+	{
+		if (in_hdr->dwBytesRecorded == m_block_size)
+			m_full_blocks.fetch_add(1, std::memory_order_relaxed);
+
+		m_ref_counts[in_hdr->dwUser].store(1, std::memory_order_release);
+	}
+
+	LPMIDIHDR SysExPool::share(LPMIDIHDR in_hdr, uint32_t slot)
+	{
+		m_ref_counts[in_hdr->dwUser].fetch_add(1, std::memory_order_acq_rel);
+
+		// the payload address never changes, and the length only shrinks, so the header stays within its prepared region.
+		MIDIHDR& out_hdr = m_out_headers[slot][in_hdr->dwUser];
+		out_hdr.dwBufferLength = in_hdr->dwBytesRecorded;
+
+		return &out_hdr;
+	}
+
+	void SysExPool::release(LPMIDIHDR hdr)
+	{
+		size_t block = hdr->dwUser;
+
+		if (m_ref_counts[block].fetch_sub(1, std::memory_order_acq_rel) != 1)
+			return;
+
+		HMIDIIN midi_in = m_midi_in.load(std::memory_order_acquire);
+
+		// the block is free again, let the input device fill it with the next SysEx message.
+		if (midi_in != NULL)
+			midiInAddBuffer(midi_in, &m_in_headers[block], sizeof(MIDIHDR));
+	}
+}
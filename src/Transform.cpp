@@ -0,0 +1,60 @@
+#include "Transform.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace EchoMIDI
+{
+	bool TransformRules::isIdentity() const
+	{
+		return *this == TransformRules();
+	}
+
+	TransformTable TransformRules::compile() const
+	{
+		TransformTable table;
+
+		// status filter, channel messages are filtered by both their type and channel.
+		table.status_mask = {};
+
+		for (uint32_t status = 0x80; status <= 0xFF; status++)
+		{
+			bool pass;
+
+			if (status >= 0xF0)
+				pass = type_mask & SYSTEM;
+			else
+				pass = (type_mask >> ((status >> 4) - 0x8) & 1) && (channel_mask >> (status & 0x0F) & 1);
+
+			if (pass)
+				table.status_mask[status >> 6] |= 1ull << (status & 63);
+		}
+
+		for (size_t channel = 0; channel < 16; channel++)
+			table.channel_map[channel] = channel_map[channel] & 0x0F;
+
+		for (int note = 0; note < 128; note++)
+		{
+			int out_note = note + transpose;
+
+			if (note < note_low || note > note_high || out_note < 0 || out_note > 127)
+				table.note_map[note] = TransformTable::NOTE_DROPPED;
+			else
+				table.note_map[note] = (uint8_t)out_note;
+		}
+
+		uint8_t low = std::clamp<uint8_t>(velocity_min, 1, 127);
+		uint8_t high = std::clamp<uint8_t>(velocity_max, low, 127);
+
+		table.velocity_map[0] = 0;
+
+		for (int velocity = 1; velocity < 128; velocity++)
+		{
+			double curved = std::pow(velocity / 127.0, (double)std::max(velocity_curve, 0.01f));
+
+			table.velocity_map[velocity] = (uint8_t)std::clamp<long>(std::lround(low + curved * (high - low)), low, high);
+		}
+
+		return table;
+	}
+}
@@ -0,0 +1,113 @@
+#include "WinMMBackend.h"
+
+namespace EchoMIDI
+{
+	// ============ Local defines ============
+
+	// translates winmm input messages into InputCallbacks calls.
+	void CALLBACK winmmInputProc(HMIDIIN hMidiIn, UINT wMsg, DWORD_PTR dwInstance, DWORD_PTR dwParam1, DWORD_PTR dwParam2)
+	{
+		const InputCallbacks* callbacks = (const InputCallbacks*)dwInstance;
+
+		if (wMsg == MIM_DATA)
+		{
+			callbacks->on_short(callbacks->user, (uint32_t)dwParam1, (DWORD)dwParam2);
+		}
+		else if (wMsg == MIM_LONGDATA)
+		{
+			LPMIDIHDR hdr = (LPMIDIHDR)dwParam1;
+
+			// blocks returned by midiInReset() carry no data, but are still passed on, so their owner can add them again.
+			callbacks->on_long(callbacks->user, (const uint8_t*)hdr->lpData, hdr->dwBytesRecorded, (DWORD)dwParam2);
+		}
+	}
+
+	// wakes sendLong() up once the driver is done with its header.
+	void CALLBACK winmmOutputProc(HMIDIOUT hMidiOut, UINT wMsg, DWORD_PTR dwInstance, DWORD_PTR dwParam1, DWORD_PTR dwParam2)
+	{
+		if (wMsg == MOM_DONE)
+			WinMMBackend::notifyDone((LPMIDIHDR)dwParam1);
+	}
+
+	// ============ WinMMBackend ============
+
+	MMRESULT WinMMBackend::getInputName(UINT id, std::string& name)
+	{
+		MIDIINCAPS midi_info;
+		MMRESULT res = midiInGetDevCaps(id, &midi_info, sizeof(MIDIINCAPS));
+
+		if (res == MMSYSERR_NOERROR)
+			name = midi_info.szPname;
+
+		return res;
+	}
+
+	MMRESULT WinMMBackend::getOutputName(UINT id, std::string& name)
+	{
+		MIDIOUTCAPS midi_info;
+		MMRESULT res = midiOutGetDevCaps(id, &midi_info, sizeof(MIDIOUTCAPS));
+
+		if (res == MMSYSERR_NOERROR)
+			name = midi_info.szPname;
+
+		return res;
+	}
+
+	MMRESULT WinMMBackend::openInput(InputHandle& handle, UINT id, const InputCallbacks& callbacks)
+	{
+		return midiInOpen(&handle, id, (DWORD_PTR)&winmmInputProc, (DWORD_PTR)&callbacks, CALLBACK_FUNCTION);
+	}
+
+	MMRESULT WinMMBackend::openOutput(OutputHandle& handle, UINT id)
+	{
+		return midiOutOpen(&handle, id, (DWORD_PTR)&winmmOutputProc, NULL, CALLBACK_FUNCTION);
+	}
+
+	MMRESULT WinMMBackend::sendLong(OutputHandle handle, const uint8_t* data, size_t length)
+	{
+		MIDIHDR hdr = {};
+		hdr.lpData = (LPSTR)data;
+		hdr.dwBufferLength = (DWORD)length;
+		hdr.dwBytesRecorded = (DWORD)length;
+
+		MMRESULT res = midiOutPrepareHeader(handle, &hdr, sizeof(MIDIHDR));
+
+		if (res != MMSYSERR_NOERROR)
+			return res;
+
+		res = midiOutLongMsg(handle, &hdr, sizeof(MIDIHDR));
+
+		// the driver sets MHDR_DONE once it has sent the message.
+		if (res == MMSYSERR_NOERROR)
+			waitDone(hdr);
+
+		midiOutUnprepareHeader(handle, &hdr, sizeof(MIDIHDR));
+
+		return res;
+	}
+
+	void WinMMBackend::waitDone(const MIDIHDR& hdr)
+	{
+		// the driver sets MHDR_DONE before it calls the output callback, so the flags are checked again after every wake up.
+		DWORD flags;
+
+		while (!((flags = hdr.dwFlags) & MHDR_DONE))
+			WaitOnAddress((volatile void*)&hdr.dwFlags, &flags, sizeof(DWORD), INFINITE);
+	}
+
+	MMRESULT WinMMBackend::sendBatch(OutputHandle handle, const uint32_t* msgs, size_t count)
+	{
+		MMRESULT first_err = MMSYSERR_NOERROR;
+
+		// a failed message does not stop the rest of the batch from being sent.
+		for (size_t i = 0; i < count; i++)
+		{
+			MMRESULT res = midiOutShortMsg(handle, msgs[i]);
+
+			if (first_err == MMSYSERR_NOERROR)
+				first_err = res;
+		}
+
+		return first_err;
+	}
+}